@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_chacha20.h"
 #include "iqr_context.h"
 #include "iqr_mac.h"
@@ -246,14 +247,8 @@ static iqr_retval append_length(iqr_MAC *poly1305_obj, size_t length)
 
 static iqr_retval init_toolkit(iqr_Context **ctx)
 {
-    /* Create an IQR Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    return IQR_OK;
+    /* Create an IQR Context. These algorithms don't need any hashes. */
+    return bootstrap_context(NULL, 0, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -407,6 +402,6 @@ cleanup:
     }
     free(key_data);
     key_data = NULL;
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
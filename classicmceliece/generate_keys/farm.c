@@ -0,0 +1,270 @@
+/** @file farm.c
+ *
+ * @brief Generate many Classic McEliece key pairs in parallel.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "farm.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "rng_pool.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Shared state.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const iqr_ClassicMcElieceParams *params;
+    rng_pool *rngs;
+    size_t pub_size;
+    size_t priv_size;
+
+    const char *pub_file;
+    const char *priv_file;
+    uint32_t count;
+    int width;
+
+    /* Next key pair to generate; threads take them with an atomic add. */
+    uint32_t next;
+    /* Set when any thread fails, so the others stop taking work. */
+    int failed;
+
+    /* Guards done and the progress output. */
+    pthread_mutex_t lock;
+    uint32_t done;
+    uint64_t start_ns;
+} farm_state;
+
+/* Build "dir/name-07.ext" from "dir/name.ext". */
+static iqr_retval numbered_name(const char *pattern, uint32_t n, int width, char **name)
+{
+    const char *base = strrchr(pattern, '/');
+    base = (base == NULL) ? pattern : base + 1;
+    const char *dot = strrchr(base, '.');
+    /* A leading dot is part of the name, not an extension. */
+    const size_t stem_len = (dot == NULL || dot == base) ? strlen(pattern) : (size_t)(dot - pattern);
+    const char *ext = pattern + stem_len;
+
+    const size_t name_size = strlen(pattern) + 16;
+    *name = calloc(1, name_size);
+    if (*name == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    snprintf(*name, name_size, "%.*s-%0*u%s", (int)stem_len, pattern, width, n, ext);
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Worker threads.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval make_key_pair(farm_state *farm, const iqr_RNG *rng, uint32_t n, uint8_t *pub_raw, uint8_t *priv_raw)
+{
+    iqr_ClassicMcEliecePublicKey *pub = NULL;
+    iqr_ClassicMcEliecePrivateKey *priv = NULL;
+    char *pub_name = NULL;
+    char *priv_name = NULL;
+
+    iqr_retval ret = iqr_ClassicMcElieceCreateKeyPair(farm->params, rng, &pub, &priv);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceCreateKeyPair(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = iqr_ClassicMcElieceExportPublicKey(pub, pub_raw, farm->pub_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceExportPublicKey(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+    ret = iqr_ClassicMcElieceExportPrivateKey(priv, priv_raw, farm->priv_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceExportPrivateKey(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = numbered_name(farm->pub_file, n, farm->width, &pub_name);
+    if (ret == IQR_OK) {
+        ret = numbered_name(farm->priv_file, n, farm->width, &priv_name);
+    }
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Write the private key first; a public key without its private key is
+     * no use to anyone.
+     */
+    ret = save_data_durable(priv_name, priv_raw, farm->priv_size, true);
+    if (ret == IQR_OK) {
+        ret = save_data_durable(pub_name, pub_raw, farm->pub_size, false);
+    }
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    pthread_mutex_lock(&farm->lock);
+    farm->done++;
+    const double minutes = (double)(time_now_ns() - farm->start_ns) / 60e9;
+    fprintf(stdout, "[%*u/%u] Saved %s and %s (%.1f key pairs/minute)\n", farm->width, farm->done, farm->count, pub_name,
+        priv_name, (minutes > 0.0) ? (double)farm->done / minutes : 0.0);
+    fflush(stdout);
+    pthread_mutex_unlock(&farm->lock);
+
+end:
+    /* (Private) Keys are private, sensitive data, be sure to clear memory
+     * containing them when you're done.
+     */
+    secure_memzero(priv_raw, farm->priv_size);
+
+    iqr_ClassicMcElieceDestroyPublicKey(&pub);
+    iqr_ClassicMcElieceDestroyPrivateKey(&priv);
+    free(pub_name);
+    free(priv_name);
+
+    return ret;
+}
+
+static void *farm_thread(void *arg)
+{
+    farm_state *farm = arg;
+    iqr_RNG *rng = NULL;
+
+    uint8_t *pub_raw = calloc(1, farm->pub_size);
+    uint8_t *priv_raw = calloc(1, farm->priv_size);
+    iqr_retval ret = IQR_OK;
+    if (pub_raw == NULL || priv_raw == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+    } else {
+        ret = rng_pool_thread_rng(farm->rngs, &rng);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on rng_pool_thread_rng(): %s\n", iqr_StrError(ret));
+        }
+    }
+
+    while (ret == IQR_OK && !__atomic_load_n(&farm->failed, __ATOMIC_RELAXED)) {
+        const uint32_t n = __atomic_fetch_add(&farm->next, 1, __ATOMIC_RELAXED);
+        if (n >= farm->count) {
+            break;
+        }
+        ret = make_key_pair(farm, rng, n + 1, pub_raw, priv_raw);
+    }
+
+    if (ret != IQR_OK) {
+        __atomic_store_n(&farm->failed, 1, __ATOMIC_RELAXED);
+    }
+
+    free(pub_raw);
+    free(priv_raw);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Running the farm.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval generate_key_farm(const iqr_Context *ctx, const iqr_ClassicMcElieceParams *params, uint32_t count, uint32_t threads,
+    const char *pub_file, const char *priv_file)
+{
+    if (ctx == NULL || params == NULL || pub_file == NULL || priv_file == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (count == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    farm_state farm;
+    memset(&farm, 0, sizeof(farm));
+    farm.params = params;
+    farm.pub_file = pub_file;
+    farm.priv_file = priv_file;
+    farm.count = count;
+    farm.width = snprintf(NULL, 0, "%u", count);
+
+    iqr_retval ret = iqr_ClassicMcElieceGetPublicKeySize(params, &farm.pub_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceGetPublicKeySize(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    ret = iqr_ClassicMcElieceGetPrivateKeySize(params, &farm.priv_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceGetPrivateKeySize(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    ret = rng_pool_create(ctx, NULL, &farm.rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    if (threads == 0) {
+        threads = online_cpus();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+
+    pthread_t *tids = calloc(threads, sizeof(*tids));
+    if (tids == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        rng_pool_destroy(&farm.rngs);
+        return IQR_ENOMEM;
+    }
+    pthread_mutex_init(&farm.lock, NULL);
+
+    fprintf(stdout, "Generating %u ClassicMcEliece key pairs on %u threads.\n", count, threads);
+    farm.start_ns = time_now_ns();
+
+    uint32_t started = 0;
+    for (; started < threads; started++) {
+        const int rc = pthread_create(&tids[started], NULL, farm_thread, &farm);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            break;
+        }
+    }
+    if (started == 0) {
+        ret = IQR_ENOMEM;
+    }
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    const double minutes = (double)(time_now_ns() - farm.start_ns) / 60e9;
+    if (farm.failed) {
+        ret = IQR_EBADVALUE;
+    }
+    if (ret == IQR_OK) {
+        fprintf(stdout, "Generated %u key pairs in %.1f minutes (%.1f key pairs/minute).\n", farm.done, minutes,
+            (minutes > 0.0) ? (double)farm.done / minutes : 0.0);
+    } else {
+        fprintf(stderr, "Only %u of %u key pairs were generated.\n", farm.done, count);
+    }
+
+    pthread_mutex_destroy(&farm.lock);
+    free(tids);
+    rng_pool_destroy(&farm.rngs);
+
+    return ret;
+}
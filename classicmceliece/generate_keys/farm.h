@@ -0,0 +1,53 @@
+/** @file farm.h
+ *
+ * @brief Generate many Classic McEliece key pairs in parallel.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FARM_H
+#define FARM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_classicmceliece.h"
+#include "iqr_context.h"
+#include "iqr_retval.h"
+
+/** Generate @a count key pairs on a pool of threads.
+ *
+ * Each thread has its own DRBG, seeded from the operating system. As soon as
+ * a key pair is ready its keys are exported and written with
+ * save_data_durable(), so a crash part way through keeps every key pair
+ * that was reported as written. Key pair `n` (counting from 1) goes to the
+ * given file names with "-n" inserted before the extension, zero-padded to
+ * the width of @a count: "pub.key" becomes "pub-07.key" when there are 32
+ * key pairs.
+ *
+ * A line of progress, with the rate so far in key pairs per minute, is
+ * printed to stdout as each key pair is written.
+ *
+ * @param ctx       The toolkit context. SHA2-256 must be registered.
+ * @param params    Classic McEliece parameters.
+ * @param count     Number of key pairs.
+ * @param threads   Number of threads, or 0 for one per online CPU.
+ * @param pub_file  Public key file name pattern.
+ * @param priv_file Private key file name pattern.
+ */
+iqr_retval generate_key_farm(const iqr_Context *ctx, const iqr_ClassicMcElieceParams *params, uint32_t count, uint32_t threads,
+    const char *pub_file, const char *priv_file);
+
+#endif
@@ -18,29 +18,36 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_classicmceliece.h"
 #include "iqr_context.h"
 #include "iqr_retval.h"
 #include "iqr_rng.h"
 #include "isara_samples.h"
 
+#include "farm.h"
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static const char *usage_msg =
 "classicmceliece_generate_keys [--variant 6|8] [--pub <filename>]\n"
-"    [--priv <filename>]\n"
+"    [--priv <filename>] [--count <count>] [--threads <count>]\n"
 "    Default for the sample (when no option is specified):\n"
 "        --variant 6\n"
 "        --pub pub.key\n"
-"        --priv priv.key\n";
+"        --priv priv.key\n"
+"        --count 1\n"
+"        --threads 0 (one per CPU)\n"
+"  With --count greater than 1, that many key pairs are generated on\n"
+"  --threads threads and numbered: pub-1.key, pub-2.key and so on.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases the generation of Classic McEliece public and
@@ -170,37 +177,18 @@ static iqr_retval showcase_classicmceliece_params_creation(const iqr_Context *ct
 
 static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 {
-    /* Create a context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
     fprintf(stdout, "The context has been created.\n");
 
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* Create an HMAC DRBG object. */
-    ret = iqr_RNGCreateHMACDRBG(*ctx, IQR_HASHALGO_SHA2_256, rng);
+    /* Create an HMAC DRBG object, seeded from the system's entropy source. */
+    ret = bootstrap_rng(IQR_HASHALGO_SHA2_256, rng);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* The seed should be initialized from a guaranteed entropy source. This is
-     * only an example; DO NOT INITIALIZE THE SEED LIKE THIS.
-     */
-    time_t seed = time(NULL);
-
-    ret = iqr_RNGInitialize(*rng, (void *) &seed, sizeof(seed));
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -219,11 +207,16 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 // Report the chosen runtime parameters.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static void preamble(const char *cmd, const iqr_ClassicMcElieceVariant *variant, const char * pub, const char * priv)
+static void preamble(const char *cmd, const iqr_ClassicMcElieceVariant *variant, const char * pub, const char * priv,
+    uint32_t count, uint32_t threads)
 {
     fprintf(stdout, "Running %s with the following parameters:\n", cmd);
     fprintf(stdout, "    public key file: %s\n", pub);
     fprintf(stdout, "    private key file: %s\n", priv);
+    if (count > 1) {
+        fprintf(stdout, "    key pairs: %u\n", count);
+        fprintf(stdout, "    threads: %u\n", threads);
+    }
     if (variant == &IQR_CLASSICMCELIECE_6) {
         fprintf(stdout, "    variant: 6\n");
     } else {
@@ -231,9 +224,30 @@ static void preamble(const char *cmd, const iqr_ClassicMcElieceVariant *variant,
     }
 }
 
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
 /* Parse the command line options. */
 static iqr_retval parse_commandline(int argc, const char **argv, const iqr_ClassicMcElieceVariant **variant,
-    const char **public_key_file, const char **private_key_file)
+    const char **public_key_file, const char **private_key_file, uint32_t *count, uint32_t *threads)
 {
     int i = 1;
     while (i != argc) {
@@ -245,6 +259,24 @@ static iqr_retval parse_commandline(int argc, const char **argv, const iqr_Class
             /* [--priv <filename>] */
             i++;
             *private_key_file = argv[i];
+        } else if (paramcmp(argv[i], "--count") == 0) {
+            /* [--count <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *count = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)value;
         } else if (paramcmp(argv[i], "--variant") == 0) {
             /* [--variant 6|8] */
             i++;
@@ -277,6 +309,8 @@ int main(int argc, const char **argv)
     const iqr_ClassicMcElieceVariant *variant = &IQR_CLASSICMCELIECE_6;
     const char *public_key_file = "pub.key";
     const char *private_key_file = "priv.key";
+    uint32_t count = 1;
+    uint32_t threads = 0;
 
     iqr_Context * ctx = NULL;
     iqr_RNG *rng = NULL;
@@ -285,13 +319,14 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &variant, &public_key_file, &private_key_file);
+    iqr_retval ret = parse_commandline(argc, argv, &variant, &public_key_file, &private_key_file, &count,
+        &threads);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Show the parameters for the program. */
-    preamble(argv[0], variant, public_key_file, private_key_file);
+    preamble(argv[0], variant, public_key_file, private_key_file, count, threads);
 
     /* IQR toolkit initialization. */
     ret = init_toolkit(&ctx, &rng);
@@ -305,12 +340,19 @@ int main(int argc, const char **argv)
         goto cleanup;
     }
 
+    if (count > 1) {
+        /* Key generation takes a long time, so spread many key pairs over
+         * several threads.
+         */
+        ret = generate_key_farm(ctx, parameters, count, threads, public_key_file, private_key_file);
+        goto cleanup;
+    }
+
     /* Showcase the generation of ClassicMcEliece public/private keys. */
     ret = showcase_classicmceliece_key_gen(parameters, rng, public_key_file, private_key_file);
 
 cleanup:
     iqr_ClassicMcElieceDestroyParams(&parameters);
-    iqr_RNGDestroy(&rng);
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,274 @@
+/** @file bootstrap.c
+ *
+ * @brief Set up the toolkit once per thread: a context, its hashes and DRBGs.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bootstrap.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "isara_samples.h"
+
+/* More than the toolkit has hash algorithms. */
+#define BOOTSTRAP_MAX_HASHES 8
+
+/* More than the toolkit has hash algorithms to build a DRBG on. */
+#define BOOTSTRAP_MAX_RNGS 8
+
+/* Bytes of seed for each DRBG. */
+#define BOOTSTRAP_SEED_SIZE 32
+
+typedef struct {
+    iqr_HashAlgorithmType hash;
+    iqr_RNG *rng;
+} bootstrap_rng_slot;
+
+/* One thread's toolkit objects. Thread-local storage rather than a
+ * pthread_key_t keeps pthreads out of the samples that don't otherwise use
+ * threads; the price is that threads have to call bootstrap_release()
+ * themselves.
+ */
+typedef struct {
+    iqr_Context *ctx;
+
+    iqr_HashAlgorithmType hashes[BOOTSTRAP_MAX_HASHES];
+    size_t hash_count;
+
+    bootstrap_rng_slot rngs[BOOTSTRAP_MAX_RNGS];
+    size_t rng_count;
+} bootstrap_thread;
+
+static __thread bootstrap_thread current;
+
+static bootstrap_stats totals;
+
+static void add_cost(uint64_t *count, uint64_t *ns, uint64_t start)
+{
+    __atomic_add_fetch(count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(ns, time_now_ns() - start, __ATOMIC_RELAXED);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Contexts and hashes.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_registered(const bootstrap_thread *t, iqr_HashAlgorithmType hash)
+{
+    for (size_t i = 0; i < t->hash_count; i++) {
+        if (t->hashes[i] == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static iqr_retval register_hash(bootstrap_thread *t, iqr_HashAlgorithmType hash, bool *did_work)
+{
+    if (is_registered(t, hash)) {
+        return IQR_OK;
+    }
+    if (t->hash_count == BOOTSTRAP_MAX_HASHES) {
+        return IQR_EOUTOFRANGE;
+    }
+
+    const iqr_HashCallbacks *cb = default_hash_callbacks(hash);
+    if (cb == NULL) {
+        fprintf(stderr, "No default implementation for hash algorithm %d\n", (int)hash);
+        return IQR_EINVALGOTYPE;
+    }
+
+    const uint64_t start = time_now_ns();
+    iqr_retval ret = iqr_HashRegisterCallbacks(t->ctx, hash, cb);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    add_cost(&totals.hashes, &totals.hash_ns, start);
+
+    t->hashes[t->hash_count++] = hash;
+    *did_work = true;
+    return IQR_OK;
+}
+
+static iqr_retval thread_context(bootstrap_thread *t, bool *did_work)
+{
+    if (t->ctx != NULL) {
+        return IQR_OK;
+    }
+
+    const uint64_t start = time_now_ns();
+    iqr_retval ret = iqr_CreateContext(&t->ctx);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    add_cost(&totals.contexts, &totals.context_ns, start);
+
+    *did_work = true;
+    return IQR_OK;
+}
+
+iqr_retval bootstrap_context(const iqr_HashAlgorithmType *hashes, size_t hash_count, iqr_Context **ctx)
+{
+    if ((hashes == NULL && hash_count != 0) || ctx == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    bootstrap_thread *t = &current;
+    bool did_work = false;
+
+    iqr_retval ret = thread_context(t, &did_work);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    for (size_t i = 0; i < hash_count; i++) {
+        ret = register_hash(t, hashes[i], &did_work);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+
+    if (!did_work) {
+        __atomic_add_fetch(&totals.cached, 1, __ATOMIC_RELAXED);
+    }
+
+    *ctx = t->ctx;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// DRBGs.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval create_rng(const bootstrap_thread *t, iqr_HashAlgorithmType hash, iqr_RNG **rng)
+{
+    uint8_t seed[BOOTSTRAP_SEED_SIZE] = { 0 };
+
+    iqr_retval ret = iqr_RNGCreateHMACDRBG(t->ctx, hash, rng);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    ret = get_system_entropy(seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on get_system_entropy(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = iqr_RNGInitialize(*rng, seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
+    }
+
+end:
+    secure_memzero(seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        iqr_RNGDestroy(rng);
+    }
+    return ret;
+}
+
+iqr_retval bootstrap_rng(iqr_HashAlgorithmType hash, iqr_RNG **rng)
+{
+    if (rng == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    bootstrap_thread *t = &current;
+    for (size_t i = 0; i < t->rng_count; i++) {
+        if (t->rngs[i].hash == hash) {
+            __atomic_add_fetch(&totals.cached, 1, __ATOMIC_RELAXED);
+            *rng = t->rngs[i].rng;
+            return IQR_OK;
+        }
+    }
+    if (t->rng_count == BOOTSTRAP_MAX_RNGS) {
+        return IQR_EOUTOFRANGE;
+    }
+
+    bool did_work = false;
+    iqr_retval ret = thread_context(t, &did_work);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    ret = register_hash(t, hash, &did_work);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint64_t start = time_now_ns();
+    iqr_RNG *tmp = NULL;
+    ret = create_rng(t, hash, &tmp);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    add_cost(&totals.rngs, &totals.rng_ns, start);
+
+    t->rngs[t->rng_count].hash = hash;
+    t->rngs[t->rng_count].rng = tmp;
+    t->rng_count++;
+
+    *rng = tmp;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Clean-up and statistics.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+void bootstrap_release(void)
+{
+    bootstrap_thread *t = &current;
+
+    for (size_t i = 0; i < t->rng_count; i++) {
+        iqr_RNGDestroy(&t->rngs[i].rng);
+    }
+    if (t->ctx != NULL) {
+        iqr_DestroyContext(&t->ctx);
+    }
+
+    memset(t, 0, sizeof(*t));
+}
+
+void bootstrap_get_stats(bootstrap_stats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    stats->contexts = __atomic_load_n(&totals.contexts, __ATOMIC_RELAXED);
+    stats->context_ns = __atomic_load_n(&totals.context_ns, __ATOMIC_RELAXED);
+    stats->hashes = __atomic_load_n(&totals.hashes, __ATOMIC_RELAXED);
+    stats->hash_ns = __atomic_load_n(&totals.hash_ns, __ATOMIC_RELAXED);
+    stats->rngs = __atomic_load_n(&totals.rngs, __ATOMIC_RELAXED);
+    stats->rng_ns = __atomic_load_n(&totals.rng_ns, __ATOMIC_RELAXED);
+    stats->cached = __atomic_load_n(&totals.cached, __ATOMIC_RELAXED);
+}
+
+void bootstrap_print_stats(FILE *out)
+{
+    bootstrap_stats stats;
+    bootstrap_get_stats(&stats);
+
+    fprintf(out, "Toolkit set-up: contexts %llu (%.1f us), hashes %llu (%.1f us), DRBGs %llu (%.1f us), cached requests %llu\n",
+        (unsigned long long)stats.contexts, (double)stats.context_ns / 1000.0, (unsigned long long)stats.hashes,
+        (double)stats.hash_ns / 1000.0, (unsigned long long)stats.rngs, (double)stats.rng_ns / 1000.0,
+        (unsigned long long)stats.cached);
+}
@@ -0,0 +1,96 @@
+/** @file bootstrap.h
+ *
+ * @brief Set up the toolkit once per thread: a context, its hashes and DRBGs.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BOOTSTRAP_H
+#define BOOTSTRAP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/* Every thread gets its own context and DRBGs, made the first time it asks
+ * for them and kept until it calls bootstrap_release(). Asking again costs a
+ * scan of a short list, so code that runs many times on the same thread can
+ * just ask every time.
+ *
+ * The context and DRBGs belong to the bootstrap; don't destroy them
+ * yourself.
+ */
+
+/** Get the calling thread's context, with some hashes registered.
+ *
+ * The first call on a thread creates the context. Each hash is registered,
+ * with the toolkit's default implementation, the first time it's asked for,
+ * so a context only ever holds the hashes its thread has needed.
+ *
+ * @param hashes        The hash algorithms that must be registered; may be
+ *                      NULL if @a hash_count is 0.
+ * @param hash_count    Number of entries in @a hashes.
+ * @param ctx           A pointer that will receive the context.
+ */
+iqr_retval bootstrap_context(const iqr_HashAlgorithmType *hashes, size_t hash_count, iqr_Context **ctx);
+
+/** Get the calling thread's HMAC-DRBG for a hash.
+ *
+ * The first call on a thread for each hash registers it in the thread's
+ * context, creates the DRBG and seeds it from get_system_entropy().
+ *
+ * @param hash  The DRBG's hash algorithm.
+ * @param rng   A pointer that will receive the DRBG.
+ */
+iqr_retval bootstrap_rng(iqr_HashAlgorithmType hash, iqr_RNG **rng);
+
+/** Destroy the calling thread's DRBGs and context.
+ *
+ * Call this at the end of main(), and before any other thread that used the
+ * bootstrap exits. Pointers the thread got from the bootstrap are invalid
+ * afterwards; the next request starts over.
+ */
+void bootstrap_release(void);
+
+/** What setting up the toolkit has cost so far, over all threads. */
+typedef struct {
+    /** Contexts created, and the time spent creating them. */
+    uint64_t contexts;
+    uint64_t context_ns;
+    /** Hashes registered, and the time spent registering them. */
+    uint64_t hashes;
+    uint64_t hash_ns;
+    /** DRBGs created and seeded, and the time that took. */
+    uint64_t rngs;
+    uint64_t rng_ns;
+    /** Requests answered without creating or registering anything. */
+    uint64_t cached;
+} bootstrap_stats;
+
+/** Get the process's set-up costs so far.
+ *
+ * @param stats     Receives the totals.
+ */
+void bootstrap_get_stats(bootstrap_stats *stats);
+
+/** Print the process's set-up costs so far on one line. */
+void bootstrap_print_stats(FILE *out);
+
+#endif
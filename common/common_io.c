@@ -23,6 +23,13 @@
 #include <stdio.h>
 #include <string.h>
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Generic POSIX file stream I/O operations.
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -126,3 +133,260 @@ end:
     fp = NULL;
     return ret;
 }
+
+iqr_retval load_text(const char *fname, char **text, size_t *text_size)
+{
+    if (fname == NULL || text == NULL || text_size == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    uint8_t *data = NULL;
+    size_t data_size = 0;
+    iqr_retval ret = load_data(fname, &data, &data_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Grow the buffer by one byte for the terminator; the last line might not
+     * end in a newline that a parser could overwrite.
+     */
+    uint8_t *tmp = realloc(data, data_size + 1);
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on realloc(): %s\n", strerror(errno));
+        free(data);
+        return IQR_ENOMEM;
+    }
+    tmp[data_size] = '\0';
+
+    *text = (char *)tmp;
+    *text_size = data_size;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Memory-mapped input.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(_WIN32) || defined(_WIN64)
+
+iqr_retval map_data(const char *fname, const uint8_t **data, size_t *data_size)
+{
+    /* No mmap() here; fall back to reading the file. */
+    uint8_t *tmp = NULL;
+    size_t tmp_size = 0;
+    iqr_retval ret = load_data(fname, &tmp, &tmp_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    *data = tmp;
+    *data_size = tmp_size;
+    return IQR_OK;
+}
+
+void unmap_data(const uint8_t *data, size_t data_size)
+{
+    (void)data_size;
+    free((void *)(uintptr_t)data);
+}
+
+#else
+
+iqr_retval map_data(const char *fname, const uint8_t **data, size_t *data_size)
+{
+    *data = NULL;
+    *data_size = 0;
+
+    const int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    iqr_retval ret = IQR_OK;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed on fstat(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+    if ((uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    /* Like load_data(), an empty file gives NULL and 0. */
+    if (st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Failed on mmap(): %s\n", strerror(errno));
+            ret = IQR_EBADVALUE;
+            goto end;
+        }
+        *data = map;
+        *data_size = (size_t)st.st_size;
+    }
+
+end:
+    /* The mapping stays valid after the descriptor is closed. */
+    close(fd);
+    return ret;
+}
+
+void unmap_data(const uint8_t *data, size_t data_size)
+{
+    if (data != NULL) {
+        munmap((void *)(uintptr_t)data, data_size);
+    }
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Durable output.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(_WIN32) || defined(_WIN64)
+
+iqr_retval save_data_durable(const char *fname, const uint8_t *data, size_t data_size, bool secret)
+{
+    /* No fsync() or atomic rename over an existing file here; write the file
+     * in place and flush it as far as stdio allows.
+     */
+    (void)secret;
+
+    FILE *fp = fopen(fname, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    iqr_retval ret = IQR_OK;
+    if (fwrite(data, 1, data_size, fp) != data_size || fflush(fp) != 0) {
+        fprintf(stderr, "Failed on fwrite(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+    fclose(fp);
+    return ret;
+}
+
+#else
+
+/* Flush the directory holding fname, so a rename into it is durable too. */
+static iqr_retval sync_parent_directory(const char *fname)
+{
+    /* "a/b" -> "a", "/b" -> "/", "b" -> "." */
+    const char *slash = strrchr(fname, '/');
+    const size_t dir_len = (slash == NULL) ? 0 : (slash == fname) ? 1 : (size_t)(slash - fname);
+    char *dir = calloc(1, dir_len + 2);
+    if (dir == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    if (dir_len == 0) {
+        dir[0] = '.';
+    } else {
+        memcpy(dir, fname, dir_len);
+    }
+
+    iqr_retval ret = IQR_OK;
+    const int fd = open(dir, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", dir, strerror(errno));
+        ret = IQR_EBADVALUE;
+    } else {
+        if (fsync(fd) != 0) {
+            fprintf(stderr, "Failed on fsync(): %s\n", strerror(errno));
+            ret = IQR_EBADVALUE;
+        }
+        close(fd);
+    }
+
+    free(dir);
+    return ret;
+}
+
+iqr_retval save_data_durable(const char *fname, const uint8_t *data, size_t data_size, bool secret)
+{
+    const size_t tmp_name_size = strlen(fname) + sizeof(".tmp");
+    char *tmp_name = calloc(1, tmp_name_size);
+    if (tmp_name == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    snprintf(tmp_name, tmp_name_size, "%s.tmp", fname);
+
+    iqr_retval ret = IQR_OK;
+    const int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, secret ? 0600 : 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", tmp_name, strerror(errno));
+        free(tmp_name);
+        return IQR_EBADVALUE;
+    }
+
+    size_t written = 0;
+    while (written < data_size) {
+        const ssize_t n = write(fd, data + written, data_size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "Failed on write(): %s\n", strerror(errno));
+            ret = IQR_EBADVALUE;
+            break;
+        }
+        written += (size_t)n;
+    }
+
+    if (ret == IQR_OK && fsync(fd) != 0) {
+        fprintf(stderr, "Failed on fsync(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+    if (close(fd) != 0 && ret == IQR_OK) {
+        fprintf(stderr, "Failed on close(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+
+    if (ret == IQR_OK && rename(tmp_name, fname) != 0) {
+        fprintf(stderr, "Failed to rename %s to %s: %s\n", tmp_name, fname, strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+    if (ret != IQR_OK) {
+        unlink(tmp_name);
+    } else {
+        ret = sync_parent_directory(fname);
+    }
+
+    free(tmp_name);
+    return ret;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Byte order.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+void put_u32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = (uint8_t)(value >> 24);
+    buf[1] = (uint8_t)(value >> 16);
+    buf[2] = (uint8_t)(value >> 8);
+    buf[3] = (uint8_t)value;
+}
+
+void put_u64(uint8_t *buf, uint64_t value)
+{
+    put_u32(buf, (uint32_t)(value >> 32));
+    put_u32(buf + 4, (uint32_t)value);
+}
+
+uint32_t get_u32(const uint8_t *buf)
+{
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+}
+
+uint64_t get_u64(const uint8_t *buf)
+{
+    return ((uint64_t)get_u32(buf) << 32) | (uint64_t)get_u32(buf + 4);
+}
@@ -0,0 +1,189 @@
+/** @file dh_load.c
+ *
+ * @brief Run many key agreement handshakes at once and measure throughput.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dh_load.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "isara_samples.h"
+#include "rng_pool.h"
+
+typedef struct {
+    const dh_load_ops *ops;
+    const void *arg;
+    rng_pool *rngs;
+
+    uint64_t total;
+    uint64_t next;
+    uint64_t handshakes;
+    uint64_t failures;
+} load_state;
+
+typedef struct {
+    load_state *state;
+    pthread_t thread;
+} load_worker;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The worker threads.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void *load_thread(void *arg)
+{
+    load_worker *worker = arg;
+    load_state *state = worker->state;
+
+    uint64_t handshakes = 0;
+    uint64_t failures = 0;
+
+    void *handshake = NULL;
+    if (state->ops->create(state->arg, &handshake) != IQR_OK) {
+        /* The other threads pick up this one's share. */
+        return NULL;
+    }
+
+    while (__atomic_fetch_add(&state->next, 1, __ATOMIC_RELAXED) < state->total) {
+        /* Fetch the RNG every time so the pool can reseed it when it's due. */
+        iqr_RNG *rng = NULL;
+        bool match = false;
+        if (rng_pool_thread_rng(state->rngs, &rng) == IQR_OK && state->ops->run(handshake, rng, &match) == IQR_OK && match) {
+            handshakes++;
+        } else {
+            failures++;
+        }
+    }
+
+    state->ops->destroy(handshake);
+
+    __atomic_fetch_add(&state->handshakes, handshakes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&state->failures, failures, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Running and reporting.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval dh_load_run(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const dh_load_ops *ops, const void *arg,
+    uint64_t handshakes, uint32_t threads, dh_load_result *result)
+{
+    if (ctx == NULL || ops == NULL || result == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (handshakes == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    if (threads == 0) {
+        threads = online_cpus();
+    }
+    if (threads > handshakes) {
+        threads = (uint32_t)handshakes;
+    }
+
+    load_state state;
+    memset(&state, 0, sizeof(state));
+    state.ops = ops;
+    state.arg = arg;
+    state.total = handshakes;
+
+    rng_pool_config config;
+    rng_pool_default_config(&config);
+    config.hash = drbg_hash;
+
+    iqr_retval ret = rng_pool_create(ctx, &config, &state.rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    load_worker *workers = calloc(threads, sizeof(*workers));
+    if (workers == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        rng_pool_destroy(&state.rngs);
+        return IQR_ENOMEM;
+    }
+
+    const uint64_t cpu_start = process_cpu_ns();
+    const uint64_t start = time_now_ns();
+
+    uint32_t started = 0;
+    for (; started < threads; started++) {
+        workers[started].state = &state;
+        const int rc = pthread_create(&workers[started].thread, NULL, load_thread, &workers[started]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            break;
+        }
+    }
+
+    /* The threads that did start run the missing threads' handshakes. */
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    result->elapsed_ns = time_now_ns() - start;
+    result->cpu_ns = process_cpu_ns() - cpu_start;
+    result->threads = started;
+    result->handshakes = state.handshakes;
+    result->failures = state.failures;
+
+    /* Handshakes no thread got to, because thread setup failed, count as
+     * failures too.
+     */
+    const uint64_t run = state.handshakes + state.failures;
+    if (run < handshakes) {
+        result->failures += handshakes - run;
+    }
+
+    free(workers);
+    rng_pool_destroy(&state.rngs);
+
+    if (started == 0) {
+        return IQR_ENOMEM;
+    }
+    return IQR_OK;
+}
+
+void dh_load_report(const char *name, const dh_load_result *result)
+{
+    if (name == NULL || result == NULL) {
+        return;
+    }
+
+    const double seconds = (double)result->elapsed_ns / 1e9;
+    const double rate = (seconds > 0) ? (double)result->handshakes / seconds : 0;
+
+    fprintf(stdout, "%s: %llu handshakes (%llu failed) on %u threads in %.3f s.\n", name,
+        (unsigned long long)result->handshakes, (unsigned long long)result->failures, result->threads, seconds);
+    fprintf(stdout, "    %.1f handshakes/sec overall, %.1f per thread.\n", rate,
+        (result->threads > 0) ? rate / result->threads : 0);
+
+    /* Per second of CPU time is per core, however many threads shared each
+     * core.
+     */
+    if (result->cpu_ns > 0) {
+        fprintf(stdout, "    %.1f handshakes/sec per core (%.3f s of CPU time).\n",
+            (double)result->handshakes / ((double)result->cpu_ns / 1e9), (double)result->cpu_ns / 1e9);
+    }
+}
@@ -0,0 +1,84 @@
+/** @file dh_load.h
+ *
+ * @brief Run many key agreement handshakes at once and measure throughput.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DH_LOAD_H
+#define DH_LOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/** How the load generator drives one scheme's handshakes.
+ *
+ * Each thread calls create() once, run() for every handshake it takes, and
+ * destroy() at the end, so the handshake state is never shared between
+ * threads.
+ */
+typedef struct {
+    /** Set up a thread's handshake state (Alice, Bob and their channel). */
+    iqr_retval (*create)(const void *arg, void **handshake);
+    /** Run one complete handshake; set @a match if both sides agreed. */
+    iqr_retval (*run)(void *handshake, const iqr_RNG *rng, bool *match);
+    /** Tear down a thread's handshake state. */
+    void (*destroy)(void *handshake);
+} dh_load_ops;
+
+typedef struct {
+    uint32_t threads;
+    /** Handshakes that completed with matching secrets. */
+    uint64_t handshakes;
+    /** Handshakes that failed or whose secrets didn't match. */
+    uint64_t failures;
+    /** Wall-clock time for the whole run. */
+    uint64_t elapsed_ns;
+    /** CPU time used by the whole process during the run; 0 if unknown. */
+    uint64_t cpu_ns;
+} dh_load_result;
+
+/** Run handshakes on several threads.
+ *
+ * Every thread has its own DRBG from an rng_pool and takes handshakes from a
+ * shared counter until @a handshakes have been started.
+ *
+ * @param ctx           The toolkit context; @a drbg_hash and the scheme's
+ *                      hashes must be registered.
+ * @param drbg_hash     Hash for the per-thread HMAC-DRBGs.
+ * @param ops           The scheme's handshake functions.
+ * @param arg           Passed to @a ops create().
+ * @param handshakes    Number of handshakes to run.
+ * @param threads       Number of threads; 0 means one per online CPU.
+ * @param result        The counts and timings.
+ *
+ * @return IQR_OK if the threads ran, even if some handshakes failed.
+ */
+iqr_retval dh_load_run(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const dh_load_ops *ops, const void *arg,
+    uint64_t handshakes, uint32_t threads, dh_load_result *result);
+
+/** Print a summary of a run, including handshakes per second of CPU time.
+ *
+ * @param name      The scheme's name.
+ * @param result    The run's results.
+ */
+void dh_load_report(const char *name, const dh_load_result *result);
+
+#endif
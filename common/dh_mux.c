@@ -0,0 +1,629 @@
+/** @file dh_mux.c
+ *
+ * @brief Multiplex many key agreement sessions over one transport link.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dh_mux.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isara_samples.h"
+#include "rng_pool.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The worker pool.
+//
+// Only the thread driving the link touches the transport. The workers run one
+// job at a time over the records of a batch, each taking the next record
+// until they're all done, and build their output in place.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef void (*mux_job)(void *arg, size_t index, const iqr_RNG *rng);
+
+typedef struct {
+    rng_pool *rngs;
+    pthread_t *threads;
+    uint32_t count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    mux_job job;
+    void *arg;
+    size_t items;
+    size_t next;
+    size_t finished;
+    bool stop;
+} mux_workers;
+
+static void *worker_thread(void *arg)
+{
+    mux_workers *w = arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->stop && w->next >= w->items) {
+            pthread_cond_wait(&w->work, &w->lock);
+        }
+        if (w->stop) {
+            break;
+        }
+        const size_t index = w->next++;
+        const mux_job job = w->job;
+        void *job_arg = w->arg;
+        pthread_mutex_unlock(&w->lock);
+
+        /* Fetch the RNG every time so the pool can reseed it when it's due.
+         * The job fails the record if there isn't one.
+         */
+        iqr_RNG *rng = NULL;
+        if (rng_pool_thread_rng(w->rngs, &rng) != IQR_OK) {
+            rng = NULL;
+        }
+        job(job_arg, index, rng);
+
+        pthread_mutex_lock(&w->lock);
+        w->finished++;
+        if (w->finished == w->items) {
+            pthread_cond_broadcast(&w->done);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+/* Hand the workers a job and return without waiting for it. */
+static void workers_start(mux_workers *w, mux_job job, void *arg, size_t items)
+{
+    pthread_mutex_lock(&w->lock);
+    w->job = job;
+    w->arg = arg;
+    w->items = items;
+    w->next = 0;
+    w->finished = 0;
+    pthread_cond_broadcast(&w->work);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void workers_wait(mux_workers *w)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->finished < w->items) {
+        pthread_cond_wait(&w->done, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void workers_destroy(mux_workers *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->stop = true;
+    pthread_cond_broadcast(&w->work);
+    pthread_mutex_unlock(&w->lock);
+
+    for (uint32_t i = 0; i < w->count; i++) {
+        pthread_join(w->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&w->done);
+    pthread_cond_destroy(&w->work);
+    pthread_mutex_destroy(&w->lock);
+    rng_pool_destroy(&w->rngs);
+    free(w->threads);
+}
+
+static iqr_retval workers_create(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, uint32_t count, mux_workers *w)
+{
+    memset(w, 0, sizeof(*w));
+
+    if (count == 0) {
+        count = online_cpus();
+    }
+
+    rng_pool_config config;
+    rng_pool_default_config(&config);
+    config.hash = drbg_hash;
+
+    iqr_retval ret = rng_pool_create(ctx, &config, &w->rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    w->threads = calloc(count, sizeof(*w->threads));
+    if (w->threads == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        rng_pool_destroy(&w->rngs);
+        return IQR_ENOMEM;
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work, NULL);
+    pthread_cond_init(&w->done, NULL);
+
+    for (; w->count < count; w->count++) {
+        const int rc = pthread_create(&w->threads[w->count], NULL, worker_thread, w);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            break;
+        }
+    }
+
+    /* The threads that did start do all of the work. */
+    if (w->count == 0) {
+        workers_destroy(w);
+        return IQR_ENOMEM;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Batches.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static size_t request_stride(const dh_sizes *sizes)
+{
+    return DH_MUX_RECORD_HEADER_SIZE + sizes->initiator_message;
+}
+
+static size_t reply_stride(const dh_mux_config *config, const dh_sizes *sizes)
+{
+    return DH_MUX_RECORD_HEADER_SIZE + sizes->responder_message + (config->verify ? sizes->secret : 0);
+}
+
+size_t dh_mux_max_batch(const dh_mux_config *config, const dh_sizes *sizes)
+{
+    if (config == NULL || sizes == NULL) {
+        return 0;
+    }
+
+    const size_t request = request_stride(sizes);
+    const size_t reply = reply_stride(config, sizes);
+    return DH_MUX_BATCH_HEADER_SIZE + (size_t)config->window * ((request > reply) ? request : reply);
+}
+
+/* The number of records in a received batch, after checking that it's the
+ * right size for them. A malformed batch means the stream can't be trusted.
+ */
+static iqr_retval batch_count(const uint8_t *batch, size_t size, uint32_t window, size_t stride, uint32_t *count)
+{
+    if (size < DH_MUX_BATCH_HEADER_SIZE) {
+        fprintf(stderr, "The batch is too short.\n");
+        return IQR_EINVDATA;
+    }
+
+    *count = get_u32(batch);
+    if (*count > window || size != DH_MUX_BATCH_HEADER_SIZE + (size_t)*count * stride) {
+        fprintf(stderr, "The batch is malformed.\n");
+        return IQR_EINVDATA;
+    }
+    return IQR_OK;
+}
+
+static void finish_stats(const transport_link *link, transport_end end, uint64_t start_ns, uint64_t cpu_start,
+    dh_mux_stats *stats)
+{
+    stats->elapsed_ns = time_now_ns() - start_ns;
+    const uint64_t cpu_end = process_cpu_ns();
+    stats->cpu_ns = (cpu_start > 0 && cpu_end > cpu_start) ? cpu_end - cpu_start : 0;
+    transport_counters(link, end, &stats->sent, &stats->received);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The initiator's end.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    uint32_t id;
+    /** Set by the worker that takes the session's reply, so a duplicate
+     * record can't finish it twice.
+     */
+    bool claimed;
+    bool ok;
+    void *initiator;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} mux_session;
+
+typedef struct {
+    const dh_mux_config *config;
+    dh_sizes sizes;
+    size_t request_stride;
+    size_t reply_stride;
+
+    /* One batch is being answered while the next is built, so there are
+     * slots for two windows of sessions. A session's slot is its ID modulo
+     * slot_count.
+     */
+    mux_session *slots;
+    size_t slot_count;
+    uint8_t *secrets;
+
+    /* The batch being built and its first session ID. */
+    uint8_t *building;
+    uint32_t first_id;
+
+    /* The replies being finished, and the IDs of the batch they answer. By
+     * the time they're finished the next batch's sessions hold the other
+     * window of slots, so a reply outside this range must not touch them.
+     */
+    const uint8_t *replies;
+    uint32_t replies_first_id;
+    uint32_t replies_count;
+} mux_initiator;
+
+static void start_job(void *arg, size_t index, const iqr_RNG *rng)
+{
+    mux_initiator *m = arg;
+    const dh_scheme *dh = m->config->dh;
+
+    const uint32_t id = m->first_id + (uint32_t)index;
+    mux_session *s = &m->slots[id % m->slot_count];
+    uint8_t *record = m->building + DH_MUX_BATCH_HEADER_SIZE + index * m->request_stride;
+
+    s->id = id;
+    s->claimed = false;
+    s->ok = false;
+    s->initiator = NULL;
+    s->start_ns = time_now_ns();
+
+    iqr_retval ret = IQR_ENULLPTR;
+    if (rng != NULL) {
+        ret = dh->initiator_start(m->config->params, rng, &s->initiator, record + DH_MUX_RECORD_HEADER_SIZE,
+            m->sizes.initiator_message);
+    }
+
+    put_u32(record, id);
+    put_u32(record + 4, (ret == IQR_OK) ? (uint32_t)m->sizes.initiator_message : 0);
+}
+
+static void finish_job(void *arg, size_t index, const iqr_RNG *rng)
+{
+    mux_initiator *m = arg;
+    const dh_scheme *dh = m->config->dh;
+    (void)rng;
+
+    const uint8_t *record = m->replies + DH_MUX_BATCH_HEADER_SIZE + index * m->reply_stride;
+    const uint32_t id = get_u32(record);
+    const uint32_t length = get_u32(record + 4);
+    const uint8_t *reply = record + DH_MUX_RECORD_HEADER_SIZE;
+
+    /* Unsigned, so IDs below the batch wrap around and fail too. */
+    if (id - m->replies_first_id >= m->replies_count) {
+        return;
+    }
+
+    const size_t slot = id % m->slot_count;
+    mux_session *s = &m->slots[slot];
+    if (s->id != id || s->initiator == NULL || __atomic_exchange_n(&s->claimed, true, __ATOMIC_ACQ_REL)) {
+        /* Not a session we're waiting for. It's counted as a failure when
+         * its batch is tallied.
+         */
+        return;
+    }
+
+    bool ok = false;
+    if (length == m->reply_stride - DH_MUX_RECORD_HEADER_SIZE) {
+        uint8_t *secret = m->secrets + slot * m->sizes.secret;
+        if (dh->initiator_finish(s->initiator, reply, m->sizes.responder_message, secret, m->sizes.secret) == IQR_OK) {
+            ok = !m->config->verify || memcmp(secret, reply + m->sizes.responder_message, m->sizes.secret) == 0;
+        }
+
+        /* A real gateway would hand the secret to the session here. */
+        secure_memzero(secret, m->sizes.secret);
+    }
+
+    dh->destroy_initiator(&s->initiator);
+    s->end_ns = time_now_ns();
+    s->ok = ok;
+}
+
+/* Take a slab for the next batch and have the workers start building it. */
+static iqr_retval build_batch(mux_initiator *m, mux_workers *w, transport_link *link, uint64_t sessions, uint64_t *started,
+    uint32_t *count)
+{
+    *count = 0;
+    if (*started == sessions) {
+        return IQR_OK;
+    }
+
+    iqr_retval ret = transport_acquire(link, &m->building);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint64_t remaining = sessions - *started;
+    *count = (remaining < m->config->window) ? (uint32_t)remaining : m->config->window;
+    m->first_id = (uint32_t)*started;
+    *started += *count;
+
+    put_u32(m->building, *count);
+    workers_start(w, start_job, m, *count);
+    return IQR_OK;
+}
+
+/* Count a batch's sessions once its replies have been finished. */
+static void tally_batch(mux_initiator *m, uint32_t first_id, uint32_t count, dh_mux_stats *stats)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        mux_session *s = &m->slots[(first_id + i) % m->slot_count];
+        if (s->claimed && s->ok) {
+            stats->sessions++;
+            latency_record(&stats->latency, s->end_ns - s->start_ns);
+        } else {
+            stats->failures++;
+        }
+
+        /* No reply came for this one. */
+        if (s->initiator != NULL) {
+            m->config->dh->destroy_initiator(&s->initiator);
+        }
+    }
+}
+
+iqr_retval dh_mux_initiate(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const dh_mux_config *config,
+    transport_link *link, uint64_t sessions, dh_mux_stats *stats)
+{
+    if (ctx == NULL || config == NULL || config->dh == NULL || config->params == NULL || link == NULL || stats == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (config->window == 0 || sessions == 0 || sessions > UINT32_MAX) {
+        return IQR_EBADVALUE;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    latency_reset(&stats->latency);
+
+    mux_initiator m;
+    memset(&m, 0, sizeof(m));
+    m.config = config;
+
+    iqr_retval ret = config->dh->get_sizes(config->params, &m.sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    m.request_stride = request_stride(&m.sizes);
+    m.reply_stride = reply_stride(config, &m.sizes);
+    m.slot_count = 2 * (size_t)config->window;
+
+    m.slots = calloc(m.slot_count, sizeof(*m.slots));
+    m.secrets = calloc(m.slot_count, m.sizes.secret);
+    if (m.slots == NULL || m.secrets == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(m.secrets);
+        free(m.slots);
+        return IQR_ENOMEM;
+    }
+
+    mux_workers w;
+    ret = workers_create(ctx, drbg_hash, config->workers, &w);
+    if (ret != IQR_OK) {
+        free(m.secrets);
+        free(m.slots);
+        return ret;
+    }
+
+    const uint64_t cpu_start = process_cpu_ns();
+    const uint64_t start_ns = time_now_ns();
+
+    uint64_t started = 0;
+    uint32_t count = 0;
+    ret = build_batch(&m, &w, link, sessions, &started, &count);
+    workers_wait(&w);
+
+    while (ret == IQR_OK && count > 0) {
+        /* The whole batch goes out in one write. */
+        const uint32_t first_id = m.first_id;
+        ret = transport_send_slab(link, TRANSPORT_ALICE, m.building, DH_MUX_BATCH_HEADER_SIZE + count * m.request_stride);
+        m.building = NULL;
+        if (ret != IQR_OK) {
+            break;
+        }
+        stats->batches++;
+
+        /* Build the next batch while this one is answered. */
+        uint32_t next_count = 0;
+        ret = build_batch(&m, &w, link, sessions, &started, &next_count);
+
+        uint8_t *replies = NULL;
+        size_t size = 0;
+        uint32_t reply_count = 0;
+        if (ret == IQR_OK) {
+            ret = transport_receive_slab(link, TRANSPORT_ALICE, &replies, &size);
+        }
+        workers_wait(&w);
+        if (ret == IQR_OK) {
+            ret = batch_count(replies, size, config->window, m.reply_stride, &reply_count);
+        }
+        if (ret == IQR_OK) {
+            m.replies = replies;
+            m.replies_first_id = first_id;
+            m.replies_count = count;
+            workers_start(&w, finish_job, &m, reply_count);
+            workers_wait(&w);
+            tally_batch(&m, first_id, count, stats);
+        }
+        transport_release(link, replies);
+
+        count = next_count;
+    }
+
+    /* An empty batch tells the responder we're done. */
+    if (ret == IQR_OK) {
+        uint8_t *last = NULL;
+        ret = transport_acquire(link, &last);
+        if (ret == IQR_OK) {
+            put_u32(last, 0);
+            ret = transport_send_slab(link, TRANSPORT_ALICE, last, DH_MUX_BATCH_HEADER_SIZE);
+        }
+    }
+
+    finish_stats(link, TRANSPORT_ALICE, start_ns, cpu_start, stats);
+
+    workers_destroy(&w);
+    transport_release(link, m.building);
+    for (size_t i = 0; i < m.slot_count; i++) {
+        if (m.slots[i].initiator != NULL) {
+            config->dh->destroy_initiator(&m.slots[i].initiator);
+        }
+    }
+    free(m.secrets);
+    free(m.slots);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The responder's end.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const dh_mux_config *config;
+    dh_sizes sizes;
+    size_t request_stride;
+    size_t reply_stride;
+
+    /** Where the secrets go when they aren't sent back. */
+    uint8_t *secrets;
+
+    const uint8_t *requests;
+    uint8_t *replies;
+
+    uint64_t ok;
+    uint64_t failed;
+} mux_responder;
+
+static void reply_job(void *arg, size_t index, const iqr_RNG *rng)
+{
+    mux_responder *r = arg;
+    const dh_mux_config *config = r->config;
+
+    const uint8_t *request = r->requests + DH_MUX_BATCH_HEADER_SIZE + index * r->request_stride;
+    uint8_t *record = r->replies + DH_MUX_BATCH_HEADER_SIZE + index * r->reply_stride;
+    uint8_t *reply = record + DH_MUX_RECORD_HEADER_SIZE;
+    uint8_t *secret = config->verify ? reply + r->sizes.responder_message : r->secrets + index * r->sizes.secret;
+
+    const uint32_t id = get_u32(request);
+    const uint32_t length = get_u32(request + 4);
+
+    /* A zero length means the initiator couldn't start this session. */
+    iqr_retval ret = IQR_EINVDATA;
+    if (rng != NULL && length == r->sizes.initiator_message) {
+        ret = config->dh->responder_reply(config->params, rng, request + DH_MUX_RECORD_HEADER_SIZE, length, reply,
+            r->sizes.responder_message, secret, r->sizes.secret);
+    }
+
+    put_u32(record, id);
+    put_u32(record + 4, (ret == IQR_OK) ? (uint32_t)(r->reply_stride - DH_MUX_RECORD_HEADER_SIZE) : 0);
+
+    /* A real gateway would hand the secret to the session here. */
+    if (!config->verify) {
+        secure_memzero(secret, r->sizes.secret);
+    }
+
+    __atomic_add_fetch((ret == IQR_OK) ? &r->ok : &r->failed, 1, __ATOMIC_RELAXED);
+}
+
+iqr_retval dh_mux_respond(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const dh_mux_config *config,
+    transport_link *link, dh_mux_stats *stats)
+{
+    if (ctx == NULL || config == NULL || config->dh == NULL || config->params == NULL || link == NULL || stats == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (config->window == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    latency_reset(&stats->latency);
+
+    mux_responder r;
+    memset(&r, 0, sizeof(r));
+    r.config = config;
+
+    iqr_retval ret = config->dh->get_sizes(config->params, &r.sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    r.request_stride = request_stride(&r.sizes);
+    r.reply_stride = reply_stride(config, &r.sizes);
+
+    r.secrets = calloc(config->window, r.sizes.secret);
+    if (r.secrets == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    mux_workers w;
+    ret = workers_create(ctx, drbg_hash, config->workers, &w);
+    if (ret != IQR_OK) {
+        free(r.secrets);
+        return ret;
+    }
+
+    const uint64_t cpu_start = process_cpu_ns();
+    const uint64_t start_ns = time_now_ns();
+
+    for (;;) {
+        uint8_t *requests = NULL;
+        size_t size = 0;
+        uint32_t count = 0;
+        ret = transport_receive_slab(link, TRANSPORT_BOB, &requests, &size);
+        if (ret != IQR_OK) {
+            break;
+        }
+        ret = batch_count(requests, size, config->window, r.request_stride, &count);
+        if (ret != IQR_OK || count == 0) {
+            transport_release(link, requests);
+            break;
+        }
+
+        ret = transport_acquire(link, &r.replies);
+        if (ret != IQR_OK) {
+            transport_release(link, requests);
+            break;
+        }
+
+        r.requests = requests;
+        workers_start(&w, reply_job, &r, count);
+        workers_wait(&w);
+        transport_release(link, requests);
+
+        /* All of the batch's replies go back in one write. */
+        put_u32(r.replies, count);
+        ret = transport_send_slab(link, TRANSPORT_BOB, r.replies, DH_MUX_BATCH_HEADER_SIZE + count * r.reply_stride);
+        r.replies = NULL;
+        if (ret != IQR_OK) {
+            break;
+        }
+        stats->batches++;
+    }
+
+    stats->sessions = r.ok;
+    stats->failures = r.failed;
+    finish_stats(link, TRANSPORT_BOB, start_ns, cpu_start, stats);
+
+    workers_destroy(&w);
+    secure_memzero(r.secrets, config->window * r.sizes.secret);
+    free(r.secrets);
+
+    return ret;
+}
@@ -0,0 +1,129 @@
+/** @file dh_mux.h
+ *
+ * @brief Multiplex many key agreement sessions over one transport link.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DH_MUX_H
+#define DH_MUX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dh_table.h"
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "latency.h"
+#include "transport.h"
+
+/* Rather than one message per frame, each side sends one frame per tick
+ * holding a batch of messages, each tagged with its session's ID:
+ *
+ *     batch:  u32 count, then count records
+ *     record: u32 session ID, u32 length, then length bytes
+ *
+ * Integers are big-endian. Every record in a batch has room for the scheme's
+ * largest message, so the workers can build them in place in the link's slab.
+ * A record with length 0 reports a session that failed on the sending side.
+ * An empty batch tells the responder there are no more sessions.
+ *
+ * The initiator keeps one batch in flight. While it waits for the replies to
+ * one batch, its workers create the keys for the next, so the two sides'
+ * computation overlaps and the link never sits idle waiting for keygen.
+ *
+ * Both ends block on the link, so they have to be in different processes or
+ * threads; use a socket transport split with transport_fork().
+ */
+
+#define DH_MUX_BATCH_HEADER_SIZE 4
+#define DH_MUX_RECORD_HEADER_SIZE 8
+
+typedef struct {
+    /** The key agreement variant. */
+    const dh_scheme *dh;
+    /** The variant's parameters, shared by every worker. */
+    const void *params;
+    /** Sessions per batch. Both ends must agree. */
+    uint32_t window;
+    /** Worker threads; 0 means one per online CPU. */
+    uint32_t workers;
+    /** Have the responder return each session's secret so the initiator can
+     * check it. Only a sample would do this. Both ends must agree.
+     */
+    bool verify;
+} dh_mux_config;
+
+typedef struct {
+    /** Sessions that completed, and that agreed on a secret if checked. */
+    uint64_t sessions;
+    /** Sessions that failed on either side or whose secrets didn't match. */
+    uint64_t failures;
+    /** Batches sent, each with a single write. */
+    uint64_t batches;
+    /** Bytes this end sent and received, frame headers included. */
+    uint64_t sent;
+    uint64_t received;
+    /** Wall-clock and process CPU time; cpu_ns is 0 if unknown. */
+    uint64_t elapsed_ns;
+    uint64_t cpu_ns;
+    /** Initiator only: from a session's keygen to its secret. */
+    latency_histogram latency;
+} dh_mux_stats;
+
+/** The size of the largest batch either end will send.
+ *
+ * Open the link with at least this as its largest message.
+ *
+ * @param config    The engine's configuration.
+ * @param sizes     The variant's sizes.
+ */
+size_t dh_mux_max_batch(const dh_mux_config *config, const dh_sizes *sizes);
+
+/** Run sessions from the initiator's end of the link.
+ *
+ * Starts @a sessions sessions, @a config window at a time, and finishes each
+ * one as its reply arrives. Sends an empty batch at the end so the responder
+ * stops.
+ *
+ * @param ctx           The toolkit context; @a drbg_hash and the scheme's
+ *                      hashes must be registered.
+ * @param drbg_hash     Hash for the workers' HMAC-DRBGs.
+ * @param config        The engine's configuration.
+ * @param link          The link; this process must hold Alice's end.
+ * @param sessions      Number of sessions to run.
+ * @param stats         The counts and timings.
+ *
+ * @return IQR_OK if the link worked, even if some sessions failed.
+ */
+iqr_retval dh_mux_initiate(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const dh_mux_config *config,
+    transport_link *link, uint64_t sessions, dh_mux_stats *stats);
+
+/** Answer sessions at the responder's end of the link until the initiator
+ * sends an empty batch.
+ *
+ * @param ctx           The toolkit context; @a drbg_hash and the scheme's
+ *                      hashes must be registered.
+ * @param drbg_hash     Hash for the workers' HMAC-DRBGs.
+ * @param config        The engine's configuration.
+ * @param link          The link; this process must hold Bob's end.
+ * @param stats         The counts and timings; latency isn't recorded.
+ */
+iqr_retval dh_mux_respond(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const dh_mux_config *config,
+    transport_link *link, dh_mux_stats *stats);
+
+#endif
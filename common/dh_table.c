@@ -0,0 +1,362 @@
+/** @file dh_table.c
+ *
+ * @brief A common interface to the toolkit's key agreement schemes.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dh_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_frododh.h"
+#include "iqr_newhopedh.h"
+#include "iqr_samwise.h"
+#include "iqr_sidh.h"
+#include "isara_samples.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Wrappers.
+//
+// NewHopeDH, FrodoDH and Samwise have the same initiator/responder API, so the
+// functions that only differ by name are generated. Parameter creation and
+// sizes differ between schemes and are written out below, as is SIDH.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#define DH_WRAPPERS(prefix, Scheme)                                                                                               \
+static void prefix##_destroy_params(void **params)                                                                                \
+{                                                                                                                                 \
+    iqr_##Scheme##Params *p = *params;                                                                                            \
+    iqr_##Scheme##DestroyParams(&p);                                                                                              \
+    *params = NULL;                                                                                                               \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_initiator_start(const void *params, const iqr_RNG *rng, void **initiator, uint8_t *message,            \
+    size_t message_size)                                                                                                          \
+{                                                                                                                                 \
+    iqr_##Scheme##InitiatorPrivateKey *key = NULL;                                                                                \
+    iqr_retval ret = iqr_##Scheme##CreateInitiatorPrivateKey(params, rng, &key);                                                  \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateInitiatorPrivateKey(): %s\n", iqr_StrError(ret));                         \
+        return ret;                                                                                                               \
+    }                                                                                                                             \
+    ret = iqr_##Scheme##GetInitiatorPublicKey(key, rng, message, message_size);                                                   \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "GetInitiatorPublicKey(): %s\n", iqr_StrError(ret));                             \
+        iqr_##Scheme##DestroyInitiatorPrivateKey(&key);                                                                           \
+    }                                                                                                                             \
+    *initiator = key;                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_responder_reply(const void *params, const iqr_RNG *rng, const uint8_t *message,                        \
+    size_t message_size, uint8_t *reply, size_t reply_size, uint8_t *secret, size_t secret_size)                                  \
+{                                                                                                                                 \
+    iqr_##Scheme##ResponderPrivateKey *key = NULL;                                                                                \
+    iqr_retval ret = iqr_##Scheme##CreateResponderPrivateKey(params, rng, &key);                                                  \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateResponderPrivateKey(): %s\n", iqr_StrError(ret));                         \
+        return ret;                                                                                                               \
+    }                                                                                                                             \
+    ret = iqr_##Scheme##GetResponderPublicKey(key, rng, message, message_size, reply, reply_size);                                \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "GetResponderPublicKey(): %s\n", iqr_StrError(ret));                             \
+    } else {                                                                                                                      \
+        ret = iqr_##Scheme##GetResponderSecret(key, secret, secret_size);                                                         \
+        if (ret != IQR_OK) {                                                                                                      \
+            fprintf(stderr, "Failed on iqr_" #Scheme "GetResponderSecret(): %s\n", iqr_StrError(ret));                            \
+        }                                                                                                                         \
+    }                                                                                                                             \
+    iqr_##Scheme##DestroyResponderPrivateKey(&key);                                                                               \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_initiator_finish(const void *initiator, const uint8_t *reply, size_t reply_size,                       \
+    uint8_t *secret, size_t secret_size)                                                                                          \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##GetInitiatorSecret(initiator, reply, reply_size, secret, secret_size);                         \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "GetInitiatorSecret(): %s\n", iqr_StrError(ret));                                \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_initiator(void **initiator)                                                                          \
+{                                                                                                                                 \
+    iqr_##Scheme##InitiatorPrivateKey *key = *initiator;                                                                          \
+    iqr_##Scheme##DestroyInitiatorPrivateKey(&key);                                                                               \
+    *initiator = NULL;                                                                                                            \
+}
+
+DH_WRAPPERS(newhopedh, NewHopeDH)
+DH_WRAPPERS(frododh, FrodoDH)
+DH_WRAPPERS(samwise, Samwise)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// NewHopeDH.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval newhopedh_create_params(const iqr_Context *ctx, void **params)
+{
+    iqr_NewHopeDHParams *p = NULL;
+    iqr_retval ret = iqr_NewHopeDHCreateParams(ctx, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_NewHopeDHCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval newhopedh_get_sizes(const void *params, dh_sizes *sizes)
+{
+    (void)params;
+
+    sizes->initiator_message = IQR_NEWHOPEDH_INITIATOR_PUBLIC_KEY_SIZE;
+    sizes->responder_message = IQR_NEWHOPEDH_RESPONDER_PUBLIC_KEY_SIZE;
+    sizes->secret = IQR_NEWHOPEDH_SECRET_SIZE;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// FrodoDH.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval frododh_create_params(const iqr_FrodoDHVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_FrodoDHParams *p = NULL;
+    iqr_retval ret = iqr_FrodoDHCreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_FrodoDHCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval frododh_aes_create_params(const iqr_Context *ctx, void **params)
+{
+    return frododh_create_params(&IQR_FRODODH_976_AES, ctx, params);
+}
+
+static iqr_retval frododh_shake_create_params(const iqr_Context *ctx, void **params)
+{
+    return frododh_create_params(&IQR_FRODODH_976_SHAKE, ctx, params);
+}
+
+static iqr_retval frododh_get_sizes(const void *params, dh_sizes *sizes)
+{
+    (void)params;
+
+    /* Both FrodoDH variants have the same sizes. */
+    sizes->initiator_message = IQR_FRODODH_INITIATOR_PUBLIC_KEY_SIZE;
+    sizes->responder_message = IQR_FRODODH_RESPONDER_PUBLIC_KEY_SIZE;
+    sizes->secret = IQR_FRODODH_SECRET_SIZE;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Samwise.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval samwise_create_params(const iqr_SamwiseVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_SamwiseParams *p = NULL;
+    iqr_retval ret = iqr_SamwiseCreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SamwiseCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval samwise_aes_create_params(const iqr_Context *ctx, void **params)
+{
+    return samwise_create_params(&IQR_SAMWISE_976_AES, ctx, params);
+}
+
+static iqr_retval samwise_chacha20_create_params(const iqr_Context *ctx, void **params)
+{
+    return samwise_create_params(&IQR_SAMWISE_976_CHACHA20, ctx, params);
+}
+
+static iqr_retval samwise_get_sizes(const void *params, dh_sizes *sizes)
+{
+    (void)params;
+
+    /* Both Samwise variants have the same sizes. */
+    sizes->initiator_message = IQR_SAMWISE_INITIATOR_PUBLIC_KEY_SIZE;
+    sizes->responder_message = IQR_SAMWISE_RESPONDER_PUBLIC_KEY_SIZE;
+    sizes->secret = IQR_SAMWISE_SECRET_SIZE;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// SIDH.
+//
+// Alice is the initiator and Bob the responder. Bob's public key doesn't
+// depend on Alice's, but his secret does, so he still has to wait for her.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval sidh_create_params(const iqr_SIDHVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_SIDHParams *p = NULL;
+    iqr_retval ret = iqr_SIDHCreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval sidh_p503_create_params(const iqr_Context *ctx, void **params)
+{
+    return sidh_create_params(&IQR_SIDH_P503, ctx, params);
+}
+
+static iqr_retval sidh_p751_create_params(const iqr_Context *ctx, void **params)
+{
+    return sidh_create_params(&IQR_SIDH_P751, ctx, params);
+}
+
+static void sidh_destroy_params(void **params)
+{
+    iqr_SIDHParams *p = *params;
+    iqr_SIDHDestroyParams(&p);
+    *params = NULL;
+}
+
+static iqr_retval sidh_get_sizes(const void *params, dh_sizes *sizes)
+{
+    /* Alice's and Bob's public keys are the same size. */
+    iqr_retval ret = iqr_SIDHGetPublicKeySize(params, &sizes->initiator_message);
+    if (ret == IQR_OK) {
+        ret = iqr_SIDHGetSecretSize(params, &sizes->secret);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHGet*Size(): %s\n", iqr_StrError(ret));
+    }
+    sizes->responder_message = sizes->initiator_message;
+    return ret;
+}
+
+static iqr_retval sidh_initiator_start(const void *params, const iqr_RNG *rng, void **initiator, uint8_t *message,
+    size_t message_size)
+{
+    iqr_SIDHAlicePrivateKey *key = NULL;
+    iqr_retval ret = iqr_SIDHCreateAlicePrivateKey(params, rng, &key);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHCreateAlicePrivateKey(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    ret = iqr_SIDHGetAlicePublicKey(key, message, message_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHGetAlicePublicKey(): %s\n", iqr_StrError(ret));
+        iqr_SIDHDestroyAlicePrivateKey(&key);
+    }
+    *initiator = key;
+    return ret;
+}
+
+static iqr_retval sidh_responder_reply(const void *params, const iqr_RNG *rng, const uint8_t *message, size_t message_size,
+    uint8_t *reply, size_t reply_size, uint8_t *secret, size_t secret_size)
+{
+    iqr_SIDHBobPrivateKey *key = NULL;
+    iqr_retval ret = iqr_SIDHCreateBobPrivateKey(params, rng, &key);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHCreateBobPrivateKey(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    ret = iqr_SIDHGetBobPublicKey(key, reply, reply_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHGetBobPublicKey(): %s\n", iqr_StrError(ret));
+    } else {
+        ret = iqr_SIDHGetBobSecret(key, message, message_size, secret, secret_size);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_SIDHGetBobSecret(): %s\n", iqr_StrError(ret));
+        }
+    }
+    iqr_SIDHDestroyBobPrivateKey(&key);
+    return ret;
+}
+
+static iqr_retval sidh_initiator_finish(const void *initiator, const uint8_t *reply, size_t reply_size, uint8_t *secret,
+    size_t secret_size)
+{
+    iqr_retval ret = iqr_SIDHGetAliceSecret(initiator, reply, reply_size, secret, secret_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHGetAliceSecret(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+static void sidh_destroy_initiator(void **initiator)
+{
+    iqr_SIDHAlicePrivateKey *key = *initiator;
+    iqr_SIDHDestroyAlicePrivateKey(&key);
+    *initiator = NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The table.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* These match the hashes registered by the individual samples. */
+static const iqr_HashAlgorithmType newhopedh_hashes[] = { IQR_HASHALGO_SHA3_256 };
+
+#define DH_FUNCTIONS(prefix, create_params, get_sizes)                                                                            \
+    create_params, prefix##_destroy_params, get_sizes, prefix##_initiator_start, prefix##_responder_reply,                        \
+    prefix##_initiator_finish, prefix##_destroy_initiator
+
+const dh_scheme dh_schemes[] = {
+    { "newhopedh", "", newhopedh_hashes, 1, DH_FUNCTIONS(newhopedh, newhopedh_create_params, newhopedh_get_sizes) },
+    { "frododh-aes", "AES", NULL, 0, DH_FUNCTIONS(frododh, frododh_aes_create_params, frododh_get_sizes) },
+    { "frododh-shake", "SHAKE", NULL, 0, DH_FUNCTIONS(frododh, frododh_shake_create_params, frododh_get_sizes) },
+    { "samwise-aes", "AES", NULL, 0, DH_FUNCTIONS(samwise, samwise_aes_create_params, samwise_get_sizes) },
+    { "samwise-chacha20", "ChaCha20", NULL, 0, DH_FUNCTIONS(samwise, samwise_chacha20_create_params, samwise_get_sizes) },
+    { "sidh-p503", "p503", NULL, 0, DH_FUNCTIONS(sidh, sidh_p503_create_params, sidh_get_sizes) },
+    { "sidh-p751", "p751", NULL, 0, DH_FUNCTIONS(sidh, sidh_p751_create_params, sidh_get_sizes) }
+};
+
+const size_t dh_scheme_count = sizeof(dh_schemes) / sizeof(dh_schemes[0]);
+
+const dh_scheme *dh_find(const char *name)
+{
+    if (name == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < dh_scheme_count; i++) {
+        if (strcmp(dh_schemes[i].name, name) == 0) {
+            return &dh_schemes[i];
+        }
+    }
+    return NULL;
+}
+
+iqr_retval dh_bootstrap_context(const dh_scheme *dh, iqr_Context **ctx)
+{
+    if (dh == NULL || ctx == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    const iqr_HashAlgorithmType drbg_hash = IQR_HASHALGO_SHA2_256;
+    iqr_retval ret = bootstrap_context(&drbg_hash, 1, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    return bootstrap_context(dh->hashes, dh->hash_count, ctx);
+}
@@ -0,0 +1,106 @@
+/** @file dh_table.h
+ *
+ * @brief A table of the toolkit's key agreement schemes behind one interface.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DH_TABLE_H
+#define DH_TABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/** Sizes of the messages and secret of a key agreement variant, in bytes. */
+typedef struct {
+    /** The initiator's (Alice's) public key. */
+    size_t initiator_message;
+    /** The responder's (Bob's) reply. */
+    size_t responder_message;
+    size_t secret;
+} dh_sizes;
+
+/** One key agreement variant (NewHopeDH, SIDH p751, ...) behind a common
+ * interface.
+ *
+ * A handshake has three steps:
+ *
+ * 1. initiator_start(): the initiator creates an ephemeral key and its
+ *    public key, the first message.
+ * 2. responder_reply(): the responder creates its own ephemeral key, replies
+ *    with its public key and derives the secret.
+ * 3. initiator_finish(): the initiator derives the secret from the reply.
+ *
+ * SIDH's Alice and Bob map onto the initiator and responder. Params and the
+ * initiator's state are the toolkit's own objects passed around as `void *`;
+ * only hand them to functions of the same entry. The functions print a
+ * "Failed on ..." message before returning an error, like the samples do.
+ */
+typedef struct {
+    /** Name used on the command line, for example "frododh-aes". */
+    const char *name;
+    /** The variant as the individual samples spell it, for example "AES". */
+    const char *variant_name;
+
+    /** Hashes that must be registered in the context; the DRBG's SHA2-256
+     * isn't included.
+     */
+    const iqr_HashAlgorithmType *hashes;
+    size_t hash_count;
+
+    iqr_retval (*create_params)(const iqr_Context *ctx, void **params);
+    void (*destroy_params)(void **params);
+    iqr_retval (*get_sizes)(const void *params, dh_sizes *sizes);
+
+    iqr_retval (*initiator_start)(const void *params, const iqr_RNG *rng, void **initiator, uint8_t *message,
+        size_t message_size);
+    iqr_retval (*responder_reply)(const void *params, const iqr_RNG *rng, const uint8_t *message, size_t message_size,
+        uint8_t *reply, size_t reply_size, uint8_t *secret, size_t secret_size);
+    iqr_retval (*initiator_finish)(const void *initiator, const uint8_t *reply, size_t reply_size, uint8_t *secret,
+        size_t secret_size);
+    void (*destroy_initiator)(void **initiator);
+} dh_scheme;
+
+/** Every key agreement variant the samples cover. */
+extern const dh_scheme dh_schemes[];
+
+/** Number of entries in dh_schemes. */
+extern const size_t dh_scheme_count;
+
+/** Look up a key agreement variant by name.
+ *
+ * @param name  The variant's name, for example "sidh-p751".
+ *
+ * @return The matching entry or NULL.
+ */
+const dh_scheme *dh_find(const char *name);
+
+/** Get the calling thread's bootstrap context, with the hashes a key
+ * agreement variant needs and SHA2-256 for the DRBG registered.
+ *
+ * Hashes that are already registered are skipped, so you can call this once
+ * per variant.
+ *
+ * @param dh    The key agreement variant.
+ * @param ctx   A pointer that will receive the context.
+ */
+iqr_retval dh_bootstrap_context(const dh_scheme *dh, iqr_Context **ctx);
+
+#endif
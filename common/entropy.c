@@ -0,0 +1,86 @@
+/** @file entropy.c
+ *
+ * @brief Read seed material from the operating system.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "isara_samples.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+// For getrandom().
+#include <sys/random.h>
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// System entropy.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval read_urandom(uint8_t *buf, size_t size)
+{
+    FILE *fp = fopen("/dev/urandom", "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open /dev/urandom: %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    const size_t read_size = fread(buf, 1, size, fp);
+    fclose(fp);
+
+    if (read_size != size) {
+        fprintf(stderr, "Failed to read from /dev/urandom\n");
+        return IQR_EBADVALUE;
+    }
+
+    return IQR_OK;
+}
+
+iqr_retval get_system_entropy(uint8_t *buf, size_t size)
+{
+    if (buf == NULL && size > 0) {
+        return IQR_ENULLPTR;
+    }
+
+#if defined(__linux__)
+    /* getrandom() blocks until the kernel's pool has been initialized, which
+     * /dev/urandom doesn't, and needs no file descriptor. Large requests may
+     * be split.
+     */
+    size_t offset = 0;
+    while (offset < size) {
+        const ssize_t got = getrandom(buf + offset, size - offset, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOSYS) {
+                // Kernels older than 3.17 don't have the system call.
+                return read_urandom(buf, size);
+            }
+            fprintf(stderr, "Failed on getrandom(): %s\n", strerror(errno));
+            return IQR_EBADVALUE;
+        }
+        offset += (size_t)got;
+    }
+
+    return IQR_OK;
+#else
+    return read_urandom(buf, size);
+#endif
+}
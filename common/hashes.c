@@ -0,0 +1,66 @@
+/** @file hashes.c
+ *
+ * @brief Register the toolkit's default hash implementations.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "isara_samples.h"
+
+#include <stdio.h>
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Hash registration.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+const iqr_HashCallbacks *default_hash_callbacks(iqr_HashAlgorithmType hash)
+{
+    switch (hash) {
+    case IQR_HASHALGO_SHA2_256:
+        return &IQR_HASH_DEFAULT_SHA2_256;
+    case IQR_HASHALGO_SHA2_384:
+        return &IQR_HASH_DEFAULT_SHA2_384;
+    case IQR_HASHALGO_SHA2_512:
+        return &IQR_HASH_DEFAULT_SHA2_512;
+    case IQR_HASHALGO_SHA3_256:
+        return &IQR_HASH_DEFAULT_SHA3_256;
+    case IQR_HASHALGO_SHA3_512:
+        return &IQR_HASH_DEFAULT_SHA3_512;
+    default:
+        return NULL;
+    }
+}
+
+iqr_retval register_hashes(iqr_Context *ctx, const iqr_HashAlgorithmType *hashes, size_t hash_count)
+{
+    if (ctx == NULL || (hashes == NULL && hash_count != 0)) {
+        return IQR_ENULLPTR;
+    }
+
+    for (size_t i = 0; i < hash_count; i++) {
+        const iqr_HashCallbacks *cb = default_hash_callbacks(hashes[i]);
+        if (cb == NULL) {
+            return IQR_EINVALGOTYPE;
+        }
+
+        iqr_retval ret = iqr_HashRegisterCallbacks(ctx, hashes[i], cb);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
+            return ret;
+        }
+    }
+
+    return IQR_OK;
+}
@@ -17,9 +17,12 @@
  * limitations under the License.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "iqr_context.h"
+#include "iqr_hash.h"
 #include "iqr_retval.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -36,6 +39,16 @@
  */
 void secure_memzero(void *b, size_t len);
 
+/** Fill a buffer with seed material from the operating system.
+ *
+ * Uses getrandom() on Linux and /dev/urandom elsewhere. Use this to seed or
+ * reseed a DRBG, not as a general purpose RNG.
+ *
+ * @param buf   Pointer to a memory buffer.
+ * @param size  The size of the buffer in bytes.
+ */
+iqr_retval get_system_entropy(uint8_t *buf, size_t size);
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Common I/O functions.
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -60,6 +73,70 @@ iqr_retval save_data(const char *fname, const uint8_t *data, size_t data_size);
  */
 iqr_retval load_data(const char *fname, uint8_t **data, size_t *data_size);
 
+/** Load a named text file into a NUL-terminated buffer.
+ *
+ * Like load_data(), but the buffer always has a terminating NUL after the
+ * file's contents, even for an empty file. You must free() @a text when
+ * you're done with it.
+ *
+ * @param fname     Name of the file.
+ * @param text      A pointer that will receive the buffer's pointer.
+ * @param text_size A pointer to the file's size in bytes, not counting the
+ *                  terminator.
+ */
+iqr_retval load_text(const char *fname, char **text, size_t *text_size);
+
+/** Map a named file into memory, read-only.
+ *
+ * Unlike load_data() this doesn't copy the file or print anything on
+ * success, which matters when you're reading thousands of files. Where
+ * mmap() isn't available the file is read into a buffer instead. Release the
+ * mapping with unmap_data().
+ *
+ * @param fname     Name of the file.
+ * @param data      A pointer that will receive the mapping; NULL for an empty
+ *                  file.
+ * @param data_size A pointer to the size of @a data in bytes.
+ */
+iqr_retval map_data(const char *fname, const uint8_t **data, size_t *data_size);
+
+/** Release a mapping made by map_data().
+ *
+ * @param data      The mapping.
+ * @param data_size Size of @a data in bytes.
+ */
+void unmap_data(const uint8_t *data, size_t data_size);
+
+/** Save a buffer to a named file so it survives a crash or power failure.
+ *
+ * The data is written to "<fname>.tmp", flushed to disk, and then renamed
+ * over @a fname, so readers see either the old file or the complete new one.
+ * Unlike save_data() this doesn't print anything on success.
+ *
+ * @param fname     Name of the file.
+ * @param data      The buffer to write.
+ * @param data_size Size of @a data in bytes.
+ * @param secret    Make the file readable by its owner only, for private
+ *                  keys.
+ */
+iqr_retval save_data_durable(const char *fname, const uint8_t *data, size_t data_size, bool secret);
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Byte order.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/** Store a 32-bit integer big-endian in @a buf's first 4 bytes. */
+void put_u32(uint8_t *buf, uint32_t value);
+
+/** Store a 64-bit integer big-endian in @a buf's first 8 bytes. */
+void put_u64(uint8_t *buf, uint64_t value);
+
+/** Read a big-endian 32-bit integer from @a buf's first 4 bytes. */
+uint32_t get_u32(const uint8_t *buf);
+
+/** Read a big-endian 64-bit integer from @a buf's first 8 bytes. */
+uint64_t get_u64(const uint8_t *buf);
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Parameter parsing.
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -74,3 +151,74 @@ iqr_retval load_data(const char *fname, uint8_t **data, size_t *data_size);
  * @return 0 if the two parameters match, non-zero otherwise.
  */
 int paramcmp(const char *p1 , const char *p2);
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Timing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/** Read a monotonic clock.
+ *
+ * Only the difference between two readings is meaningful.
+ *
+ * @return The current value of the monotonic clock, in nanoseconds.
+ */
+uint64_t time_now_ns(void);
+
+/** Check whether cycles_now() works on this CPU.
+ *
+ * @return true on x86 and x86-64, false elsewhere.
+ */
+bool cycle_counter_available(void);
+
+/** Read the CPU's cycle counter.
+ *
+ * Only the difference between two readings on the same core is meaningful.
+ *
+ * @return The time stamp counter, or 0 if cycle_counter_available() is false.
+ */
+uint64_t cycles_now(void);
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Resource use.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/** Report the process's peak resident set size so far.
+ *
+ * @return The peak RSS in bytes, or 0 if the platform doesn't report it.
+ */
+uint64_t peak_rss_bytes(void);
+
+/** Report the CPU time the process has used so far, on all of its threads.
+ *
+ * Only the difference between two readings is meaningful.
+ *
+ * @return User plus system time in nanoseconds, or 0 if the platform doesn't
+ *         report it.
+ */
+uint64_t process_cpu_ns(void);
+
+/** Count the CPUs that are online, for sizing thread pools.
+ *
+ * @return The number of online CPUs, or 1 if the platform doesn't report it.
+ */
+uint32_t online_cpus(void);
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Hash registration.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/** Find the toolkit's default implementation of a hash algorithm.
+ *
+ * @param hash  The hash algorithm.
+ *
+ * @return The IQR_HASH_DEFAULT_* callbacks for @a hash, or NULL.
+ */
+const iqr_HashCallbacks *default_hash_callbacks(iqr_HashAlgorithmType hash);
+
+/** Register the default implementations of several hash algorithms.
+ *
+ * @param ctx           The toolkit context.
+ * @param hashes        The hash algorithms to register.
+ * @param hash_count    Number of entries in @a hashes.
+ */
+iqr_retval register_hashes(iqr_Context *ctx, const iqr_HashAlgorithmType *hashes, size_t hash_count);
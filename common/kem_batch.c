@@ -0,0 +1,423 @@
+/** @file kem_batch.c
+ *
+ * @brief Encapsulate to many recipients in one run.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kem_batch.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isara_samples.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// No pwrite() here, so there's no batch mode.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval kem_encapsulate_batch(const iqr_Context *ctx, const kem_scheme *kem, const void *params,
+    iqr_HashAlgorithmType drbg_hash, const char *list_file, const char *output_file, uint32_t threads)
+{
+    (void)ctx;
+    (void)kem;
+    (void)params;
+    (void)drbg_hash;
+    (void)list_file;
+    (void)output_file;
+    (void)threads;
+
+    fprintf(stderr, "Batch encapsulation isn't available on this platform.\n");
+    return IQR_EBADVALUE;
+}
+
+#else
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "key_cache.h"
+#include "rng_pool.h"
+
+/* Imported public keys kept for recipients that appear more than once. */
+#define KEM_BATCH_KEY_CACHE_SIZE 64
+
+typedef struct {
+    const kem_scheme *kem;
+    const void *params;
+    rng_pool *rngs;
+    key_cache *keys;
+
+    char **files;
+    size_t count;
+    kem_sizes sizes;
+    size_t record_size;
+
+    int fd;
+    uint32_t *status;
+
+    /* Shared between the threads. */
+    size_t next;
+    bool write_failed;
+} batch_state;
+
+typedef struct {
+    batch_state *state;
+    pthread_t thread;
+    iqr_retval result;
+} batch_worker;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Output helpers.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool write_at(int fd, const uint8_t *buf, size_t size, uint64_t offset)
+{
+    while (size > 0) {
+        const ssize_t put = pwrite(fd, buf, size, (off_t)offset);
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed on pwrite(): %s\n", strerror(errno));
+            return false;
+        }
+        buf += put;
+        size -= (size_t)put;
+        offset += (uint64_t)put;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The list of public key files.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Split the list into lines in place; the returned names point into @a data. */
+static iqr_retval parse_list(char *data, size_t data_size, char ***files, size_t *count)
+{
+    size_t lines = 1;
+    for (size_t i = 0; i < data_size; i++) {
+        if (data[i] == '\n') {
+            lines++;
+        }
+    }
+
+    char **tmp = calloc(lines, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    size_t found = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= data_size; i++) {
+        if (i < data_size && data[i] != '\n') {
+            continue;
+        }
+
+        size_t end = i;
+        while (end > start && (data[end - 1] == '\r' || data[end - 1] == ' ' || data[end - 1] == '\t')) {
+            end--;
+        }
+        if (end > start && data[start] != '#') {
+            data[end] = '\0';
+            tmp[found++] = data + start;
+        }
+        start = i + 1;
+    }
+
+    *files = tmp;
+    *count = found;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Encapsulation.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static kem_batch_status encapsulate_one(batch_state *state, const char *file, const iqr_RNG *rng, uint8_t *record)
+{
+    const void *pub = NULL;
+    key_cache_entry *entry = NULL;
+    key_cache_result result = KEY_CACHE_READ_FAILED;
+
+    if (key_cache_get(state->keys, file, &pub, &entry, &result) != IQR_OK) {
+        return (result == KEY_CACHE_READ_FAILED) ? KEM_BATCH_READ_FAILED : KEM_BATCH_IMPORT_FAILED;
+    }
+
+    kem_batch_status status = KEM_BATCH_OK;
+    if (state->kem->encapsulate(pub, rng, record, state->sizes.ciphertext, record + state->sizes.ciphertext,
+        state->sizes.shared_key) != IQR_OK) {
+        status = KEM_BATCH_ENCAPSULATE_FAILED;
+    }
+
+    key_cache_release(state->keys, entry);
+    return status;
+}
+
+static void *batch_thread(void *arg)
+{
+    batch_worker *w = arg;
+    batch_state *state = w->state;
+
+    uint8_t *record = calloc(1, state->record_size);
+    if (record == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        w->result = IQR_ENOMEM;
+        return NULL;
+    }
+
+    iqr_RNG *rng = NULL;
+    w->result = rng_pool_thread_rng(state->rngs, &rng);
+
+    while (w->result == IQR_OK && !__atomic_load_n(&state->write_failed, __ATOMIC_RELAXED)) {
+        const size_t i = __atomic_fetch_add(&state->next, 1, __ATOMIC_RELAXED);
+        if (i >= state->count) {
+            break;
+        }
+
+        const kem_batch_status status = encapsulate_one(state, state->files[i], rng, record);
+        state->status[i] = (uint32_t)status;
+
+        /* The file starts out zero-filled, so failed records need no write. */
+        if (status == KEM_BATCH_OK) {
+            const uint64_t offset = KEM_BATCH_HEADER_SIZE + (uint64_t)i * state->record_size;
+            if (!write_at(state->fd, record, state->record_size, offset)) {
+                __atomic_store_n(&state->write_failed, true, __ATOMIC_RELAXED);
+                w->result = IQR_EBADVALUE;
+            }
+        }
+        secure_memzero(record, state->record_size);
+    }
+
+    free(record);
+    return NULL;
+}
+
+static iqr_retval run_threads(batch_state *state, uint32_t threads)
+{
+    batch_worker *workers = calloc(threads, sizeof(*workers));
+    if (workers == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = IQR_OK;
+    uint32_t started = 0;
+    for (; started < threads; started++) {
+        workers[started].state = state;
+        const int rc = pthread_create(&workers[started].thread, NULL, batch_thread, &workers[started]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+    }
+
+    /* If some threads didn't start, the others still get through the list. */
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].result != IQR_OK && ret == IQR_OK) {
+            ret = workers[i].result;
+        }
+    }
+    if (started == 0) {
+        ret = IQR_ENOMEM;
+    }
+
+    free(workers);
+    return ret;
+}
+
+static iqr_retval write_header_and_index(const batch_state *state, uint64_t index_offset)
+{
+    uint8_t header[KEM_BATCH_HEADER_SIZE] = { 0 };
+    memcpy(header, "IQRKEMB1", 8);
+    put_u32(header + 8, (uint32_t)state->count);
+    put_u32(header + 12, (uint32_t)state->sizes.ciphertext);
+    put_u32(header + 16, (uint32_t)state->sizes.shared_key);
+    put_u64(header + 24, index_offset);
+
+    size_t index_size = 0;
+    for (size_t i = 0; i < state->count; i++) {
+        index_size += 8 + strlen(state->files[i]);
+    }
+
+    uint8_t *index = calloc(1, index_size + 1);
+    if (index == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    uint8_t *p = index;
+    for (size_t i = 0; i < state->count; i++) {
+        const size_t len = strlen(state->files[i]);
+        put_u32(p, state->status[i]);
+        put_u32(p + 4, (uint32_t)len);
+        memcpy(p + 8, state->files[i], len);
+        p += 8 + len;
+    }
+
+    iqr_retval ret = IQR_OK;
+    if (!write_at(state->fd, index, index_size, index_offset) || !write_at(state->fd, header, sizeof(header), 0)) {
+        ret = IQR_EBADVALUE;
+    }
+
+    free(index);
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Public interface.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval kem_encapsulate_batch(const iqr_Context *ctx, const kem_scheme *kem, const void *params,
+    iqr_HashAlgorithmType drbg_hash, const char *list_file, const char *output_file, uint32_t threads)
+{
+    if (ctx == NULL || kem == NULL || params == NULL || list_file == NULL || output_file == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    char *list = NULL;
+    size_t list_size = 0;
+
+    batch_state state;
+    memset(&state, 0, sizeof(state));
+    state.kem = kem;
+    state.params = params;
+    state.fd = -1;
+
+    iqr_retval ret = kem->get_sizes(params, &state.sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    state.record_size = state.sizes.ciphertext + state.sizes.shared_key;
+
+    ret = load_text(list_file, &list, &list_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = parse_list(list, list_size, &state.files, &state.count);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (state.count == 0 || state.count > UINT32_MAX) {
+        fprintf(stderr, "%s must list between 1 and %u public key files.\n", list_file, (unsigned int)UINT32_MAX);
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    state.status = calloc(state.count, sizeof(*state.status));
+    if (state.status == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    /* A list that names the same recipient more than once only imports its
+     * key once.
+     */
+    ret = key_cache_create(params, kem->import_public_key, kem->destroy_public_key, KEM_BATCH_KEY_CACHE_SIZE, &state.keys);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on key_cache_create(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    rng_pool_config config;
+    rng_pool_default_config(&config);
+    config.hash = drbg_hash;
+    ret = rng_pool_create(ctx, &config, &state.rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    state.fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (state.fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", output_file, strerror(errno));
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    /* Size the file up front so every thread can write its records in place;
+     * the index goes after the last record.
+     */
+    const uint64_t index_offset = KEM_BATCH_HEADER_SIZE + (uint64_t)state.count * state.record_size;
+    if (ftruncate(state.fd, (off_t)index_offset) != 0) {
+        fprintf(stderr, "Failed on ftruncate(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    if (threads == 0) {
+        threads = online_cpus();
+    }
+    if (threads > state.count) {
+        threads = (uint32_t)state.count;
+    }
+
+    const uint64_t start = time_now_ns();
+    ret = run_threads(&state, threads);
+    const double seconds = (double)(time_now_ns() - start) / 1e9;
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = write_header_and_index(&state, index_offset);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < state.count; i++) {
+        if (state.status[i] != KEM_BATCH_OK) {
+            failed++;
+        }
+    }
+
+    fprintf(stdout, "Encapsulated to %zu of %zu public keys in %.2f s (%.1f per second) with %u threads.\n",
+        state.count - failed, state.count, seconds, seconds > 0.0 ? (double)state.count / seconds : 0.0, threads);
+    uint64_t hits = 0;
+    uint64_t imports = 0;
+    key_cache_stats(state.keys, &hits, &imports);
+    fprintf(stdout, "Imported %llu public keys; %llu were reused from the key cache.\n", (unsigned long long)imports,
+        (unsigned long long)hits);
+    if (failed > 0) {
+        fprintf(stdout, "%zu public keys failed; their index entries in %s say why.\n", failed, output_file);
+    }
+    fprintf(stdout, "Successfully saved %s\n", output_file);
+
+end:
+    if (state.fd >= 0 && close(state.fd) != 0 && ret == IQR_OK) {
+        fprintf(stderr, "Failed on close(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+    rng_pool_destroy(&state.rngs);
+    key_cache_destroy(&state.keys);
+    free(state.status);
+    free(state.files);
+    free(list);
+
+    return ret;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/** @file kem_batch.h
+ *
+ * @brief Encapsulate to many recipients in one run.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KEM_BATCH_H
+#define KEM_BATCH_H
+
+#include <stdint.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "kem_table.h"
+
+/* The batch output file is laid out as follows; integers are big-endian.
+ *
+ * Header (32 bytes):
+ *     "IQRKEMB1"     magic
+ *     u32            record count
+ *     u32            ciphertext size
+ *     u32            shared key size
+ *     u32            reserved, 0
+ *     u64            offset of the index
+ *
+ * Records, one per public key in list order, each ciphertext then shared
+ * key, so record i starts at 32 + i * (ciphertext size + shared key size).
+ *
+ * Index, one entry per record:
+ *     u32            a kem_batch_status; unless it's KEM_BATCH_OK the record
+ *                    is all zeroes
+ *     u32            length of the public key's file name
+ *     ...            the file name, not NUL terminated
+ */
+
+/** Size of the batch output file's header in bytes. */
+#define KEM_BATCH_HEADER_SIZE 32
+
+typedef enum {
+    KEM_BATCH_OK = 0,
+    /** The public key file couldn't be read. */
+    KEM_BATCH_READ_FAILED = 1,
+    /** The public key couldn't be imported. */
+    KEM_BATCH_IMPORT_FAILED = 2,
+    /** Encapsulation failed. */
+    KEM_BATCH_ENCAPSULATE_FAILED = 3
+} kem_batch_status;
+
+/** Encapsulate a fresh shared key to every public key in a list.
+ *
+ * The list file names one public key file per line; blank lines and lines
+ * starting with '#' are skipped. Public keys are imported straight from a
+ * read-only mapping of their file through a key_cache, so a key listed more
+ * than once is only imported once. The work is spread over @a threads
+ * threads that each have their own DRBG. A public key that can't be read or
+ * imported doesn't stop the batch; its index entry records the failure.
+ *
+ * The output holds the shared keys, so it's created readable by the owner
+ * only. Threads write their records in place with pwrite(), so batch mode
+ * isn't available on Windows.
+ *
+ * @param ctx           The toolkit context; @a drbg_hash and the KEM's hashes
+ *                      must be registered.
+ * @param kem           The KEM variant.
+ * @param params        Parameters created by @a kem's create_params (or the
+ *                      matching toolkit function).
+ * @param drbg_hash     Hash for the per-thread HMAC-DRBGs.
+ * @param list_file     Name of the list of public key files.
+ * @param output_file   Name of the batch output file.
+ * @param threads       Number of threads; 0 means one per online CPU.
+ */
+iqr_retval kem_encapsulate_batch(const iqr_Context *ctx, const kem_scheme *kem, const void *params,
+    iqr_HashAlgorithmType drbg_hash, const char *list_file, const char *output_file, uint32_t threads);
+
+#endif
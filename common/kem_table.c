@@ -0,0 +1,384 @@
+/** @file kem_table.c
+ *
+ * @brief A common interface to the toolkit's key encapsulation mechanisms.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kem_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_classicmceliece.h"
+#include "iqr_frodokem.h"
+#include "iqr_kyber.h"
+#include "iqr_ntruprime.h"
+#include "iqr_sike.h"
+#include "isara_samples.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Wrappers.
+//
+// The toolkit's KEM APIs all have the same shape, so the functions that only
+// differ by name are generated. Parameter creation and sizes differ between
+// schemes and are written out below.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#define KEM_WRAPPERS(prefix, Scheme)                                                                                              \
+static void prefix##_destroy_params(void **params)                                                                                \
+{                                                                                                                                 \
+    iqr_##Scheme##Params *p = *params;                                                                                            \
+    iqr_##Scheme##DestroyParams(&p);                                                                                              \
+    *params = NULL;                                                                                                               \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_create_key_pair(const void *params, const iqr_RNG *rng, void **pub, void **priv)                      \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *pub_key = NULL;                                                                                      \
+    iqr_##Scheme##PrivateKey *priv_key = NULL;                                                                                    \
+    iqr_retval ret = iqr_##Scheme##CreateKeyPair(params, rng, &pub_key, &priv_key);                                               \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateKeyPair(): %s\n", iqr_StrError(ret));                                     \
+    }                                                                                                                             \
+    *pub = pub_key;                                                                                                               \
+    *priv = priv_key;                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_import_public_key(const void *params, const uint8_t *buf, size_t buf_size, void **pub)                \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *key = NULL;                                                                                          \
+    iqr_retval ret = iqr_##Scheme##ImportPublicKey(params, buf, buf_size, &key);                                                  \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ImportPublicKey(): %s\n", iqr_StrError(ret));                                   \
+    }                                                                                                                             \
+    *pub = key;                                                                                                                   \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_import_private_key(const void *params, const uint8_t *buf, size_t buf_size, void **priv)              \
+{                                                                                                                                 \
+    iqr_##Scheme##PrivateKey *key = NULL;                                                                                         \
+    iqr_retval ret = iqr_##Scheme##ImportPrivateKey(params, buf, buf_size, &key);                                                 \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ImportPrivateKey(): %s\n", iqr_StrError(ret));                                  \
+    }                                                                                                                             \
+    *priv = key;                                                                                                                  \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_export_public_key(const void *pub, uint8_t *buf, size_t buf_size)                                     \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##ExportPublicKey(pub, buf, buf_size);                                                           \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ExportPublicKey(): %s\n", iqr_StrError(ret));                                   \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_export_private_key(const void *priv, uint8_t *buf, size_t buf_size)                                   \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##ExportPrivateKey(priv, buf, buf_size);                                                         \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ExportPrivateKey(): %s\n", iqr_StrError(ret));                                  \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_public_key(void **pub)                                                                               \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *key = *pub;                                                                                          \
+    iqr_##Scheme##DestroyPublicKey(&key);                                                                                         \
+    *pub = NULL;                                                                                                                  \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_private_key(void **priv)                                                                             \
+{                                                                                                                                 \
+    iqr_##Scheme##PrivateKey *key = *priv;                                                                                        \
+    iqr_##Scheme##DestroyPrivateKey(&key);                                                                                        \
+    *priv = NULL;                                                                                                                 \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_encapsulate(const void *pub, const iqr_RNG *rng, uint8_t *ciphertext, size_t ciphertext_size,         \
+    uint8_t *shared_key, size_t shared_key_size)                                                                                  \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##Encapsulate(pub, rng, ciphertext, ciphertext_size, shared_key, shared_key_size);               \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "Encapsulate(): %s\n", iqr_StrError(ret));                                       \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_decapsulate(const void *priv, const uint8_t *ciphertext, size_t ciphertext_size, uint8_t *shared_key, \
+    size_t shared_key_size)                                                                                                       \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##Decapsulate(priv, ciphertext, ciphertext_size, shared_key, shared_key_size);                   \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "Decapsulate(): %s\n", iqr_StrError(ret));                                       \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}
+
+KEM_WRAPPERS(kyber, Kyber)
+KEM_WRAPPERS(frodokem, FrodoKEM)
+KEM_WRAPPERS(ntruprime, NTRUPrime)
+KEM_WRAPPERS(sike, SIKE)
+KEM_WRAPPERS(mceliece, ClassicMcEliece)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Kyber.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval kyber_create_params(const iqr_KyberVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_KyberParams *p = NULL;
+    iqr_retval ret = iqr_KyberCreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval kyber_128_create_params(const iqr_Context *ctx, void **params)
+{
+    return kyber_create_params(&IQR_KYBER_768, ctx, params);
+}
+
+static iqr_retval kyber_224_create_params(const iqr_Context *ctx, void **params)
+{
+    return kyber_create_params(&IQR_KYBER_1024, ctx, params);
+}
+
+static iqr_retval kyber_get_sizes(const void *params, kem_sizes *sizes)
+{
+    iqr_retval ret = iqr_KyberGetPublicKeySize(params, &sizes->public_key);
+    if (ret == IQR_OK) {
+        ret = iqr_KyberGetPrivateKeySize(params, &sizes->private_key);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_KyberGetCiphertextSize(params, &sizes->ciphertext);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberGet*Size(): %s\n", iqr_StrError(ret));
+    }
+    sizes->shared_key = IQR_KYBER_SHARED_KEY_SIZE;
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// FrodoKEM.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval frodokem_create_params(const iqr_FrodoKEMVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_FrodoKEMParams *p = NULL;
+    iqr_retval ret = iqr_FrodoKEMCreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_FrodoKEMCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval frodokem_aes_create_params(const iqr_Context *ctx, void **params)
+{
+    return frodokem_create_params(&IQR_FRODOKEM_976_AES, ctx, params);
+}
+
+static iqr_retval frodokem_shake_create_params(const iqr_Context *ctx, void **params)
+{
+    return frodokem_create_params(&IQR_FRODOKEM_976_SHAKE, ctx, params);
+}
+
+static iqr_retval frodokem_get_sizes(const void *params, kem_sizes *sizes)
+{
+    (void)params;
+
+    /* Both FrodoKEM variants have the same sizes. */
+    sizes->public_key = IQR_FRODOKEM_PUBLIC_KEY_SIZE;
+    sizes->private_key = IQR_FRODOKEM_PRIVATE_KEY_SIZE;
+    sizes->ciphertext = IQR_FRODOKEM_CIPHERTEXT_SIZE;
+    sizes->shared_key = IQR_FRODOKEM_SHARED_KEY_SIZE;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// NTRUPrime.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval ntruprime_create_params(const iqr_Context *ctx, void **params)
+{
+    iqr_NTRUPrimeParams *p = NULL;
+    iqr_retval ret = iqr_NTRUPrimeCreateParams(ctx, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_NTRUPrimeCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval ntruprime_get_sizes(const void *params, kem_sizes *sizes)
+{
+    (void)params;
+
+    sizes->public_key = IQR_NTRUPRIME_PUBLIC_KEY_SIZE;
+    sizes->private_key = IQR_NTRUPRIME_PRIVATE_KEY_SIZE;
+    sizes->ciphertext = IQR_NTRUPRIME_CIPHERTEXT_SIZE;
+    sizes->shared_key = IQR_NTRUPRIME_SHARED_KEY_SIZE;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// SIKE.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval sike_create_params(const iqr_SIKEVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_SIKEParams *p = NULL;
+    iqr_retval ret = iqr_SIKECreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIKECreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval sike_p503_create_params(const iqr_Context *ctx, void **params)
+{
+    return sike_create_params(&IQR_SIKE_P503, ctx, params);
+}
+
+static iqr_retval sike_p751_create_params(const iqr_Context *ctx, void **params)
+{
+    return sike_create_params(&IQR_SIKE_P751, ctx, params);
+}
+
+static iqr_retval sike_get_sizes(const void *params, kem_sizes *sizes)
+{
+    iqr_retval ret = iqr_SIKEGetPublicKeySize(params, &sizes->public_key);
+    if (ret == IQR_OK) {
+        ret = iqr_SIKEGetPrivateKeySize(params, &sizes->private_key);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_SIKEGetCiphertextSize(params, &sizes->ciphertext);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_SIKEGetSharedKeySize(params, &sizes->shared_key);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIKEGet*Size(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Classic McEliece.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval mceliece_create_params(const iqr_ClassicMcElieceVariant *variant, const iqr_Context *ctx, void **params)
+{
+    iqr_ClassicMcElieceParams *p = NULL;
+    iqr_retval ret = iqr_ClassicMcElieceCreateParams(ctx, variant, &p);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceCreateParams(): %s\n", iqr_StrError(ret));
+    }
+    *params = p;
+    return ret;
+}
+
+static iqr_retval mceliece_6_create_params(const iqr_Context *ctx, void **params)
+{
+    return mceliece_create_params(&IQR_CLASSICMCELIECE_6, ctx, params);
+}
+
+static iqr_retval mceliece_8_create_params(const iqr_Context *ctx, void **params)
+{
+    return mceliece_create_params(&IQR_CLASSICMCELIECE_8, ctx, params);
+}
+
+static iqr_retval mceliece_get_sizes(const void *params, kem_sizes *sizes)
+{
+    iqr_retval ret = iqr_ClassicMcElieceGetPublicKeySize(params, &sizes->public_key);
+    if (ret == IQR_OK) {
+        ret = iqr_ClassicMcElieceGetPrivateKeySize(params, &sizes->private_key);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_ClassicMcElieceGetCiphertextSize(params, &sizes->ciphertext);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ClassicMcElieceGet*Size(): %s\n", iqr_StrError(ret));
+    }
+    sizes->shared_key = IQR_CLASSICMCELIECE_SHARED_KEY_SIZE;
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The table.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* These match the hashes registered by the individual samples. */
+static const iqr_HashAlgorithmType sha3_hashes[] = { IQR_HASHALGO_SHA3_256, IQR_HASHALGO_SHA3_512 };
+static const iqr_HashAlgorithmType ntruprime_hashes[] = { IQR_HASHALGO_SHA2_512 };
+
+#define KEM_FUNCTIONS(prefix, create_params, get_sizes)                                                                           \
+    create_params, prefix##_destroy_params, get_sizes, prefix##_create_key_pair, prefix##_import_public_key,                      \
+    prefix##_import_private_key, prefix##_export_public_key, prefix##_export_private_key, prefix##_destroy_public_key,           \
+    prefix##_destroy_private_key, prefix##_encapsulate, prefix##_decapsulate
+
+const kem_scheme kem_schemes[] = {
+    { "kyber-128", "128", sha3_hashes, 2, KEM_FUNCTIONS(kyber, kyber_128_create_params, kyber_get_sizes) },
+    { "kyber-224", "224", sha3_hashes, 2, KEM_FUNCTIONS(kyber, kyber_224_create_params, kyber_get_sizes) },
+    { "frodokem-aes", "AES", NULL, 0, KEM_FUNCTIONS(frodokem, frodokem_aes_create_params, frodokem_get_sizes) },
+    { "frodokem-shake", "SHAKE", NULL, 0, KEM_FUNCTIONS(frodokem, frodokem_shake_create_params, frodokem_get_sizes) },
+    { "ntruprime", "", ntruprime_hashes, 1, KEM_FUNCTIONS(ntruprime, ntruprime_create_params, ntruprime_get_sizes) },
+    { "sike-p503", "p503", sha3_hashes, 2, KEM_FUNCTIONS(sike, sike_p503_create_params, sike_get_sizes) },
+    { "sike-p751", "p751", sha3_hashes, 2, KEM_FUNCTIONS(sike, sike_p751_create_params, sike_get_sizes) },
+    { "classicmceliece-6", "6", NULL, 0, KEM_FUNCTIONS(mceliece, mceliece_6_create_params, mceliece_get_sizes) },
+    { "classicmceliece-8", "8", NULL, 0, KEM_FUNCTIONS(mceliece, mceliece_8_create_params, mceliece_get_sizes) }
+};
+
+const size_t kem_scheme_count = sizeof(kem_schemes) / sizeof(kem_schemes[0]);
+
+const kem_scheme *kem_find(const char *name)
+{
+    if (name == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < kem_scheme_count; i++) {
+        if (strcmp(kem_schemes[i].name, name) == 0) {
+            return &kem_schemes[i];
+        }
+    }
+    return NULL;
+}
+
+iqr_retval kem_bootstrap_context(const kem_scheme *kem, iqr_Context **ctx)
+{
+    if (kem == NULL || ctx == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    const iqr_HashAlgorithmType drbg_hash = IQR_HASHALGO_SHA2_256;
+    iqr_retval ret = bootstrap_context(&drbg_hash, 1, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    return bootstrap_context(kem->hashes, kem->hash_count, ctx);
+}
@@ -0,0 +1,101 @@
+/** @file kem_table.h
+ *
+ * @brief A common interface to the toolkit's key encapsulation mechanisms.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KEM_TABLE_H
+#define KEM_TABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/** Sizes of the buffers used by a KEM variant, in bytes. */
+typedef struct {
+    size_t public_key;
+    size_t private_key;
+    size_t ciphertext;
+    size_t shared_key;
+} kem_sizes;
+
+/** One KEM variant (Kyber 128, SIKE p751, ...) behind a common interface.
+ *
+ * Params, keys and ciphertexts are the toolkit's own objects passed around as
+ * `void *`; only hand them to functions of the same entry. The functions
+ * print a "Failed on ..." message before returning an error, like the
+ * samples do.
+ */
+typedef struct {
+    /** Name used on the command line, for example "kyber-128". */
+    const char *name;
+    /** The variant as the individual samples spell it, for example "128". */
+    const char *variant_name;
+
+    /** Hashes that must be registered in the context; the DRBG's SHA2-256
+     * isn't included.
+     */
+    const iqr_HashAlgorithmType *hashes;
+    size_t hash_count;
+
+    iqr_retval (*create_params)(const iqr_Context *ctx, void **params);
+    void (*destroy_params)(void **params);
+    iqr_retval (*get_sizes)(const void *params, kem_sizes *sizes);
+
+    iqr_retval (*create_key_pair)(const void *params, const iqr_RNG *rng, void **pub, void **priv);
+    iqr_retval (*import_public_key)(const void *params, const uint8_t *buf, size_t buf_size, void **pub);
+    iqr_retval (*import_private_key)(const void *params, const uint8_t *buf, size_t buf_size, void **priv);
+    iqr_retval (*export_public_key)(const void *pub, uint8_t *buf, size_t buf_size);
+    iqr_retval (*export_private_key)(const void *priv, uint8_t *buf, size_t buf_size);
+    void (*destroy_public_key)(void **pub);
+    void (*destroy_private_key)(void **priv);
+
+    iqr_retval (*encapsulate)(const void *pub, const iqr_RNG *rng, uint8_t *ciphertext, size_t ciphertext_size,
+        uint8_t *shared_key, size_t shared_key_size);
+    iqr_retval (*decapsulate)(const void *priv, const uint8_t *ciphertext, size_t ciphertext_size, uint8_t *shared_key,
+        size_t shared_key_size);
+} kem_scheme;
+
+/** Every KEM variant the samples cover. */
+extern const kem_scheme kem_schemes[];
+
+/** Number of entries in kem_schemes. */
+extern const size_t kem_scheme_count;
+
+/** Look up a KEM variant by name.
+ *
+ * @param name  The variant's name, for example "sike-p751".
+ *
+ * @return The matching entry or NULL.
+ */
+const kem_scheme *kem_find(const char *name);
+
+/** Get the calling thread's bootstrap context, with the hashes a KEM variant
+ * needs and SHA2-256 for the DRBG registered.
+ *
+ * Hashes that are already registered are skipped, so you can call this once
+ * per variant.
+ *
+ * @param kem   The KEM variant.
+ * @param ctx   A pointer that will receive the context.
+ */
+iqr_retval kem_bootstrap_context(const kem_scheme *kem, iqr_Context **ctx);
+
+#endif
@@ -0,0 +1,342 @@
+/** @file key_cache.c
+ *
+ * @brief A cache of imported public keys, keyed by file.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "key_cache.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "isara_samples.h"
+
+/* What identifies one version of a key file. */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+} file_version;
+
+struct key_cache_entry {
+    char *path;
+    file_version version;
+    void *key;
+
+    /* Callers holding the key. */
+    uint32_t refs;
+    uint64_t last_used;
+    /* Cleared when the entry leaves the table; it's freed on last release. */
+    bool cached;
+};
+
+struct key_cache {
+    const void *params;
+    key_cache_import_fn import;
+    key_cache_destroy_fn destroy;
+
+    pthread_mutex_t lock;
+    key_cache_entry **entries;
+    size_t count;
+    size_t capacity;
+
+    uint64_t clock;
+    uint64_t hits;
+    uint64_t imports;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Helpers.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool get_version(const char *path, file_version *version)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+
+    memset(version, 0, sizeof(*version));
+    version->dev = st.st_dev;
+    version->ino = st.st_ino;
+    version->size = st.st_size;
+    version->mtime = st.st_mtime;
+#if defined(_WIN32) || defined(_WIN64)
+    /* Only whole seconds here; mtime_nsec stays 0. */
+#elif defined(__APPLE__)
+    version->mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+    version->mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+static bool same_version(const file_version *a, const file_version *b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size && a->mtime == b->mtime
+        && a->mtime_nsec == b->mtime_nsec;
+}
+
+/* Whether @a a was modified after @a b. */
+static bool newer_version(const file_version *a, const file_version *b)
+{
+    return a->mtime > b->mtime || (a->mtime == b->mtime && a->mtime_nsec > b->mtime_nsec);
+}
+
+static void free_entry(key_cache *cache, key_cache_entry *entry)
+{
+    if (entry->key != NULL) {
+        cache->destroy(&entry->key);
+    }
+    free(entry->path);
+    free(entry);
+}
+
+/* Take an entry out of the table; call with the lock held. */
+static void remove_entry(key_cache *cache, size_t i)
+{
+    key_cache_entry *entry = cache->entries[i];
+    cache->entries[i] = cache->entries[--cache->count];
+    entry->cached = false;
+    if (entry->refs == 0) {
+        free_entry(cache, entry);
+    }
+}
+
+static key_cache_entry *find_entry(key_cache *cache, const char *path, size_t *index)
+{
+    for (size_t i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i]->path, path) == 0) {
+            *index = i;
+            return cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Make room for one more entry; call with the lock held. Returns false if
+ * every entry is in use.
+ */
+static bool make_room(key_cache *cache)
+{
+    if (cache->count < cache->capacity) {
+        return true;
+    }
+
+    size_t victim = cache->count;
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->entries[i]->refs == 0
+            && (victim == cache->count || cache->entries[i]->last_used < cache->entries[victim]->last_used)) {
+            victim = i;
+        }
+    }
+    if (victim == cache->count) {
+        return false;
+    }
+
+    remove_entry(cache, victim);
+    return true;
+}
+
+static key_cache_result import_file(key_cache *cache, const char *path, key_cache_entry **entry)
+{
+    const uint8_t *data = NULL;
+    size_t data_size = 0;
+
+    key_cache_entry *tmp = calloc(1, sizeof(*tmp));
+    const size_t path_size = strlen(path) + 1;
+    char *path_copy = calloc(1, path_size);
+    if (tmp == NULL || path_copy == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(tmp);
+        free(path_copy);
+        return KEY_CACHE_IMPORT_FAILED;
+    }
+    memcpy(path_copy, path, path_size);
+    tmp->path = path_copy;
+
+    /* Take the version before reading, so a write that races with the read
+     * shows up as a change on the next lookup.
+     */
+    if (!get_version(path, &tmp->version) || map_data(path, &data, &data_size) != IQR_OK) {
+        free_entry(cache, tmp);
+        return KEY_CACHE_READ_FAILED;
+    }
+
+    const iqr_retval ret = cache->import(cache->params, data, data_size, &tmp->key);
+    unmap_data(data, data_size);
+    if (ret != IQR_OK) {
+        free_entry(cache, tmp);
+        return KEY_CACHE_IMPORT_FAILED;
+    }
+
+    *entry = tmp;
+    return KEY_CACHE_IMPORTED;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Public interface.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval key_cache_create(const void *params, key_cache_import_fn import, key_cache_destroy_fn destroy, size_t capacity,
+    key_cache **cache)
+{
+    if (import == NULL || destroy == NULL || cache == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (capacity == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    key_cache *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        return IQR_ENOMEM;
+    }
+    tmp->entries = calloc(capacity, sizeof(*tmp->entries));
+    if (tmp->entries == NULL) {
+        free(tmp);
+        return IQR_ENOMEM;
+    }
+
+    tmp->params = params;
+    tmp->import = import;
+    tmp->destroy = destroy;
+    tmp->capacity = capacity;
+    pthread_mutex_init(&tmp->lock, NULL);
+
+    *cache = tmp;
+    return IQR_OK;
+}
+
+iqr_retval key_cache_get(key_cache *cache, const char *path, const void **key, key_cache_entry **entry,
+    key_cache_result *result)
+{
+    if (cache == NULL || path == NULL || key == NULL || entry == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    key_cache_result dummy;
+    if (result == NULL) {
+        result = &dummy;
+    }
+    *key = NULL;
+    *entry = NULL;
+
+    file_version version;
+    if (!get_version(path, &version)) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        *result = KEY_CACHE_READ_FAILED;
+        return IQR_EBADVALUE;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    size_t index = 0;
+    key_cache_entry *found = find_entry(cache, path, &index);
+    if (found != NULL && same_version(&found->version, &version)) {
+        found->refs++;
+        found->last_used = ++cache->clock;
+        cache->hits++;
+        pthread_mutex_unlock(&cache->lock);
+
+        *key = found->key;
+        *entry = found;
+        *result = KEY_CACHE_HIT;
+        return IQR_OK;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    /* Import without holding the lock; this is the slow part. */
+    key_cache_entry *imported = NULL;
+    *result = import_file(cache, path, &imported);
+    if (*result != KEY_CACHE_IMPORTED) {
+        return IQR_EBADVALUE;
+    }
+    imported->refs = 1;
+
+    pthread_mutex_lock(&cache->lock);
+    cache->imports++;
+    imported->last_used = ++cache->clock;
+
+    /* Another thread may have imported the same file meanwhile. The newer
+     * version keeps the slot, and on a tie the entry that's already there
+     * stays; an import that loses isn't cached and is freed on release.
+     */
+    bool keep = true;
+    found = find_entry(cache, path, &index);
+    if (found != NULL) {
+        if (newer_version(&imported->version, &found->version)) {
+            remove_entry(cache, index);
+        } else {
+            keep = false;
+        }
+    }
+    if (keep && make_room(cache)) {
+        imported->cached = true;
+        cache->entries[cache->count++] = imported;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    *key = imported->key;
+    *entry = imported;
+    return IQR_OK;
+}
+
+void key_cache_release(key_cache *cache, key_cache_entry *entry)
+{
+    if (cache == NULL || entry == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    entry->refs--;
+    const bool orphaned = !entry->cached && entry->refs == 0;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (orphaned) {
+        free_entry(cache, entry);
+    }
+}
+
+void key_cache_stats(key_cache *cache, uint64_t *hits, uint64_t *imports)
+{
+    pthread_mutex_lock(&cache->lock);
+    *hits = cache->hits;
+    *imports = cache->imports;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void key_cache_destroy(key_cache **cache)
+{
+    if (cache == NULL || *cache == NULL) {
+        return;
+    }
+
+    key_cache *tmp = *cache;
+    for (size_t i = 0; i < tmp->count; i++) {
+        free_entry(tmp, tmp->entries[i]);
+    }
+    pthread_mutex_destroy(&tmp->lock);
+    free(tmp->entries);
+    free(tmp);
+    *cache = NULL;
+}
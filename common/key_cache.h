@@ -0,0 +1,113 @@
+/** @file key_cache.h
+ *
+ * @brief A cache of imported public keys, keyed by file.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_retval.h"
+
+/** Imports a key from a buffer; kem_scheme's and sig_scheme's
+ * import_public_key functions fit.
+ */
+typedef iqr_retval (*key_cache_import_fn)(const void *params, const uint8_t *buf, size_t buf_size, void **key);
+
+/** Destroys a key made by the matching key_cache_import_fn. */
+typedef void (*key_cache_destroy_fn)(void **key);
+
+/** What key_cache_get() had to do. */
+typedef enum {
+    /** The key was already imported and the file hasn't changed. */
+    KEY_CACHE_HIT,
+    /** The key was imported now, because it wasn't cached or the file
+     * changed.
+     */
+    KEY_CACHE_IMPORTED,
+    /** The file couldn't be read. */
+    KEY_CACHE_READ_FAILED,
+    /** The file was read but the key couldn't be imported. */
+    KEY_CACHE_IMPORT_FAILED
+} key_cache_result;
+
+/** A cache of imported keys. */
+typedef struct key_cache key_cache;
+
+/** A key handed out by key_cache_get(). */
+typedef struct key_cache_entry key_cache_entry;
+
+/** Create a key cache.
+ *
+ * Keys are read with map_data(), so the file is mapped read-only straight
+ * out of the page cache (and shared with every other process using it)
+ * instead of being copied into a buffer first; the mapping is released as
+ * soon as the toolkit has imported the key.
+ *
+ * Entries are keyed by path and checked against the file's device, inode,
+ * size and modification time on every lookup, so replacing a key file
+ * replaces the cached key. When the cache is full the least recently used
+ * key that nobody holds is dropped.
+ *
+ * The cache can be shared between threads.
+ *
+ * @param params    Passed to @a import; must outlive the cache.
+ * @param import    Imports a key from a file's contents.
+ * @param destroy   Destroys an imported key.
+ * @param capacity  Maximum number of keys kept.
+ * @param cache     A pointer that will receive the new cache.
+ */
+iqr_retval key_cache_create(const void *params, key_cache_import_fn import, key_cache_destroy_fn destroy, size_t capacity,
+    key_cache **cache);
+
+/** Get the imported key for a file, importing it if needed.
+ *
+ * The key stays valid until you hand @a entry back with key_cache_release(),
+ * even if the file changes or the key is dropped from the cache meanwhile.
+ *
+ * @param cache     The cache.
+ * @param path      Name of the key file.
+ * @param key       A pointer that will receive the key.
+ * @param entry     A pointer that will receive the entry to release.
+ * @param result    Receives what happened; may be NULL.
+ */
+iqr_retval key_cache_get(key_cache *cache, const char *path, const void **key, key_cache_entry **entry,
+    key_cache_result *result);
+
+/** Hand back a key from key_cache_get().
+ *
+ * @param cache     The cache.
+ * @param entry     The entry; NULL is ignored.
+ */
+void key_cache_release(key_cache *cache, key_cache_entry *entry);
+
+/** Get the number of lookups served from the cache and the number that had
+ * to import the key.
+ */
+void key_cache_stats(key_cache *cache, uint64_t *hits, uint64_t *imports);
+
+/** Destroy a key cache and every key in it.
+ *
+ * All entries must have been released.
+ *
+ * @param cache     The cache; set to NULL.
+ */
+void key_cache_destroy(key_cache **cache);
+
+#endif
@@ -0,0 +1,362 @@
+/** @file keypool.c
+ *
+ * @brief Precompute ephemeral keys on a background thread.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "keypool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isara_samples.h"
+#include "rng_pool.h"
+
+/* The ring is a bounded multi-producer, multi-consumer queue: every slot
+ * carries a sequence number that tells producers and consumers whose turn it
+ * is, so neither side needs a lock. Only the watermark wake-ups use the
+ * mutex.
+ */
+typedef struct {
+    size_t seq;
+    void *item;
+} keypool_slot;
+
+struct keypool {
+    keypool_ops ops;
+    const void *arg;
+    rng_pool *rngs;
+
+    keypool_slot *slots;
+    size_t mask;
+    size_t head;
+    size_t tail;
+
+    size_t low;
+    size_t high;
+
+    uint64_t hits;
+    uint64_t misses;
+
+    pthread_t refill;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    /** Signalled whenever the refill thread finishes a pass. */
+    pthread_cond_t filled;
+    /** Set by keypool_warm() to ask for a pass above the low watermark. */
+    bool fill_requested;
+    /** The last pass's result. */
+    iqr_retval fill_result;
+    bool stop;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Lock-free ring.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool ring_push(keypool *pool, void *item)
+{
+    size_t pos = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED);
+    keypool_slot *slot = NULL;
+    for (;;) {
+        slot = &pool->slots[pos & pool->mask];
+        const size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // Full.
+        } else {
+            pos = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->item = item;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool ring_pop(keypool *pool, void **item)
+{
+    size_t pos = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+    keypool_slot *slot = NULL;
+    for (;;) {
+        slot = &pool->slots[pos & pool->mask];
+        const size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // Empty.
+        } else {
+            pos = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    *item = slot->item;
+    slot->item = NULL;
+    __atomic_store_n(&slot->seq, pos + pool->mask + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+size_t keypool_available(const keypool *pool)
+{
+    if (pool == NULL) {
+        return 0;
+    }
+
+    const size_t head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    const size_t tail = __atomic_load_n(&pool->tail, __ATOMIC_ACQUIRE);
+
+    /* The two loads aren't atomic together, so this is only an estimate. */
+    return (tail > head) ? tail - head : 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Precomputation.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval create_item(keypool *pool, void **item)
+{
+    iqr_RNG *rng = NULL;
+    iqr_retval ret = rng_pool_thread_rng(pool->rngs, &rng);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    return pool->ops.create(pool->arg, rng, item);
+}
+
+static void *refill_thread(void *arg)
+{
+    keypool *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && !pool->fill_requested && keypool_available(pool) > pool->low) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        const bool stop = pool->stop;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) {
+            break;
+        }
+
+        iqr_retval ret = IQR_OK;
+        while (!__atomic_load_n(&pool->stop, __ATOMIC_RELAXED) && keypool_available(pool) < pool->high) {
+            void *item = NULL;
+            ret = create_item(pool, &item);
+            if (ret != IQR_OK) {
+                /* Takes fall back to creating their own items, so a failure
+                 * here only costs latency. Try again on the next wake-up.
+                 */
+                break;
+            }
+            if (!ring_push(pool, item)) {
+                pool->ops.destroy(item);
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->fill_requested = false;
+        pool->fill_result = ret;
+        pthread_cond_broadcast(&pool->filled);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Public interface.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval keypool_create(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const keypool_ops *ops,
+    const void *arg, size_t capacity, size_t low_watermark, size_t high_watermark, keypool **pool)
+{
+    if (ctx == NULL || ops == NULL || pool == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    if (capacity == 0 || high_watermark == 0 || high_watermark > slots || low_watermark >= high_watermark) {
+        return IQR_EBADVALUE;
+    }
+
+    keypool *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    tmp->slots = calloc(slots, sizeof(*tmp->slots));
+    if (tmp->slots == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(tmp);
+        return IQR_ENOMEM;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        tmp->slots[i].seq = i;
+    }
+
+    tmp->ops = *ops;
+    tmp->arg = arg;
+    tmp->mask = slots - 1;
+    tmp->low = low_watermark;
+    tmp->high = high_watermark;
+    tmp->fill_result = IQR_OK;
+
+    rng_pool_config config;
+    rng_pool_default_config(&config);
+    config.hash = drbg_hash;
+
+    iqr_retval ret = rng_pool_create(ctx, &config, &tmp->rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        free(tmp->slots);
+        free(tmp);
+        return ret;
+    }
+
+    pthread_mutex_init(&tmp->lock, NULL);
+    pthread_cond_init(&tmp->wake, NULL);
+    pthread_cond_init(&tmp->filled, NULL);
+
+    int rc = pthread_create(&tmp->refill, NULL, refill_thread, tmp);
+    if (rc != 0) {
+        fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+        pthread_cond_destroy(&tmp->filled);
+        pthread_cond_destroy(&tmp->wake);
+        pthread_mutex_destroy(&tmp->lock);
+        rng_pool_destroy(&tmp->rngs);
+        free(tmp->slots);
+        free(tmp);
+        return IQR_ENOMEM;
+    }
+
+    *pool = tmp;
+    return IQR_OK;
+}
+
+iqr_retval keypool_take(keypool *pool, void **item)
+{
+    if (pool == NULL || item == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    if (ring_pop(pool, item)) {
+        __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+
+        /* Only touch the lock when we've crossed the low watermark. */
+        if (keypool_available(pool) <= pool->low) {
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_signal(&pool->wake);
+            pthread_mutex_unlock(&pool->lock);
+        }
+        return IQR_OK;
+    }
+
+    __atomic_add_fetch(&pool->misses, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    return create_item(pool, item);
+}
+
+iqr_retval keypool_warm(keypool *pool)
+{
+    if (pool == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    iqr_retval ret = IQR_OK;
+
+    pthread_mutex_lock(&pool->lock);
+    while (keypool_available(pool) < pool->high) {
+        /* Ask for a pass even above the low watermark, and wait for it to
+         * finish. A pass that ends short of full has failed.
+         */
+        pool->fill_requested = true;
+        pthread_cond_signal(&pool->wake);
+        pthread_cond_wait(&pool->filled, &pool->lock);
+        if (pool->fill_result != IQR_OK) {
+            ret = pool->fill_result;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return ret;
+}
+
+void keypool_stats(const keypool *pool, uint64_t *hits, uint64_t *misses)
+{
+    if (pool == NULL) {
+        return;
+    }
+    if (hits != NULL) {
+        *hits = __atomic_load_n(&pool->hits, __ATOMIC_RELAXED);
+    }
+    if (misses != NULL) {
+        *misses = __atomic_load_n(&pool->misses, __ATOMIC_RELAXED);
+    }
+}
+
+void keypool_destroy(keypool **pool)
+{
+    if (pool == NULL || *pool == NULL) {
+        return;
+    }
+
+    keypool *p = *pool;
+
+    pthread_mutex_lock(&p->lock);
+    __atomic_store_n(&p->stop, true, __ATOMIC_RELAXED);
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->refill, NULL);
+
+    /* Nobody else is using the ring any more, so drain whatever's left. */
+    void *item = NULL;
+    while (ring_pop(p, &item)) {
+        p->ops.destroy(item);
+    }
+
+    pthread_cond_destroy(&p->filled);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    rng_pool_destroy(&p->rngs);
+    secure_memzero(p->slots, (p->mask + 1) * sizeof(*p->slots));
+    free(p->slots);
+    free(p);
+
+    *pool = NULL;
+}
@@ -0,0 +1,114 @@
+/** @file keypool.h
+ *
+ * @brief Precompute ephemeral keys on a background thread.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KEYPOOL_H
+#define KEYPOOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/** How a scheme precomputes the part of its work that doesn't depend on the
+ * peer: a key agreement responder's private key, say, or a KEM key pair.
+ *
+ * The pool never looks inside an item; it only hands it to whoever takes it.
+ */
+typedef struct {
+    /** Make one item, such as an ephemeral private key. */
+    iqr_retval (*create)(const void *arg, const iqr_RNG *rng, void **item);
+    /** Destroy an item nobody took. */
+    void (*destroy)(void *item);
+} keypool_ops;
+
+/** A pool of precomputed keys, refilled by a background thread. */
+typedef struct keypool keypool;
+
+/** Create a key pool and start its refill thread.
+ *
+ * The refill thread sleeps until the number of pooled items drops to
+ * @a low_watermark, then creates items until there are @a high_watermark of
+ * them. The pool starts out empty; use keypool_warm() to wait for the
+ * first fill.
+ *
+ * The refill thread doesn't survive fork(), so create the pool in the process
+ * that will take from it.
+ *
+ * @param ctx               The toolkit context; @a drbg_hash and the scheme's
+ *                          hashes must be registered.
+ * @param drbg_hash         Hash for the pool's HMAC-DRBGs.
+ * @param ops               The scheme's item functions; copied.
+ * @param arg               Passed to @a ops create(); must outlive the pool.
+ * @param capacity          Slots in the ring; rounded up to a power of two.
+ * @param low_watermark     Refill when this many items or fewer remain.
+ * @param high_watermark    Stop refilling at this many items.
+ * @param pool              A pointer that will receive the new pool.
+ */
+iqr_retval keypool_create(const iqr_Context *ctx, iqr_HashAlgorithmType drbg_hash, const keypool_ops *ops,
+    const void *arg, size_t capacity, size_t low_watermark, size_t high_watermark, keypool **pool);
+
+/** Take an item from the pool.
+ *
+ * When an item is available this doesn't block or allocate. If the pool has
+ * run dry, an item is created on the calling thread instead and counted as a
+ * miss. Either way the caller owns the item.
+ *
+ * Safe to call from several threads at once.
+ *
+ * @param pool  The key pool.
+ * @param item  A pointer that will receive the item.
+ */
+iqr_retval keypool_take(keypool *pool, void **item);
+
+/** Wait until the pool has been filled to its high watermark.
+ *
+ * @param pool  The key pool.
+ *
+ * @return IQR_OK once the pool is full, or the refill thread's error if it
+ * couldn't create an item.
+ */
+iqr_retval keypool_warm(keypool *pool);
+
+/** Number of items currently in the pool.
+ *
+ * @param pool  The key pool.
+ */
+size_t keypool_available(const keypool *pool);
+
+/** Report how many takes were served from the pool and how many weren't.
+ *
+ * @param pool      The key pool.
+ * @param hits      A pointer that will receive the number of pooled takes.
+ * @param misses    A pointer that will receive the number of inline takes.
+ */
+void keypool_stats(const keypool *pool, uint64_t *hits, uint64_t *misses);
+
+/** Stop the refill thread and destroy the pool.
+ *
+ * Items still in the pool are destroyed. Don't call this while other threads
+ * might still call keypool_take().
+ *
+ * @param pool  The pool to destroy; set to NULL on return.
+ */
+void keypool_destroy(keypool **pool);
+
+#endif
@@ -0,0 +1,140 @@
+/** @file latency.c
+ *
+ * @brief A fixed-size latency histogram for the benchmarking samples.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "latency.h"
+
+#include <string.h>
+
+/* Values below 2 * SUB_BUCKETS get a bucket each. Above that, the values
+ * between 2^n and 2^(n+1) share SUB_BUCKETS buckets.
+ */
+#define SUB_BITS 5
+#define SUB_BUCKETS (1u << SUB_BITS)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Bucket arithmetic.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static unsigned int bucket_index(uint64_t ns)
+{
+    if (ns < 2 * SUB_BUCKETS) {
+        return (unsigned int)ns;
+    }
+
+    unsigned int msb = 63;
+    while ((ns >> msb) == 0) {
+        msb--;
+    }
+    const unsigned int shift = msb - SUB_BITS;
+
+    return shift * SUB_BUCKETS + (unsigned int)(ns >> shift);
+}
+
+/* The largest value that lands in the bucket. */
+static uint64_t bucket_value(unsigned int index)
+{
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+
+    const unsigned int shift = index / SUB_BUCKETS - 1;
+    const uint64_t top = index % SUB_BUCKETS + SUB_BUCKETS;
+
+    return ((top + 1) << shift) - 1;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Public interface.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+void latency_reset(latency_histogram *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min_ns = UINT64_MAX;
+}
+
+void latency_record(latency_histogram *h, uint64_t ns)
+{
+    h->buckets[bucket_index(ns)]++;
+    h->count++;
+    h->sum_ns += ns;
+    if (ns < h->min_ns) {
+        h->min_ns = ns;
+    }
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+}
+
+void latency_merge(latency_histogram *dst, const latency_histogram *src)
+{
+    for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->min_ns < dst->min_ns) {
+        dst->min_ns = src->min_ns;
+    }
+    if (src->max_ns > dst->max_ns) {
+        dst->max_ns = src->max_ns;
+    }
+}
+
+uint64_t latency_percentile(const latency_histogram *h, double pct)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+
+    /* The rank of the sample we're after, counting from 1. */
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > h->count) {
+        rank = h->count;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            /* Don't report more than we actually saw. */
+            const uint64_t value = bucket_value(i);
+            return (value < h->max_ns) ? value : h->max_ns;
+        }
+    }
+
+    return h->max_ns;
+}
+
+void latency_print(FILE *out, const char *label, const latency_histogram *h)
+{
+    if (h->count == 0) {
+        return;
+    }
+
+    const uint64_t p50 = latency_percentile(h, 50.0);
+    const uint64_t p99 = latency_percentile(h, 99.0);
+    const uint64_t p999 = latency_percentile(h, 99.9);
+
+    fprintf(out, "%s in microseconds: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", label, (double)p50 / 1e3,
+        (double)p99 / 1e3, (double)p999 / 1e3, (double)h->max_ns / 1e3);
+}
@@ -0,0 +1,84 @@
+/** @file latency.h
+ *
+ * @brief A fixed-size latency histogram for the benchmarking samples.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** Number of buckets in a latency_histogram. */
+#define LATENCY_BUCKETS 1920
+
+/** A log-linear histogram of durations in nanoseconds.
+ *
+ * Every power of two is split into 32 buckets, so a percentile is accurate to
+ * about 3% no matter how long the operation takes. Recording a sample never
+ * allocates, which keeps it out of the timings. A histogram isn't thread safe;
+ * give each thread its own and merge them at the end.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_histogram;
+
+/** Empty a histogram.
+ *
+ * @param h     The histogram.
+ */
+void latency_reset(latency_histogram *h);
+
+/** Record one duration.
+ *
+ * @param h     The histogram.
+ * @param ns    The duration in nanoseconds.
+ */
+void latency_record(latency_histogram *h, uint64_t ns);
+
+/** Add the samples in one histogram to another.
+ *
+ * @param dst   The histogram receiving the samples.
+ * @param src   The histogram to add.
+ */
+void latency_merge(latency_histogram *dst, const latency_histogram *src);
+
+/** Estimate a percentile.
+ *
+ * @param h     The histogram.
+ * @param pct   The percentile, from 0.0 to 100.0.
+ *
+ * @return The duration in nanoseconds, or 0 if the histogram is empty.
+ */
+uint64_t latency_percentile(const latency_histogram *h, double pct);
+
+/** Print the median, tail percentiles and maximum on one line.
+ *
+ * For example: "<label> in microseconds: p50 12.3, p99 45.6, p99.9 78.9,
+ * max 101.2". Nothing is printed for an empty histogram.
+ *
+ * @param out   The stream to print to.
+ * @param label What was measured.
+ * @param h     The histogram.
+ */
+void latency_print(FILE *out, const char *label, const latency_histogram *h);
+
+#endif
@@ -0,0 +1,455 @@
+/** @file merkle_batch.c
+ *
+ * @brief Sign many messages with one stateful signature over a Merkle tree.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "merkle_batch.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iqr_hash.h"
+#include "isara_samples.h"
+
+#define PROOF_MAGIC "IQRMRKL1"
+#define PROOF_MAGIC_SIZE 8
+
+#define PREFIX_LEAF 0x00
+#define PREFIX_NODE 0x01
+
+/* The stand-in message's label, including its terminating 0x00. */
+#define STAND_IN_LABEL "ISARA-Samples-Merkle"
+#define STAND_IN_LABEL_SIZE sizeof(STAND_IN_LABEL)
+
+/* Label, u64 leaf count and root. */
+#define STAND_IN_SIZE (STAND_IN_LABEL_SIZE + 8 + MERKLE_DIGEST_SIZE)
+
+/* Leaf indices are u32, so there are at most 33 levels. */
+#define MAX_LEVELS 33
+
+struct merkle_batch {
+    /* The list file's contents; the names point into it. */
+    char *list;
+    char **names;
+    size_t count;
+
+    /* Every level of the tree, leaves first. */
+    uint8_t *nodes;
+    size_t levels;
+    size_t level_start[MAX_LEVELS];
+    size_t level_width[MAX_LEVELS];
+
+    uint8_t signed_digest[MERKLE_DIGEST_SIZE];
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Helpers.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* out = H(prefix || a || b); b can be NULL. */
+static iqr_retval hash_prefixed(iqr_Hash *hash, uint8_t prefix, const uint8_t *a, size_t a_size, const uint8_t *b,
+    size_t b_size, uint8_t *out)
+{
+    iqr_retval ret = iqr_HashBegin(hash);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashBegin(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    ret = iqr_HashUpdate(hash, &prefix, 1);
+    if (ret == IQR_OK) {
+        ret = iqr_HashUpdate(hash, a, a_size);
+    }
+    if (ret == IQR_OK && b != NULL) {
+        ret = iqr_HashUpdate(hash, b, b_size);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashUpdate(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    ret = iqr_HashEnd(hash, out, MERKLE_DIGEST_SIZE);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashEnd(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+/* Hash the stand-in message the same way the samples hash a single message
+ * before signing it.
+ */
+static iqr_retval hash_signed(iqr_Hash *hash, const uint8_t *root, uint64_t count, uint8_t *out)
+{
+    uint8_t stand_in[STAND_IN_SIZE];
+    memcpy(stand_in, STAND_IN_LABEL, STAND_IN_LABEL_SIZE);
+    put_u64(stand_in + STAND_IN_LABEL_SIZE, count);
+    memcpy(stand_in + STAND_IN_LABEL_SIZE + 8, root, MERKLE_DIGEST_SIZE);
+
+    const iqr_retval ret = iqr_HashMessage(hash, stand_in, sizeof(stand_in), out, MERKLE_DIGEST_SIZE);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashMessage(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+static iqr_retval parse_list(char *data, size_t data_size, char ***names, size_t *count)
+{
+    size_t lines = 1;
+    for (size_t i = 0; i < data_size; i++) {
+        if (data[i] == '\n') {
+            lines++;
+        }
+    }
+
+    char **tmp = calloc(lines, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    size_t found = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= data_size; i++) {
+        if (i < data_size && data[i] != '\n') {
+            continue;
+        }
+
+        size_t end = i;
+        while (end > start && (data[end - 1] == '\r' || data[end - 1] == ' ' || data[end - 1] == '\t')) {
+            end--;
+        }
+        if (end > start && data[start] != '#') {
+            data[end] = '\0';
+            tmp[found++] = data + start;
+        }
+        start = i + 1;
+    }
+
+    *names = tmp;
+    *count = found;
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Building the tree.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval hash_leaf(iqr_Hash *hash, const char *message_file, uint8_t *leaf)
+{
+    const uint8_t *message = NULL;
+    size_t message_size = 0;
+    iqr_retval ret = map_data(message_file, &message, &message_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    if (message_size < 1) {
+        fprintf(stderr, "Input message %s must be one or more bytes long.\n", message_file);
+        unmap_data(message, message_size);
+        return IQR_EINVBUFSIZE;
+    }
+
+    /* The same digest the single-message samples sign. */
+    uint8_t digest[MERKLE_DIGEST_SIZE];
+    ret = iqr_HashMessage(hash, message, message_size, digest, sizeof(digest));
+    unmap_data(message, message_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashMessage(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    return hash_prefixed(hash, PREFIX_LEAF, digest, sizeof(digest), NULL, 0, leaf);
+}
+
+iqr_retval merkle_batch_create(const iqr_Context *ctx, const char *list_file, merkle_batch **batch)
+{
+    if (ctx == NULL || list_file == NULL || batch == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    iqr_Hash *hash = NULL;
+    size_t list_size = 0;
+
+    merkle_batch *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = load_text(list_file, &tmp->list, &list_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = parse_list(tmp->list, list_size, &tmp->names, &tmp->count);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (tmp->count == 0 || tmp->count > UINT32_MAX) {
+        fprintf(stderr, "%s must list between 1 and %u message files.\n", list_file, (unsigned int)UINT32_MAX);
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    /* Each level has half as many nodes as the one below, rounded up. */
+    size_t total = 0;
+    for (size_t width = tmp->count; ; width = (width + 1) / 2) {
+        tmp->level_start[tmp->levels] = total;
+        tmp->level_width[tmp->levels] = width;
+        tmp->levels++;
+        total += width;
+        if (width == 1) {
+            break;
+        }
+    }
+
+    tmp->nodes = calloc(total, MERKLE_DIGEST_SIZE);
+    if (tmp->nodes == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = iqr_HashCreate(ctx, IQR_HASHALGO_SHA2_512, &hash);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    for (size_t i = 0; i < tmp->count; i++) {
+        ret = hash_leaf(hash, tmp->names[i], tmp->nodes + i * MERKLE_DIGEST_SIZE);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+    }
+
+    for (size_t level = 1; level < tmp->levels; level++) {
+        const uint8_t *below = tmp->nodes + tmp->level_start[level - 1] * MERKLE_DIGEST_SIZE;
+        const size_t below_width = tmp->level_width[level - 1];
+        uint8_t *here = tmp->nodes + tmp->level_start[level] * MERKLE_DIGEST_SIZE;
+
+        for (size_t i = 0; i < tmp->level_width[level]; i++) {
+            const uint8_t *left = below + 2 * i * MERKLE_DIGEST_SIZE;
+            if (2 * i + 1 < below_width) {
+                ret = hash_prefixed(hash, PREFIX_NODE, left, MERKLE_DIGEST_SIZE, left + MERKLE_DIGEST_SIZE,
+                    MERKLE_DIGEST_SIZE, here + i * MERKLE_DIGEST_SIZE);
+                if (ret != IQR_OK) {
+                    goto end;
+                }
+            } else {
+                /* The odd node out moves up a level. */
+                memcpy(here + i * MERKLE_DIGEST_SIZE, left, MERKLE_DIGEST_SIZE);
+            }
+        }
+    }
+
+    const uint8_t *root = tmp->nodes + tmp->level_start[tmp->levels - 1] * MERKLE_DIGEST_SIZE;
+    ret = hash_signed(hash, root, tmp->count, tmp->signed_digest);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    fprintf(stdout, "Built a Merkle tree over %zu messages from %s.\n", tmp->count, list_file);
+
+    *batch = tmp;
+    tmp = NULL;
+
+end:
+    iqr_HashDestroy(&hash);
+    merkle_batch_destroy(&tmp);
+    return ret;
+}
+
+size_t merkle_batch_count(const merkle_batch *batch)
+{
+    return (batch == NULL) ? 0 : batch->count;
+}
+
+void merkle_batch_signed_digest(const merkle_batch *batch, uint8_t *digest)
+{
+    if (batch == NULL || digest == NULL) {
+        return;
+    }
+    memcpy(digest, batch->signed_digest, MERKLE_DIGEST_SIZE);
+}
+
+void merkle_batch_destroy(merkle_batch **batch)
+{
+    if (batch == NULL || *batch == NULL) {
+        return;
+    }
+
+    free((*batch)->nodes);
+    free((*batch)->names);
+    free((*batch)->list);
+    free(*batch);
+    *batch = NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Proofs.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static size_t build_proof(const merkle_batch *batch, size_t index, uint8_t *proof)
+{
+    memcpy(proof, PROOF_MAGIC, PROOF_MAGIC_SIZE);
+    put_u32(proof + 8, (uint32_t)index);
+    put_u32(proof + 12, (uint32_t)batch->count);
+
+    size_t size = MERKLE_PROOF_HEADER_SIZE;
+    for (size_t level = 0; level + 1 < batch->levels; level++) {
+        const size_t sibling = index ^ 1;
+        if (sibling < batch->level_width[level]) {
+            memcpy(proof + size, batch->nodes + (batch->level_start[level] + sibling) * MERKLE_DIGEST_SIZE,
+                MERKLE_DIGEST_SIZE);
+            size += MERKLE_DIGEST_SIZE;
+        }
+        index /= 2;
+    }
+    return size;
+}
+
+iqr_retval merkle_batch_save_proofs(const merkle_batch *batch)
+{
+    if (batch == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    iqr_retval ret = IQR_OK;
+    char *proof_file = NULL;
+    uint8_t *proof = calloc(1, MERKLE_PROOF_HEADER_SIZE + (batch->levels - 1) * MERKLE_DIGEST_SIZE);
+    if (proof == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    for (size_t i = 0; i < batch->count; i++) {
+        const size_t name_size = strlen(batch->names[i]);
+        proof_file = calloc(1, name_size + sizeof(MERKLE_PROOF_SUFFIX));
+        if (proof_file == NULL) {
+            fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+            ret = IQR_ENOMEM;
+            goto end;
+        }
+        memcpy(proof_file, batch->names[i], name_size);
+        memcpy(proof_file + name_size, MERKLE_PROOF_SUFFIX, sizeof(MERKLE_PROOF_SUFFIX));
+
+        const size_t proof_size = build_proof(batch, i, proof);
+        ret = save_data_durable(proof_file, proof, proof_size, false);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+
+        free(proof_file);
+        proof_file = NULL;
+    }
+
+    fprintf(stdout, "Saved %zu inclusion proofs.\n", batch->count);
+
+end:
+    free(proof_file);
+    free(proof);
+    return ret;
+}
+
+iqr_retval merkle_proof_signed_digest(const iqr_Context *ctx, const uint8_t *message_digest, const char *proof_file,
+    uint8_t *digest)
+{
+    if (ctx == NULL || message_digest == NULL || proof_file == NULL || digest == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    iqr_Hash *hash = NULL;
+    uint8_t *proof = NULL;
+    size_t proof_size = 0;
+    uint8_t node[MERKLE_DIGEST_SIZE];
+
+    iqr_retval ret = load_data(proof_file, &proof, &proof_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (proof_size < MERKLE_PROOF_HEADER_SIZE || memcmp(proof, PROOF_MAGIC, PROOF_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "%s isn't an inclusion proof.\n", proof_file);
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+
+    size_t index = get_u32(proof + 8);
+    size_t width = get_u32(proof + 12);
+    if (width == 0 || index >= width) {
+        fprintf(stderr, "%s has an invalid leaf index.\n", proof_file);
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+    const size_t count = width;
+
+    ret = iqr_HashCreate(ctx, IQR_HASHALGO_SHA2_512, &hash);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = hash_prefixed(hash, PREFIX_LEAF, message_digest, MERKLE_DIGEST_SIZE, NULL, 0, node);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Walk up to the root, taking siblings from the proof where the path's
+     * node has one.
+     */
+    size_t offset = MERKLE_PROOF_HEADER_SIZE;
+    for (; width > 1; width = (width + 1) / 2, index /= 2) {
+        if ((index ^ 1) >= width) {
+            continue;
+        }
+        if (proof_size - offset < MERKLE_DIGEST_SIZE) {
+            fprintf(stderr, "%s is truncated.\n", proof_file);
+            ret = IQR_EINVDATA;
+            goto end;
+        }
+
+        const uint8_t *sibling = proof + offset;
+        offset += MERKLE_DIGEST_SIZE;
+        if ((index & 1) == 0) {
+            ret = hash_prefixed(hash, PREFIX_NODE, node, sizeof(node), sibling, MERKLE_DIGEST_SIZE, node);
+        } else {
+            ret = hash_prefixed(hash, PREFIX_NODE, sibling, MERKLE_DIGEST_SIZE, node, sizeof(node), node);
+        }
+        if (ret != IQR_OK) {
+            goto end;
+        }
+    }
+    if (offset != proof_size) {
+        fprintf(stderr, "%s has trailing data.\n", proof_file);
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+
+    ret = hash_signed(hash, node, count, digest);
+
+end:
+    iqr_HashDestroy(&hash);
+    free(proof);
+    return ret;
+}
+
+bool merkle_is_stand_in(const uint8_t *message, size_t message_size)
+{
+    return message != NULL && message_size >= STAND_IN_LABEL_SIZE
+        && memcmp(message, STAND_IN_LABEL, STAND_IN_LABEL_SIZE) == 0;
+}
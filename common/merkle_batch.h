@@ -0,0 +1,140 @@
+/** @file merkle_batch.h
+ *
+ * @brief Sign many messages with one stateful signature over a Merkle tree.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MERKLE_BATCH_H
+#define MERKLE_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_retval.h"
+
+/* HSS, XMSS and XMSS^MT signatures each use up one of the private key's
+ * one-time signatures. In batch mode the messages' SHA2-512 digests become
+ * the leaves of a Merkle tree and only the tree's root is signed, so the
+ * whole batch costs one signature. Each message gets an inclusion proof,
+ * which together with the root's signature lets it be verified on its own.
+ *
+ * All hashes are SHA2-512, with a prefix byte so leaves and inner nodes can't
+ * be mistaken for one another:
+ *
+ *     leaf    = H(0x00 || SHA2-512(message))
+ *     node    = H(0x01 || left || right)
+ *
+ * A level with an odd number of nodes passes its last node up unchanged
+ * rather than pairing it with itself.
+ *
+ * The root isn't signed as a bare digest. Instead the batch signs a
+ * domain-separated stand-in message, hashed with SHA2-512 just as the
+ * single-message samples hash a message before signing it:
+ *
+ *     "ISARA-Samples-Merkle"   label
+ *     0x00
+ *     u64                      leaf count
+ *     64 bytes                 root
+ *
+ * The sign and verify samples refuse single messages that start with the
+ * label (see merkle_is_stand_in()), so a batch signature never verifies as a
+ * signature over a single message, nor the other way around.
+ *
+ * The proof file is laid out as follows; integers are big-endian.
+ *
+ * Header (16 bytes):
+ *     "IQRMRKL1"     magic
+ *     u32            the message's leaf index
+ *     u32            leaf count
+ *
+ * Followed by the sibling digests from the leaf's level up, 64 bytes each.
+ * Levels where the path's node has no sibling are skipped, so the number of
+ * siblings follows from the index and the leaf count.
+ */
+
+/** Size of the digests in the tree, and of the signed digest. */
+#define MERKLE_DIGEST_SIZE 64
+
+/** Size of the proof file's header in bytes. */
+#define MERKLE_PROOF_HEADER_SIZE 16
+
+/** Appended to a message's file name to name its proof file. */
+#define MERKLE_PROOF_SUFFIX ".proof"
+
+/** A Merkle tree over a batch of messages. */
+typedef struct merkle_batch merkle_batch;
+
+/** Build a Merkle tree over the messages named in a list file.
+ *
+ * The list file names one message file per line; blank lines and lines
+ * starting with '#' are skipped. Each message is mapped read-only and hashed
+ * in place, so they aren't copied.
+ *
+ * @param ctx           The toolkit context; SHA2-512 must be registered.
+ * @param list_file     Name of the list file.
+ * @param batch         The tree; destroy it with merkle_batch_destroy().
+ */
+iqr_retval merkle_batch_create(const iqr_Context *ctx, const char *list_file, merkle_batch **batch);
+
+/** The number of messages in the batch. */
+size_t merkle_batch_count(const merkle_batch *batch);
+
+/** The digest to sign with the stateful scheme: SHA2-512 of the stand-in
+ * message.
+ *
+ * @param batch     The tree.
+ * @param digest    Receives MERKLE_DIGEST_SIZE bytes.
+ */
+void merkle_batch_signed_digest(const merkle_batch *batch, uint8_t *digest);
+
+/** Write each message's inclusion proof to "<message>.proof".
+ *
+ * A proof is no use without the signature over the root, so it does no harm
+ * to write the proofs before signing.
+ */
+iqr_retval merkle_batch_save_proofs(const merkle_batch *batch);
+
+/** Destroy a tree.
+ *
+ * @param batch     The tree; set to NULL.
+ */
+void merkle_batch_destroy(merkle_batch **batch);
+
+/** Work out the digest that was signed from a message's digest and its proof,
+ * by rebuilding the batch's stand-in message.
+ *
+ * Verify the batch's signature against the result; if the proof doesn't
+ * belong to the message the signature won't verify.
+ *
+ * @param ctx               The toolkit context; SHA2-512 must be registered.
+ * @param message_digest    SHA2-512 digest of the message.
+ * @param proof_file        Name of the message's proof file.
+ * @param digest            Receives MERKLE_DIGEST_SIZE bytes. It can be the
+ *                          same buffer as @a message_digest.
+ */
+iqr_retval merkle_proof_signed_digest(const iqr_Context *ctx, const uint8_t *message_digest, const char *proof_file,
+    uint8_t *digest);
+
+/** Check whether a single message could be mistaken for a batch's stand-in
+ * message, i.e. whether it starts with the stand-in's label.
+ *
+ * @return true if the message must not be signed or verified on its own.
+ */
+bool merkle_is_stand_in(const uint8_t *message, size_t message_size);
+
+#endif
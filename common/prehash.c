@@ -0,0 +1,277 @@
+/** @file prehash.c
+ *
+ * @brief Sign a digest of a message that's too big to load.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prehash.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iqr_hash.h"
+#include "isara_samples.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PREHASH_LABEL "ISARA-Samples-Prehash"
+
+/* Both hashes have 64-byte digests. */
+#define PREHASH_DIGEST_SIZE 64
+
+/* Buffer size for reading a stream. */
+#define PREHASH_READ_SIZE (64 * 1024)
+
+/* How much of a regular file is mapped at once; a multiple of any page size,
+ * and small enough for a 32-bit address space.
+ */
+#define PREHASH_WINDOW_SIZE (64 * 1024 * 1024)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Modes.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval prehash_parse(const char *name, prehash_mode *mode)
+{
+    if (name == NULL || mode == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    if (paramcmp(name, "none") == 0) {
+        *mode = PREHASH_NONE;
+    } else if (paramcmp(name, "sha2-512") == 0) {
+        *mode = PREHASH_SHA2_512;
+    } else if (paramcmp(name, "sha3-512") == 0) {
+        *mode = PREHASH_SHA3_512;
+    } else {
+        return IQR_EBADVALUE;
+    }
+
+    return IQR_OK;
+}
+
+const char *prehash_name(prehash_mode mode)
+{
+    switch (mode) {
+    case PREHASH_NONE:
+        return "none";
+    case PREHASH_SHA2_512:
+        return "sha2-512";
+    case PREHASH_SHA3_512:
+        return "sha3-512";
+    default:
+        return "unknown";
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Hashing a message a piece at a time.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval hash_update(iqr_Hash *hash, const uint8_t *buf, size_t size)
+{
+    const iqr_retval ret = iqr_HashUpdate(hash, buf, size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashUpdate(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+static iqr_retval hash_stream(iqr_Hash *hash, FILE *fp, const char *name, uint64_t *total)
+{
+    uint8_t *buf = calloc(1, PREHASH_READ_SIZE);
+    if (buf == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = IQR_OK;
+    while (ret == IQR_OK) {
+        const size_t got = fread(buf, 1, PREHASH_READ_SIZE, fp);
+        if (got > 0) {
+            ret = hash_update(hash, buf, got);
+            *total += got;
+        }
+        if (got < PREHASH_READ_SIZE) {
+            if (ferror(fp) != 0) {
+                fprintf(stderr, "Failed to read %s: %s\n", name, strerror(errno));
+                ret = IQR_EBADVALUE;
+            }
+            break;
+        }
+    }
+
+    free(buf);
+    return ret;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+static iqr_retval hash_file(iqr_Hash *hash, const char *fname, uint64_t *total)
+{
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    const iqr_retval ret = hash_stream(hash, fp, fname, total);
+    fclose(fp);
+    return ret;
+}
+
+#else
+
+static iqr_retval hash_file(iqr_Hash *hash, const char *fname, uint64_t *total)
+{
+    const int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed on fstat(): %s\n", strerror(errno));
+        close(fd);
+        return IQR_EBADVALUE;
+    }
+
+    iqr_retval ret = IQR_OK;
+    if (!S_ISREG(st.st_mode)) {
+        /* Pipes and devices can't be mapped. */
+        FILE *fp = fdopen(fd, "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "Failed on fdopen(): %s\n", strerror(errno));
+            close(fd);
+            return IQR_EBADVALUE;
+        }
+        ret = hash_stream(hash, fp, fname, total);
+        fclose(fp);
+        return ret;
+    }
+
+    /* Map the file a window at a time. The pages are clean and only read
+     * once, so the kernel can drop them as soon as we're past them.
+     */
+    const uint64_t file_size = (uint64_t)st.st_size;
+    for (uint64_t offset = 0; offset < file_size && ret == IQR_OK; offset += PREHASH_WINDOW_SIZE) {
+        const uint64_t left = file_size - offset;
+        const size_t window = (left < PREHASH_WINDOW_SIZE) ? (size_t)left : PREHASH_WINDOW_SIZE;
+
+        void *map = mmap(NULL, window, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Failed on mmap(): %s\n", strerror(errno));
+            ret = IQR_EBADVALUE;
+            break;
+        }
+        madvise(map, window, MADV_SEQUENTIAL);
+
+        ret = hash_update(hash, map, window);
+        *total += window;
+
+        munmap(map, window);
+    }
+
+    close(fd);
+    return ret;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The stand-in message.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval prehash_message(const iqr_Context *ctx, prehash_mode mode, const char *message_file, uint8_t **message,
+    size_t *message_size)
+{
+    if (ctx == NULL || message_file == NULL || message == NULL || message_size == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    uint64_t total = 0;
+    iqr_HashAlgorithmType alg = IQR_HASHALGO_SHA2_512;
+    const char *hash_name = "SHA2-512";
+    if (mode == PREHASH_SHA3_512) {
+        alg = IQR_HASHALGO_SHA3_512;
+        hash_name = "SHA3-512";
+    } else if (mode != PREHASH_SHA2_512) {
+        return IQR_EBADVALUE;
+    }
+
+    const size_t label_size = sizeof(PREHASH_LABEL);
+    const size_t name_size = strlen(hash_name) + 1;
+    const size_t size = label_size + name_size + PREHASH_DIGEST_SIZE;
+
+    uint8_t *tmp = calloc(1, size);
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    memcpy(tmp, PREHASH_LABEL, label_size);
+    memcpy(tmp + label_size, hash_name, name_size);
+
+    iqr_Hash *hash = NULL;
+    iqr_retval ret = iqr_HashCreate(ctx, alg, &hash);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+    ret = iqr_HashBegin(hash);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashBegin(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    if (strcmp(message_file, PREHASH_STDIN) == 0) {
+        ret = hash_stream(hash, stdin, "standard input", &total);
+    } else {
+        ret = hash_file(hash, message_file, &total);
+    }
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = iqr_HashEnd(hash, tmp + label_size + name_size, PREHASH_DIGEST_SIZE);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashEnd(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    fprintf(stdout, "Hashed %s (%llu bytes) with %s.\n", message_file, (unsigned long long)total, hash_name);
+
+    *message = tmp;
+    *message_size = size;
+    tmp = NULL;
+
+end:
+    iqr_HashDestroy(&hash);
+    free(tmp);
+    return ret;
+}
+
+bool prehash_is_stand_in(const uint8_t *message, size_t message_size)
+{
+    return message != NULL && message_size >= sizeof(PREHASH_LABEL)
+        && memcmp(message, PREHASH_LABEL, sizeof(PREHASH_LABEL)) == 0;
+}
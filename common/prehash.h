@@ -0,0 +1,89 @@
+/** @file prehash.h
+ *
+ * @brief Sign a digest of a message that's too big to load.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PREHASH_H
+#define PREHASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_retval.h"
+
+/* In pre-hash mode the signature covers a short, domain-separated stand-in
+ * for the message instead of the message itself:
+ *
+ *     "ISARA-Samples-Prehash"  label
+ *     0x00
+ *     "SHA2-512" or "SHA3-512" the hash's name
+ *     0x00
+ *     64 bytes                 digest of the message
+ *
+ * The hash name keeps a stand-in from one hash apart from the same digest
+ * under the other. The label alone doesn't keep the two modes apart, since a
+ * message could start with it; that's up to the samples, which refuse to
+ * sign or verify such a message without --prehash (see prehash_is_stand_in()).
+ */
+
+typedef enum {
+    /** Sign the message itself. */
+    PREHASH_NONE = 0,
+    PREHASH_SHA2_512,
+    PREHASH_SHA3_512
+} prehash_mode;
+
+/** The message name that means standard input. */
+#define PREHASH_STDIN "-"
+
+/** Parse a --prehash argument: "none", "sha2-512" or "sha3-512".
+ *
+ * @return IQR_OK, or IQR_EBADVALUE if @a name isn't one of these.
+ */
+iqr_retval prehash_parse(const char *name, prehash_mode *mode);
+
+/** The mode's name as prehash_parse() spells it. */
+const char *prehash_name(prehash_mode mode);
+
+/** Build the stand-in message for a pre-hash signature.
+ *
+ * The message is hashed a piece at a time, so memory use doesn't depend on
+ * its size: a regular file is mapped a window at a time, anything else
+ * (including standard input, named with PREHASH_STDIN) is read in chunks.
+ *
+ * @param ctx           The toolkit context; the mode's hash must be
+ *                      registered.
+ * @param mode          PREHASH_SHA2_512 or PREHASH_SHA3_512.
+ * @param message_file  Name of the message file, or PREHASH_STDIN.
+ * @param message       Receives the stand-in message; free() it when you're
+ *                      done.
+ * @param message_size  Receives the stand-in message's size in bytes.
+ */
+iqr_retval prehash_message(const iqr_Context *ctx, prehash_mode mode, const char *message_file, uint8_t **message,
+    size_t *message_size);
+
+/** Check whether a message could be mistaken for a pre-hash stand-in, i.e.
+ * whether it starts with the stand-in's label and its terminating 0x00.
+ *
+ * @return true if the message must not be signed or verified without
+ * --prehash.
+ */
+bool prehash_is_stand_in(const uint8_t *message, size_t message_size);
+
+#endif
@@ -0,0 +1,353 @@
+/** @file rng_pool.c
+ *
+ * @brief A pool of buffered, per-thread HMAC-DRBG instances.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rng_pool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isara_samples.h"
+
+/* Bytes of system entropy used to seed and reseed each DRBG. This covers the
+ * entropy input and nonce for the strongest hash the DRBG supports.
+ */
+#define RNG_POOL_SEED_SIZE 64
+
+typedef struct rng_pool_thread rng_pool_thread;
+
+struct rng_pool_thread {
+    rng_pool *pool;
+    iqr_RNG *rng;
+    /* The unread bytes are the last `available` bytes of the buffer. */
+    uint8_t *buffer;
+    size_t available;
+    uint64_t bytes_since_reseed;
+    uint64_t reseeded_at;
+    rng_pool_thread *next;
+};
+
+struct rng_pool {
+    const iqr_Context *ctx;
+    rng_pool_config config;
+    pthread_key_t key;
+    /* Protects the list of per-thread states. */
+    pthread_mutex_t lock;
+    rng_pool_thread *threads;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Per-thread state.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void free_thread_state(rng_pool_thread *state)
+{
+    iqr_RNGDestroy(&state->rng);
+    if (state->buffer != NULL) {
+        secure_memzero(state->buffer, state->pool->config.buffer_size);
+    }
+    free(state->buffer);
+    free(state);
+}
+
+/* Runs when a thread that used the pool exits. */
+static void thread_state_destructor(void *arg)
+{
+    rng_pool_thread *state = arg;
+    rng_pool *pool = state->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    rng_pool_thread **link = &pool->threads;
+    while (*link != NULL && *link != state) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = state->next;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    free_thread_state(state);
+}
+
+static iqr_retval seed_thread_state(rng_pool_thread *state, int initial)
+{
+    uint8_t seed[RNG_POOL_SEED_SIZE];
+    iqr_retval ret = get_system_entropy(seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (initial) {
+        ret = iqr_RNGInitialize(state->rng, seed, sizeof(seed));
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
+        }
+    } else {
+        ret = iqr_RNGReseed(state->rng, seed, sizeof(seed));
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_RNGReseed(): %s\n", iqr_StrError(ret));
+        }
+    }
+    secure_memzero(seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Don't hand out bytes generated before the reseed. */
+    secure_memzero(state->buffer, state->pool->config.buffer_size);
+    state->available = 0;
+    state->bytes_since_reseed = 0;
+    state->reseeded_at = time_now_ns();
+
+    return IQR_OK;
+}
+
+static iqr_retval get_thread_state(rng_pool *pool, rng_pool_thread **state)
+{
+    *state = pthread_getspecific(pool->key);
+    if (*state != NULL) {
+        return IQR_OK;
+    }
+
+    rng_pool_thread *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    tmp->pool = pool;
+
+    tmp->buffer = calloc(1, pool->config.buffer_size);
+    if (tmp->buffer == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(tmp);
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = iqr_RNGCreateHMACDRBG(pool->ctx, pool->config.hash, &tmp->rng);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
+        free_thread_state(tmp);
+        return ret;
+    }
+
+    ret = seed_thread_state(tmp, 1);
+    if (ret != IQR_OK) {
+        free_thread_state(tmp);
+        return ret;
+    }
+
+    int rc = pthread_setspecific(pool->key, tmp);
+    if (rc != 0) {
+        fprintf(stderr, "Failed on pthread_setspecific(): %s\n", strerror(rc));
+        free_thread_state(tmp);
+        return IQR_ENOMEM;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    tmp->next = pool->threads;
+    pool->threads = tmp;
+    pthread_mutex_unlock(&pool->lock);
+
+    *state = tmp;
+    return IQR_OK;
+}
+
+static iqr_retval reseed_if_due(rng_pool_thread *state)
+{
+    const rng_pool_config *config = &state->pool->config;
+    if (state->bytes_since_reseed < config->reseed_bytes
+        && time_now_ns() - state->reseeded_at < config->reseed_interval_ns) {
+        return IQR_OK;
+    }
+
+    return seed_thread_state(state, 0);
+}
+
+/* Call the DRBG, keeping track of the reseed budget. */
+static iqr_retval generate(rng_pool_thread *state, uint8_t *buf, size_t size)
+{
+    iqr_retval ret = reseed_if_due(state);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = iqr_RNGGetBytes(state->rng, buf, size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGGetBytes(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    state->bytes_since_reseed += size;
+
+    return IQR_OK;
+}
+
+/* Copy bytes out of the buffer and wipe them so they can't be served twice. */
+static void take_buffered(rng_pool_thread *state, uint8_t *buf, size_t size)
+{
+    uint8_t *src = state->buffer + state->pool->config.buffer_size - state->available;
+    memcpy(buf, src, size);
+    secure_memzero(src, size);
+    state->available -= size;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Public interface.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+void rng_pool_default_config(rng_pool_config *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->hash = IQR_HASHALGO_SHA2_256;
+    config->buffer_size = 4096;
+    config->small_request_max = 256;
+    config->reseed_bytes = UINT64_C(1) << 20;
+    config->reseed_interval_ns = UINT64_C(60) * UINT64_C(1000000000);
+}
+
+iqr_retval rng_pool_create(const iqr_Context *ctx, const rng_pool_config *config, rng_pool **pool)
+{
+    if (ctx == NULL || pool == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    rng_pool_config cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        rng_pool_default_config(&cfg);
+    }
+    if (cfg.buffer_size == 0 || cfg.small_request_max > cfg.buffer_size || cfg.reseed_bytes == 0
+        || cfg.reseed_interval_ns == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    rng_pool *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    tmp->ctx = ctx;
+    tmp->config = cfg;
+
+    int rc = pthread_key_create(&tmp->key, thread_state_destructor);
+    if (rc != 0) {
+        fprintf(stderr, "Failed on pthread_key_create(): %s\n", strerror(rc));
+        free(tmp);
+        return IQR_ENOMEM;
+    }
+
+    rc = pthread_mutex_init(&tmp->lock, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "Failed on pthread_mutex_init(): %s\n", strerror(rc));
+        pthread_key_delete(tmp->key);
+        free(tmp);
+        return IQR_ENOMEM;
+    }
+
+    *pool = tmp;
+    return IQR_OK;
+}
+
+iqr_retval rng_pool_get_bytes(rng_pool *pool, uint8_t *buf, size_t size)
+{
+    if (pool == NULL || (buf == NULL && size > 0)) {
+        return IQR_ENULLPTR;
+    }
+
+    rng_pool_thread *state = NULL;
+    iqr_retval ret = get_thread_state(pool, &state);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (size > pool->config.small_request_max) {
+        return generate(state, buf, size);
+    }
+
+    /* The common case: no DRBG call at all. */
+    if (size <= state->available) {
+        take_buffered(state, buf, size);
+        return IQR_OK;
+    }
+
+    /* Drain what's left, then refill. */
+    const size_t head = state->available;
+    take_buffered(state, buf, head);
+
+    ret = generate(state, state->buffer, pool->config.buffer_size);
+    if (ret != IQR_OK) {
+        secure_memzero(buf, head);
+        return ret;
+    }
+    state->available = pool->config.buffer_size;
+
+    take_buffered(state, buf + head, size - head);
+
+    return IQR_OK;
+}
+
+iqr_retval rng_pool_thread_rng(rng_pool *pool, iqr_RNG **rng)
+{
+    if (pool == NULL || rng == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    rng_pool_thread *state = NULL;
+    iqr_retval ret = get_thread_state(pool, &state);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = reseed_if_due(state);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    *rng = state->rng;
+    return IQR_OK;
+}
+
+void rng_pool_destroy(rng_pool **pool)
+{
+    if (pool == NULL || *pool == NULL) {
+        return;
+    }
+
+    rng_pool *p = *pool;
+
+    /* Once the key is gone no destructors will run for it, so every state
+     * left on the list is ours to free.
+     */
+    pthread_key_delete(p->key);
+
+    rng_pool_thread *state = p->threads;
+    while (state != NULL) {
+        rng_pool_thread *next = state->next;
+        free_thread_state(state);
+        state = next;
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+    *pool = NULL;
+}
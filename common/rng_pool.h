@@ -0,0 +1,112 @@
+/** @file rng_pool.h
+ *
+ * @brief A pool of buffered, per-thread HMAC-DRBG instances.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RNG_POOL_H
+#define RNG_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/** Tuning knobs for an RNG pool.
+ *
+ * Pass NULL to rng_pool_create() to use the defaults listed here.
+ */
+typedef struct {
+    /** HMAC-DRBG hash; it must be registered in the pool's context.
+     * Default: IQR_HASHALGO_SHA2_256.
+     */
+    iqr_HashAlgorithmType hash;
+    /** Size of each thread's refill buffer in bytes. Default: 4096. */
+    size_t buffer_size;
+    /** Requests larger than this skip the buffer and go straight to the
+     * DRBG. Must not exceed @a buffer_size. Default: 256.
+     */
+    size_t small_request_max;
+    /** Reseed a thread's DRBG after it has produced this many bytes.
+     * Default: 1 MiB.
+     */
+    uint64_t reseed_bytes;
+    /** Reseed a thread's DRBG when this many nanoseconds have passed since
+     * the last (re)seed. Default: 60 seconds.
+     */
+    uint64_t reseed_interval_ns;
+} rng_pool_config;
+
+/** Fill in the default pool settings.
+ *
+ * Use this as a starting point when you only want to change some of them.
+ *
+ * @param config    The settings to fill in.
+ */
+void rng_pool_default_config(rng_pool_config *config);
+
+/** An RNG pool. */
+typedef struct rng_pool rng_pool;
+
+/** Create an RNG pool.
+ *
+ * Each thread that uses the pool gets its own DRBG, created and seeded from
+ * get_system_entropy() on first use. Small requests are served from a
+ * per-thread buffer of pre-generated bytes; served bytes are wiped from the
+ * buffer. Reseeding happens automatically whenever a thread's byte or time
+ * budget has run out; the budget is checked every time the DRBG itself is
+ * called, and pending buffered bytes are discarded when it reseeds.
+ *
+ * @param ctx       The toolkit context. It must outlive the pool.
+ * @param config    Pool settings, or NULL for the defaults.
+ * @param pool      A pointer that will receive the new pool.
+ */
+iqr_retval rng_pool_create(const iqr_Context *ctx, const rng_pool_config *config, rng_pool **pool);
+
+/** Fill a buffer with random bytes from the calling thread's DRBG.
+ *
+ * @param pool  The RNG pool.
+ * @param buf   The buffer to fill.
+ * @param size  Size of @a buf in bytes.
+ */
+iqr_retval rng_pool_get_bytes(rng_pool *pool, uint8_t *buf, size_t size);
+
+/** Get the calling thread's DRBG.
+ *
+ * Use this for toolkit functions that take an iqr_RNG. The RNG belongs to
+ * the pool and must only be used by the calling thread; don't destroy it.
+ * Bytes drawn from it directly aren't counted against the reseed budget,
+ * but the budget is checked (and the DRBG reseeded if needed) before it's
+ * returned.
+ *
+ * @param pool  The RNG pool.
+ * @param rng   A pointer that will receive the thread's RNG.
+ */
+iqr_retval rng_pool_thread_rng(rng_pool *pool, iqr_RNG **rng);
+
+/** Destroy an RNG pool.
+ *
+ * Every per-thread DRBG and buffer is destroyed and wiped. Don't call this
+ * while other threads are still using the pool.
+ *
+ * @param pool  The pool to destroy; set to NULL on return.
+ */
+void rng_pool_destroy(rng_pool **pool);
+
+#endif
@@ -0,0 +1,562 @@
+/** @file sig_batch.c
+ *
+ * @brief Verify many signatures in one run.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sig_batch.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isara_samples.h"
+#include "prehash.h"
+
+/* Signatures handed to a thread at a time; small enough that a key with a
+ * long list of signatures is spread over every thread.
+ */
+#define SIG_BATCH_CHUNK_SIZE 32
+
+typedef struct {
+    const char *pub;
+    const char *message;
+    const char *signature;
+    /* Position in the manifest. */
+    size_t index;
+} batch_entry;
+
+typedef struct {
+    /* The group's entries are order[first] to order[first + count - 1]. */
+    size_t first;
+    size_t count;
+
+    /* The key is imported by whichever thread gets to the group first, and
+     * destroyed by the thread that finishes its last chunk.
+     */
+    pthread_mutex_t lock;
+    bool imported;
+    void *key;
+    size_t chunks_left;
+} key_group;
+
+typedef struct {
+    key_group *group;
+    /* The chunk's entries are order[first] to order[first + count - 1]. */
+    size_t first;
+    size_t count;
+} batch_chunk;
+
+/* Each thread starts with a contiguous run of chunks, chunks[head] to
+ * chunks[tail - 1]. The owner takes chunks from the tail and other threads
+ * steal from the head, so they only meet on the last chunk.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} chunk_deque;
+
+typedef struct {
+    const sig_scheme *sig;
+    void *params;
+
+    batch_entry *entries;
+    batch_entry **order;
+    size_t count;
+
+    key_group *groups;
+    size_t group_count;
+    batch_chunk *chunks;
+    size_t chunk_count;
+
+    chunk_deque *deques;
+    uint32_t threads;
+
+    sig_batch_status *status;
+
+    /* Shared between the threads. */
+    size_t imports;
+    size_t steals;
+} batch_state;
+
+typedef struct {
+    batch_state *state;
+    uint32_t id;
+    pthread_t thread;
+} batch_worker;
+
+static const char *status_name(sig_batch_status status)
+{
+    switch (status) {
+    case SIG_BATCH_VALID:
+        return "valid";
+    case SIG_BATCH_INVALID:
+        return "invalid";
+    case SIG_BATCH_UNREADABLE:
+        return "unreadable";
+    case SIG_BATCH_BAD_KEY:
+        return "bad-key";
+    default:
+        return "unknown";
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The manifest.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Split the manifest into entries in place; the returned names point into
+ * @a data, which must be NUL terminated.
+ */
+static iqr_retval parse_manifest(const char *manifest_file, char *data, size_t data_size, batch_entry **entries, size_t *count)
+{
+    size_t lines = 1;
+    for (size_t i = 0; i < data_size; i++) {
+        if (data[i] == '\n') {
+            lines++;
+        }
+    }
+
+    batch_entry *tmp = calloc(lines, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    size_t found = 0;
+    size_t line = 0;
+    for (char *p = data; p <= data + data_size; line++) {
+        char *end = memchr(p, '\n', (size_t)(data + data_size - p));
+        if (end == NULL) {
+            end = data + data_size;
+        }
+
+        const char *fields[3] = { NULL, NULL, NULL };
+        size_t field_count = 0;
+        bool extra = false;
+        char *q = p;
+        while (true) {
+            while (q < end && is_blank(*q)) {
+                q++;
+            }
+            if (q == end || (field_count == 0 && *q == '#')) {
+                break;
+            }
+            if (field_count == 3) {
+                extra = true;
+                break;
+            }
+            fields[field_count++] = q;
+            while (q < end && !is_blank(*q)) {
+                q++;
+            }
+            /* Overwrites a blank, the newline, or the terminator. */
+            const bool at_end = (q == end);
+            *q = '\0';
+            if (at_end) {
+                break;
+            }
+            q++;
+        }
+
+        if (extra || (field_count != 0 && field_count != 3)) {
+            fprintf(stderr, "%s, line %zu: expected <public key file> <message file> <signature file>.\n", manifest_file,
+                line + 1);
+            free(tmp);
+            return IQR_EBADVALUE;
+        }
+        if (field_count == 3) {
+            tmp[found].pub = fields[0];
+            tmp[found].message = fields[1];
+            tmp[found].signature = fields[2];
+            tmp[found].index = found;
+            found++;
+        }
+
+        p = end + 1;
+    }
+
+    *entries = tmp;
+    *count = found;
+    return IQR_OK;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const batch_entry *x = *(const batch_entry * const *)a;
+    const batch_entry *y = *(const batch_entry * const *)b;
+
+    const int c = strcmp(x->pub, y->pub);
+    if (c != 0) {
+        return c;
+    }
+    /* qsort() isn't stable; keep each key's signatures in manifest order. */
+    return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+/* Sort the entries by public key, then cut each key's entries into chunks. */
+static iqr_retval build_groups(batch_state *state)
+{
+    state->order = calloc(state->count, sizeof(*state->order));
+    if (state->order == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    for (size_t i = 0; i < state->count; i++) {
+        state->order[i] = &state->entries[i];
+    }
+    qsort(state->order, state->count, sizeof(*state->order), compare_entries);
+
+    size_t groups = 0;
+    size_t chunks = 0;
+    for (size_t i = 0, run = 0; i < state->count; i++) {
+        if (i == 0 || strcmp(state->order[i - 1]->pub, state->order[i]->pub) != 0) {
+            groups++;
+            run = 0;
+        }
+        if (run++ % SIG_BATCH_CHUNK_SIZE == 0) {
+            chunks++;
+        }
+    }
+
+    state->groups = calloc(groups, sizeof(*state->groups));
+    state->chunks = calloc(chunks, sizeof(*state->chunks));
+    if (state->groups == NULL || state->chunks == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    key_group *g = NULL;
+    for (size_t i = 0; i < state->count; i++) {
+        if (g == NULL || strcmp(state->order[i - 1]->pub, state->order[i]->pub) != 0) {
+            g = &state->groups[state->group_count++];
+            g->first = i;
+            pthread_mutex_init(&g->lock, NULL);
+        }
+        if (g->count % SIG_BATCH_CHUNK_SIZE == 0) {
+            batch_chunk *c = &state->chunks[state->chunk_count++];
+            c->group = g;
+            c->first = i;
+            g->chunks_left++;
+        }
+        state->chunks[state->chunk_count - 1].count++;
+        g->count++;
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Verification.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void *import_key(batch_state *state, const char *file)
+{
+    const uint8_t *buf = NULL;
+    size_t buf_size = 0;
+    if (map_data(file, &buf, &buf_size) != IQR_OK) {
+        return NULL;
+    }
+
+    void *key = NULL;
+    if (state->sig->import_public_key(state->params, buf, buf_size, &key) != IQR_OK) {
+        key = NULL;
+    }
+    unmap_data(buf, buf_size);
+
+    __atomic_fetch_add(&state->imports, 1, __ATOMIC_RELAXED);
+    return key;
+}
+
+static sig_batch_status verify_one(const batch_state *state, const void *key, const batch_entry *entry)
+{
+    const uint8_t *message = NULL;
+    size_t message_size = 0;
+    const uint8_t *signature = NULL;
+    size_t signature_size = 0;
+
+    sig_batch_status status = SIG_BATCH_UNREADABLE;
+    if (map_data(entry->message, &message, &message_size) == IQR_OK
+        && map_data(entry->signature, &signature, &signature_size) == IQR_OK) {
+        /* Batches don't pre-hash, so a stand-in message can't be valid. */
+        status = SIG_BATCH_INVALID;
+        if (!prehash_is_stand_in(message, message_size)
+            && state->sig->verify(key, message, message_size, signature, signature_size) == IQR_OK) {
+            status = SIG_BATCH_VALID;
+        }
+    }
+
+    unmap_data(signature, signature_size);
+    unmap_data(message, message_size);
+    return status;
+}
+
+static void run_chunk(batch_state *state, const batch_chunk *chunk)
+{
+    key_group *g = chunk->group;
+
+    pthread_mutex_lock(&g->lock);
+    if (!g->imported) {
+        g->key = import_key(state, state->order[g->first]->pub);
+        g->imported = true;
+    }
+    const void *key = g->key;
+    pthread_mutex_unlock(&g->lock);
+
+    for (size_t i = chunk->first; i < chunk->first + chunk->count; i++) {
+        const batch_entry *entry = state->order[i];
+        state->status[entry->index] = (key == NULL) ? SIG_BATCH_BAD_KEY : verify_one(state, key, entry);
+    }
+
+    pthread_mutex_lock(&g->lock);
+    g->chunks_left--;
+    if (g->chunks_left == 0) {
+        state->sig->destroy_public_key(&g->key);
+    }
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* Take the next chunk from our own deque, or steal one from another thread's. */
+static bool take_chunk(batch_state *state, uint32_t id, size_t *chunk)
+{
+    chunk_deque *own = &state->deques[id];
+    pthread_mutex_lock(&own->lock);
+    const bool have = own->head < own->tail;
+    if (have) {
+        *chunk = --own->tail;
+    }
+    pthread_mutex_unlock(&own->lock);
+    if (have) {
+        return true;
+    }
+
+    /* Nothing is ever added to a deque, so once every deque is empty the
+     * batch is done.
+     */
+    for (uint32_t k = 1; k < state->threads; k++) {
+        chunk_deque *victim = &state->deques[(id + k) % state->threads];
+        pthread_mutex_lock(&victim->lock);
+        const bool stolen = victim->head < victim->tail;
+        if (stolen) {
+            *chunk = victim->head++;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (stolen) {
+            __atomic_fetch_add(&state->steals, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void *batch_thread(void *arg)
+{
+    batch_worker *w = arg;
+    batch_state *state = w->state;
+
+    size_t chunk = 0;
+    while (take_chunk(state, w->id, &chunk)) {
+        run_chunk(state, &state->chunks[chunk]);
+    }
+
+    return NULL;
+}
+
+static iqr_retval run_threads(batch_state *state)
+{
+    batch_worker *workers = calloc(state->threads, sizeof(*workers));
+    state->deques = calloc(state->threads, sizeof(*state->deques));
+    if (workers == NULL || state->deques == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(workers);
+        free(state->deques);
+        state->deques = NULL;
+        return IQR_ENOMEM;
+    }
+
+    /* Deal the chunks out in contiguous runs, so a thread starts on whole keys
+     * and only shares a key with another thread once it has to steal.
+     */
+    for (uint32_t t = 0; t < state->threads; t++) {
+        pthread_mutex_init(&state->deques[t].lock, NULL);
+        state->deques[t].head = state->chunk_count * t / state->threads;
+        state->deques[t].tail = state->chunk_count * (t + 1) / state->threads;
+    }
+
+    iqr_retval ret = IQR_OK;
+    uint32_t started = 0;
+    for (; started < state->threads; started++) {
+        workers[started].state = state;
+        workers[started].id = started;
+        const int rc = pthread_create(&workers[started].thread, NULL, batch_thread, &workers[started]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+    }
+
+    /* The threads that did start steal the missing threads' chunks. */
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    if (started > 0) {
+        ret = IQR_OK;
+    }
+
+    free(workers);
+    return ret;
+}
+
+static iqr_retval write_results(const batch_state *state, const char *output_file)
+{
+    FILE *fp = fopen(output_file, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s: %s\n", output_file, strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    for (size_t i = 0; i < state->count; i++) {
+        const batch_entry *entry = &state->entries[i];
+        fprintf(fp, "%s %s %s %s\n", status_name(state->status[i]), entry->pub, entry->message, entry->signature);
+    }
+
+    /* fclose() reports write errors that fprintf() buffered. */
+    if (ferror(fp) != 0 || fclose(fp) != 0) {
+        fprintf(stderr, "Failed to write %s\n", output_file);
+        return IQR_EBADVALUE;
+    }
+
+    fprintf(stdout, "Successfully saved %s\n", output_file);
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Public interface.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval sig_verify_batch(const iqr_Context *ctx, const sig_scheme *sig, const char *manifest_file, const char *output_file,
+    uint32_t threads)
+{
+    if (ctx == NULL || sig == NULL || manifest_file == NULL || output_file == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (sig->stateful) {
+        fprintf(stderr, "Batch verification only supports the stateless schemes, not %s.\n", sig->name);
+        return IQR_EBADVALUE;
+    }
+
+    char *manifest = NULL;
+    size_t manifest_size = 0;
+
+    batch_state state;
+    memset(&state, 0, sizeof(state));
+    state.sig = sig;
+
+    iqr_retval ret = sig->create_params(ctx, SIG_STRATEGY_FULL, &state.params);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = load_text(manifest_file, &manifest, &manifest_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = parse_manifest(manifest_file, manifest, manifest_size, &state.entries, &state.count);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (state.count == 0) {
+        fprintf(stderr, "%s doesn't list any signatures.\n", manifest_file);
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    state.status = calloc(state.count, sizeof(*state.status));
+    if (state.status == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = build_groups(&state);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    if (threads == 0) {
+        threads = online_cpus();
+    }
+    if (threads > state.chunk_count) {
+        threads = (uint32_t)state.chunk_count;
+    }
+    state.threads = threads;
+
+    const uint64_t start = time_now_ns();
+    ret = run_threads(&state);
+    const double seconds = (double)(time_now_ns() - start) / 1e9;
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    size_t totals[SIG_BATCH_BAD_KEY + 1] = { 0 };
+    for (size_t i = 0; i < state.count; i++) {
+        totals[state.status[i]]++;
+    }
+
+    fprintf(stdout, "Checked %zu signatures in %.2f s (%.1f per second) with %u threads.\n", state.count, seconds,
+        seconds > 0.0 ? (double)state.count / seconds : 0.0, threads);
+    fprintf(stdout, "    valid: %zu, invalid: %zu, unreadable: %zu, bad public key: %zu\n", totals[SIG_BATCH_VALID],
+        totals[SIG_BATCH_INVALID], totals[SIG_BATCH_UNREADABLE], totals[SIG_BATCH_BAD_KEY]);
+    fprintf(stdout, "Imported %zu public keys; idle threads stole %zu of %zu chunks.\n", state.imports, state.steals,
+        state.chunk_count);
+
+    ret = write_results(&state, output_file);
+    if (ret == IQR_OK && totals[SIG_BATCH_VALID] != state.count) {
+        ret = IQR_EINVSIGNATURE;
+    }
+
+end:
+    /* Keys are destroyed as their last chunk finishes; this only catches
+     * groups that never ran because the threads didn't start.
+     */
+    for (size_t i = 0; i < state.group_count; i++) {
+        sig->destroy_public_key(&state.groups[i].key);
+        pthread_mutex_destroy(&state.groups[i].lock);
+    }
+    for (uint32_t t = 0; state.deques != NULL && t < state.threads; t++) {
+        pthread_mutex_destroy(&state.deques[t].lock);
+    }
+    free(state.deques);
+    free(state.chunks);
+    free(state.groups);
+    free(state.order);
+    free(state.status);
+    free(state.entries);
+    free(manifest);
+    sig->destroy_params(&state.params);
+
+    return ret;
+}
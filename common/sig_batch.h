@@ -0,0 +1,79 @@
+/** @file sig_batch.h
+ *
+ * @brief Verify many signatures in one run.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIG_BATCH_H
+#define SIG_BATCH_H
+
+#include <stdint.h>
+
+#include "iqr_context.h"
+#include "iqr_retval.h"
+#include "sig_table.h"
+
+/* The manifest names one signature per line as three whitespace-separated
+ * file names:
+ *
+ *     <public key file> <message file> <signature file>
+ *
+ * Blank lines and lines starting with '#' are skipped.
+ *
+ * The results file has one line per manifest entry, in manifest order: the
+ * entry's status ("valid", "invalid", "unreadable" or "bad-key") followed by
+ * its three file names.
+ */
+
+typedef enum {
+    SIG_BATCH_VALID = 0,
+    /** The signature didn't verify. */
+    SIG_BATCH_INVALID = 1,
+    /** The message or signature file couldn't be read. */
+    SIG_BATCH_UNREADABLE = 2,
+    /** The public key file couldn't be read or imported. */
+    SIG_BATCH_BAD_KEY = 3
+} sig_batch_status;
+
+/** Verify every signature in a manifest.
+ *
+ * Entries are grouped by public key file, so each public key is read and
+ * imported once no matter how many signatures it's listed with. The groups
+ * are cut into chunks and dealt out to @a threads threads; a thread that runs
+ * out of chunks steals from the others, so one key with a very long list of
+ * signatures doesn't leave the other threads idle. Messages and signatures
+ * are read through read-only mappings.
+ *
+ * Only the stateless schemes are supported; the stateful schemes sign a
+ * digest of the message instead. Messages are signed as they are, so one
+ * that starts like a pre-hash stand-in (see prehash_is_stand_in()) is
+ * reported as invalid.
+ *
+ * @param ctx           The toolkit context; @a sig's hashes must be
+ *                      registered.
+ * @param sig           The signature scheme variant.
+ * @param manifest_file Name of the manifest.
+ * @param output_file   Name of the results file.
+ * @param threads       Number of threads; 0 means one per online CPU.
+ *
+ * @return IQR_OK if every signature verified, IQR_EINVSIGNATURE if the batch
+ * ran but at least one entry didn't verify, or another error if the batch
+ * couldn't run.
+ */
+iqr_retval sig_verify_batch(const iqr_Context *ctx, const sig_scheme *sig, const char *manifest_file, const char *output_file,
+    uint32_t threads);
+
+#endif
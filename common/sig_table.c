@@ -0,0 +1,456 @@
+/** @file sig_table.c
+ *
+ * @brief A common interface to the toolkit's signature schemes.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sig_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_dilithium.h"
+#include "iqr_hss.h"
+#include "iqr_rainbow.h"
+#include "iqr_sphincs.h"
+#include "iqr_xmss.h"
+#include "iqr_xmssmt.h"
+#include "isara_samples.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Wrappers.
+//
+// The toolkit's signature APIs come in two shapes, stateless and stateful,
+// so the functions that only differ by name are generated. Signing differs
+// between the stateless schemes and is written out below.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#define SIG_KEY_WRAPPERS(prefix, Scheme)                                                                                          \
+static void prefix##_destroy_params(void **params)                                                                                \
+{                                                                                                                                 \
+    iqr_##Scheme##Params *p = *params;                                                                                            \
+    iqr_##Scheme##DestroyParams(&p);                                                                                              \
+    *params = NULL;                                                                                                               \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_import_public_key(const void *params, const uint8_t *buf, size_t buf_size, void **pub)                 \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *key = NULL;                                                                                          \
+    iqr_retval ret = iqr_##Scheme##ImportPublicKey(params, buf, buf_size, &key);                                                  \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ImportPublicKey(): %s\n", iqr_StrError(ret));                                   \
+    }                                                                                                                             \
+    *pub = key;                                                                                                                   \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_import_private_key(const void *params, const uint8_t *buf, size_t buf_size, void **priv)               \
+{                                                                                                                                 \
+    iqr_##Scheme##PrivateKey *key = NULL;                                                                                         \
+    iqr_retval ret = iqr_##Scheme##ImportPrivateKey(params, buf, buf_size, &key);                                                 \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ImportPrivateKey(): %s\n", iqr_StrError(ret));                                  \
+    }                                                                                                                             \
+    *priv = key;                                                                                                                  \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_export_public_key(const void *pub, uint8_t *buf, size_t buf_size)                                      \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##ExportPublicKey(pub, buf, buf_size);                                                           \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ExportPublicKey(): %s\n", iqr_StrError(ret));                                   \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_export_private_key(const void *priv, uint8_t *buf, size_t buf_size)                                    \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##ExportPrivateKey(priv, buf, buf_size);                                                         \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "ExportPrivateKey(): %s\n", iqr_StrError(ret));                                  \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_public_key(void **pub)                                                                               \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *key = *pub;                                                                                          \
+    iqr_##Scheme##DestroyPublicKey(&key);                                                                                         \
+    *pub = NULL;                                                                                                                  \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_private_key(void **priv)                                                                             \
+{                                                                                                                                 \
+    iqr_##Scheme##PrivateKey *key = *priv;                                                                                        \
+    iqr_##Scheme##DestroyPrivateKey(&key);                                                                                        \
+    *priv = NULL;                                                                                                                 \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_verify(const void *pub, const uint8_t *msg, size_t msg_size, const uint8_t *sig, size_t sig_size)      \
+{                                                                                                                                 \
+    return iqr_##Scheme##Verify(pub, msg, msg_size, sig, sig_size);                                                               \
+}
+
+#define STATELESS_WRAPPERS(prefix, Scheme)                                                                                        \
+static iqr_retval prefix##_create_params(const iqr_##Scheme##Variant *variant, const iqr_Context *ctx, sig_strategy strategy,     \
+    void **params)                                                                                                                \
+{                                                                                                                                 \
+    (void)strategy;                                                                                                               \
+                                                                                                                                  \
+    iqr_##Scheme##Params *p = NULL;                                                                                               \
+    iqr_retval ret = iqr_##Scheme##CreateParams(ctx, variant, &p);                                                                \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateParams(): %s\n", iqr_StrError(ret));                                      \
+    }                                                                                                                             \
+    *params = p;                                                                                                                  \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_get_sizes(const void *params, sig_sizes *sizes)                                                        \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##GetPublicKeySize(params, &sizes->public_key);                                                  \
+    if (ret == IQR_OK) {                                                                                                          \
+        ret = iqr_##Scheme##GetPrivateKeySize(params, &sizes->private_key);                                                       \
+    }                                                                                                                             \
+    if (ret == IQR_OK) {                                                                                                          \
+        ret = iqr_##Scheme##GetSignatureSize(params, &sizes->signature);                                                          \
+    }                                                                                                                             \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "Get*Size(): %s\n", iqr_StrError(ret));                                          \
+    }                                                                                                                             \
+    sizes->state = 0;                                                                                                             \
+    sizes->max_signatures = UINT64_MAX;                                                                                           \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_create_key_pair(const void *params, const iqr_RNG *rng, void **pub, void **priv, void **state)         \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *pub_key = NULL;                                                                                      \
+    iqr_##Scheme##PrivateKey *priv_key = NULL;                                                                                    \
+    iqr_retval ret = iqr_##Scheme##CreateKeyPair(params, rng, &pub_key, &priv_key);                                               \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateKeyPair(): %s\n", iqr_StrError(ret));                                     \
+    }                                                                                                                             \
+    *pub = pub_key;                                                                                                               \
+    *priv = priv_key;                                                                                                             \
+    if (state != NULL) {                                                                                                          \
+        *state = NULL;                                                                                                            \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_state(void **state)                                                                                  \
+{                                                                                                                                 \
+    *state = NULL;                                                                                                                \
+}
+
+#define STATEFUL_WRAPPERS(prefix, Scheme, SCHEME)                                                                                 \
+static iqr_retval prefix##_create_params(const iqr_##Scheme##Variant *variant, const iqr_Context *ctx, sig_strategy strategy,     \
+    void **params)                                                                                                                \
+{                                                                                                                                 \
+    const iqr_##Scheme##TreeStrategy *tree_strategy = &IQR_##SCHEME##_FULL_TREE_STRATEGY;                                         \
+    if (strategy == SIG_STRATEGY_CPU) {                                                                                           \
+        tree_strategy = &IQR_##SCHEME##_CPU_CONSTRAINED_STRATEGY;                                                                 \
+    } else if (strategy == SIG_STRATEGY_MEMORY) {                                                                                 \
+        tree_strategy = &IQR_##SCHEME##_MEMORY_CONSTRAINED_STRATEGY;                                                              \
+    } else if (strategy == SIG_STRATEGY_VERIFY_ONLY) {                                                                            \
+        tree_strategy = &IQR_##SCHEME##_VERIFY_ONLY_STRATEGY;                                                                     \
+    }                                                                                                                             \
+                                                                                                                                  \
+    iqr_##Scheme##Params *p = NULL;                                                                                               \
+    iqr_retval ret = iqr_##Scheme##CreateParams(ctx, tree_strategy, variant, &p);                                                 \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateParams(): %s\n", iqr_StrError(ret));                                      \
+    }                                                                                                                             \
+    *params = p;                                                                                                                  \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_get_sizes(const void *params, sig_sizes *sizes)                                                        \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##GetPublicKeySize(params, &sizes->public_key);                                                  \
+    if (ret == IQR_OK) {                                                                                                          \
+        ret = iqr_##Scheme##GetPrivateKeySize(params, &sizes->private_key);                                                       \
+    }                                                                                                                             \
+    if (ret == IQR_OK) {                                                                                                          \
+        ret = iqr_##Scheme##GetSignatureSize(params, &sizes->signature);                                                          \
+    }                                                                                                                             \
+    if (ret == IQR_OK) {                                                                                                          \
+        ret = iqr_##Scheme##GetStateSize(params, &sizes->state);                                                                  \
+    }                                                                                                                             \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "Get*Size(): %s\n", iqr_StrError(ret));                                          \
+        return ret;                                                                                                               \
+    }                                                                                                                             \
+    ret = iqr_##Scheme##GetMaximumSignatureCount(params, &sizes->max_signatures);                                                 \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "GetMaximumSignatureCount(): %s\n", iqr_StrError(ret));                          \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_create_key_pair(const void *params, const iqr_RNG *rng, void **pub, void **priv, void **state)         \
+{                                                                                                                                 \
+    iqr_##Scheme##PublicKey *pub_key = NULL;                                                                                      \
+    iqr_##Scheme##PrivateKey *priv_key = NULL;                                                                                    \
+    iqr_##Scheme##PrivateKeyState *key_state = NULL;                                                                              \
+    iqr_retval ret = iqr_##Scheme##CreateKeyPair(params, rng, &pub_key, &priv_key, &key_state);                                   \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "CreateKeyPair(): %s\n", iqr_StrError(ret));                                     \
+    }                                                                                                                             \
+    *pub = pub_key;                                                                                                               \
+    *priv = priv_key;                                                                                                             \
+    *state = key_state;                                                                                                           \
+    return ret;                                                                                                                   \
+}                                                                                                                                 \
+                                                                                                                                  \
+static void prefix##_destroy_state(void **state)                                                                                  \
+{                                                                                                                                 \
+    iqr_##Scheme##PrivateKeyState *key_state = *state;                                                                            \
+    iqr_##Scheme##DestroyState(&key_state);                                                                                       \
+    *state = NULL;                                                                                                                \
+}                                                                                                                                 \
+                                                                                                                                  \
+static iqr_retval prefix##_sign(const void *priv, const iqr_RNG *rng, void *state, const uint8_t *msg, size_t msg_size,           \
+    uint8_t *sig, size_t sig_size)                                                                                                \
+{                                                                                                                                 \
+    iqr_retval ret = iqr_##Scheme##Sign(priv, rng, msg, msg_size, state, sig, sig_size);                                          \
+    if (ret != IQR_OK) {                                                                                                          \
+        fprintf(stderr, "Failed on iqr_" #Scheme "Sign(): %s\n", iqr_StrError(ret));                                              \
+    }                                                                                                                             \
+    return ret;                                                                                                                   \
+}
+
+#define SIG_VARIANT(prefix, suffix, VARIANT)                                                                                      \
+static iqr_retval prefix##_##suffix##_create_params(const iqr_Context *ctx, sig_strategy strategy, void **params)                 \
+{                                                                                                                                 \
+    return prefix##_create_params(&VARIANT, ctx, strategy, params);                                                               \
+}
+
+SIG_KEY_WRAPPERS(dilithium, Dilithium)
+SIG_KEY_WRAPPERS(rainbow, Rainbow)
+SIG_KEY_WRAPPERS(sphincs, SPHINCS)
+SIG_KEY_WRAPPERS(hss, HSS)
+SIG_KEY_WRAPPERS(xmss, XMSS)
+SIG_KEY_WRAPPERS(xmssmt, XMSSMT)
+
+STATELESS_WRAPPERS(dilithium, Dilithium)
+STATELESS_WRAPPERS(rainbow, Rainbow)
+STATELESS_WRAPPERS(sphincs, SPHINCS)
+
+STATEFUL_WRAPPERS(hss, HSS, HSS)
+STATEFUL_WRAPPERS(xmss, XMSS, XMSS)
+STATEFUL_WRAPPERS(xmssmt, XMSSMT, XMSSMT)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Dilithium.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+SIG_VARIANT(dilithium, 128, IQR_DILITHIUM_128)
+SIG_VARIANT(dilithium, 160, IQR_DILITHIUM_160)
+
+static iqr_retval dilithium_sign(const void *priv, const iqr_RNG *rng, void *state, const uint8_t *msg, size_t msg_size,
+    uint8_t *sig, size_t sig_size)
+{
+    /* Dilithium signatures are deterministic. */
+    (void)rng;
+    (void)state;
+
+    iqr_retval ret = iqr_DilithiumSign(priv, msg, msg_size, sig, sig_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_DilithiumSign(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Rainbow.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+SIG_VARIANT(rainbow, iiic, IQR_RAINBOW_GF256_68_36_36)
+SIG_VARIANT(rainbow, vc, IQR_RAINBOW_GF256_92_48_48)
+
+static iqr_retval rainbow_sign(const void *priv, const iqr_RNG *rng, void *state, const uint8_t *msg, size_t msg_size,
+    uint8_t *sig, size_t sig_size)
+{
+    (void)state;
+
+    iqr_retval ret = iqr_RainbowSign(priv, rng, msg, msg_size, sig, sig_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RainbowSign(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// SPHINCS+.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+SIG_VARIANT(sphincs, sha192f, IQR_SPHINCS_SHA2_256_192F)
+SIG_VARIANT(sphincs, sha192s, IQR_SPHINCS_SHA2_256_192S)
+SIG_VARIANT(sphincs, sha256f, IQR_SPHINCS_SHA2_256_256F)
+SIG_VARIANT(sphincs, sha256s, IQR_SPHINCS_SHA2_256_256S)
+SIG_VARIANT(sphincs, shake192f, IQR_SPHINCS_SHAKE_256_192F)
+SIG_VARIANT(sphincs, shake192s, IQR_SPHINCS_SHAKE_256_192S)
+SIG_VARIANT(sphincs, shake256f, IQR_SPHINCS_SHAKE_256_256F)
+SIG_VARIANT(sphincs, shake256s, IQR_SPHINCS_SHAKE_256_256S)
+
+static iqr_retval sphincs_sign(const void *priv, const iqr_RNG *rng, void *state, const uint8_t *msg, size_t msg_size,
+    uint8_t *sig, size_t sig_size)
+{
+    (void)state;
+
+    iqr_retval ret = iqr_SPHINCSSign(priv, rng, msg, msg_size, sig, sig_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SPHINCSSign(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// HSS, XMSS and XMSS^MT.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+SIG_VARIANT(hss, 2e20f, IQR_HSS_2E20_FAST)
+SIG_VARIANT(hss, 2e20s, IQR_HSS_2E20_SMALL)
+SIG_VARIANT(hss, 2e25f, IQR_HSS_2E25_FAST)
+SIG_VARIANT(hss, 2e25s, IQR_HSS_2E25_SMALL)
+SIG_VARIANT(hss, 2e30f, IQR_HSS_2E30_FAST)
+SIG_VARIANT(hss, 2e30s, IQR_HSS_2E30_SMALL)
+SIG_VARIANT(hss, 2e45f, IQR_HSS_2E45_FAST)
+SIG_VARIANT(hss, 2e45s, IQR_HSS_2E45_SMALL)
+SIG_VARIANT(hss, 2e65f, IQR_HSS_2E65_FAST)
+SIG_VARIANT(hss, 2e65s, IQR_HSS_2E65_SMALL)
+
+SIG_VARIANT(xmss, 10, IQR_XMSS_2E10)
+SIG_VARIANT(xmss, 16, IQR_XMSS_2E16)
+SIG_VARIANT(xmss, 20, IQR_XMSS_2E20)
+
+SIG_VARIANT(xmssmt, 2e20_2d, IQR_XMSSMT_2E20_2D)
+SIG_VARIANT(xmssmt, 2e20_4d, IQR_XMSSMT_2E20_4D)
+SIG_VARIANT(xmssmt, 2e40_2d, IQR_XMSSMT_2E40_2D)
+SIG_VARIANT(xmssmt, 2e40_4d, IQR_XMSSMT_2E40_4D)
+SIG_VARIANT(xmssmt, 2e40_8d, IQR_XMSSMT_2E40_8D)
+SIG_VARIANT(xmssmt, 2e60_3d, IQR_XMSSMT_2E60_3D)
+SIG_VARIANT(xmssmt, 2e60_6d, IQR_XMSSMT_2E60_6D)
+SIG_VARIANT(xmssmt, 2e60_12d, IQR_XMSSMT_2E60_12D)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The table.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* These match the hashes registered by the individual samples. */
+static const iqr_HashAlgorithmType sha3_hashes[] = { IQR_HASHALGO_SHA3_512 };
+static const iqr_HashAlgorithmType rainbow_hashes[] = { IQR_HASHALGO_SHA2_384, IQR_HASHALGO_SHA2_512 };
+static const iqr_HashAlgorithmType stateful_hashes[] = { IQR_HASHALGO_SHA2_512 };
+
+#define SIG_FUNCTIONS(prefix, create_params)                                                                                      \
+    create_params, prefix##_destroy_params, prefix##_get_sizes, prefix##_create_key_pair, prefix##_import_public_key,             \
+    prefix##_import_private_key, prefix##_export_public_key, prefix##_export_private_key, prefix##_destroy_public_key,           \
+    prefix##_destroy_private_key, prefix##_destroy_state, prefix##_sign, prefix##_verify
+
+#define STATELESS(name, variant_name, hashes, prefix, suffix)                                                                     \
+    { name, variant_name, false, 0, hashes, sizeof(hashes) / sizeof(hashes[0]),                                                  \
+        SIG_FUNCTIONS(prefix, prefix##_##suffix##_create_params) }
+
+#define STATEFUL(name, variant_name, prefix, suffix)                                                                              \
+    { name, variant_name, true, IQR_SHA2_512_DIGEST_SIZE, stateful_hashes, 1,                                                     \
+        SIG_FUNCTIONS(prefix, prefix##_##suffix##_create_params) }
+
+const sig_scheme sig_schemes[] = {
+    STATELESS("dilithium-128", "128", sha3_hashes, dilithium, 128),
+    STATELESS("dilithium-160", "160", sha3_hashes, dilithium, 160),
+    STATELESS("rainbow-iiic", "IIIc", rainbow_hashes, rainbow, iiic),
+    STATELESS("rainbow-vc", "Vc", rainbow_hashes, rainbow, vc),
+    STATELESS("sphincs-sha192f", "sha192f", sha3_hashes, sphincs, sha192f),
+    STATELESS("sphincs-sha192s", "sha192s", sha3_hashes, sphincs, sha192s),
+    STATELESS("sphincs-sha256f", "sha256f", sha3_hashes, sphincs, sha256f),
+    STATELESS("sphincs-sha256s", "sha256s", sha3_hashes, sphincs, sha256s),
+    STATELESS("sphincs-shake192f", "shake192f", sha3_hashes, sphincs, shake192f),
+    STATELESS("sphincs-shake192s", "shake192s", sha3_hashes, sphincs, shake192s),
+    STATELESS("sphincs-shake256f", "shake256f", sha3_hashes, sphincs, shake256f),
+    STATELESS("sphincs-shake256s", "shake256s", sha3_hashes, sphincs, shake256s),
+    STATEFUL("hss-2e20f", "2e20f", hss, 2e20f),
+    STATEFUL("hss-2e20s", "2e20s", hss, 2e20s),
+    STATEFUL("hss-2e25f", "2e25f", hss, 2e25f),
+    STATEFUL("hss-2e25s", "2e25s", hss, 2e25s),
+    STATEFUL("hss-2e30f", "2e30f", hss, 2e30f),
+    STATEFUL("hss-2e30s", "2e30s", hss, 2e30s),
+    STATEFUL("hss-2e45f", "2e45f", hss, 2e45f),
+    STATEFUL("hss-2e45s", "2e45s", hss, 2e45s),
+    STATEFUL("hss-2e65f", "2e65f", hss, 2e65f),
+    STATEFUL("hss-2e65s", "2e65s", hss, 2e65s),
+    STATEFUL("xmss-10", "10", xmss, 10),
+    STATEFUL("xmss-16", "16", xmss, 16),
+    STATEFUL("xmss-20", "20", xmss, 20),
+    STATEFUL("xmssmt-2e20_2d", "2e20_2d", xmssmt, 2e20_2d),
+    STATEFUL("xmssmt-2e20_4d", "2e20_4d", xmssmt, 2e20_4d),
+    STATEFUL("xmssmt-2e40_2d", "2e40_2d", xmssmt, 2e40_2d),
+    STATEFUL("xmssmt-2e40_4d", "2e40_4d", xmssmt, 2e40_4d),
+    STATEFUL("xmssmt-2e40_8d", "2e40_8d", xmssmt, 2e40_8d),
+    STATEFUL("xmssmt-2e60_3d", "2e60_3d", xmssmt, 2e60_3d),
+    STATEFUL("xmssmt-2e60_6d", "2e60_6d", xmssmt, 2e60_6d),
+    STATEFUL("xmssmt-2e60_12d", "2e60_12d", xmssmt, 2e60_12d)
+};
+
+const size_t sig_scheme_count = sizeof(sig_schemes) / sizeof(sig_schemes[0]);
+
+const sig_scheme *sig_find(const char *name)
+{
+    if (name == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < sig_scheme_count; i++) {
+        if (strcmp(sig_schemes[i].name, name) == 0) {
+            return &sig_schemes[i];
+        }
+    }
+    return NULL;
+}
+
+const char *sig_strategy_name(sig_strategy strategy)
+{
+    switch (strategy) {
+    case SIG_STRATEGY_CPU:
+        return "cpu";
+    case SIG_STRATEGY_MEMORY:
+        return "memory";
+    case SIG_STRATEGY_FULL:
+        return "full";
+    case SIG_STRATEGY_VERIFY_ONLY:
+        return "verify";
+    default:
+        return "unknown";
+    }
+}
+
+iqr_retval sig_bootstrap_context(const sig_scheme *sig, iqr_Context **ctx)
+{
+    if (sig == NULL || ctx == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    const iqr_HashAlgorithmType drbg_hash = IQR_HASHALGO_SHA2_256;
+    iqr_retval ret = bootstrap_context(&drbg_hash, 1, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    return bootstrap_context(sig->hashes, sig->hash_count, ctx);
+}
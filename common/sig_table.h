@@ -0,0 +1,132 @@
+/** @file sig_table.h
+ *
+ * @brief A common interface to the toolkit's signature schemes.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIG_TABLE_H
+#define SIG_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+
+/** Tree strategies for the stateful schemes; stateless schemes ignore it. */
+typedef enum {
+    SIG_STRATEGY_CPU,
+    SIG_STRATEGY_MEMORY,
+    SIG_STRATEGY_FULL,
+    SIG_STRATEGY_VERIFY_ONLY
+} sig_strategy;
+
+/** Sizes used by a signature scheme variant. */
+typedef struct {
+    /** Buffer sizes in bytes; @a state is 0 for stateless schemes. */
+    size_t public_key;
+    size_t private_key;
+    size_t signature;
+    size_t state;
+    /** Signatures one key can make; UINT64_MAX for stateless schemes. */
+    uint64_t max_signatures;
+} sig_sizes;
+
+/** One signature scheme variant (Dilithium 128, XMSS 2^16, ...) behind a
+ * common interface.
+ *
+ * Params, keys and states are the toolkit's own objects passed around as
+ * `void *`; only hand them to functions of the same entry. The functions
+ * print a "Failed on ..." message before returning an error, like the
+ * samples do, except verify(), which leaves a failure for the caller to
+ * report.
+ */
+typedef struct {
+    /** Name used on the command line, for example "dilithium-128". */
+    const char *name;
+    /** The variant as the individual samples spell it, for example "128". */
+    const char *variant_name;
+
+    /** Stateful schemes take a private key state and a strategy. */
+    bool stateful;
+    /** The stateful schemes sign a SHA2-512 digest of the message instead of
+     * the message itself; this is that digest's size, or 0 when the scheme
+     * takes the whole message.
+     */
+    size_t digest_size;
+
+    /** Hashes that must be registered in the context; the DRBG's SHA2-256
+     * isn't included.
+     */
+    const iqr_HashAlgorithmType *hashes;
+    size_t hash_count;
+
+    iqr_retval (*create_params)(const iqr_Context *ctx, sig_strategy strategy, void **params);
+    void (*destroy_params)(void **params);
+    iqr_retval (*get_sizes)(const void *params, sig_sizes *sizes);
+
+    /** @a state is only set for stateful schemes; pass NULL otherwise. */
+    iqr_retval (*create_key_pair)(const void *params, const iqr_RNG *rng, void **pub, void **priv, void **state);
+    iqr_retval (*import_public_key)(const void *params, const uint8_t *buf, size_t buf_size, void **pub);
+    iqr_retval (*import_private_key)(const void *params, const uint8_t *buf, size_t buf_size, void **priv);
+    iqr_retval (*export_public_key)(const void *pub, uint8_t *buf, size_t buf_size);
+    iqr_retval (*export_private_key)(const void *priv, uint8_t *buf, size_t buf_size);
+    void (*destroy_public_key)(void **pub);
+    void (*destroy_private_key)(void **priv);
+    void (*destroy_state)(void **state);
+
+    /** For stateful schemes @a msg is the digest and @a state is updated;
+     * stateless schemes ignore @a state.
+     */
+    iqr_retval (*sign)(const void *priv, const iqr_RNG *rng, void *state, const uint8_t *msg, size_t msg_size, uint8_t *sig,
+        size_t sig_size);
+    iqr_retval (*verify)(const void *pub, const uint8_t *msg, size_t msg_size, const uint8_t *sig, size_t sig_size);
+} sig_scheme;
+
+/** Every signature scheme variant the samples cover. */
+extern const sig_scheme sig_schemes[];
+
+/** Number of entries in sig_schemes. */
+extern const size_t sig_scheme_count;
+
+/** Look up a signature scheme variant by name.
+ *
+ * @param name  The variant's name, for example "xmss-16".
+ *
+ * @return The matching entry or NULL.
+ */
+const sig_scheme *sig_find(const char *name);
+
+/** The strategy's name as the stateful samples spell it: "cpu", "memory",
+ * "full" or "verify".
+ */
+const char *sig_strategy_name(sig_strategy strategy);
+
+/** Get the calling thread's bootstrap context, with the hashes a signature
+ * scheme variant needs and SHA2-256 for the DRBG registered.
+ *
+ * Hashes that are already registered are skipped, so you can call this once
+ * per variant.
+ *
+ * @param sig   The signature scheme variant.
+ * @param ctx   A pointer that will receive the context.
+ */
+iqr_retval sig_bootstrap_context(const sig_scheme *sig, iqr_Context **ctx);
+
+#endif
@@ -0,0 +1,111 @@
+/** @file timing.c
+ *
+ * @brief Monotonic clock helpers for the benchmarking samples.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "isara_samples.h"
+
+#include <time.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Timing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t time_now_ns(void)
+{
+    /* CLOCK_MONOTONIC isn't affected by wall clock adjustments, which is what
+     * you want when timing an operation.
+     */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+bool cycle_counter_available(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t cycles_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    /* The TSC ticks at a constant rate on current CPUs, so this is reference
+     * cycles rather than core cycles; close enough to compare algorithms on
+     * one machine.
+     */
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Resource use.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t peak_rss_bytes(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    /* macOS reports bytes, everyone else kilobytes. */
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+uint64_t process_cpu_ns(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    const uint64_t user = (uint64_t)usage.ru_utime.tv_sec * 1000000000u + (uint64_t)usage.ru_utime.tv_usec * 1000u;
+    const uint64_t sys = (uint64_t)usage.ru_stime.tv_sec * 1000000000u + (uint64_t)usage.ru_stime.tv_usec * 1000u;
+    return user + sys;
+#endif
+}
+
+uint32_t online_cpus(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return 1;
+#else
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cpus > 0 && cpus <= (long)UINT32_MAX) ? (uint32_t)cpus : 1;
+#endif
+}
@@ -0,0 +1,814 @@
+/** @file transport.c
+ *
+ * @brief Carry the key agreement samples' messages between Alice and Bob.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "transport.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isara_samples.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/* Don't let a peer that went away kill us with SIGPIPE; the failed send is
+ * reported instead.
+ */
+#if defined(MSG_NOSIGNAL)
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#define NUM_ENDS 2
+
+struct transport_link {
+    transport_kind kind;
+    size_t max_message;
+
+    /* The slab pool. Each slab holds one message of up to max_message bytes
+     * and starts on a TRANSPORT_SLAB_ALIGN boundary, with room in front of it
+     * for a frame header so a frame never has to be assembled elsewhere.
+     */
+    uint8_t *pool;
+    size_t pool_size;
+    size_t slab_stride;
+    uint8_t *slab[TRANSPORT_SLABS];
+    bool slab_busy[TRANSPORT_SLABS];
+
+    /* Memory transport: the slab waiting at each receiving end, if any. */
+    uint8_t *mailbox[NUM_ENDS];
+    size_t mailbox_size[NUM_ENDS];
+
+    /* Socket transports: a descriptor for each end, -1 if this process
+     * doesn't hold it.
+     */
+    int fd[NUM_ENDS];
+#if !defined(_WIN32) && !defined(_WIN64)
+    pid_t child;
+#endif
+
+    uint64_t sent[NUM_ENDS];
+    uint64_t received[NUM_ENDS];
+    uint64_t copied;
+};
+
+static transport_end other_end(transport_end end)
+{
+    return (end == TRANSPORT_ALICE) ? TRANSPORT_BOB : TRANSPORT_ALICE;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Transports.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval transport_parse(const char *name, transport_kind *kind)
+{
+    if (name == NULL || kind == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    if (paramcmp(name, "memory") == 0) {
+        *kind = TRANSPORT_MEMORY;
+    } else if (paramcmp(name, "socketpair") == 0) {
+        *kind = TRANSPORT_SOCKETPAIR;
+    } else if (paramcmp(name, "tcp") == 0) {
+        *kind = TRANSPORT_TCP;
+    } else {
+        return IQR_EBADVALUE;
+    }
+
+    return IQR_OK;
+}
+
+const char *transport_name(transport_kind kind)
+{
+    switch (kind) {
+    case TRANSPORT_MEMORY:
+        return "memory";
+    case TRANSPORT_SOCKETPAIR:
+        return "socketpair";
+    case TRANSPORT_TCP:
+        return "tcp";
+    default:
+        return "unknown";
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Socket plumbing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(_WIN32) || defined(_WIN64)
+
+static iqr_retval open_sockets(transport_link *link)
+{
+    fprintf(stderr, "The %s transport isn't available on Windows.\n", transport_name(link->kind));
+    return IQR_EBADVALUE;
+}
+
+static iqr_retval send_frame(int fd, const uint8_t *frame, size_t size)
+{
+    (void)fd;
+    (void)frame;
+    (void)size;
+    return IQR_EBADVALUE;
+}
+
+static iqr_retval receive_bytes(int fd, uint8_t *buf, size_t size)
+{
+    (void)fd;
+    (void)buf;
+    (void)size;
+    return IQR_EBADVALUE;
+}
+
+static void close_fd(int *fd)
+{
+    *fd = -1;
+}
+
+#else
+
+static void close_fd(int *fd)
+{
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static iqr_retval set_nodelay(int fd)
+{
+    /* Every message is a complete frame; waiting to coalesce it with more
+     * data would only add latency.
+     */
+    const int on = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) != 0) {
+        fprintf(stderr, "Failed on setsockopt(TCP_NODELAY): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+    return IQR_OK;
+}
+
+static iqr_retval open_tcp(transport_link *link)
+{
+    /* Listen on an ephemeral loopback port, connect Alice to it and accept
+     * Bob's end. The listening socket isn't needed after that.
+     */
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        fprintf(stderr, "Failed on socket(): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_size = sizeof(addr);
+
+    iqr_retval ret = IQR_EBADVALUE;
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Failed on bind(): %s\n", strerror(errno));
+        goto end;
+    }
+    if (listen(listener, 1) != 0) {
+        fprintf(stderr, "Failed on listen(): %s\n", strerror(errno));
+        goto end;
+    }
+    if (getsockname(listener, (struct sockaddr *)&addr, &addr_size) != 0) {
+        fprintf(stderr, "Failed on getsockname(): %s\n", strerror(errno));
+        goto end;
+    }
+
+    link->fd[TRANSPORT_ALICE] = socket(AF_INET, SOCK_STREAM, 0);
+    if (link->fd[TRANSPORT_ALICE] < 0) {
+        fprintf(stderr, "Failed on socket(): %s\n", strerror(errno));
+        goto end;
+    }
+    if (connect(link->fd[TRANSPORT_ALICE], (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Failed on connect(): %s\n", strerror(errno));
+        goto end;
+    }
+
+    do {
+        link->fd[TRANSPORT_BOB] = accept(listener, NULL, NULL);
+    } while (link->fd[TRANSPORT_BOB] < 0 && errno == EINTR);
+    if (link->fd[TRANSPORT_BOB] < 0) {
+        fprintf(stderr, "Failed on accept(): %s\n", strerror(errno));
+        goto end;
+    }
+
+    ret = set_nodelay(link->fd[TRANSPORT_ALICE]);
+    if (ret == IQR_OK) {
+        ret = set_nodelay(link->fd[TRANSPORT_BOB]);
+    }
+
+end:
+    close(listener);
+    return ret;
+}
+
+static iqr_retval open_sockets(transport_link *link)
+{
+    if (link->kind == TRANSPORT_TCP) {
+        return open_tcp(link);
+    }
+
+    int fds[NUM_ENDS] = { -1, -1 };
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        fprintf(stderr, "Failed on socketpair(): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+    link->fd[TRANSPORT_ALICE] = fds[0];
+    link->fd[TRANSPORT_BOB] = fds[1];
+    return IQR_OK;
+}
+
+static iqr_retval send_frame(int fd, const uint8_t *frame, size_t size)
+{
+    while (size > 0) {
+        const ssize_t sent = send(fd, frame, size, SEND_FLAGS);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed on send(): %s\n", strerror(errno));
+            return IQR_EINVDATA;
+        }
+        frame += sent;
+        size -= (size_t)sent;
+    }
+    return IQR_OK;
+}
+
+static iqr_retval receive_bytes(int fd, uint8_t *buf, size_t size)
+{
+    while (size > 0) {
+        const ssize_t got = recv(fd, buf, size, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed on recv(): %s\n", strerror(errno));
+            return IQR_EINVDATA;
+        }
+        if (got == 0) {
+            fprintf(stderr, "The other end closed the link.\n");
+            return IQR_EINVDATA;
+        }
+        buf += got;
+        size -= (size_t)got;
+    }
+    return IQR_OK;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The slab pool.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval create_pool(transport_link *link)
+{
+    /* Round each slab up to whole alignment units and put one more unit in
+     * front of it, which the frame header sits at the end of.
+     */
+    const size_t units = (link->max_message + TRANSPORT_SLAB_ALIGN - 1) / TRANSPORT_SLAB_ALIGN;
+    link->slab_stride = (units + 1) * TRANSPORT_SLAB_ALIGN;
+    link->pool_size = TRANSPORT_SLABS * link->slab_stride + TRANSPORT_SLAB_ALIGN - 1;
+
+    link->pool = calloc(1, link->pool_size);
+    if (link->pool == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    const uintptr_t misalignment = (uintptr_t)link->pool % TRANSPORT_SLAB_ALIGN;
+    uint8_t *first = link->pool + ((misalignment == 0) ? 0 : TRANSPORT_SLAB_ALIGN - misalignment);
+    for (int i = 0; i < TRANSPORT_SLABS; i++) {
+        link->slab[i] = first + (size_t)i * link->slab_stride + TRANSPORT_SLAB_ALIGN;
+    }
+    return IQR_OK;
+}
+
+/* The slab's index, or -1 if it isn't one of the link's slabs in use. */
+static int slab_index(const transport_link *link, const uint8_t *slab)
+{
+    for (int i = 0; i < TRANSPORT_SLABS; i++) {
+        if (link->slab[i] == slab && link->slab_busy[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+iqr_retval transport_acquire(transport_link *link, uint8_t **slab)
+{
+    if (link == NULL || slab == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    for (int i = 0; i < TRANSPORT_SLABS; i++) {
+        if (!link->slab_busy[i]) {
+            link->slab_busy[i] = true;
+            *slab = link->slab[i];
+            return IQR_OK;
+        }
+    }
+
+    fprintf(stderr, "All of the link's slabs are in use.\n");
+    return IQR_ENOMEM;
+}
+
+void transport_release(transport_link *link, uint8_t *slab)
+{
+    if (link == NULL || slab == NULL) {
+        return;
+    }
+
+    const int index = slab_index(link, slab);
+    if (index >= 0) {
+        link->slab_busy[index] = false;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Opening and closing links.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval transport_open(transport_kind kind, size_t max_message, transport_link **link)
+{
+    if (link == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (max_message == 0 || max_message > UINT32_MAX - TRANSPORT_SLAB_ALIGN) {
+        return IQR_EINVBUFSIZE;
+    }
+
+    transport_link *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    tmp->kind = kind;
+    tmp->max_message = max_message;
+    tmp->fd[TRANSPORT_ALICE] = -1;
+    tmp->fd[TRANSPORT_BOB] = -1;
+
+    iqr_retval ret = create_pool(tmp);
+    if (ret == IQR_OK) {
+        if (kind == TRANSPORT_SOCKETPAIR || kind == TRANSPORT_TCP) {
+            ret = open_sockets(tmp);
+        } else if (kind != TRANSPORT_MEMORY) {
+            ret = IQR_EBADVALUE;
+        }
+    }
+    if (ret != IQR_OK) {
+        transport_close(&tmp);
+        return ret;
+    }
+
+    *link = tmp;
+    return IQR_OK;
+}
+
+void transport_close(transport_link **link)
+{
+    if (link == NULL || *link == NULL) {
+        return;
+    }
+
+    transport_link *tmp = *link;
+    for (int end = 0; end < NUM_ENDS; end++) {
+        close_fd(&tmp->fd[end]);
+    }
+
+    if (tmp->pool != NULL) {
+        /* Most messages are public keys, but the caller can't know what's
+         * left lying around in here.
+         */
+        secure_memzero(tmp->pool, tmp->pool_size);
+    }
+    free(tmp->pool);
+
+    /* With its end closed the child fails its next receive, if it hadn't
+     * finished already.
+     */
+    transport_join(tmp);
+
+    free(tmp);
+    *link = NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Sending and receiving.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval transport_send_slab(transport_link *link, transport_end from, uint8_t *slab, size_t size)
+{
+    if (link == NULL || slab == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (slab_index(link, slab) < 0) {
+        fprintf(stderr, "That buffer isn't one of the link's slabs.\n");
+        return IQR_EINVPTR;
+    }
+
+    iqr_retval ret = IQR_OK;
+    if (from != TRANSPORT_ALICE && from != TRANSPORT_BOB) {
+        ret = IQR_EBADVALUE;
+    } else if (size > link->max_message) {
+        fprintf(stderr, "The message is bigger than the link allows.\n");
+        ret = IQR_EINVBUFSIZE;
+    } else if (link->kind == TRANSPORT_MEMORY) {
+        const transport_end to = other_end(from);
+        if (link->mailbox[to] != NULL) {
+            fprintf(stderr, "The last message hasn't been received yet.\n");
+            ret = IQR_EINVDATA;
+        } else {
+            /* The slab itself changes hands; nothing is copied. */
+            link->mailbox[to] = slab;
+            link->mailbox_size[to] = size;
+            link->sent[from] += size;
+            return IQR_OK;
+        }
+    } else if (link->fd[from] < 0) {
+        fprintf(stderr, "This process doesn't hold that end of the link.\n");
+        ret = IQR_EBADVALUE;
+    } else {
+        /* Send the length and the message together from the slab, so with
+         * TCP_NODELAY a small message goes out in one segment.
+         */
+        uint8_t *frame = slab - TRANSPORT_FRAME_HEADER_SIZE;
+        put_u32(frame, (uint32_t)size);
+        ret = send_frame(link->fd[from], frame, TRANSPORT_FRAME_HEADER_SIZE + size);
+        if (ret == IQR_OK) {
+            link->sent[from] += TRANSPORT_FRAME_HEADER_SIZE + size;
+        }
+    }
+
+    transport_release(link, slab);
+    return ret;
+}
+
+iqr_retval transport_receive_slab(transport_link *link, transport_end at, uint8_t **slab, size_t *size)
+{
+    if (link == NULL || slab == NULL || size == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (at != TRANSPORT_ALICE && at != TRANSPORT_BOB) {
+        return IQR_EBADVALUE;
+    }
+
+    if (link->kind == TRANSPORT_MEMORY) {
+        if (link->mailbox[at] == NULL) {
+            fprintf(stderr, "No message is waiting.\n");
+            return IQR_EINVDATA;
+        }
+        *slab = link->mailbox[at];
+        *size = link->mailbox_size[at];
+        link->mailbox[at] = NULL;
+        link->received[at] += *size;
+        return IQR_OK;
+    }
+
+    if (link->fd[at] < 0) {
+        fprintf(stderr, "This process doesn't hold that end of the link.\n");
+        return IQR_EBADVALUE;
+    }
+
+    uint8_t header[TRANSPORT_FRAME_HEADER_SIZE];
+    iqr_retval ret = receive_bytes(link->fd[at], header, sizeof(header));
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint32_t length = get_u32(header);
+    if (length > link->max_message) {
+        /* The rest of the stream can't be trusted now, so don't try to skip
+         * the message.
+         */
+        fprintf(stderr, "The message is bigger than the link allows.\n");
+        return IQR_EINVBUFSIZE;
+    }
+
+    /* The message goes straight from the socket into the slab. */
+    uint8_t *tmp = NULL;
+    ret = transport_acquire(link, &tmp);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    ret = receive_bytes(link->fd[at], tmp, length);
+    if (ret != IQR_OK) {
+        transport_release(link, tmp);
+        return ret;
+    }
+
+    *slab = tmp;
+    *size = length;
+    link->received[at] += TRANSPORT_FRAME_HEADER_SIZE + length;
+    return IQR_OK;
+}
+
+iqr_retval transport_send(transport_link *link, transport_end from, const uint8_t *buf, size_t size)
+{
+    if (link == NULL || buf == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (size > link->max_message) {
+        fprintf(stderr, "The message is bigger than the link allows.\n");
+        return IQR_EINVBUFSIZE;
+    }
+
+    uint8_t *slab = NULL;
+    const iqr_retval ret = transport_acquire(link, &slab);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    memcpy(slab, buf, size);
+    link->copied += size;
+    return transport_send_slab(link, from, slab, size);
+}
+
+iqr_retval transport_receive(transport_link *link, transport_end at, uint8_t *buf, size_t *size)
+{
+    if (link == NULL || buf == NULL || size == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    uint8_t *slab = NULL;
+    size_t received = 0;
+    iqr_retval ret = transport_receive_slab(link, at, &slab, &received);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (received > *size) {
+        fprintf(stderr, "The message is bigger than the buffer.\n");
+        ret = IQR_EINVBUFSIZE;
+    } else {
+        memcpy(buf, slab, received);
+        link->copied += received;
+        *size = received;
+    }
+
+    /* The samples send Bob's secret this way, so don't leave the message in
+     * the pool.
+     */
+    secure_memzero(slab, received);
+    transport_release(link, slab);
+    return ret;
+}
+
+uint64_t transport_copied(const transport_link *link)
+{
+    return (link == NULL) ? 0 : link->copied;
+}
+
+void transport_counters(const transport_link *link, transport_end end, uint64_t *sent, uint64_t *received)
+{
+    if (link == NULL || sent == NULL || received == NULL || (end != TRANSPORT_ALICE && end != TRANSPORT_BOB)) {
+        return;
+    }
+    *sent = link->sent[end];
+    *received = link->received[end];
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Running Alice and Bob in separate processes.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(_WIN32) || defined(_WIN64)
+
+iqr_retval transport_fork(transport_link *link, transport_role *role)
+{
+    if (link == NULL || role == NULL) {
+        return IQR_ENULLPTR;
+    }
+    *role = TRANSPORT_ROLE_BOTH;
+    return IQR_OK;
+}
+
+iqr_retval transport_join(transport_link *link)
+{
+    (void)link;
+    return IQR_OK;
+}
+
+#else
+
+iqr_retval transport_fork(transport_link *link, transport_role *role)
+{
+    if (link == NULL || role == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    if (link->kind == TRANSPORT_MEMORY) {
+        *role = TRANSPORT_ROLE_BOTH;
+        return IQR_OK;
+    }
+    if (link->fd[TRANSPORT_ALICE] < 0 || link->fd[TRANSPORT_BOB] < 0) {
+        fprintf(stderr, "The link has already been split.\n");
+        return IQR_EBADVALUE;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Failed on fork(): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    if (pid == 0) {
+        close_fd(&link->fd[TRANSPORT_ALICE]);
+        link->child = 0;
+        *role = TRANSPORT_ROLE_BOB;
+    } else {
+        close_fd(&link->fd[TRANSPORT_BOB]);
+        link->child = pid;
+        *role = TRANSPORT_ROLE_ALICE;
+    }
+    return IQR_OK;
+}
+
+iqr_retval transport_join(transport_link *link)
+{
+    if (link == NULL || link->child == 0) {
+        return IQR_OK;
+    }
+
+    int status = 0;
+    pid_t pid = -1;
+    do {
+        pid = waitpid(link->child, &status, 0);
+    } while (pid < 0 && errno == EINTR);
+    link->child = 0;
+
+    if (pid < 0) {
+        fprintf(stderr, "Failed on waitpid(): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        fprintf(stderr, "Bob's process failed.\n");
+        return IQR_EINVDATA;
+    }
+    return IQR_OK;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Round-trip timing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool holds_both_ends(const transport_link *link)
+{
+    return link->kind == TRANSPORT_MEMORY || (link->fd[TRANSPORT_ALICE] >= 0 && link->fd[TRANSPORT_BOB] >= 0);
+}
+
+static iqr_retval echo_once(transport_link *link)
+{
+    uint8_t byte = 0;
+    size_t size = sizeof(byte);
+    iqr_retval ret = transport_receive(link, TRANSPORT_BOB, &byte, &size);
+    if (ret == IQR_OK) {
+        ret = transport_send(link, TRANSPORT_BOB, &byte, size);
+    }
+    return ret;
+}
+
+iqr_retval transport_ping(transport_link *link, uint32_t rounds, uint64_t *best_ns, uint64_t *mean_ns)
+{
+    if (link == NULL || best_ns == NULL || mean_ns == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (rounds == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    /* If Bob's end is in this process too, answer for him; the time then
+     * covers both ends' trips through the kernel, just without a context
+     * switch.
+     */
+    const bool echo_here = holds_both_ends(link);
+
+    uint64_t best = UINT64_MAX;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < rounds; i++) {
+        uint8_t byte = (uint8_t)i;
+        size_t size = sizeof(byte);
+
+        const uint64_t start = time_now_ns();
+        iqr_retval ret = transport_send(link, TRANSPORT_ALICE, &byte, size);
+        if (ret == IQR_OK && echo_here) {
+            ret = echo_once(link);
+        }
+        if (ret == IQR_OK) {
+            ret = transport_receive(link, TRANSPORT_ALICE, &byte, &size);
+        }
+        const uint64_t elapsed = time_now_ns() - start;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+
+        total += elapsed;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    *best_ns = best;
+    *mean_ns = total / rounds;
+    return IQR_OK;
+}
+
+iqr_retval transport_echo(transport_link *link, uint32_t rounds)
+{
+    if (link == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        const iqr_retval ret = echo_once(link);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    return IQR_OK;
+}
+
+iqr_retval transport_timing_begin(transport_link *link, transport_timing *timing)
+{
+    if (link == NULL || timing == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    memset(timing, 0, sizeof(*timing));
+    const iqr_retval ret = transport_ping(link, TRANSPORT_PINGS, &timing->ping_best_ns, &timing->ping_mean_ns);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Leave the pings out of the handshake's byte counts. */
+    timing->sent = link->sent[TRANSPORT_ALICE];
+    timing->received = link->received[TRANSPORT_ALICE];
+    timing->start_ns = time_now_ns();
+    return IQR_OK;
+}
+
+void transport_timing_end(const transport_link *link, transport_timing *timing)
+{
+    if (link == NULL || timing == NULL) {
+        return;
+    }
+
+    timing->handshake_ns = time_now_ns() - timing->start_ns;
+    timing->sent = link->sent[TRANSPORT_ALICE] - timing->sent;
+    timing->received = link->received[TRANSPORT_ALICE] - timing->received;
+}
+
+void transport_timing_report(const transport_link *link, const transport_timing *timing)
+{
+    if (link == NULL || timing == NULL) {
+        return;
+    }
+
+    fprintf(stdout, "Transport: %s, with Bob in %s process.\n", transport_name(link->kind),
+        holds_both_ends(link) ? "the same" : "a separate");
+    fprintf(stdout, "    Link round trip: %.1f us best, %.1f us mean over %d pings.\n",
+        (double)timing->ping_best_ns / 1e3, (double)timing->ping_mean_ns / 1e3, TRANSPORT_PINGS);
+    fprintf(stdout, "    Handshake as Alice saw it: %.1f us.\n", (double)timing->handshake_ns / 1e3);
+    fprintf(stdout, "    Alice sent %llu bytes and received %llu bytes.\n", (unsigned long long)timing->sent,
+        (unsigned long long)timing->received);
+}
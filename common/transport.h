@@ -0,0 +1,211 @@
+/** @file transport.h
+ *
+ * @brief Carry the key agreement samples' messages between Alice and Bob.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_retval.h"
+
+/* A transport is a two-ended link; Alice holds one end and Bob the other.
+ * Messages are delivered whole and in order.
+ *
+ * Messages live in slabs from a pool that belongs to the link, so they can
+ * be handed over rather than copied. Acquire a slab, build the message in it
+ * and send it; the link takes the slab back. A received message arrives in a
+ * slab, which the receiver gives back with transport_release() when it's done.
+ * The memory transport passes the slab itself to the other end. The socket
+ * transports send from the slab and receive straight into one.
+ *
+ * On the socket transports each message goes out as a frame: a big-endian
+ * u32 length followed by the message.
+ *
+ * The socket transports can be split between two processes with
+ * transport_fork(), so the handshake's messages really do cross a process
+ * boundary. They aren't available on Windows.
+ */
+
+typedef enum {
+    TRANSPORT_MEMORY,
+    TRANSPORT_SOCKETPAIR,
+    TRANSPORT_TCP
+} transport_kind;
+
+/** Which end of the link a message is sent from or received at. */
+typedef enum {
+    TRANSPORT_ALICE,
+    TRANSPORT_BOB
+} transport_end;
+
+/** Which ends of the link this process holds after transport_fork(). */
+typedef enum {
+    TRANSPORT_ROLE_BOTH,
+    TRANSPORT_ROLE_ALICE,
+    TRANSPORT_ROLE_BOB
+} transport_role;
+
+/** Size of a frame's length prefix on the socket transports. */
+#define TRANSPORT_FRAME_HEADER_SIZE 4
+
+/** Alignment of the slabs. */
+#define TRANSPORT_SLAB_ALIGN 64
+
+/** Number of slabs in a link's pool. A handshake has at most two messages in
+ * flight, plus whichever one a side is still holding.
+ */
+#define TRANSPORT_SLABS 4
+
+typedef struct transport_link transport_link;
+
+/** Parse "memory", "socketpair" or "tcp". */
+iqr_retval transport_parse(const char *name, transport_kind *kind);
+
+const char *transport_name(transport_kind kind);
+
+/** Open a link.
+ *
+ * @param kind          The transport.
+ * @param max_message   The largest message either end will send.
+ * @param link          The link; close it with transport_close().
+ */
+iqr_retval transport_open(transport_kind kind, size_t max_message, transport_link **link);
+
+/** Take a free slab from the link's pool.
+ *
+ * @param link      The link.
+ * @param slab      Receives a slab with room for the link's largest message.
+ *
+ * @return IQR_ENOMEM if every slab is in use.
+ */
+iqr_retval transport_acquire(transport_link *link, uint8_t **slab);
+
+/** Give a slab back to the link's pool. */
+void transport_release(transport_link *link, uint8_t *slab);
+
+/** Send the message in a slab from one end to the other.
+ *
+ * The link takes the slab back whether or not this succeeds. On the socket
+ * transports this blocks until the message has been handed to the kernel.
+ */
+iqr_retval transport_send_slab(transport_link *link, transport_end from, uint8_t *slab, size_t size);
+
+/** Receive the next message at one end, in a slab.
+ *
+ * On the socket transports this blocks until a message arrives. The memory
+ * transport fails if no message is waiting.
+ *
+ * @param link      The link.
+ * @param at        The receiving end.
+ * @param slab      Receives the slab holding the message; give it back with
+ *                  transport_release().
+ * @param size      Receives the message's size.
+ */
+iqr_retval transport_receive_slab(transport_link *link, transport_end at, uint8_t **slab, size_t *size);
+
+/** Copy a message into a slab and send it. Meant for small messages. */
+iqr_retval transport_send(transport_link *link, transport_end from, const uint8_t *buf, size_t size);
+
+/** Receive a message and copy it out of its slab. Meant for small messages.
+ *
+ * @param link      The link.
+ * @param at        The receiving end.
+ * @param buf       Receives the message.
+ * @param size      On input the size of @a buf; on output the message's size.
+ */
+iqr_retval transport_receive(transport_link *link, transport_end at, uint8_t *buf, size_t *size);
+
+/** Bytes transport_send() and transport_receive() have copied. */
+uint64_t transport_copied(const transport_link *link);
+
+/** Split the link's ends between this process and a new child process.
+ *
+ * The child gets Bob's end and the parent keeps Alice's. Standard output is
+ * flushed first so nothing is printed twice. The memory transport can't
+ * cross processes, so it isn't split and @a role is TRANSPORT_ROLE_BOTH.
+ *
+ * The child should exit() when it's done; the parent collects it with
+ * transport_join().
+ */
+iqr_retval transport_fork(transport_link *link, transport_role *role);
+
+/** Wait for the child process started by transport_fork().
+ *
+ * @return IQR_OK if there was no child or it exited successfully.
+ */
+iqr_retval transport_join(transport_link *link);
+
+/** Measure the link's round-trip time from Alice's end.
+ *
+ * Alice sends @a rounds one-byte messages and waits for each to come back.
+ * Bob's end has to run transport_echo() with the same @a rounds.
+ *
+ * @param link      The link.
+ * @param rounds    Number of round trips.
+ * @param best_ns   The fastest round trip.
+ * @param mean_ns   The average round trip.
+ */
+iqr_retval transport_ping(transport_link *link, uint32_t rounds, uint64_t *best_ns, uint64_t *mean_ns);
+
+/** Send @a rounds messages back to Alice as they arrive at Bob's end. */
+iqr_retval transport_echo(transport_link *link, uint32_t rounds);
+
+/** Number of pings transport_timing_begin() sends. */
+#define TRANSPORT_PINGS 100
+
+/** A handshake's round-trip figures, as seen from Alice's end. */
+typedef struct {
+    uint64_t ping_best_ns;
+    uint64_t ping_mean_ns;
+    /** From Alice's first message to her having the secret. */
+    uint64_t handshake_ns;
+    /** Bytes Alice sent and received during the handshake. */
+    uint64_t sent;
+    uint64_t received;
+
+    uint64_t start_ns;
+} transport_timing;
+
+/** Ping the link, then start timing a handshake.
+ *
+ * If Bob's end is in another process it has to run
+ * transport_echo(link, TRANSPORT_PINGS) before the handshake.
+ */
+iqr_retval transport_timing_begin(transport_link *link, transport_timing *timing);
+
+/** Stop timing when Alice has the secret. */
+void transport_timing_end(const transport_link *link, transport_timing *timing);
+
+/** Print the figures. */
+void transport_timing_report(const transport_link *link, const transport_timing *timing);
+
+/** Bytes sent and received at one end of the link, frame headers included.
+ *
+ * Only ends held by this process are counted.
+ */
+void transport_counters(const transport_link *link, transport_end end, uint64_t *sent, uint64_t *received);
+
+/** Close a link.
+ *
+ * @param link      The link; set to NULL.
+ */
+void transport_close(transport_link **link);
+
+#endif
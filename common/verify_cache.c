@@ -0,0 +1,559 @@
+/** @file verify_cache.c
+ *
+ * @brief A persistent cache of signatures that have already been verified.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "verify_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iqr_hash.h"
+#include "iqr_mac.h"
+#include "isara_samples.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CACHE_MAGIC "IQRVCAC1"
+#define CACHE_HEADER_SIZE 64
+#define CACHE_SLOT_SIZE 64
+#define CACHE_TAG_SIZE 16
+
+/* Slots checked for an id before giving up; an id is never stored further
+ * than this from its home slot.
+ */
+#define CACHE_PROBES 8
+
+/* Header field offsets. */
+#define HEADER_SLOTS 8
+#define HEADER_COUNTER 16
+#define HEADER_TAG 24
+
+/* Slot field offsets. */
+#define SLOT_TAG 32
+#define SLOT_USED 48
+
+struct verify_cache {
+    iqr_Hash *hash;
+    iqr_MAC *hmac;
+    uint8_t key[VERIFY_CACHE_KEY_SIZE];
+
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    uint32_t slots;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Helpers.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Compare tags without leaking where they differ. */
+static bool tags_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < CACHE_TAG_SIZE; i++) {
+        diff |= (uint8_t)(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+/* HMAC over a label and some data, truncated to CACHE_TAG_SIZE bytes. The
+ * label keeps header tags and slot tags apart.
+ */
+static iqr_retval make_tag(verify_cache *cache, const char *label, const uint8_t *data, size_t data_size,
+    uint8_t tag[CACHE_TAG_SIZE])
+{
+    uint8_t full[IQR_SHA2_256_DIGEST_SIZE] = { 0 };
+
+    iqr_retval ret = iqr_MACBegin(cache->hmac, cache->key, sizeof(cache->key));
+    if (ret == IQR_OK) {
+        ret = iqr_MACUpdate(cache->hmac, (const uint8_t *)label, strlen(label) + 1);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_MACUpdate(cache->hmac, data, data_size);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_MACEnd(cache->hmac, full, sizeof(full));
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on the verify cache's HMAC: %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    memcpy(tag, full, CACHE_TAG_SIZE);
+    return IQR_OK;
+}
+
+static uint8_t *slot_at(const verify_cache *cache, uint32_t index)
+{
+    return cache->map + CACHE_HEADER_SIZE + (size_t)index * CACHE_SLOT_SIZE;
+}
+
+static uint64_t next_use(verify_cache *cache)
+{
+    const uint64_t use = get_u64(cache->map + HEADER_COUNTER) + 1;
+    put_u64(cache->map + HEADER_COUNTER, use);
+    return use;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Hashing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval verify_cache_make_id(verify_cache *cache, const char *scheme, const uint8_t *pub, size_t pub_size, const uint8_t *msg,
+    size_t msg_size, const uint8_t *sig, size_t sig_size, verify_cache_id *id)
+{
+    if (cache == NULL || scheme == NULL || id == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    uint8_t digests[3 * IQR_SHA2_256_DIGEST_SIZE] = { 0 };
+
+    iqr_retval ret = iqr_HashMessage(cache->hash, pub, pub_size, digests, IQR_SHA2_256_DIGEST_SIZE);
+    if (ret == IQR_OK) {
+        ret = iqr_HashMessage(cache->hash, msg, msg_size, digests + IQR_SHA2_256_DIGEST_SIZE, IQR_SHA2_256_DIGEST_SIZE);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashMessage(cache->hash, sig, sig_size, digests + 2 * IQR_SHA2_256_DIGEST_SIZE, IQR_SHA2_256_DIGEST_SIZE);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashBegin(cache->hash);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashUpdate(cache->hash, (const uint8_t *)scheme, strlen(scheme) + 1);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashUpdate(cache->hash, digests, sizeof(digests));
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashEnd(cache->hash, id->digest, sizeof(id->digest));
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on the verify cache's SHA2-256: %s\n", iqr_StrError(ret));
+    }
+
+    return ret;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// No mmap() or flock() here, so there's no cache.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval verify_cache_open(const iqr_Context *ctx, const char *cache_file, const char *key_file, uint32_t slots,
+    verify_cache **cache)
+{
+    (void)ctx;
+    (void)cache_file;
+    (void)key_file;
+    (void)slots;
+    (void)cache;
+
+    fprintf(stderr, "The verify cache isn't available on this platform.\n");
+    return IQR_EBADVALUE;
+}
+
+bool verify_cache_lookup(verify_cache *cache, const verify_cache_id *id)
+{
+    (void)cache;
+    (void)id;
+    return false;
+}
+
+iqr_retval verify_cache_add(verify_cache *cache, const verify_cache_id *id)
+{
+    (void)cache;
+    (void)id;
+    return IQR_EBADVALUE;
+}
+
+void verify_cache_close(verify_cache **cache)
+{
+    (void)cache;
+}
+
+#else
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The cache file.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void lock_file(const verify_cache *cache)
+{
+    while (flock(cache->fd, LOCK_EX) != 0 && errno == EINTR) {
+    }
+}
+
+static void unlock_file(const verify_cache *cache)
+{
+    flock(cache->fd, LOCK_UN);
+}
+
+/* The header's contents minus the tag, which is what the tag covers. */
+static iqr_retval header_tag(verify_cache *cache, uint32_t slots, uint8_t tag[CACHE_TAG_SIZE])
+{
+    uint8_t fields[12] = { 0 };
+    memcpy(fields, CACHE_MAGIC, 8);
+    put_u32(fields + 8, slots);
+    return make_tag(cache, "header", fields, sizeof(fields), tag);
+}
+
+/* Check the header of a file that's the right size for @a slots. */
+static bool header_valid(verify_cache *cache, uint32_t slots)
+{
+    if (memcmp(cache->map, CACHE_MAGIC, 8) != 0 || get_u32(cache->map + HEADER_SLOTS) != slots) {
+        return false;
+    }
+
+    uint8_t tag[CACHE_TAG_SIZE] = { 0 };
+    if (header_tag(cache, slots, tag) != IQR_OK) {
+        return false;
+    }
+    return tags_equal(tag, cache->map + HEADER_TAG);
+}
+
+static iqr_retval make_header(verify_cache *cache, uint32_t slots, uint8_t header[CACHE_HEADER_SIZE])
+{
+    memset(header, 0, CACHE_HEADER_SIZE);
+    memcpy(header, CACHE_MAGIC, 8);
+    put_u32(header + HEADER_SLOTS, slots);
+    return header_tag(cache, slots, header + HEADER_TAG);
+}
+
+/* Size an empty file and write a fresh header. Other processes may already
+ * have the file mapped, so it's only ever grown: shrinking a mapped file
+ * makes their next access to the lost pages fault.
+ */
+static iqr_retval init_file(verify_cache *cache, int fd, uint32_t slots)
+{
+    uint8_t header[CACHE_HEADER_SIZE];
+    iqr_retval ret = make_header(cache, slots, header);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (ftruncate(fd, (off_t)cache->map_size) != 0) {
+        fprintf(stderr, "Failed on ftruncate(): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+    if (pwrite(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        fprintf(stderr, "Failed on pwrite(): %s\n", strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    return IQR_OK;
+}
+
+/* Replace a file with the wrong slot count. The new file is built under a
+ * temporary name and renamed into place, so processes that still have the
+ * old one mapped keep using its inode undisturbed. On success the cache
+ * holds the new file, locked.
+ */
+static iqr_retval replace_file(verify_cache *cache, const char *cache_file, uint32_t slots)
+{
+    const size_t name_size = strlen(cache_file) + sizeof(".XXXXXX");
+    char *name = calloc(1, name_size);
+    if (name == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    snprintf(name, name_size, "%s.XXXXXX", cache_file);
+
+    iqr_retval ret = IQR_OK;
+    const int fd = mkstemp(name);
+    if (fd < 0) {
+        fprintf(stderr, "Failed on mkstemp(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    /* Lock it before it's visible under the real name. */
+    while (flock(fd, LOCK_EX) != 0 && errno == EINTR) {
+    }
+
+    ret = init_file(cache, fd, slots);
+    if (ret == IQR_OK && rename(name, cache_file) != 0) {
+        fprintf(stderr, "Failed on rename(): %s\n", strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+    if (ret != IQR_OK) {
+        unlink(name);
+        close(fd);
+        goto end;
+    }
+
+    unlock_file(cache);
+    close(cache->fd);
+    cache->fd = fd;
+
+end:
+    free(name);
+    return ret;
+}
+
+/* Empty a mapped file that has the right size but a bad header. The caller
+ * holds the lock, so nobody else is reading the slots.
+ */
+static iqr_retval clear_file(verify_cache *cache, uint32_t slots)
+{
+    uint8_t header[CACHE_HEADER_SIZE];
+    iqr_retval ret = make_header(cache, slots, header);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    memset(cache->map + CACHE_HEADER_SIZE, 0, cache->map_size - CACHE_HEADER_SIZE);
+    memcpy(cache->map, header, sizeof(header));
+    return IQR_OK;
+}
+
+/* Open and lock the file that's currently under @a cache_file. If another
+ * process replaced it while this one waited for the lock, start over with
+ * the replacement.
+ */
+static iqr_retval open_locked(verify_cache *cache, const char *cache_file, struct stat *st)
+{
+    for (;;) {
+        cache->fd = open(cache_file, O_RDWR | O_CREAT, 0600);
+        if (cache->fd < 0) {
+            fprintf(stderr, "Failed to open %s: %s\n", cache_file, strerror(errno));
+            return IQR_EBADVALUE;
+        }
+
+        lock_file(cache);
+
+        struct stat named;
+        if (fstat(cache->fd, st) != 0) {
+            fprintf(stderr, "Failed on fstat(): %s\n", strerror(errno));
+            return IQR_EBADVALUE;
+        }
+        if (stat(cache_file, &named) == 0 && named.st_dev == st->st_dev && named.st_ino == st->st_ino) {
+            return IQR_OK;
+        }
+
+        unlock_file(cache);
+        close(cache->fd);
+        cache->fd = -1;
+    }
+}
+
+static iqr_retval load_key(verify_cache *cache, const char *key_file)
+{
+    uint8_t *key = NULL;
+    size_t key_size = 0;
+    iqr_retval ret = load_data(key_file, &key, &key_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (key_size < VERIFY_CACHE_KEY_SIZE) {
+        fprintf(stderr, "The verify cache key in %s must be at least %d bytes.\n", key_file, VERIFY_CACHE_KEY_SIZE);
+        ret = IQR_EBADVALUE;
+    } else {
+        memcpy(cache->key, key, sizeof(cache->key));
+    }
+
+    secure_memzero(key, key_size);
+    free(key);
+    return ret;
+}
+
+iqr_retval verify_cache_open(const iqr_Context *ctx, const char *cache_file, const char *key_file, uint32_t slots,
+    verify_cache **cache)
+{
+    if (ctx == NULL || cache_file == NULL || key_file == NULL || cache == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (slots < CACHE_PROBES) {
+        return IQR_EINVBUFSIZE;
+    }
+
+    verify_cache *tmp = calloc(1, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+    tmp->fd = -1;
+    tmp->slots = slots;
+    tmp->map_size = CACHE_HEADER_SIZE + (size_t)slots * CACHE_SLOT_SIZE;
+
+    iqr_retval ret = iqr_HashCreate(ctx, IQR_HASHALGO_SHA2_256, &tmp->hash);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+    ret = iqr_MACCreateHMAC(ctx, IQR_HASHALGO_SHA2_256, &tmp->hmac);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_MACCreateHMAC(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = load_key(tmp, key_file);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    struct stat st;
+    ret = open_locked(tmp, cache_file, &st);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* A new file is grown in place. One sized for a different slot count may
+     * be mapped by processes using it, so it's replaced rather than resized.
+     */
+    const bool right_size = ((uint64_t)st.st_size == (uint64_t)tmp->map_size);
+    if (st.st_size == 0) {
+        ret = init_file(tmp, tmp->fd, slots);
+    } else if (!right_size) {
+        fprintf(stdout, "%s has a different slot count; starting an empty verify cache.\n", cache_file);
+        ret = replace_file(tmp, cache_file, slots);
+    }
+
+    if (ret == IQR_OK) {
+        void *map = mmap(NULL, tmp->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, tmp->fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Failed on mmap(): %s\n", strerror(errno));
+            ret = IQR_EBADVALUE;
+        } else {
+            tmp->map = map;
+        }
+    }
+
+    /* A file of the right size written under another key (or tampered with)
+     * is emptied in place.
+     */
+    if (ret == IQR_OK && right_size && !header_valid(tmp, slots)) {
+        fprintf(stdout, "%s wasn't written with this key; starting an empty verify cache.\n", cache_file);
+        ret = clear_file(tmp, slots);
+    }
+
+    unlock_file(tmp);
+
+end:
+    if (ret != IQR_OK) {
+        verify_cache_close(&tmp);
+    }
+    *cache = tmp;
+    return ret;
+}
+
+bool verify_cache_lookup(verify_cache *cache, const verify_cache_id *id)
+{
+    if (cache == NULL || id == NULL) {
+        return false;
+    }
+
+    bool hit = false;
+    const uint32_t home = (uint32_t)(get_u64(id->digest) % cache->slots);
+
+    lock_file(cache);
+    for (uint32_t i = 0; i < CACHE_PROBES; i++) {
+        uint8_t *slot = slot_at(cache, (home + i) % cache->slots);
+        if (get_u64(slot + SLOT_USED) == 0 || memcmp(slot, id->digest, sizeof(id->digest)) != 0) {
+            continue;
+        }
+
+        uint8_t tag[CACHE_TAG_SIZE] = { 0 };
+        if (make_tag(cache, "verified", id->digest, sizeof(id->digest), tag) == IQR_OK && tags_equal(tag, slot + SLOT_TAG)) {
+            put_u64(slot + SLOT_USED, next_use(cache));
+            hit = true;
+        } else {
+            /* Someone wrote this slot without the key; drop it. */
+            memset(slot, 0, CACHE_SLOT_SIZE);
+        }
+        break;
+    }
+    unlock_file(cache);
+
+    return hit;
+}
+
+iqr_retval verify_cache_add(verify_cache *cache, const verify_cache_id *id)
+{
+    if (cache == NULL || id == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    uint8_t tag[CACHE_TAG_SIZE] = { 0 };
+    iqr_retval ret = make_tag(cache, "verified", id->digest, sizeof(id->digest), tag);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint32_t home = (uint32_t)(get_u64(id->digest) % cache->slots);
+
+    lock_file(cache);
+
+    /* Take the slot that already holds the id, else the first empty slot,
+     * else the one used least recently.
+     */
+    uint8_t *target = NULL;
+    uint64_t oldest = UINT64_MAX;
+    for (uint32_t i = 0; i < CACHE_PROBES; i++) {
+        uint8_t *slot = slot_at(cache, (home + i) % cache->slots);
+        const uint64_t used = get_u64(slot + SLOT_USED);
+        if (used != 0 && memcmp(slot, id->digest, sizeof(id->digest)) == 0) {
+            target = slot;
+            break;
+        }
+        if (used < oldest) {
+            oldest = used;
+            target = slot;
+        }
+    }
+
+    memset(target, 0, CACHE_SLOT_SIZE);
+    memcpy(target, id->digest, sizeof(id->digest));
+    memcpy(target + SLOT_TAG, tag, sizeof(tag));
+    put_u64(target + SLOT_USED, next_use(cache));
+
+    unlock_file(cache);
+
+    return IQR_OK;
+}
+
+void verify_cache_close(verify_cache **cache)
+{
+    if (cache == NULL || *cache == NULL) {
+        return;
+    }
+
+    verify_cache *c = *cache;
+    if (c->map != NULL) {
+        munmap(c->map, c->map_size);
+    }
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    iqr_MACDestroy(&c->hmac);
+    iqr_HashDestroy(&c->hash);
+    secure_memzero(c->key, sizeof(c->key));
+    free(c);
+    *cache = NULL;
+}
+
+#endif
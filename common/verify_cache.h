@@ -0,0 +1,120 @@
+/** @file verify_cache.h
+ *
+ * @brief A persistent cache of signatures that have already been verified.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VERIFY_CACHE_H
+#define VERIFY_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_retval.h"
+
+/* The cache file is a fixed-size open-addressing hash table that's mapped
+ * into memory; integers are big-endian.
+ *
+ * Header (64 bytes):
+ *     "IQRVCAC1"     magic
+ *     u32            slot count
+ *     u32            reserved, 0
+ *     u64            use counter
+ *     16 bytes       HMAC tag over the magic and slot count
+ *     24 bytes       reserved, 0
+ *
+ * Slots (64 bytes each):
+ *     32 bytes       verify_cache_id
+ *     16 bytes       HMAC tag over the id
+ *     u64            use counter value when last used; 0 for an empty slot
+ *     8 bytes        reserved, 0
+ *
+ * Tags are truncated HMAC-SHA2-256 under the cache key. Without the key,
+ * nobody who can write the file can add an entry that will be accepted.
+ */
+
+/** Size of the cache's HMAC key in bytes. */
+#define VERIFY_CACHE_KEY_SIZE 32
+
+/** Slots in a new cache file; 64 bytes each. */
+#define VERIFY_CACHE_DEFAULT_SLOTS 65536
+
+/** Identifies one signature check. */
+typedef struct {
+    uint8_t digest[32];
+} verify_cache_id;
+
+/** An open cache file. */
+typedef struct verify_cache verify_cache;
+
+/** Open a cache file, creating it if needed.
+ *
+ * A file that's damaged or was written with a different key is emptied. A
+ * file with a different slot count is replaced with an empty one, built
+ * under a temporary name next to it and renamed into place; it's never
+ * resized, so processes that still have the old file open aren't disturbed.
+ * The file is locked while it's read or written, so several processes can
+ * share it.
+ *
+ * @param ctx           The toolkit context; SHA2-256 must be registered.
+ * @param cache_file    Name of the cache file.
+ * @param key_file      Name of a file holding at least
+ *                      VERIFY_CACHE_KEY_SIZE bytes of secret key.
+ * @param slots         Slot count for a new file.
+ * @param cache         The opened cache.
+ */
+iqr_retval verify_cache_open(const iqr_Context *ctx, const char *cache_file, const char *key_file, uint32_t slots,
+    verify_cache **cache);
+
+/** Work out the id of a signature check.
+ *
+ * The id is a SHA2-256 digest over @a scheme and the SHA2-256 digests of the
+ * public key, the message and the signature.
+ *
+ * @param cache     The cache.
+ * @param scheme    Names the scheme, and the variant unless the public key
+ *                  encodes it, for example "sphincs-sha192f" or "xmss".
+ * @param pub       The public key as stored on disk.
+ * @param msg       The message, or for the stateful schemes the digest that
+ *                  was signed.
+ * @param sig       The signature.
+ * @param id        The id.
+ */
+iqr_retval verify_cache_make_id(verify_cache *cache, const char *scheme, const uint8_t *pub, size_t pub_size, const uint8_t *msg,
+    size_t msg_size, const uint8_t *sig, size_t sig_size, verify_cache_id *id);
+
+/** Check whether a signature has already been verified.
+ *
+ * @return true if the cache holds @a id with a valid tag.
+ */
+bool verify_cache_lookup(verify_cache *cache, const verify_cache_id *id);
+
+/** Record a signature that verified.
+ *
+ * If the slots @a id can go in are all taken, the one that was used least
+ * recently is replaced.
+ */
+iqr_retval verify_cache_add(verify_cache *cache, const verify_cache_id *id);
+
+/** Close a cache file; the file keeps its entries.
+ *
+ * @param cache     The cache; set to NULL.
+ */
+void verify_cache_close(verify_cache **cache);
+
+#endif
@@ -0,0 +1,365 @@
+/** @file main.c
+ *
+ * @brief Measure what passing the key agreement samples' messages costs, with
+ * and without copying them.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dh_table.h"
+#include "iqr_retval.h"
+#include "isara_samples.h"
+#include "transport.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"comms_bench [--handshakes <count>] [--transport all|memory|socketpair|tcp]\n"
+"    Defaults are: \n"
+"        --handshakes 10000\n"
+"        --transport all\n"
+"  Passes a handshake's worth of messages between Alice and Bob for each\n"
+"  key agreement scheme, first by copying them in and out of buffers from\n"
+"  calloc() and then by handing over the transport's slabs. No keys are\n"
+"  generated; only the message traffic is timed.\n";
+
+/* The messages each scheme's handshake sends: Alice's public key and Bob's
+ * reply.
+ */
+typedef struct {
+    const char *name;
+    size_t initiator_size;
+    size_t responder_size;
+} dh_messages;
+
+static const transport_kind transports[] = { TRANSPORT_MEMORY, TRANSPORT_SOCKETPAIR, TRANSPORT_TCP };
+
+#define TRANSPORT_COUNT (sizeof(transports) / sizeof(transports[0]))
+
+typedef struct {
+    uint64_t elapsed_ns;
+    uint64_t allocations;
+    uint64_t copied;
+} bench_result;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Look up each scheme's message sizes.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Ask the toolkit for a key agreement variant's message sizes, so they always
+ * match the keys the samples really send.
+ */
+static iqr_retval get_messages(const dh_scheme *dh, dh_messages *messages)
+{
+    iqr_Context *ctx = NULL;
+    iqr_retval ret = dh_bootstrap_context(dh, &ctx);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on dh_bootstrap_context(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    void *params = NULL;
+    ret = dh->create_params(ctx, &params);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed to create %s's parameters: %s\n", dh->name, iqr_StrError(ret));
+        return ret;
+    }
+
+    dh_sizes sizes;
+    ret = dh->get_sizes(params, &sizes);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed to get %s's sizes: %s\n", dh->name, iqr_StrError(ret));
+    } else {
+        messages->name = dh->name;
+        messages->initiator_size = sizes.initiator_message;
+        messages->responder_size = sizes.responder_message;
+    }
+
+    dh->destroy_params(&params);
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The two ways of passing a message.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Stand in for the toolkit writing a key into the buffer, and for the other
+ * side reading it, so both modes touch every byte.
+ */
+static void fill(uint8_t *buf, size_t size, uint64_t seed)
+{
+    memset(buf, (int)(seed & 0xff), size);
+}
+
+static uint8_t touch(const uint8_t *buf, size_t size)
+{
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum ^= buf[i];
+    }
+    return sum;
+}
+
+/* The way the samples used to do it: every message is built in a buffer of its
+ * own, copied into the link, and copied out into another buffer at the other
+ * end.
+ */
+static iqr_retval copy_message(transport_link *link, transport_end from, size_t size, uint64_t seed, bench_result *result)
+{
+    const transport_end to = (from == TRANSPORT_ALICE) ? TRANSPORT_BOB : TRANSPORT_ALICE;
+
+    uint8_t *out = calloc(1, size);
+    uint8_t *in = calloc(1, size);
+    if (out == NULL || in == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(out);
+        free(in);
+        return IQR_ENOMEM;
+    }
+    result->allocations += 2;
+
+    fill(out, size, seed);
+    iqr_retval ret = transport_send(link, from, out, size);
+    if (ret == IQR_OK) {
+        size_t received = size;
+        ret = transport_receive(link, to, in, &received);
+        if (ret == IQR_OK && touch(in, received) != touch(out, size)) {
+            ret = IQR_EINVDATA;
+        }
+    }
+
+    free(out);
+    free(in);
+    return ret;
+}
+
+/* The way the samples do it now: the message is built in one of the link's
+ * slabs and the receiver reads it from the slab it arrives in.
+ */
+static iqr_retval slab_message(transport_link *link, transport_end from, size_t size, uint64_t seed)
+{
+    const transport_end to = (from == TRANSPORT_ALICE) ? TRANSPORT_BOB : TRANSPORT_ALICE;
+
+    uint8_t *out = NULL;
+    iqr_retval ret = transport_acquire(link, &out);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    fill(out, size, seed);
+    const uint8_t expected = touch(out, size);
+    ret = transport_send_slab(link, from, out, size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    uint8_t *in = NULL;
+    size_t received = 0;
+    ret = transport_receive_slab(link, to, &in, &received);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    if (received != size || touch(in, received) != expected) {
+        ret = IQR_EINVDATA;
+    }
+    transport_release(link, in);
+    return ret;
+}
+
+static iqr_retval bench_handshakes(const dh_messages *scheme, transport_kind kind, bool slabs, uint64_t handshakes,
+    bench_result *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    const size_t max_message = (scheme->initiator_size > scheme->responder_size) ? scheme->initiator_size :
+        scheme->responder_size;
+
+    transport_link *link = NULL;
+    iqr_retval ret = transport_open(kind, max_message, &link);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on transport_open(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    const uint64_t start = time_now_ns();
+    for (uint64_t h = 0; h < handshakes && ret == IQR_OK; h++) {
+        if (slabs) {
+            ret = slab_message(link, TRANSPORT_ALICE, scheme->initiator_size, h);
+            if (ret == IQR_OK) {
+                ret = slab_message(link, TRANSPORT_BOB, scheme->responder_size, h);
+            }
+        } else {
+            ret = copy_message(link, TRANSPORT_ALICE, scheme->initiator_size, h, result);
+            if (ret == IQR_OK) {
+                ret = copy_message(link, TRANSPORT_BOB, scheme->responder_size, h, result);
+            }
+        }
+    }
+    result->elapsed_ns = time_now_ns() - start;
+    result->copied = transport_copied(link);
+
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed to pass %s's messages: %s\n", scheme->name, iqr_StrError(ret));
+    }
+
+    transport_close(&link);
+    return ret;
+}
+
+static void report(const dh_messages *scheme, transport_kind kind, const char *mode, uint64_t handshakes,
+    const bench_result *result)
+{
+    fprintf(stdout, "%-16s %-10s %-5s %10.0f %8.1f %10.0f\n", scheme->name, transport_name(kind), mode,
+        (double)result->elapsed_ns / (double)handshakes, (double)result->allocations / (double)handshakes,
+        (double)result->copied / (double)handshakes);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+static void preamble(const char *cmd, uint64_t handshakes, const bool *use_transport)
+{
+    fprintf(stdout, "Running %s with the following parameters...\n", cmd);
+    fprintf(stdout, "    Handshakes: %llu\n", (unsigned long long)handshakes);
+    fprintf(stdout, "    Transports:");
+    for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+        if (use_transport[t]) {
+            fprintf(stdout, " %s", transport_name(transports[t]));
+        }
+    }
+    fprintf(stdout, "\n\n");
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, uint64_t *handshakes, bool *use_transport)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--handshakes") == 0) {
+            /* [--handshakes <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *handshakes = (uint64_t)value;
+        } else if (paramcmp(argv[i], "--transport") == 0) {
+            /* [--transport all|memory|socketpair|tcp] */
+            i++;
+            if (paramcmp(argv[i], "all") == 0) {
+                for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+                    use_transport[t] = true;
+                }
+            } else {
+                transport_kind kind = TRANSPORT_MEMORY;
+                if (transport_parse(argv[i], &kind) != IQR_OK) {
+                    fprintf(stdout, "%s", usage_msg);
+                    return IQR_EBADVALUE;
+                }
+                for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+                    use_transport[t] = (transports[t] == kind);
+                }
+            }
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    uint64_t handshakes = 10000;
+    bool use_transport[TRANSPORT_COUNT] = { true, true, true };
+
+    iqr_retval ret = parse_commandline(argc, argv, &handshakes, use_transport);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    preamble(argv[0], handshakes, use_transport);
+
+    fprintf(stdout, "%-16s %-10s %-5s %10s %8s %10s\n", "scheme", "transport", "mode", "ns/hs", "allocs", "copied");
+    for (size_t s = 0; s < dh_scheme_count && ret == IQR_OK; s++) {
+        dh_messages scheme;
+        ret = get_messages(&dh_schemes[s], &scheme);
+        for (size_t t = 0; t < TRANSPORT_COUNT && ret == IQR_OK; t++) {
+            if (!use_transport[t]) {
+                continue;
+            }
+
+            bench_result copy;
+            bench_result slab;
+            ret = bench_handshakes(&scheme, transports[t], false, handshakes, &copy);
+            if (ret == IQR_OK) {
+                ret = bench_handshakes(&scheme, transports[t], true, handshakes, &slab);
+            }
+            if (ret == IQR_OK) {
+                report(&scheme, transports[t], "copy", handshakes, &copy);
+                report(&scheme, transports[t], "slab", handshakes, &slab);
+            }
+        }
+    }
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
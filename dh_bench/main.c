@@ -0,0 +1,544 @@
+/** @file main.c
+ *
+ * @brief Measure handshake throughput and latency for the toolkit's key
+ * agreement schemes.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "dh_table.h"
+#include "iqr_context.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "latency.h"
+#include "rng_pool.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"dh_bench [--scheme all|<scheme>[,<scheme>...]] [--handshakes <count>]\n"
+"  [--threads <count>] [--output <filename>]\n"
+"    <scheme> is one of newhopedh, frododh-aes, frododh-shake, samwise-aes,\n"
+"    samwise-chacha20, sidh-p503 or sidh-p751.\n"
+"    Defaults are: \n"
+"        --scheme all\n"
+"        --handshakes 1000\n"
+"        --threads 1\n"
+"        --output stdout\n"
+"  Runs the given number of complete handshakes for each scheme, split\n"
+"  between the threads, and writes the timings as JSON.\n";
+
+/* The three steps of a handshake, plus the whole thing. */
+typedef enum {
+    PHASE_INITIATOR_KEYGEN,
+    PHASE_RESPONDER_RESPONSE,
+    PHASE_INITIATOR_FINALIZE,
+    PHASE_HANDSHAKE,
+    PHASE_COUNT
+} dh_phase;
+
+static const char *phase_names[PHASE_COUNT] = {
+    "initiator_keygen", "responder_response", "initiator_finalize", "handshake"
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Worker threads.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Holds the workers until they're all ready, so they start timing together. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t ready;
+    bool go;
+} start_gate;
+
+typedef struct {
+    const dh_scheme *dh;
+    const void *params;
+    const dh_sizes *sizes;
+    rng_pool *rngs;
+    start_gate *gate;
+    size_t handshakes;
+
+    latency_histogram latency[PHASE_COUNT];
+
+    iqr_retval ret;
+} bench_worker;
+
+/* Both sides of one handshake, each step timed on its own. In a real protocol
+ * the two messages would cross a network; see comms_bench for what that adds.
+ */
+static iqr_retval handshake(bench_worker *w, const iqr_RNG *rng, uint8_t *message, uint8_t *reply,
+    uint8_t *initiator_secret, uint8_t *responder_secret)
+{
+    const dh_scheme *dh = w->dh;
+    const dh_sizes *sizes = w->sizes;
+    void *initiator = NULL;
+
+    const uint64_t t0 = time_now_ns();
+    iqr_retval ret = dh->initiator_start(w->params, rng, &initiator, message, sizes->initiator_message);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint64_t t1 = time_now_ns();
+    ret = dh->responder_reply(w->params, rng, message, sizes->initiator_message, reply, sizes->responder_message,
+        responder_secret, sizes->secret);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint64_t t2 = time_now_ns();
+    ret = dh->initiator_finish(initiator, reply, sizes->responder_message, initiator_secret, sizes->secret);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    const uint64_t t3 = time_now_ns();
+
+    latency_record(&w->latency[PHASE_INITIATOR_KEYGEN], t1 - t0);
+    latency_record(&w->latency[PHASE_RESPONDER_RESPONSE], t2 - t1);
+    latency_record(&w->latency[PHASE_INITIATOR_FINALIZE], t3 - t2);
+    latency_record(&w->latency[PHASE_HANDSHAKE], t3 - t0);
+
+    /* A benchmark of a broken handshake isn't worth much. */
+    if (memcmp(initiator_secret, responder_secret, sizes->secret) != 0) {
+        fprintf(stderr, "%s: the secrets don't match!\n", dh->name);
+        ret = IQR_EINVDATA;
+    }
+
+end:
+    dh->destroy_initiator(&initiator);
+    return ret;
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_worker *w = arg;
+    iqr_RNG *rng = NULL;
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        latency_reset(&w->latency[p]);
+    }
+
+    uint8_t *message = calloc(1, w->sizes->initiator_message);
+    uint8_t *reply = calloc(1, w->sizes->responder_message);
+    uint8_t *initiator_secret = calloc(1, w->sizes->secret);
+    uint8_t *responder_secret = calloc(1, w->sizes->secret);
+    if (message == NULL || reply == NULL || initiator_secret == NULL || responder_secret == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        w->ret = IQR_ENOMEM;
+    } else {
+        w->ret = rng_pool_thread_rng(w->rngs, &rng);
+    }
+
+    pthread_mutex_lock(&w->gate->lock);
+    w->gate->ready++;
+    pthread_cond_broadcast(&w->gate->cond);
+    while (!w->gate->go) {
+        pthread_cond_wait(&w->gate->cond, &w->gate->lock);
+    }
+    pthread_mutex_unlock(&w->gate->lock);
+
+    for (size_t i = 0; i < w->handshakes && w->ret == IQR_OK; i++) {
+        w->ret = handshake(w, rng, message, reply, initiator_secret, responder_secret);
+    }
+
+    if (initiator_secret != NULL) {
+        secure_memzero(initiator_secret, w->sizes->secret);
+    }
+    if (responder_secret != NULL) {
+        secure_memzero(responder_secret, w->sizes->secret);
+    }
+    free(message);
+    free(reply);
+    free(initiator_secret);
+    free(responder_secret);
+
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmark driver.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    FILE *out;
+    bool first_row;
+} bench_output;
+
+static void report(bench_output *output, const dh_scheme *dh, const dh_sizes *sizes, uint32_t threads, size_t handshakes,
+    uint64_t elapsed_ns, const latency_histogram *latency)
+{
+    const double per_sec = (elapsed_ns > 0) ? (double)handshakes * 1e9 / (double)elapsed_ns : 0.0;
+    const size_t wire_bytes = sizes->initiator_message + sizes->responder_message;
+
+    fprintf(output->out, "%s  {\"scheme\": \"%s\", \"threads\": %u, \"handshakes\": %zu, \"elapsed_ms\": %.2f, "
+        "\"handshakes_per_sec\": %.1f,\n", output->first_row ? "" : ",\n", dh->name, threads, handshakes,
+        (double)elapsed_ns / 1e6, per_sec);
+    fprintf(output->out, "   \"initiator_bytes\": %zu, \"responder_bytes\": %zu, \"wire_bytes_per_handshake\": %zu, "
+        "\"wire_mbytes_per_sec\": %.2f, \"secret_bytes\": %zu", sizes->initiator_message, sizes->responder_message,
+        wire_bytes, (double)wire_bytes * per_sec / 1e6, sizes->secret);
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const latency_histogram *h = &latency[p];
+        const double mean_us = (h->count > 0) ? (double)h->sum_ns / (double)h->count / 1e3 : 0.0;
+        const uint64_t p50 = latency_percentile(h, 50.0);
+        const uint64_t p99 = latency_percentile(h, 99.0);
+        fprintf(output->out, ",\n   \"%s\": {\"mean_us\": %.2f, \"min_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, "
+            "\"max_us\": %.2f}", phase_names[p], mean_us, (double)h->min_ns / 1e3, (double)p50 / 1e3, (double)p99 / 1e3,
+            (double)h->max_ns / 1e3);
+    }
+    fprintf(output->out, "}");
+
+    output->first_row = false;
+}
+
+static iqr_retval bench_scheme(const iqr_Context *ctx, const dh_scheme *dh, rng_pool *rngs, uint32_t threads,
+    size_t handshakes, bench_output *output)
+{
+    void *params = NULL;
+    dh_sizes sizes;
+    pthread_t *tids = NULL;
+    uint32_t started = 0;
+    uint64_t start_ns = 0;
+    uint64_t elapsed_ns = 0;
+
+    start_gate gate;
+    memset(&gate, 0, sizeof(gate));
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+
+    /* The histograms are large, so the workers live on the heap. */
+    latency_histogram *latency = calloc(PHASE_COUNT, sizeof(*latency));
+    bench_worker *workers = calloc(threads, sizeof(*workers));
+    if (latency == NULL || workers == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(workers);
+        free(latency);
+        return IQR_ENOMEM;
+    }
+
+    /* The threads share one set of parameters, like a server would. */
+    iqr_retval ret = dh->create_params(ctx, &params);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = dh->get_sizes(params, &sizes);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    tids = calloc(threads, sizeof(*tids));
+    if (tids == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    /* Split the handshakes as evenly as possible. */
+    for (uint32_t t = 0; t < threads; t++) {
+        bench_worker *w = &workers[t];
+        w->dh = dh;
+        w->params = params;
+        w->sizes = &sizes;
+        w->rngs = rngs;
+        w->gate = &gate;
+        w->handshakes = handshakes / threads + ((t < handshakes % threads) ? 1 : 0);
+    }
+
+    for (; started < threads; started++) {
+        const int rc = pthread_create(&tids[started], NULL, bench_thread, &workers[started]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&gate.lock);
+    while (gate.ready < started) {
+        pthread_cond_wait(&gate.cond, &gate.lock);
+    }
+    gate.go = true;
+    start_ns = time_now_ns();
+    pthread_cond_broadcast(&gate.cond);
+    pthread_mutex_unlock(&gate.lock);
+
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+        if (workers[t].ret != IQR_OK && ret == IQR_OK) {
+            ret = workers[t].ret;
+        }
+    }
+    elapsed_ns = time_now_ns() - start_ns;
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        latency_reset(&latency[p]);
+        for (uint32_t t = 0; t < threads; t++) {
+            latency_merge(&latency[p], &workers[t].latency[p]);
+        }
+    }
+
+    report(output, dh, &sizes, threads, handshakes, elapsed_ns, latency);
+
+end:
+    free(tids);
+    free(workers);
+    free(latency);
+    if (params != NULL) {
+        dh->destroy_params(&params);
+    }
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.lock);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// any one key agreement scheme.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const bool *use_scheme)
+{
+    /* Create a Context. */
+    iqr_retval ret = bootstrap_context(NULL, 0, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Register the hashes every selected scheme needs, plus the DRBG's. */
+    for (size_t s = 0; s < dh_scheme_count; s++) {
+        if (use_scheme[s]) {
+            ret = dh_bootstrap_context(&dh_schemes[s], ctx);
+            if (ret != IQR_OK) {
+                return ret;
+            }
+        }
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse a comma separated list of scheme names, or "all". */
+static iqr_retval get_schemes(const char *p, bool *use_scheme)
+{
+    if (paramcmp(p, "all") == 0) {
+        for (size_t s = 0; s < dh_scheme_count; s++) {
+            use_scheme[s] = true;
+        }
+        return IQR_OK;
+    }
+
+    for (size_t s = 0; s < dh_scheme_count; s++) {
+        use_scheme[s] = false;
+    }
+
+    while (*p != '\0') {
+        const char *end = strchr(p, ',');
+        const size_t len = (end != NULL) ? (size_t)(end - p) : strlen(p);
+
+        bool found = false;
+        for (size_t s = 0; s < dh_scheme_count; s++) {
+            if (strlen(dh_schemes[s].name) == len && strncmp(dh_schemes[s].name, p, len) == 0) {
+                use_scheme[s] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            return IQR_EBADVALUE;
+        }
+
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return IQR_OK;
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, bool *use_scheme, size_t *handshakes, uint32_t *threads,
+    const char **output)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--scheme") == 0) {
+            /* [--scheme all|<scheme>[,<scheme>...]] */
+            i++;
+            if (get_schemes(argv[i], use_scheme) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--handshakes") == 0 || paramcmp(argv[i], "--threads") == 0) {
+            /* [--handshakes <count>] [--threads <count>] */
+            const bool thread_count = paramcmp(argv[i], "--threads") == 0;
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            if (thread_count) {
+                *threads = (uint32_t)value;
+            } else {
+                *handshakes = (size_t)value;
+            }
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output = argv[i];
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+
+    /* Every thread needs at least one handshake. */
+    if ((size_t)*threads > *handshakes) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    bool *use_scheme = calloc(dh_scheme_count, sizeof(*use_scheme));
+    size_t handshakes = 1000;
+    uint32_t threads = 1;
+    const char *output = NULL;
+
+    iqr_Context *ctx = NULL;
+    rng_pool *rngs = NULL;
+
+    if (use_scheme == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    for (size_t s = 0; s < dh_scheme_count; s++) {
+        use_scheme[s] = true;
+    }
+
+    iqr_retval ret = parse_commandline(argc, argv, use_scheme, &handshakes, &threads, &output);
+    if (ret != IQR_OK) {
+        free(use_scheme);
+        return EXIT_FAILURE;
+    }
+
+    bench_output results;
+    results.out = stdout;
+    results.first_row = true;
+
+    if (output != NULL) {
+        results.out = fopen(output, "w");
+        if (results.out == NULL) {
+            fprintf(stderr, "Failed to open %s: %s\n", output, strerror(errno));
+            free(use_scheme);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ret = init_toolkit(&ctx, use_scheme);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    /* The individual samples seed NewHopeDH's DRBG with SHA3-256, but every
+     * scheme is just as happy with a SHA2-256 HMAC-DRBG, the pool's default.
+     */
+    ret = rng_pool_create(ctx, NULL, &rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto cleanup;
+    }
+
+    fprintf(results.out, "[\n");
+    for (size_t s = 0; s < dh_scheme_count && ret == IQR_OK; s++) {
+        if (use_scheme[s]) {
+            ret = bench_scheme(ctx, &dh_schemes[s], rngs, threads, handshakes, &results);
+        }
+    }
+    fprintf(results.out, "\n]\n");
+
+    /* The one-off set-up cost, kept out of the results. */
+    bootstrap_print_stats(stderr);
+
+cleanup:
+    rng_pool_destroy(&rngs);
+    bootstrap_release();
+    if (results.out != stdout) {
+        fclose(results.out);
+    }
+    free(use_scheme);
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,323 @@
+/** @file main.c
+ *
+ * @brief Run many key agreement sessions at once over a single connection.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "dh_mux.h"
+#include "dh_table.h"
+#include "iqr_context.h"
+#include "iqr_retval.h"
+#include "isara_samples.h"
+#include "latency.h"
+#include "transport.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"dh_mux [--scheme <scheme>] [--sessions <count>] [--window <count>]\n"
+"  [--workers <count>] [--transport socketpair|tcp] [--verify]\n"
+"    <scheme> is one of newhopedh, frododh-aes, frododh-shake, samwise-aes,\n"
+"    samwise-chacha20, sidh-p503 or sidh-p751.\n"
+"    Defaults are: \n"
+"        --scheme newhopedh\n"
+"        --sessions 10000\n"
+"        --window 64\n"
+"        --workers 0 (one per online CPU)\n"
+"        --transport socketpair\n"
+"  Runs the sessions between an initiator in this process and a responder\n"
+"  in a child process, over one connection. Each side sends a window of\n"
+"  sessions' messages per write and works on them with its worker threads.\n"
+"  --verify has the responder send each secret back so they can be compared.\n";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This function showcases multiplexing sessions over one connection.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void report(const char *side, const dh_mux_stats *stats, bool verify)
+{
+    const uint64_t total = stats->sessions + stats->failures;
+    const double seconds = (double)stats->elapsed_ns / 1e9;
+
+    fprintf(stdout, "%s: %llu sessions (%llu failed) in %.3f s, %.1f sessions/sec.\n", side,
+        (unsigned long long)stats->sessions, (unsigned long long)stats->failures, seconds,
+        (seconds > 0) ? (double)stats->sessions / seconds : 0.0);
+    if (stats->batches > 0 && total > 0) {
+        fprintf(stdout, "    %llu writes, %.1f sessions per write; %.0f bytes sent and %.0f received per session.\n",
+            (unsigned long long)stats->batches, (double)total / (double)stats->batches,
+            (double)stats->sent / (double)total, (double)stats->received / (double)total);
+    }
+    if (stats->cpu_ns > 0) {
+        fprintf(stdout, "    %.1f sessions/sec per core (%.3f s of CPU time).\n",
+            (double)stats->sessions / ((double)stats->cpu_ns / 1e9), (double)stats->cpu_ns / 1e9);
+    }
+    if (verify && stats->latency.count > 0) {
+        fprintf(stdout, "    Every completed session's secrets matched.\n");
+    }
+    latency_print(stdout, "    Session latency", &stats->latency);
+}
+
+static iqr_retval showcase_dh_mux(const iqr_Context *ctx, const dh_scheme *dh, transport_kind transport, uint32_t sessions,
+    uint32_t window, uint32_t workers, bool verify)
+{
+    void *params = NULL;
+    transport_link *link = NULL;
+    transport_role role = TRANSPORT_ROLE_BOTH;
+    dh_sizes sizes;
+
+    /* The histogram is large, so keep it off the stack. */
+    dh_mux_stats *stats = calloc(1, sizeof(*stats));
+    if (stats == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = dh->create_params(ctx, &params);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = dh->get_sizes(params, &sizes);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    dh_mux_config config;
+    memset(&config, 0, sizeof(config));
+    config.dh = dh;
+    config.params = params;
+    config.window = window;
+    config.workers = workers;
+    config.verify = verify;
+
+    /* Every frame is a whole batch, so the link has to carry the largest
+     * one.
+     */
+    ret = transport_open(transport, dh_mux_max_batch(&config, &sizes), &link);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on transport_open(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    /* The responder gets a process of its own. Both ends block on the link,
+     * so they can't take turns in one process.
+     */
+    ret = transport_fork(link, &role);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (role == TRANSPORT_ROLE_BOTH) {
+        fprintf(stderr, "The %s transport can't be split between processes.\n", transport_name(transport));
+        ret = IQR_EBADVALUE;
+        goto end;
+    }
+
+    if (role == TRANSPORT_ROLE_BOB) {
+        ret = dh_mux_respond(ctx, IQR_HASHALGO_SHA2_256, &config, link, stats);
+        if (ret == IQR_OK) {
+            report("Responder", stats, false);
+        }
+        goto end;
+    }
+
+    ret = dh_mux_initiate(ctx, IQR_HASHALGO_SHA2_256, &config, link, sessions, stats);
+    if (ret == IQR_OK) {
+        /* Let the responder print its figures first. */
+        ret = transport_join(link);
+    }
+    if (ret == IQR_OK) {
+        report("Initiator", stats, verify);
+        if (stats->failures > 0) {
+            fprintf(stdout, "\nSome sessions failed.\n\n");
+        }
+    }
+
+end:
+    transport_close(&link);
+    if (params != NULL) {
+        dh->destroy_params(&params);
+    }
+    free(stats);
+
+    if (role == TRANSPORT_ROLE_BOB) {
+        /* This is the responder's process, and its work is done. */
+        exit((ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// any one key agreement scheme.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const dh_scheme *dh)
+{
+    /* Create a Context with the scheme's hashes and the DRBG's registered. */
+    return dh_bootstrap_context(dh, ctx);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+static void preamble(const char *cmd, const dh_scheme *dh, transport_kind transport, uint32_t sessions, uint32_t window,
+    uint32_t workers, bool verify)
+{
+    fprintf(stdout, "Running %s with the following parameters...\n", cmd);
+    fprintf(stdout, "    Scheme: %s\n", dh->name);
+    fprintf(stdout, "    Sessions: %u\n", sessions);
+    fprintf(stdout, "    Window: %u\n", window);
+    if (workers == 0) {
+        fprintf(stdout, "    Workers: one per online CPU\n");
+    } else {
+        fprintf(stdout, "    Workers: %u\n", workers);
+    }
+    fprintf(stdout, "    Transport: %s\n", transport_name(transport));
+    fprintf(stdout, "    Verify secrets: %s\n", verify ? "yes" : "no");
+    fprintf(stdout, "\n");
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, const dh_scheme **dh, transport_kind *transport,
+    uint32_t *sessions, uint32_t *window, uint32_t *workers, bool *verify)
+{
+    int i = 1;
+
+    while (i != argc) {
+        if (paramcmp(argv[i], "--verify") == 0) {
+            *verify = true;
+        } else if (paramcmp(argv[i], "--scheme") == 0) {
+            /* [--scheme <scheme>] */
+            i++;
+            *dh = (i == argc) ? NULL : dh_find(argv[i]);
+            if (*dh == NULL) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--sessions") == 0) {
+            /* [--sessions <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 1) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *sessions = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--window") == 0) {
+            /* [--window <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 1 || value > 4096) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *window = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--workers") == 0) {
+            /* [--workers <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *workers = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--transport") == 0) {
+            /* [--transport socketpair|tcp] */
+            i++;
+            if (i == argc || transport_parse(argv[i], transport) != IQR_OK || *transport == TRANSPORT_MEMORY) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    const dh_scheme *dh = dh_find("newhopedh");
+    transport_kind transport = TRANSPORT_SOCKETPAIR;
+    uint32_t sessions = 10000;
+    uint32_t window = 64;
+    uint32_t workers = 0;
+    bool verify = false;
+
+    iqr_Context *ctx = NULL;
+
+    /* If the command line arguments were not sane, this function will exit
+     * the program.
+     */
+    iqr_retval ret = parse_commandline(argc, argv, &dh, &transport, &sessions, &window, &workers, &verify);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    preamble(argv[0], dh, transport, sessions, window, workers, verify);
+
+    ret = init_toolkit(&ctx, dh);
+    if (ret == IQR_OK) {
+        ret = showcase_dh_mux(ctx, dh, transport, sessions, window, workers, verify);
+    }
+
+    bootstrap_release();
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
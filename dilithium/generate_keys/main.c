@@ -21,8 +21,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_dilithium.h"
 #include "iqr_hash.h"
@@ -155,35 +155,16 @@ end:
 
 static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA3_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA3_512, &IQR_HASH_DEFAULT_SHA3_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This lets us give satisfactory randomness to the algorithm. */
-    ret =  iqr_RNGCreateHMACDRBG(*ctx, IQR_HASHALGO_SHA3_512, rng);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* The seed should be initialized from a guaranteed entropy source. This is
-     * only an example; DO NOT INITIALIZE THE SEED LIKE THIS.
-     */
-    time_t seed = time(NULL);
-
-    ret = iqr_RNGInitialize(*rng, (uint8_t *)&seed, sizeof(seed));
+    /* Create an HMAC DRBG object, seeded from the system's entropy source. */
+    ret = bootstrap_rng(IQR_HASHALGO_SHA3_512, rng);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -284,7 +265,6 @@ int main(int argc, const char **argv)
     ret = showcase_dilithium_keygen(ctx, rng, variant, pub, priv);
 
 cleanup:
-    iqr_RNGDestroy(&rng);
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
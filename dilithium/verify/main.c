@@ -18,15 +18,21 @@
  */
 
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_dilithium.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
 #include "isara_samples.h"
+#include "prehash.h"
+#include "sig_batch.h"
+#include "verify_cache.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Tell the user about the command-line arguments.
@@ -35,11 +41,25 @@
 static const char *usage_msg =
 "dilithium_verify [--security 128|160] [--sig <filename>] [--pub <filename>]\n"
 "  [--message <filename>]\n"
+"  [--prehash none|sha2-512|sha3-512]\n"
+"  [--cache <filename> --cache-key <filename>]\n"
+"dilithium_verify [--security 128|160] --batch <filename>\n"
+"  [--output <filename>] [--threads <count>]\n"
 "    Defaults are: \n"
 "        --security 128\n"
 "        --sig sig.dat\n"
 "        --pub pub.key\n"
-"        --message message.dat\n";
+"        --message message.dat\n"
+"        --prehash none\n"
+"        --output verify_results.txt\n"
+"        --threads 0 (one per CPU)\n"
+"  --batch names a manifest listing a public key, message and signature file\n"
+"  per line; the result for every line is written to the --output file.\n"
+"  --cache names a verify cache file; a signature found in it was verified\n"
+"  before and isn't checked again. --cache-key names the file holding the\n"
+"  cache's secret HMAC key (at least 32 bytes).\n"
+"  --prehash checks a signature made with the same --prehash option; the\n"
+"  message can be any size, and --message - reads standard input.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases the verification of a Dilithium signature against a
@@ -47,7 +67,7 @@ static const char *usage_msg =
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static iqr_retval showcase_dilithium_verify(const iqr_Context *ctx, const iqr_DilithiumVariant *variant, const char *pub_file,
-    const char *message_file, const char *sig_file)
+    const char *message_file, const char *sig_file, verify_cache *cache, prehash_mode prehash)
 {
     iqr_DilithiumParams *params = NULL;
     iqr_DilithiumPublicKey *pub = NULL;
@@ -61,6 +81,9 @@ static iqr_retval showcase_dilithium_verify(const iqr_Context *ctx, const iqr_Di
     size_t sig_size = 0;
     uint8_t *sig = NULL;
 
+    verify_cache_id cache_id;
+    memset(&cache_id, 0, sizeof(cache_id));
+
     iqr_retval ret = iqr_DilithiumCreateParams(ctx, variant, &params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_DilithiumCreateParams(): %s\n", iqr_StrError(ret));
@@ -73,7 +96,16 @@ static iqr_retval showcase_dilithium_verify(const iqr_Context *ctx, const iqr_Di
         goto end;
     }
 
-    ret = load_data(message_file, &message, &message_size);
+    if (prehash != PREHASH_NONE) {
+        /* Stream the message through the hash instead of loading it. */
+        ret = prehash_message(ctx, prehash, message_file, &message, &message_size);
+    } else {
+        ret = load_data(message_file, &message, &message_size);
+        if (ret == IQR_OK && prehash_is_stand_in(message, message_size)) {
+            fprintf(stderr, "%s starts like a pre-hash stand-in message; it can only be verified with --prehash.\n", message_file);
+            ret = IQR_EINVDATA;
+        }
+    }
     if (ret != IQR_OK) {
         goto end;
     }
@@ -83,6 +115,21 @@ static iqr_retval showcase_dilithium_verify(const iqr_Context *ctx, const iqr_Di
         goto end;
     }
 
+    /* A signature that verified on an earlier run is in the cache, so the
+     * toolkit doesn't need to check it again.
+     */
+    if (cache != NULL) {
+        const char *scheme = variant == &IQR_DILITHIUM_160 ? "dilithium-160" : "dilithium-128";
+        ret = verify_cache_make_id(cache, scheme, pub_raw, pub_raw_size, message, message_size, sig, sig_size, &cache_id);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        if (verify_cache_lookup(cache, &cache_id)) {
+            fprintf(stdout, "Found the Dilithium signature in the verify cache; it was verified before.\n");
+            goto end;
+        }
+    }
+
     /* Import the public key data and create a public key object. */
     ret = iqr_DilithiumImportPublicKey(params, pub_raw, pub_raw_size, &pub);
     if (ret != IQR_OK) {
@@ -95,6 +142,9 @@ static iqr_retval showcase_dilithium_verify(const iqr_Context *ctx, const iqr_Di
     ret = iqr_DilithiumVerify(pub, message, message_size, sig, sig_size);
     if (ret == IQR_OK) {
         fprintf(stdout, "Dilithium verified the signature successfully!\n");
+        if (cache != NULL) {
+            ret = verify_cache_add(cache, &cache_id);
+        }
     } else {
         fprintf(stderr, "Failed on iqr_DilithiumVerify(): %s\n", iqr_StrError(ret));
     }
@@ -118,17 +168,12 @@ end:
 
 static iqr_retval init_toolkit(iqr_Context **ctx)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered.
+     * SHA2-256 is for the verify cache.
+     */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA3_512, IQR_HASHALGO_SHA2_512, IQR_HASHALGO_SHA2_256 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA3_512, &IQR_HASH_DEFAULT_SHA3_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -145,7 +190,8 @@ static iqr_retval init_toolkit(iqr_Context **ctx)
 // Report the chosen runtime parameters.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static void preamble(const char *cmd, const iqr_DilithiumVariant *variant, const char *sig, const char *pub, const char *message)
+static void preamble(const char *cmd, const iqr_DilithiumVariant *variant, const char *sig, const char *pub, const char *message,
+    const char *batch, const char *output, uint32_t threads, const char *cache_file, prehash_mode prehash)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     if (variant == &IQR_DILITHIUM_160) {
@@ -153,15 +199,49 @@ static void preamble(const char *cmd, const iqr_DilithiumVariant *variant, const
     } else {
         fprintf(stdout, "    security level: 128 bits\n");
     }
-    fprintf(stdout, "    signature file: %s\n", sig);
-    fprintf(stdout, "    public key file: %s\n", pub);
-    fprintf(stdout, "    message data file: %s\n", message);
+    if (batch != NULL) {
+        fprintf(stdout, "    manifest file: %s\n", batch);
+        fprintf(stdout, "    results file: %s\n", output);
+        fprintf(stdout, "    threads: %u\n", threads);
+    } else {
+        fprintf(stdout, "    signature file: %s\n", sig);
+        fprintf(stdout, "    public key file: %s\n", pub);
+        fprintf(stdout, "    message data file: %s\n", message);
+    }
+    if (cache_file != NULL) {
+        fprintf(stdout, "    verify cache: %s\n", cache_file);
+    }
+    if (prehash != PREHASH_NONE) {
+        fprintf(stdout, "    pre-hash: %s\n", prehash_name(prehash));
+    }
     fprintf(stdout, "\n");
 }
 
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
 /* Parse the command line options. */
 static iqr_retval parse_commandline(int argc, const char **argv, const iqr_DilithiumVariant **variant, const char **sig,
-    const char **pub, const char **message)
+    const char **pub, const char **message, const char **batch_file, const char **output_file, uint32_t *threads,
+    const char **cache_file, const char **cache_key_file, prehash_mode *prehash)
 {
     int i = 1;
     while (i != argc) {
@@ -188,6 +268,38 @@ static iqr_retval parse_commandline(int argc, const char **argv, const iqr_Dilit
            /* [--message <filename>] */
            i++;
            *message = argv[i];
+        } else if (paramcmp(argv[i], "--prehash") == 0) {
+            /* [--prehash none|sha2-512|sha3-512] */
+            i++;
+            if (prehash_parse(argv[i], prehash) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--cache") == 0) {
+            /* [--cache <filename>] */
+            i++;
+            *cache_file = argv[i];
+        } else if (paramcmp(argv[i], "--cache-key") == 0) {
+            /* [--cache-key <filename>] */
+            i++;
+            *cache_key_file = argv[i];
+        } else if (paramcmp(argv[i], "--batch") == 0) {
+            /* [--batch <filename>] */
+            i++;
+            *batch_file = argv[i];
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output_file = argv[i];
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)value;
         } else {
             fprintf(stdout, "%s", usage_msg);
             return IQR_EBADVALUE;
@@ -196,6 +308,18 @@ static iqr_retval parse_commandline(int argc, const char **argv, const iqr_Dilit
         i++;
     }
 
+    /* Batch mode verifies whole messages. */
+    if (*batch_file != NULL && *prehash != PREHASH_NONE) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
+    /* The cache and its key go together, and batch mode doesn't use them. */
+    if ((*cache_file == NULL) != (*cache_key_file == NULL) || (*batch_file != NULL && *cache_file != NULL)) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
     return IQR_OK;
 }
 
@@ -212,19 +336,27 @@ int main(int argc, const char **argv)
     const char *sig = "sig.dat";
     const char *pub = "pub.key";
     const char *message = "message.dat";
+    prehash_mode prehash = PREHASH_NONE;
+    const char *cache_file = NULL;
+    const char *cache_key_file = NULL;
+    const char *batch_file = NULL;
+    const char *output_file = "verify_results.txt";
+    uint32_t threads = 0;
 
     iqr_Context *ctx = NULL;
+    verify_cache *cache = NULL;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &variant, &sig, &pub, &message);
+    iqr_retval ret = parse_commandline(argc, argv, &variant, &sig, &pub, &message, &batch_file, &output_file, &threads,
+        &cache_file, &cache_key_file, &prehash);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], variant, sig, pub, message);
+    preamble(argv[0], variant, sig, pub, message, batch_file, output_file, threads, cache_file, prehash);
 
     /* IQR initialization that is not specific to Dilithium. */
     ret = init_toolkit(&ctx);
@@ -232,10 +364,25 @@ int main(int argc, const char **argv)
         goto cleanup;
     }
 
-    /* Showcase the verification of a Dilithium signature. */
-    ret = showcase_dilithium_verify(ctx, variant, pub, message, sig);
+    /* Signatures that verified on an earlier run skip the toolkit. */
+    if (cache_file != NULL) {
+        ret = verify_cache_open(ctx, cache_file, cache_key_file, VERIFY_CACHE_DEFAULT_SLOTS, &cache);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
+    if (batch_file != NULL) {
+        /* Verify every signature in the manifest. */
+        const sig_scheme *scheme = sig_find(variant == &IQR_DILITHIUM_160 ? "dilithium-160" : "dilithium-128");
+        ret = sig_verify_batch(ctx, scheme, batch_file, output_file, threads);
+    } else {
+        /* Showcase the verification of a Dilithium signature. */
+        ret = showcase_dilithium_verify(ctx, variant, pub, message, sig, cache, prehash);
+    }
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    verify_cache_close(&cache);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -2,9 +2,9 @@
  *
  * @brief Functions to demonstrate how Bob (the responder) should use FrodoDH.
  *
- * Bob is treated as a pseudo-separate process. He has his own params and
- * appears to keep his own state. It is done like this to show how the "Bob"
- * side of the transaction can be performed independent of Alice.
+ * Bob is treated as a pseudo-separate process. He keeps his params and
+ * private key in a bob_session, so the "Bob" side of the transaction can be
+ * performed independent of Alice, and of any other handshake.
  *
  * @copyright Copyright (C) 2017-2019, ISARA Corporation
  *
@@ -23,7 +23,6 @@
 
 #include "internal.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -32,15 +31,13 @@
 #include "iqr_rng.h"
 #include "isara_samples.h"
 
-/* It is not suggested to make these global variables. It's not thread safe.
- * It would be better to pass this around as required. It is done this way to
- * facilitate the pseudo-separate process paradigm.
- */
-static iqr_FrodoDHParams *params;
-static iqr_FrodoDHResponderPrivateKey *responder_private_key;
-
-iqr_retval init_bob(const iqr_Context *ctx, const iqr_FrodoDHVariant *variant)
+iqr_retval init_bob(bob_session *bob, const iqr_Context *ctx, const iqr_FrodoDHVariant *variant)
 {
+    if (bob == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (ctx == NULL) {
         fprintf(stderr, "Context was null, somehow.\n");
         return IQR_ENULLPTR;
@@ -51,15 +48,39 @@ iqr_retval init_bob(const iqr_Context *ctx, const iqr_FrodoDHVariant *variant)
         return IQR_ENULLPTR;
     }
 
-    iqr_retval ret = iqr_FrodoDHCreateParams(ctx, variant, &params);
+    iqr_retval ret = iqr_FrodoDHCreateParams(ctx, variant, &bob->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_FrodoDHCreateParams(): %s\n", iqr_StrError(ret));
     }
     return ret;
 }
 
-iqr_retval bob_start(const iqr_RNG *rng, bool dump)
+iqr_retval bob_precompute(const void *params, const iqr_RNG *rng, void **precomputed)
 {
+    iqr_FrodoDHResponderPrivateKey *key = NULL;
+    iqr_retval ret = iqr_FrodoDHCreateResponderPrivateKey(params, rng, &key);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_FrodoDHCreateResponderPrivateKey(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    *precomputed = key;
+    return IQR_OK;
+}
+
+void bob_discard_precomputed(void *precomputed)
+{
+    iqr_FrodoDHResponderPrivateKey *key = precomputed;
+    iqr_FrodoDHDestroyResponderPrivateKey(&key);
+}
+
+iqr_retval bob_start(bob_session *bob, comms_channel *comms, const iqr_RNG *rng, bool dump)
+{
+    if (bob == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (rng == NULL) {
         fprintf(stderr, "The RNG was null and we really need that RNG\n");
         return IQR_ENULLPTR;
@@ -67,35 +88,44 @@ iqr_retval bob_start(const iqr_RNG *rng, bool dump)
 
     uint8_t *responder_public_key = NULL;
 
+    /* Alice's key arrives in a slab, and Bob builds his reply in another one.
+     * Sending the reply hands its slab over; the other goes back at the end.
+     */
+    uint8_t *initiator_public_key = NULL;
     size_t initiator_size = IQR_FRODODH_INITIATOR_PUBLIC_KEY_SIZE;
-    uint8_t *initiator_public_key = calloc(1, initiator_size);
-    if (initiator_public_key == NULL) {
-        fprintf(stderr, "We seem to have run out of memory. ret=%d\n", errno);
-        return IQR_ENOMEM;
-    }
-
-    iqr_retval ret = receive_from_alice(initiator_public_key, initiator_size);
+    iqr_retval ret = receive_from_alice(comms, &initiator_public_key, initiator_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "We couldn't get the initiator key from Alice.\n");
         goto end;
     }
 
     size_t responder_size = IQR_FRODODH_RESPONDER_PUBLIC_KEY_SIZE;
-    responder_public_key = calloc(1, responder_size);
-    if (responder_public_key == NULL) {
-        fprintf(stderr, "Couldn't find more memory. ret=%d\n", errno);
-        ret = IQR_ENOMEM;
+    ret = comms_acquire(comms, &responder_public_key);
+    if (ret != IQR_OK) {
         goto end;
     }
 
-    ret = iqr_FrodoDHCreateResponderPrivateKey(params, rng, &responder_private_key);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_FrodoDHCreateResponderPrivateKey(): %s\n", iqr_StrError(ret));
-        goto end;
+    if (bob->pool != NULL) {
+        /* The private key was made ahead of time, so only the half of Bob's
+         * work that needs Alice's key is left.
+         */
+        void *precomputed = NULL;
+        ret = keypool_take(bob->pool, &precomputed);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on keypool_take(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+        bob->responder_private_key = precomputed;
+    } else {
+        ret = iqr_FrodoDHCreateResponderPrivateKey(bob->params, rng, &bob->responder_private_key);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_FrodoDHCreateResponderPrivateKey(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
     }
 
-    ret = iqr_FrodoDHGetResponderPublicKey(responder_private_key, rng, initiator_public_key, initiator_size, responder_public_key,
-        responder_size);
+    ret = iqr_FrodoDHGetResponderPublicKey(bob->responder_private_key, rng, initiator_public_key, initiator_size,
+        responder_public_key, responder_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_FrodoDHGetResponderPublicKey(): %s\n", iqr_StrError(ret));
         goto end;
@@ -108,19 +138,25 @@ iqr_retval bob_start(const iqr_RNG *rng, bool dump)
         }
     }
 
-    ret = send_to_alice(responder_public_key, responder_size);
+    ret = send_to_alice(comms, responder_public_key, responder_size);
+    responder_public_key = NULL;
 
 end:
     if (ret != IQR_OK) {
-        iqr_FrodoDHDestroyResponderPrivateKey(&responder_private_key);
+        iqr_FrodoDHDestroyResponderPrivateKey(&bob->responder_private_key);
     }
-    free(responder_public_key);
-    free(initiator_public_key);
+    comms_release(comms, responder_public_key);
+    comms_release(comms, initiator_public_key);
     return ret;
 }
 
-iqr_retval bob_get_secret(uint8_t *secret, size_t secret_size)
+iqr_retval bob_get_secret(bob_session *bob, uint8_t *secret, size_t secret_size)
 {
+    if (bob == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     iqr_retval ret = IQR_OK;
 
     if (secret == NULL || secret_size != IQR_FRODODH_SECRET_SIZE) {
@@ -129,20 +165,28 @@ iqr_retval bob_get_secret(uint8_t *secret, size_t secret_size)
         goto end;
     }
 
-    ret = iqr_FrodoDHGetResponderSecret(responder_private_key, secret, secret_size);
+    ret = iqr_FrodoDHGetResponderSecret(bob->responder_private_key, secret, secret_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_FrodoDHGetResponderSecret(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
 end:
-    iqr_FrodoDHDestroyResponderPrivateKey(&responder_private_key);
+    iqr_FrodoDHDestroyResponderPrivateKey(&bob->responder_private_key);
     return ret;
 }
 
-iqr_retval cleanup_bob(void)
+iqr_retval cleanup_bob(bob_session *bob)
 {
-    iqr_retval ret = iqr_FrodoDHDestroyParams(&params);
+    if (bob == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
+    /* A handshake that stopped part way can leave a private key behind. */
+    iqr_FrodoDHDestroyResponderPrivateKey(&bob->responder_private_key);
+
+    iqr_retval ret = iqr_FrodoDHDestroyParams(&bob->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_FrodoDHDestroyParams(): %s\n", iqr_StrError(ret));
     }
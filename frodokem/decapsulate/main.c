@@ -24,6 +24,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_frodokem.h"
@@ -134,24 +135,10 @@ static iqr_retval showcase_frodokem_params_creation(const iqr_Context *ctx, cons
 
 static iqr_retval init_toolkit(iqr_Context **ctx)
 {
-    /* Create a context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA3_256, IQR_HASHALGO_SHA3_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the SHA3-256 functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA3_256, &IQR_HASH_DEFAULT_SHA3_256);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the SHA3-512 functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA3_512, &IQR_HASH_DEFAULT_SHA3_512);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -268,7 +255,7 @@ int main(int argc, const char **argv)
 
 cleanup:
     iqr_FrodoKEMDestroyParams(&parameters);
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -18,18 +18,20 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_frodokem.h"
 #include "iqr_retval.h"
 #include "iqr_rng.h"
 #include "isara_samples.h"
+#include "kem_batch.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -38,11 +40,17 @@
 static const char *usage_msg =
 "frodokem_encapsulate [--variant AES|SHAKE] [--pub <filename>]\n"
 "  [--ciphertext <filename>] [--shared <filename>]\n"
+"frodokem_encapsulate [--variant AES|SHAKE] --batch <filename>\n"
+"  [--output <filename>] [--threads <count>]\n"
 "    Default for the sample (when no option is specified):\n"
 "        --variant AES\n"
 "        --pub pub.key\n"
 "        --ciphertext ciphertext.dat\n"
-"        --shared shared.key\n";
+"        --shared shared.key\n"
+"        --output batch.dat\n"
+"        --threads 0 (one per CPU)\n"
+"  --batch names a file listing one public key file per line; every\n"
+"  ciphertext and shared key is written to the --output file.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases FrodoKEM encapsulation.
@@ -125,37 +133,18 @@ static iqr_retval showcase_frodokem_params_creation(const iqr_Context *ctx, cons
 
 static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 {
-    /* Create a context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
     fprintf(stdout, "The context has been created.\n");
 
-    /* This sets the SHA2-256 functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
+    /* Create an HMAC DRBG object, seeded from the system's entropy source. */
+    ret = bootstrap_rng(IQR_HASHALGO_SHA2_256, rng);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This lets us give satisfactory randomness to the algorithm. */
-    ret =  iqr_RNGCreateHMACDRBG(*ctx, IQR_HASHALGO_SHA2_256, rng);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* The seed should be initialized from a guaranteed entropy source. This is
-     * only an example; DO NOT INITIALIZE THE SEED LIKE THIS.
-     */
-    time_t seed = time(NULL);
-
-    ret = iqr_RNGInitialize(*rng, (void *) &seed, sizeof(seed));
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -175,12 +164,18 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static void preamble(const char *cmd, const iqr_FrodoKEMVariant *variant, const char *pub, const char *cipher,
-    const char *sharedkey)
+    const char *sharedkey, const char *batch, const char *output, uint32_t threads)
 {
     fprintf(stdout, "Running %s with the following parameters:\n", cmd);
-    fprintf(stdout, "    public key file: %s\n", pub);
-    fprintf(stdout, "    ciphertext file: %s\n", cipher);
-    fprintf(stdout, "    shared key file: %s\n", sharedkey);
+    if (batch != NULL) {
+        fprintf(stdout, "    public key list: %s\n", batch);
+        fprintf(stdout, "    output file: %s\n", output);
+        fprintf(stdout, "    threads: %u\n", threads);
+    } else {
+        fprintf(stdout, "    public key file: %s\n", pub);
+        fprintf(stdout, "    ciphertext file: %s\n", cipher);
+        fprintf(stdout, "    shared key file: %s\n", sharedkey);
+    }
     if (variant == &IQR_FRODOKEM_976_AES) {
         fprintf(stdout, "    variant: AES\n");
     } else {
@@ -188,9 +183,31 @@ static void preamble(const char *cmd, const iqr_FrodoKEMVariant *variant, const
     }
 }
 
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
 /* Parse the command line options. */
-static iqr_retval parse_commandline(int argc, const char **argv, const iqr_FrodoKEMVariant **variant, const char **public_key_file,
-    const char **ciphertext_file, const char **sharedkey_file)
+static iqr_retval parse_commandline(int argc, const char **argv, const iqr_FrodoKEMVariant **variant,
+    const char **public_key_file, const char **ciphertext_file, const char **sharedkey_file, const char **batch_file,
+    const char **output_file, uint32_t *threads)
 {
     int i = 1;
     while (i != argc) {
@@ -206,6 +223,23 @@ static iqr_retval parse_commandline(int argc, const char **argv, const iqr_Frodo
             /* [--shared <filename>] */
             i++;
             *sharedkey_file = argv[i];
+        } else if (paramcmp(argv[i], "--batch") == 0) {
+            /* [--batch <filename>] */
+            i++;
+            *batch_file = argv[i];
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output_file = argv[i];
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)value;
         } else if (paramcmp(argv[i], "--variant") == 0) {
             /* [--variant AES|SHAKE] */
             i++;
@@ -239,6 +273,9 @@ int main(int argc, const char **argv)
     const char *public_key_file = "pub.key";
     const char *ciphertext_file = "ciphertext.dat";
     const char *sharedkey_file = "shared.key";
+    const char *batch_file = NULL;
+    const char *output_file = "batch.dat";
+    uint32_t threads = 0;
 
     iqr_Context * ctx = NULL;
     iqr_RNG *rng = NULL;
@@ -247,13 +284,14 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &variant, &public_key_file, &ciphertext_file, &sharedkey_file);
+    iqr_retval ret = parse_commandline(argc, argv, &variant, &public_key_file, &ciphertext_file, &sharedkey_file, &batch_file,
+        &output_file, &threads);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Show the parameters for the program. */
-    preamble(argv[0], variant, public_key_file, ciphertext_file, sharedkey_file);
+    preamble(argv[0], variant, public_key_file, ciphertext_file, sharedkey_file, batch_file, output_file, threads);
 
     /* IQR toolkit initialization. */
     ret = init_toolkit(&ctx, &rng);
@@ -267,12 +305,17 @@ int main(int argc, const char **argv)
         goto cleanup;
     }
 
-    /* Showcase FrodoKEM encapsulation. */
-    ret = showcase_frodokem_encapsulation(rng, parameters, public_key_file, ciphertext_file, sharedkey_file);
+    if (batch_file != NULL) {
+        /* Encapsulate to every public key in the list. */
+        const kem_scheme *kem = kem_find(variant == &IQR_FRODOKEM_976_AES ? "frodokem-aes" : "frodokem-shake");
+        ret = kem_encapsulate_batch(ctx, kem, parameters, IQR_HASHALGO_SHA2_256, batch_file, output_file, threads);
+    } else {
+        /* Showcase FrodoKEM encapsulation. */
+        ret = showcase_frodokem_encapsulation(rng, parameters, public_key_file, ciphertext_file, sharedkey_file);
+    }
 
 cleanup:
     iqr_FrodoKEMDestroyParams(&parameters);
-    iqr_RNGDestroy(&rng);
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
@@ -117,23 +118,10 @@ end:
     return ret;
 }
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash_alg, const iqr_HashCallbacks *cb)
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash_alg)
 {
-    /* Create an IQR Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, hash_alg, cb);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    return IQR_OK;
+    /* Create a context with the chosen hash function registered. */
+    return bootstrap_context(&hash_alg, 1, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -168,8 +156,7 @@ static void preamble(const char *cmd, iqr_HashAlgorithmType hash_alg, const char
     fprintf(stdout, "\n");
 }
 
-static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash_alg, const iqr_HashCallbacks **cb,
-    const char **message_file)
+static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash_alg, const char **message_file)
 {
     int i = 1;
     while (i != argc) {
@@ -184,19 +171,14 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             i++;
             if  (paramcmp(argv[i], "sha2-256") == 0) {
                 *hash_alg = IQR_HASHALGO_SHA2_256;
-                *cb = &IQR_HASH_DEFAULT_SHA2_256;
             } else if (paramcmp(argv[i], "sha2-384") == 0) {
                 *hash_alg = IQR_HASHALGO_SHA2_384;
-                *cb = &IQR_HASH_DEFAULT_SHA2_384;
             } else if (paramcmp(argv[i], "sha2-512") == 0) {
                 *hash_alg = IQR_HASHALGO_SHA2_512;
-                *cb = &IQR_HASH_DEFAULT_SHA2_512;
             } else if (paramcmp(argv[i], "sha3-256") == 0) {
                 *hash_alg = IQR_HASHALGO_SHA3_256;
-                *cb = &IQR_HASH_DEFAULT_SHA3_256;
             } else if (paramcmp(argv[i], "sha3-512") == 0) {
                 *hash_alg = IQR_HASHALGO_SHA3_512;
-                *cb = &IQR_HASH_DEFAULT_SHA3_512;
             } else {
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
@@ -223,14 +205,13 @@ int main(int argc, const char **argv)
      */
     const char *message_file = "message.dat";
     iqr_HashAlgorithmType hash_alg = IQR_HASHALGO_SHA2_512;
-    const iqr_HashCallbacks *cb = &IQR_HASH_DEFAULT_SHA2_512;
 
     iqr_Context *ctx = NULL;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &hash_alg, &cb, &message_file);
+    iqr_retval ret = parse_commandline(argc, argv, &hash_alg, &message_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
@@ -239,7 +220,7 @@ int main(int argc, const char **argv)
     preamble(argv[0], hash_alg, message_file);
 
     /* IQR initialization that is not specific to hashing. */
-    ret = init_toolkit(&ctx, hash_alg, cb);
+    ret = init_toolkit(&ctx, hash_alg);
     if (ret != IQR_OK) {
         goto cleanup;
     }
@@ -248,6 +229,6 @@ int main(int argc, const char **argv)
     ret = showcase_hash(ctx, hash_alg, message_file);
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_mac.h"
@@ -169,23 +170,10 @@ end:
 // HMAC.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb)
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash)
 {
-    /* Create a Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, hash, cb);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    return IQR_OK;
+    /* Create a context with the chosen hash function registered. */
+    return bootstrap_context(&hash, 1, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -230,7 +218,7 @@ static void preamble(const char *cmd, iqr_HashAlgorithmType hash, const uint8_t
     fprintf(stdout, "\n");
 }
 
-static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash, const iqr_HashCallbacks **cb,
+static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash,
     const uint8_t **key, const char **key_file, bool *default_key, struct file_list **files, const char **tag_file)
 {
     int i = 1;
@@ -273,19 +261,14 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             i++;
             if (paramcmp(argv[i], "sha2-256") == 0) {
                 *hash = IQR_HASHALGO_SHA2_256;
-                *cb = &IQR_HASH_DEFAULT_SHA2_256;
             } else if (paramcmp(argv[i], "sha2-384") == 0) {
                 *hash = IQR_HASHALGO_SHA2_384;
-                *cb = &IQR_HASH_DEFAULT_SHA2_384;
             } else if (paramcmp(argv[i], "sha2-512") == 0) {
                 *hash = IQR_HASHALGO_SHA2_512;
-                *cb = &IQR_HASH_DEFAULT_SHA2_512;
             } else if (paramcmp(argv[i], "sha3-256") == 0) {
                 *hash = IQR_HASHALGO_SHA3_256;
-                *cb = &IQR_HASH_DEFAULT_SHA3_256;
             } else if (paramcmp(argv[i], "sha3-512") == 0) {
                 *hash = IQR_HASHALGO_SHA3_512;
-                *cb = &IQR_HASH_DEFAULT_SHA3_512;
             } else {
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
@@ -334,7 +317,6 @@ int main(int argc, const char **argv)
      * here.
      */
     iqr_HashAlgorithmType hash = IQR_HASHALGO_SHA2_256;
-    const iqr_HashCallbacks *cb = &IQR_HASH_DEFAULT_SHA2_256;
     const uint8_t *key = (const uint8_t *)"*********ISARA-HMAC-KEY*********";
     const uint8_t *key_48 = (const uint8_t *)"*********ISARA-HMAC-KEY-FOR-384-BIT-SHA*********";
     const uint8_t *key_64 = (const uint8_t *)"*****************ISARA-HMAC-KEY-FOR-512-BIT-SHA*****************";
@@ -347,7 +329,7 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &key, &key_file, &default_key, &files, &tag_file);
+    iqr_retval ret = parse_commandline(argc, argv, &hash, &key, &key_file, &default_key, &files, &tag_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
@@ -366,7 +348,7 @@ int main(int argc, const char **argv)
     /* IQR initialization that is not specific to HMAC. */
     iqr_Context *ctx = NULL;
     uint8_t *loaded_key = NULL;
-    ret = init_toolkit(&ctx, hash, cb);
+    ret = init_toolkit(&ctx, hash);
     if (ret != IQR_OK) {
         goto cleanup;
     }
@@ -405,7 +387,7 @@ cleanup:
     }
     files = NULL;
 
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -22,11 +22,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_hss.h"
 #include "iqr_retval.h"
 #include "isara_samples.h"
+#include "merkle_batch.h"
+#include "verify_cache.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -35,7 +38,8 @@
 static const char *usage_msg =
 "hss_verify [--sig <filename>] [--pub <filename>]\n"
 "  [--variant 2e20f|2e25f|2e30f|2e45f|2e65f|2e20s|2e25s|2e30s|2e45s|2e65s]\n"
-"  [--message <filename>]\n"
+"  [--message <filename>] [--proof <filename>]\n"
+"  [--cache <filename> --cache-key <filename>]\n"
 "\n"
 "  The 'f' variants are Fast, the 's' variants are Small.\n"
 "\n"
@@ -43,7 +47,12 @@ static const char *usage_msg =
 "        --sig sig.dat\n"
 "        --pub pub.key\n"
 "        --variant 2e30f\n"
-"        --message message.dat\n";
+"        --message message.dat\n"
+"  --cache names a verify cache file; a signature found in it was verified\n"
+"  before and isn't checked again. --cache-key names the file holding the\n"
+"  cache's secret HMAC key (at least 32 bytes).\n"
+"  --proof names the message's inclusion proof from a batch signed with\n"
+"  hss_sign --batch; the signature is the batch's signature.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases the verification of an HSS signature against a
@@ -51,7 +60,7 @@ static const char *usage_msg =
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static iqr_retval showcase_hss_verify(const iqr_Context *ctx, const iqr_HSSVariant *variant, const uint8_t *digest,
-    const char *pub_file, const char *sig_file)
+    const char *pub_file, const char *sig_file, verify_cache *cache)
 {
     iqr_HSSParams *params = NULL;
     iqr_HSSPublicKey *pub = NULL;
@@ -62,6 +71,9 @@ static iqr_retval showcase_hss_verify(const iqr_Context *ctx, const iqr_HSSVaria
     size_t sig_size = 0;
     uint8_t *sig = NULL;
 
+    verify_cache_id cache_id;
+    memset(&cache_id, 0, sizeof(cache_id));
+
     /* The tree strategy chosen will have no effect on verification. */
     iqr_retval ret = iqr_HSSCreateParams(ctx, &IQR_HSS_VERIFY_ONLY_STRATEGY, variant, &params);
     if (ret != IQR_OK) {
@@ -80,6 +92,21 @@ static iqr_retval showcase_hss_verify(const iqr_Context *ctx, const iqr_HSSVaria
         goto end;
     }
 
+    /* A signature that verified on an earlier run is in the cache, so the
+     * toolkit doesn't need to check it again.
+     */
+    if (cache != NULL) {
+        ret = verify_cache_make_id(cache, "hss", pub_raw, pub_raw_size, digest, IQR_SHA2_512_DIGEST_SIZE, sig, sig_size,
+            &cache_id);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        if (verify_cache_lookup(cache, &cache_id)) {
+            fprintf(stdout, "Found the HSS signature in the verify cache; it was verified before.\n");
+            goto end;
+        }
+    }
+
     /* Import the public key data and create a public key object. */
     ret = iqr_HSSImportPublicKey(params, pub_raw, pub_raw_size, &pub);
     if (ret != IQR_OK) {
@@ -92,6 +119,9 @@ static iqr_retval showcase_hss_verify(const iqr_Context *ctx, const iqr_HSSVaria
     ret = iqr_HSSVerify(pub, digest, IQR_SHA2_512_DIGEST_SIZE, sig, sig_size);
     if (ret == IQR_OK) {
         fprintf(stdout, "HSS verified the signature successfully!\n");
+        if (cache != NULL) {
+            ret = verify_cache_add(cache, &cache_id);
+        }
     } else {
         fprintf(stderr, "Failed on iqr_HSSVerify(): %s\n", iqr_StrError(ret));
     }
@@ -144,24 +174,10 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
     uint8_t *message_raw = NULL;
     size_t message_raw_size = 0;
 
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256, IQR_HASHALGO_SHA2_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* SHA2-512 is used on the message before signing in the hss_sign sample. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_512, &IQR_HASH_DEFAULT_SHA2_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -170,6 +186,11 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
     if (ret != IQR_OK) {
         return ret;
     }
+    if (merkle_is_stand_in(message_raw, message_raw_size)) {
+        fprintf(stderr, "%s starts like a Merkle batch's signed message; it can't be verified on its own.\n", message);
+        free(message_raw);
+        return IQR_EINVDATA;
+    }
 
     *digest = calloc(1, IQR_SHA2_512_DIGEST_SIZE);
     if (*digest == NULL) {
@@ -202,7 +223,7 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static void preamble(const char *cmd, const char *sig, const char *pub, const iqr_HSSVariant *variant,
-    const char *message)
+    const char *message, const char *proof_file, const char *cache_file)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     fprintf(stdout, "    signature file: %s\n", sig);
@@ -233,11 +254,17 @@ static void preamble(const char *cmd, const char *sig, const char *pub, const iq
     }
 
     fprintf(stdout, "    message data file: %s\n", message);
+    if (proof_file != NULL) {
+        fprintf(stdout, "    inclusion proof file: %s\n", proof_file);
+    }
+    if (cache_file != NULL) {
+        fprintf(stdout, "    verify cache: %s\n", cache_file);
+    }
     fprintf(stdout, "\n");
 }
 
 static iqr_retval parse_commandline(int argc, const char **argv, const char **sig, const char **pub, const iqr_HSSVariant **variant,
-    const char **message)
+    const char **message, const char **proof_file, const char **cache_file, const char **cache_key_file)
 {
     int i = 1;
     while (i != argc) {
@@ -284,10 +311,29 @@ static iqr_retval parse_commandline(int argc, const char **argv, const char **si
            /* [--message <filename>] */
            i++;
            *message = argv[i];
+        } else if (paramcmp(argv[i], "--proof") == 0) {
+            /* [--proof <filename>] */
+            i++;
+            *proof_file = argv[i];
+        } else if (paramcmp(argv[i], "--cache") == 0) {
+            /* [--cache <filename>] */
+            i++;
+            *cache_file = argv[i];
+        } else if (paramcmp(argv[i], "--cache-key") == 0) {
+            /* [--cache-key <filename>] */
+            i++;
+            *cache_key_file = argv[i];
         }
 
         i++;
     }
+
+    /* The cache and its key go together. */
+    if ((*cache_file == NULL) != (*cache_key_file == NULL)) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
     return IQR_OK;
 }
 
@@ -302,21 +348,25 @@ int main(int argc, const char **argv)
     const char *sig = "sig.dat";
     const char *pub = "pub.key";
     const char *message = "message.dat";
+    const char *proof_file = NULL;
+    const char *cache_file = NULL;
+    const char *cache_key_file = NULL;
     const iqr_HSSVariant *variant = &IQR_HSS_2E30_FAST;
 
     iqr_Context *ctx = NULL;
+    verify_cache *cache = NULL;
     uint8_t *digest = NULL;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &sig, &pub, &variant, &message);
+    iqr_retval ret = parse_commandline(argc, argv, &sig, &pub, &variant, &message, &proof_file, &cache_file, &cache_key_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], sig, pub, variant, message);
+    preamble(argv[0], sig, pub, variant, message, proof_file, cache_file);
 
     /* IQR initialization that is not specific to HSS. */
     ret = init_toolkit(&ctx, message, &digest);
@@ -324,12 +374,32 @@ int main(int argc, const char **argv)
         goto cleanup;
     }
 
+    /* A message from a batch is covered by a signature over a digest of
+     * the batch's Merkle tree; its inclusion proof leads from the
+     * message's digest to that digest.
+     */
+    if (proof_file != NULL) {
+        ret = merkle_proof_signed_digest(ctx, digest, proof_file, digest);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
+    /* Signatures that verified on an earlier run skip the toolkit. */
+    if (cache_file != NULL) {
+        ret = verify_cache_open(ctx, cache_file, cache_key_file, VERIFY_CACHE_DEFAULT_SLOTS, &cache);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
     /* This function showcases the usage of HSS signature verification.
      */
-    ret = showcase_hss_verify(ctx, variant, digest, pub, sig);
+    ret = showcase_hss_verify(ctx, variant, digest, pub, sig, cache);
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    verify_cache_close(&cache);
+    bootstrap_release();
     free(digest);
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
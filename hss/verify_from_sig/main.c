@@ -23,11 +23,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_hss.h"
 #include "iqr_retval.h"
 #include "isara_samples.h"
+#include "merkle_batch.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -142,24 +144,10 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
     uint8_t *message_raw = NULL;
     size_t message_raw_size = 0;
 
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256, IQR_HASHALGO_SHA2_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* SHA2-512 is used on the message before signing in the hss_sign sample. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_512, &IQR_HASH_DEFAULT_SHA2_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -168,6 +156,11 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
     if (ret != IQR_OK) {
         return ret;
     }
+    if (merkle_is_stand_in(message_raw, message_raw_size)) {
+        fprintf(stderr, "%s starts like a Merkle batch's signed message; it can't be verified on its own.\n", message);
+        free(message_raw);
+        return IQR_EINVDATA;
+    }
 
     *digest = calloc(1, IQR_SHA2_512_DIGEST_SIZE);
     if (*digest == NULL) {
@@ -273,7 +266,7 @@ int main(int argc, const char **argv)
     ret = showcase_hss_verify_from_sig(ctx, digest, pub, sig);
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     free(digest);
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,656 @@
+/** @file main.c
+ *
+ * @brief Combine a classical key agreement and a post-quantum KEM into one
+ * hybrid session key, entirely in memory.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_kdf.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "kem_table.h"
+#include "latency.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"hybrid_kem [--kem <kem>] [--bench <count>]\n"
+"    <kem> is one of kyber-128, kyber-224, frodokem-aes, frodokem-shake,\n"
+"    ntruprime, sike-p503, sike-p751, classicmceliece-6 or\n"
+"    classicmceliece-8.\n"
+"    Defaults are: \n"
+"        --kem kyber-128\n"
+"  Generates a hybrid key pair, encapsulates a session key to it and\n"
+"  decapsulates it again, all in memory. With --bench, times <count>\n"
+"  hybrid encapsulations and decapsulations instead.\n";
+
+/* Sizes of the classical stand-in's keys and secret; the same as X25519's. */
+#define CLASSICAL_KEY_SIZE 32
+#define CLASSICAL_SECRET_SIZE 32
+
+/* The largest shared key any of the KEMs produces. */
+#define MAX_KEM_SHARED_KEY_SIZE 64
+
+#define SESSION_KEY_SIZE 32
+
+/* Goes in front of everything the KDF binds the session key to, so a key
+ * derived here can't be mistaken for one derived for another purpose.
+ */
+static const uint8_t hybrid_label[] = { 'h', 'y', 'b', 'r', 'i', 'd', '-', 'k', 'e', 'm', '-', 'v', '1' };
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The classical half: a stand-in for ECDH.
+//
+// The toolkit doesn't do elliptic curves, so this stand-in only has X25519's
+// shape: 32-byte keys and a 32-byte secret that both sides compute from their
+// own key and the other side's public key. Anyone who sees both public keys
+// can compute its secret too! Swap in X25519 from your TLS library before
+// using this for anything real. Until then the session key is exactly as
+// strong as the KEM.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval classical_create_key_pair(const iqr_RNG *rng, iqr_Hash *sha256, uint8_t *priv, uint8_t *pub)
+{
+    iqr_retval ret = iqr_RNGGetBytes(rng, priv, CLASSICAL_KEY_SIZE);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGGetBytes(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    ret = iqr_HashMessage(sha256, priv, CLASSICAL_KEY_SIZE, pub, CLASSICAL_KEY_SIZE);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashMessage(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+static iqr_retval classical_agree(iqr_Hash *sha256, const uint8_t *priv, const uint8_t *own_pub, const uint8_t *peer_pub,
+    uint8_t *secret)
+{
+    /* Real ECDH would multiply the peer's public key by our private key. */
+    (void)priv;
+
+    /* Hash the public keys in a fixed order so both sides agree. */
+    const bool own_first = memcmp(own_pub, peer_pub, CLASSICAL_KEY_SIZE) < 0;
+    iqr_retval ret = iqr_HashBegin(sha256);
+    if (ret == IQR_OK) {
+        ret = iqr_HashUpdate(sha256, own_first ? own_pub : peer_pub, CLASSICAL_KEY_SIZE);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashUpdate(sha256, own_first ? peer_pub : own_pub, CLASSICAL_KEY_SIZE);
+    }
+    if (ret == IQR_OK) {
+        ret = iqr_HashEnd(sha256, secret, CLASSICAL_SECRET_SIZE);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_Hash*(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The hybrid KEM.
+//
+// The session key comes from a single Concatenation KDF pass:
+//
+//     secret = classical secret || KEM shared key
+//     info   = label || responder's classical public key ||
+//              hybrid ciphertext
+//     hybrid ciphertext = initiator's classical public key || KEM ciphertext
+//
+// An attacker has to break both halves to learn the secret, and binding the
+// whole exchange into the info means neither half can be swapped out.
+//
+// The info is laid out in one transcript buffer with the hybrid ciphertext at
+// its end. The initiator builds the ciphertext in place and the responder
+// receives it in place, so the KDF reads it without anything being copied.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Where the hybrid ciphertext starts in the transcript. */
+#define CIPHERTEXT_OFFSET (sizeof(hybrid_label) + CLASSICAL_KEY_SIZE)
+
+typedef struct {
+    const iqr_Context *ctx;
+    const kem_scheme *kem;
+    void *params;
+    kem_sizes sizes;
+    /** For the classical stand-in. */
+    iqr_Hash *sha256;
+} hybrid_scheme;
+
+typedef struct {
+    void *kem_pub;
+    uint8_t classical_pub[CLASSICAL_KEY_SIZE];
+} hybrid_public_key;
+
+typedef struct {
+    void *kem_priv;
+    uint8_t classical_priv[CLASSICAL_KEY_SIZE];
+    uint8_t classical_pub[CLASSICAL_KEY_SIZE];
+} hybrid_private_key;
+
+/* Where the time goes in one hybrid operation; NULL when nobody's asking. */
+typedef struct {
+    uint64_t classical_ns;
+    uint64_t kem_ns;
+    uint64_t kdf_ns;
+} hybrid_timing;
+
+static size_t hybrid_ciphertext_size(const hybrid_scheme *h)
+{
+    return CLASSICAL_KEY_SIZE + h->sizes.ciphertext;
+}
+
+static size_t hybrid_transcript_size(const hybrid_scheme *h)
+{
+    return CIPHERTEXT_OFFSET + hybrid_ciphertext_size(h);
+}
+
+static iqr_retval derive_session_key(const hybrid_scheme *h, const uint8_t *secret, const uint8_t *transcript,
+    uint8_t *session_key)
+{
+    iqr_retval ret = iqr_ConcatenationKDFDeriveKey(h->ctx, IQR_HASHALGO_SHA2_256, secret,
+        CLASSICAL_SECRET_SIZE + h->sizes.shared_key, transcript, hybrid_transcript_size(h), session_key, SESSION_KEY_SIZE);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_ConcatenationKDFDeriveKey(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+static iqr_retval hybrid_create_key_pair(const hybrid_scheme *h, const iqr_RNG *rng, hybrid_public_key *pub,
+    hybrid_private_key *priv)
+{
+    iqr_retval ret = h->kem->create_key_pair(h->params, rng, &pub->kem_pub, &priv->kem_priv);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = classical_create_key_pair(rng, h->sha256, priv->classical_priv, priv->classical_pub);
+    if (ret == IQR_OK) {
+        memcpy(pub->classical_pub, priv->classical_pub, CLASSICAL_KEY_SIZE);
+    }
+    return ret;
+}
+
+static void hybrid_destroy_keys(const hybrid_scheme *h, hybrid_public_key *pub, hybrid_private_key *priv)
+{
+    if (pub->kem_pub != NULL) {
+        h->kem->destroy_public_key(&pub->kem_pub);
+    }
+    if (priv->kem_priv != NULL) {
+        h->kem->destroy_private_key(&priv->kem_priv);
+    }
+    secure_memzero(priv->classical_priv, sizeof(priv->classical_priv));
+}
+
+/* Fill the transcript and derive the session key. The hybrid ciphertext to
+ * send is at transcript + CIPHERTEXT_OFFSET.
+ */
+static iqr_retval hybrid_encapsulate(const hybrid_scheme *h, const iqr_RNG *rng, const hybrid_public_key *pub,
+    uint8_t *transcript, uint8_t *session_key, hybrid_timing *timing)
+{
+    uint8_t classical_priv[CLASSICAL_KEY_SIZE] = { 0 };
+    uint8_t secret[CLASSICAL_SECRET_SIZE + MAX_KEM_SHARED_KEY_SIZE] = { 0 };
+
+    uint8_t *responder_pub = transcript + sizeof(hybrid_label);
+    uint8_t *initiator_pub = transcript + CIPHERTEXT_OFFSET;
+    uint8_t *kem_ciphertext = initiator_pub + CLASSICAL_KEY_SIZE;
+
+    memcpy(transcript, hybrid_label, sizeof(hybrid_label));
+    memcpy(responder_pub, pub->classical_pub, CLASSICAL_KEY_SIZE);
+
+    /* An ephemeral classical key, agreed with the responder's static one. */
+    const uint64_t t0 = time_now_ns();
+    iqr_retval ret = classical_create_key_pair(rng, h->sha256, classical_priv, initiator_pub);
+    if (ret == IQR_OK) {
+        ret = classical_agree(h->sha256, classical_priv, initiator_pub, pub->classical_pub, secret);
+    }
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint64_t t1 = time_now_ns();
+    ret = h->kem->encapsulate(pub->kem_pub, rng, kem_ciphertext, h->sizes.ciphertext, secret + CLASSICAL_SECRET_SIZE,
+        h->sizes.shared_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint64_t t2 = time_now_ns();
+    ret = derive_session_key(h, secret, transcript, session_key);
+    const uint64_t t3 = time_now_ns();
+
+    if (timing != NULL) {
+        timing->classical_ns += t1 - t0;
+        timing->kem_ns += t2 - t1;
+        timing->kdf_ns += t3 - t2;
+    }
+
+end:
+    secure_memzero(classical_priv, sizeof(classical_priv));
+    secure_memzero(secret, sizeof(secret));
+    return ret;
+}
+
+/* The hybrid ciphertext must already be at transcript + CIPHERTEXT_OFFSET;
+ * receive it straight into the transcript.
+ */
+static iqr_retval hybrid_decapsulate(const hybrid_scheme *h, const hybrid_private_key *priv, uint8_t *transcript,
+    uint8_t *session_key, hybrid_timing *timing)
+{
+    uint8_t secret[CLASSICAL_SECRET_SIZE + MAX_KEM_SHARED_KEY_SIZE] = { 0 };
+
+    const uint8_t *initiator_pub = transcript + CIPHERTEXT_OFFSET;
+    const uint8_t *kem_ciphertext = initiator_pub + CLASSICAL_KEY_SIZE;
+
+    memcpy(transcript, hybrid_label, sizeof(hybrid_label));
+    memcpy(transcript + sizeof(hybrid_label), priv->classical_pub, CLASSICAL_KEY_SIZE);
+
+    const uint64_t t0 = time_now_ns();
+    iqr_retval ret = classical_agree(h->sha256, priv->classical_priv, priv->classical_pub, initiator_pub, secret);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint64_t t1 = time_now_ns();
+    ret = h->kem->decapsulate(priv->kem_priv, kem_ciphertext, h->sizes.ciphertext, secret + CLASSICAL_SECRET_SIZE,
+        h->sizes.shared_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint64_t t2 = time_now_ns();
+    ret = derive_session_key(h, secret, transcript, session_key);
+    const uint64_t t3 = time_now_ns();
+
+    if (timing != NULL) {
+        timing->classical_ns += t1 - t0;
+        timing->kem_ns += t2 - t1;
+        timing->kdf_ns += t3 - t2;
+    }
+
+end:
+    secure_memzero(secret, sizeof(secret));
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This function showcases a hybrid key exchange.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval showcase_hybrid_kem(const hybrid_scheme *h, const iqr_RNG *rng)
+{
+    hybrid_public_key pub;
+    hybrid_private_key priv;
+    memset(&pub, 0, sizeof(pub));
+    memset(&priv, 0, sizeof(priv));
+    uint8_t initiator_key[SESSION_KEY_SIZE] = { 0 };
+    uint8_t responder_key[SESSION_KEY_SIZE] = { 0 };
+
+    /* The initiator's and responder's transcripts; in a real exchange they'd
+     * be on different machines.
+     */
+    uint8_t *sent = calloc(1, hybrid_transcript_size(h));
+    uint8_t *received = calloc(1, hybrid_transcript_size(h));
+    if (sent == NULL || received == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(sent);
+        free(received);
+        return IQR_ENOMEM;
+    }
+
+    /* The responder's static key pair. */
+    iqr_retval ret = hybrid_create_key_pair(h, rng, &pub, &priv);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    fprintf(stdout, "The responder's hybrid key pair has been created.\n");
+
+    ret = hybrid_encapsulate(h, rng, &pub, sent, initiator_key, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    fprintf(stdout, "The initiator has encapsulated a session key.\n");
+
+    /* Stand in for the network: the ciphertext lands in the responder's
+     * transcript.
+     */
+    memcpy(received + CIPHERTEXT_OFFSET, sent + CIPHERTEXT_OFFSET, hybrid_ciphertext_size(h));
+
+    ret = hybrid_decapsulate(h, &priv, received, responder_key, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    fprintf(stdout, "The responder has decapsulated the session key.\n\n");
+
+    fprintf(stdout, "Hybrid public key: %zu bytes (%zu classical + %zu %s).\n", CLASSICAL_KEY_SIZE + h->sizes.public_key,
+        (size_t)CLASSICAL_KEY_SIZE, h->sizes.public_key, h->kem->name);
+    fprintf(stdout, "Hybrid ciphertext: %zu bytes (%zu classical + %zu %s).\n", hybrid_ciphertext_size(h),
+        (size_t)CLASSICAL_KEY_SIZE, h->sizes.ciphertext, h->kem->name);
+
+    if (memcmp(initiator_key, responder_key, SESSION_KEY_SIZE) == 0) {
+        fprintf(stdout, "\nThe initiator's and responder's session keys match.\n\n");
+    } else {
+        fprintf(stdout, "\nThe initiator's and responder's session keys do NOT match.\n\n");
+        ret = IQR_EINVDATA;
+    }
+
+end:
+    /* These keys are private, sensitive data, be sure to clear memory
+     * containing them when you're done.
+     */
+    secure_memzero(initiator_key, sizeof(initiator_key));
+    secure_memzero(responder_key, sizeof(responder_key));
+    hybrid_destroy_keys(h, &pub, &priv);
+    free(sent);
+    free(received);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmark the whole hybrid exchange.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void report_breakdown(const char *side, const hybrid_timing *timing, uint32_t count)
+{
+    const double total = (double)(timing->classical_ns + timing->kem_ns + timing->kdf_ns);
+    if (total <= 0) {
+        return;
+    }
+
+    fprintf(stdout, "%s mean in microseconds: classical %.2f (%.0f%%), KEM %.2f (%.0f%%), KDF %.2f (%.0f%%)\n", side,
+        (double)timing->classical_ns / count / 1e3, 100.0 * (double)timing->classical_ns / total,
+        (double)timing->kem_ns / count / 1e3, 100.0 * (double)timing->kem_ns / total,
+        (double)timing->kdf_ns / count / 1e3, 100.0 * (double)timing->kdf_ns / total);
+}
+
+static iqr_retval bench_hybrid_kem(const hybrid_scheme *h, const iqr_RNG *rng, uint32_t count)
+{
+    hybrid_public_key pub;
+    hybrid_private_key priv;
+    memset(&pub, 0, sizeof(pub));
+    memset(&priv, 0, sizeof(priv));
+    hybrid_timing encap_timing;
+    hybrid_timing decap_timing;
+    memset(&encap_timing, 0, sizeof(encap_timing));
+    memset(&decap_timing, 0, sizeof(decap_timing));
+    uint8_t initiator_key[SESSION_KEY_SIZE] = { 0 };
+    uint8_t responder_key[SESSION_KEY_SIZE] = { 0 };
+
+    /* The histograms are large, so keep them off the stack. */
+    latency_histogram *latency = calloc(3, sizeof(*latency));
+    uint8_t *sent = calloc(1, hybrid_transcript_size(h));
+    uint8_t *received = calloc(1, hybrid_transcript_size(h));
+    if (latency == NULL || sent == NULL || received == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(latency);
+        free(sent);
+        free(received);
+        return IQR_ENOMEM;
+    }
+    latency_reset(&latency[0]);
+    latency_reset(&latency[1]);
+    latency_reset(&latency[2]);
+
+    /* Like a server, the responder keeps one static key pair. */
+    iqr_retval ret = hybrid_create_key_pair(h, rng, &pub, &priv);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint64_t start = time_now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        const uint64_t t0 = time_now_ns();
+        ret = hybrid_encapsulate(h, rng, &pub, sent, initiator_key, &encap_timing);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        const uint64_t t1 = time_now_ns();
+
+        /* Not timed: this is the network's job. */
+        memcpy(received + CIPHERTEXT_OFFSET, sent + CIPHERTEXT_OFFSET, hybrid_ciphertext_size(h));
+
+        const uint64_t t2 = time_now_ns();
+        ret = hybrid_decapsulate(h, &priv, received, responder_key, &decap_timing);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        const uint64_t t3 = time_now_ns();
+
+        latency_record(&latency[0], t1 - t0);
+        latency_record(&latency[1], t3 - t2);
+        latency_record(&latency[2], (t1 - t0) + (t3 - t2));
+
+        if (memcmp(initiator_key, responder_key, SESSION_KEY_SIZE) != 0) {
+            fprintf(stderr, "The initiator's and responder's session keys do NOT match.\n");
+            ret = IQR_EINVDATA;
+            goto end;
+        }
+    }
+    const double seconds = (double)(time_now_ns() - start) / 1e9;
+
+    fprintf(stdout, "%u hybrid exchanges with %s in %.3f s, %.1f exchanges/sec.\n\n", count, h->kem->name, seconds,
+        (seconds > 0) ? (double)count / seconds : 0.0);
+    latency_print(stdout, "Encapsulate", &latency[0]);
+    latency_print(stdout, "Decapsulate", &latency[1]);
+    latency_print(stdout, "Total hybrid latency", &latency[2]);
+    fprintf(stdout, "\n");
+    report_breakdown("Encapsulate", &encap_timing, count);
+    report_breakdown("Decapsulate", &decap_timing, count);
+    fprintf(stdout, "\n");
+
+end:
+    secure_memzero(initiator_key, sizeof(initiator_key));
+    secure_memzero(responder_key, sizeof(responder_key));
+    hybrid_destroy_keys(h, &pub, &priv);
+    free(latency);
+    free(sent);
+    free(received);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// the hybrid KEM.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const kem_scheme *kem, iqr_RNG **rng)
+{
+    /* The KEM's hashes, plus SHA2-256 for the DRBG, the KDF and the
+     * classical stand-in.
+     */
+    iqr_retval ret = kem_bootstrap_context(kem, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* This lets us give satisfactory randomness to the algorithm. */
+    return bootstrap_rng(IQR_HASHALGO_SHA2_256, rng);
+}
+
+static iqr_retval init_hybrid(const iqr_Context *ctx, const kem_scheme *kem, hybrid_scheme *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->ctx = ctx;
+    h->kem = kem;
+
+    iqr_retval ret = kem->create_params(ctx, &h->params);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    ret = kem->get_sizes(h->params, &h->sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    if (h->sizes.shared_key > MAX_KEM_SHARED_KEY_SIZE) {
+        fprintf(stderr, "The KEM's shared key is too big.\n");
+        return IQR_EINVBUFSIZE;
+    }
+
+    ret = iqr_HashCreate(ctx, IQR_HASHALGO_SHA2_256, &h->sha256);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+    }
+    return ret;
+}
+
+static void cleanup_hybrid(hybrid_scheme *h)
+{
+    iqr_HashDestroy(&h->sha256);
+    if (h->params != NULL) {
+        h->kem->destroy_params(&h->params);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+static void preamble(const char *cmd, const kem_scheme *kem, uint32_t bench)
+{
+    fprintf(stdout, "Running %s with the following parameters...\n", cmd);
+    fprintf(stdout, "    Classical: ECDH stand-in (NOT secure; see the README)\n");
+    fprintf(stdout, "    KEM: %s\n", kem->name);
+    fprintf(stdout, "    KDF: Concatenation KDF with SHA2-256\n");
+    if (bench > 0) {
+        fprintf(stdout, "    Benchmark: %u exchanges\n", bench);
+    }
+    fprintf(stdout, "\n");
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, const kem_scheme **kem, uint32_t *bench)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--kem") == 0) {
+            /* [--kem <kem>] */
+            i++;
+            *kem = kem_find(argv[i]);
+            if (*kem == NULL) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--bench") == 0) {
+            /* [--bench <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *bench = (uint32_t)value;
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    const kem_scheme *kem = kem_find("kyber-128");
+    uint32_t bench = 0;
+
+    iqr_Context *ctx = NULL;
+    iqr_RNG *rng = NULL;
+    hybrid_scheme h;
+    memset(&h, 0, sizeof(h));
+
+    /* If the command line arguments were not sane, this function will exit
+     * the program.
+     */
+    iqr_retval ret = parse_commandline(argc, argv, &kem, &bench);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    preamble(argv[0], kem, bench);
+
+    ret = init_toolkit(&ctx, kem, &rng);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    ret = init_hybrid(ctx, kem, &h);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    if (bench > 0) {
+        ret = bench_hybrid_kem(&h, rng, bench);
+    } else {
+        ret = showcase_hybrid_kem(&h, rng);
+    }
+
+cleanup:
+    cleanup_hybrid(&h);
+    bootstrap_release();
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
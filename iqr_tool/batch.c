@@ -0,0 +1,881 @@
+/** @file batch.c
+ *
+ * @brief Run a script of sample operations in one process.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batch.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_mac.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "kem_table.h"
+#include "key_cache.h"
+#include "merkle_batch.h"
+#include "prehash.h"
+#include "sig_table.h"
+
+/* Keys kept per scheme, for public and private keys separately. */
+#define BATCH_KEY_CACHE_SIZE 64
+
+/* Most words on a line: the command and four arguments. */
+#define BATCH_MAX_WORDS 5
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Shared state.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const char *name;
+    iqr_HashAlgorithmType alg;
+    size_t digest_size;
+} batch_hash;
+
+static const batch_hash hashes[] = {
+    { "sha2-256", IQR_HASHALGO_SHA2_256, IQR_SHA2_256_DIGEST_SIZE },
+    { "sha2-384", IQR_HASHALGO_SHA2_384, IQR_SHA2_384_DIGEST_SIZE },
+    { "sha2-512", IQR_HASHALGO_SHA2_512, IQR_SHA2_512_DIGEST_SIZE },
+    { "sha3-256", IQR_HASHALGO_SHA3_256, IQR_SHA3_256_DIGEST_SIZE },
+    { "sha3-512", IQR_HASHALGO_SHA3_512, IQR_SHA3_512_DIGEST_SIZE },
+};
+
+#define HASH_COUNT (sizeof(hashes) / sizeof(hashes[0]))
+
+/* Largest digest in hashes[]. */
+#define BATCH_MAX_DIGEST IQR_SHA2_512_DIGEST_SIZE
+
+/* Index of SHA2-512 in hashes[]; the stateful schemes sign its digest. */
+#define BATCH_SHA2_512 2
+
+/* A KEM or signature scheme that a command has used. */
+typedef struct {
+    void *params;
+    key_cache *pubs;
+    key_cache *privs;
+} batch_scheme;
+
+typedef struct {
+    iqr_Context *ctx;
+    iqr_RNG *rng;
+
+    iqr_Hash *hash[HASH_COUNT];
+    iqr_MAC *hmac[HASH_COUNT];
+
+    /* Indexed like kem_schemes and sig_schemes. */
+    batch_scheme *kems;
+    batch_scheme *sigs;
+} batch_state;
+
+static bool find_hash(const char *name, size_t *index)
+{
+    for (size_t i = 0; i < HASH_COUNT; i++) {
+        if (paramcmp(name, hashes[i].name) == 0) {
+            *index = i;
+            return true;
+        }
+    }
+    fprintf(stderr, "Unknown hash: %s\n", name);
+    return false;
+}
+
+static iqr_retval get_hash(batch_state *state, size_t index, iqr_Hash **hash)
+{
+    if (state->hash[index] == NULL) {
+        iqr_retval ret = bootstrap_context(&hashes[index].alg, 1, &state->ctx);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+
+        ret = iqr_HashCreate(state->ctx, hashes[index].alg, &state->hash[index]);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+            return ret;
+        }
+    }
+
+    *hash = state->hash[index];
+    return IQR_OK;
+}
+
+static iqr_retval get_hmac(batch_state *state, size_t index, iqr_MAC **hmac)
+{
+    if (state->hmac[index] == NULL) {
+        iqr_retval ret = bootstrap_context(&hashes[index].alg, 1, &state->ctx);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+
+        ret = iqr_MACCreateHMAC(state->ctx, hashes[index].alg, &state->hmac[index]);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_MACCreateHMAC(): %s\n", iqr_StrError(ret));
+            return ret;
+        }
+    }
+
+    *hmac = state->hmac[index];
+    return IQR_OK;
+}
+
+static void destroy_scheme(batch_scheme *scheme, void (*destroy_params)(void **params))
+{
+    key_cache_destroy(&scheme->pubs);
+    key_cache_destroy(&scheme->privs);
+    if (scheme->params != NULL) {
+        destroy_params(&scheme->params);
+    }
+}
+
+/* Set up a KEM the first time a command uses it. */
+static iqr_retval get_kem(batch_state *state, const char *name, const kem_scheme **kem, batch_scheme **scheme)
+{
+    *kem = kem_find(name);
+    if (*kem == NULL) {
+        fprintf(stderr, "Unknown KEM: %s\n", name);
+        return IQR_EBADVALUE;
+    }
+
+    batch_scheme *s = &state->kems[*kem - kem_schemes];
+    *scheme = s;
+    if (s->params != NULL) {
+        return IQR_OK;
+    }
+
+    iqr_retval ret = kem_bootstrap_context(*kem, &state->ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = (*kem)->create_params(state->ctx, &s->params);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = key_cache_create(s->params, (*kem)->import_public_key, (*kem)->destroy_public_key, BATCH_KEY_CACHE_SIZE, &s->pubs);
+    if (ret == IQR_OK) {
+        ret = key_cache_create(s->params, (*kem)->import_private_key, (*kem)->destroy_private_key, BATCH_KEY_CACHE_SIZE,
+            &s->privs);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on key_cache_create(): %s\n", iqr_StrError(ret));
+        destroy_scheme(s, (*kem)->destroy_params);
+    }
+    return ret;
+}
+
+/* Set up a signature scheme the first time a command uses it. */
+static iqr_retval get_sig(batch_state *state, const char *name, const sig_scheme **sig, batch_scheme **scheme)
+{
+    *sig = sig_find(name);
+    if (*sig == NULL) {
+        fprintf(stderr, "Unknown signature scheme: %s\n", name);
+        return IQR_EBADVALUE;
+    }
+
+    batch_scheme *s = &state->sigs[*sig - sig_schemes];
+    *scheme = s;
+    if (s->params != NULL) {
+        return IQR_OK;
+    }
+
+    iqr_retval ret = sig_bootstrap_context(*sig, &state->ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Stateful schemes only verify here; stateless ones ignore the strategy. */
+    ret = (*sig)->create_params(state->ctx, SIG_STRATEGY_VERIFY_ONLY, &s->params);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = key_cache_create(s->params, (*sig)->import_public_key, (*sig)->destroy_public_key, BATCH_KEY_CACHE_SIZE, &s->pubs);
+    if (ret == IQR_OK) {
+        ret = key_cache_create(s->params, (*sig)->import_private_key, (*sig)->destroy_private_key, BATCH_KEY_CACHE_SIZE,
+            &s->privs);
+    }
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on key_cache_create(): %s\n", iqr_StrError(ret));
+        destroy_scheme(s, (*sig)->destroy_params);
+    }
+    return ret;
+}
+
+static bool reject_stateful(const sig_scheme *sig)
+{
+    if (sig->stateful) {
+        fprintf(stderr, "%s is stateful; use its own samples to keep track of the private key's state.\n", sig->name);
+        return true;
+    }
+    return false;
+}
+
+/* Messages are signed as they are, so refuse ones that could be mistaken for
+ * a pre-hash stand-in or, for the stateful schemes, a Merkle batch's stand-in.
+ */
+static bool reject_stand_in(const sig_scheme *sig, const char *message_file, const uint8_t *message, size_t message_size)
+{
+    if (prehash_is_stand_in(message, message_size)) {
+        fprintf(stderr, "%s starts like a pre-hash stand-in message; batch mode doesn't pre-hash.\n", message_file);
+        return true;
+    }
+    if (sig->stateful && merkle_is_stand_in(message, message_size)) {
+        fprintf(stderr, "%s starts like a Merkle batch's signed message; it can't be used on its own.\n", message_file);
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Commands.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* hash <hash> <message> <digest> */
+static iqr_retval cmd_hash(batch_state *state, const char **args)
+{
+    size_t h = 0;
+    if (!find_hash(args[0], &h)) {
+        return IQR_EBADVALUE;
+    }
+
+    iqr_Hash *hash = NULL;
+    iqr_retval ret = get_hash(state, h, &hash);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint8_t *message = NULL;
+    size_t message_size = 0;
+    ret = map_data(args[1], &message, &message_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    uint8_t digest[BATCH_MAX_DIGEST];
+    ret = iqr_HashMessage(hash, message, message_size, digest, hashes[h].digest_size);
+    unmap_data(message, message_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashMessage(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    return save_data(args[2], digest, hashes[h].digest_size);
+}
+
+/* hmac <hash> <key> <message> <tag> */
+static iqr_retval cmd_hmac(batch_state *state, const char **args)
+{
+    size_t h = 0;
+    if (!find_hash(args[0], &h)) {
+        return IQR_EBADVALUE;
+    }
+
+    iqr_MAC *hmac = NULL;
+    iqr_retval ret = get_hmac(state, h, &hmac);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint8_t *key = NULL;
+    size_t key_size = 0;
+    const uint8_t *message = NULL;
+    size_t message_size = 0;
+    uint8_t tag[BATCH_MAX_DIGEST];
+
+    ret = map_data(args[1], &key, &key_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = map_data(args[2], &message, &message_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = iqr_MACMessage(hmac, key, key_size, message, message_size, tag, hashes[h].digest_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_MACMessage(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = save_data(args[3], tag, hashes[h].digest_size);
+
+end:
+    unmap_data(message, message_size);
+    unmap_data(key, key_size);
+    return ret;
+}
+
+/* kem-keygen <kem> <public key> <private key> */
+static iqr_retval cmd_kem_keygen(batch_state *state, const char **args)
+{
+    const kem_scheme *kem = NULL;
+    batch_scheme *scheme = NULL;
+    iqr_retval ret = get_kem(state, args[0], &kem, &scheme);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    kem_sizes sizes;
+    ret = kem->get_sizes(scheme->params, &sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    void *pub = NULL;
+    void *priv = NULL;
+    uint8_t *pub_raw = calloc(1, sizes.public_key);
+    uint8_t *priv_raw = calloc(1, sizes.private_key);
+    if (pub_raw == NULL || priv_raw == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = kem->create_key_pair(scheme->params, state->rng, &pub, &priv);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = kem->export_public_key(pub, pub_raw, sizes.public_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = kem->export_private_key(priv, priv_raw, sizes.private_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = save_data(args[1], pub_raw, sizes.public_key);
+    if (ret == IQR_OK) {
+        ret = save_data(args[2], priv_raw, sizes.private_key);
+    }
+
+end:
+    if (priv != NULL) {
+        kem->destroy_private_key(&priv);
+    }
+    if (pub != NULL) {
+        kem->destroy_public_key(&pub);
+    }
+    if (priv_raw != NULL) {
+        secure_memzero(priv_raw, sizes.private_key);
+    }
+    free(priv_raw);
+    free(pub_raw);
+    return ret;
+}
+
+/* encapsulate <kem> <public key> <ciphertext> <shared key> */
+static iqr_retval cmd_encapsulate(batch_state *state, const char **args)
+{
+    const kem_scheme *kem = NULL;
+    batch_scheme *scheme = NULL;
+    iqr_retval ret = get_kem(state, args[0], &kem, &scheme);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    kem_sizes sizes;
+    ret = kem->get_sizes(scheme->params, &sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const void *pub = NULL;
+    key_cache_entry *entry = NULL;
+    uint8_t *ciphertext = calloc(1, sizes.ciphertext);
+    uint8_t *shared_key = calloc(1, sizes.shared_key);
+    if (ciphertext == NULL || shared_key == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = key_cache_get(scheme->pubs, args[1], &pub, &entry, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = kem->encapsulate(pub, state->rng, ciphertext, sizes.ciphertext, shared_key, sizes.shared_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = save_data(args[2], ciphertext, sizes.ciphertext);
+    if (ret == IQR_OK) {
+        ret = save_data(args[3], shared_key, sizes.shared_key);
+    }
+
+end:
+    key_cache_release(scheme->pubs, entry);
+    if (shared_key != NULL) {
+        secure_memzero(shared_key, sizes.shared_key);
+    }
+    free(shared_key);
+    free(ciphertext);
+    return ret;
+}
+
+/* decapsulate <kem> <private key> <ciphertext> <shared key> */
+static iqr_retval cmd_decapsulate(batch_state *state, const char **args)
+{
+    const kem_scheme *kem = NULL;
+    batch_scheme *scheme = NULL;
+    iqr_retval ret = get_kem(state, args[0], &kem, &scheme);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    kem_sizes sizes;
+    ret = kem->get_sizes(scheme->params, &sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const void *priv = NULL;
+    key_cache_entry *entry = NULL;
+    const uint8_t *ciphertext = NULL;
+    size_t ciphertext_size = 0;
+    uint8_t *shared_key = calloc(1, sizes.shared_key);
+    if (shared_key == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = key_cache_get(scheme->privs, args[1], &priv, &entry, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = map_data(args[2], &ciphertext, &ciphertext_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = kem->decapsulate(priv, ciphertext, ciphertext_size, shared_key, sizes.shared_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = save_data(args[3], shared_key, sizes.shared_key);
+
+end:
+    unmap_data(ciphertext, ciphertext_size);
+    key_cache_release(scheme->privs, entry);
+    if (shared_key != NULL) {
+        secure_memzero(shared_key, sizes.shared_key);
+    }
+    free(shared_key);
+    return ret;
+}
+
+/* sig-keygen <scheme> <public key> <private key> */
+static iqr_retval cmd_sig_keygen(batch_state *state, const char **args)
+{
+    const sig_scheme *sig = NULL;
+    batch_scheme *scheme = NULL;
+    iqr_retval ret = get_sig(state, args[0], &sig, &scheme);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    if (reject_stateful(sig)) {
+        return IQR_EBADVALUE;
+    }
+
+    sig_sizes sizes;
+    ret = sig->get_sizes(scheme->params, &sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    void *pub = NULL;
+    void *priv = NULL;
+    uint8_t *pub_raw = calloc(1, sizes.public_key);
+    uint8_t *priv_raw = calloc(1, sizes.private_key);
+    if (pub_raw == NULL || priv_raw == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = sig->create_key_pair(scheme->params, state->rng, &pub, &priv, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = sig->export_public_key(pub, pub_raw, sizes.public_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = sig->export_private_key(priv, priv_raw, sizes.private_key);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = save_data(args[1], pub_raw, sizes.public_key);
+    if (ret == IQR_OK) {
+        ret = save_data(args[2], priv_raw, sizes.private_key);
+    }
+
+end:
+    if (priv != NULL) {
+        sig->destroy_private_key(&priv);
+    }
+    if (pub != NULL) {
+        sig->destroy_public_key(&pub);
+    }
+    if (priv_raw != NULL) {
+        secure_memzero(priv_raw, sizes.private_key);
+    }
+    free(priv_raw);
+    free(pub_raw);
+    return ret;
+}
+
+/* sign <scheme> <private key> <message> <signature> */
+static iqr_retval cmd_sign(batch_state *state, const char **args)
+{
+    const sig_scheme *sig = NULL;
+    batch_scheme *scheme = NULL;
+    iqr_retval ret = get_sig(state, args[0], &sig, &scheme);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    if (reject_stateful(sig)) {
+        return IQR_EBADVALUE;
+    }
+
+    sig_sizes sizes;
+    ret = sig->get_sizes(scheme->params, &sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const void *priv = NULL;
+    key_cache_entry *entry = NULL;
+    const uint8_t *message = NULL;
+    size_t message_size = 0;
+    uint8_t *signature = calloc(1, sizes.signature);
+    if (signature == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = key_cache_get(scheme->privs, args[1], &priv, &entry, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = map_data(args[2], &message, &message_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (reject_stand_in(sig, args[2], message, message_size)) {
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+
+    ret = sig->sign(priv, state->rng, NULL, message, message_size, signature, sizes.signature);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = save_data(args[3], signature, sizes.signature);
+
+end:
+    unmap_data(message, message_size);
+    key_cache_release(scheme->privs, entry);
+    free(signature);
+    return ret;
+}
+
+/* verify <scheme> <public key> <message> <signature> */
+static iqr_retval cmd_verify(batch_state *state, const char **args)
+{
+    const sig_scheme *sig = NULL;
+    batch_scheme *scheme = NULL;
+    iqr_retval ret = get_sig(state, args[0], &sig, &scheme);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const void *pub = NULL;
+    key_cache_entry *entry = NULL;
+    const uint8_t *message = NULL;
+    size_t message_size = 0;
+    const uint8_t *signature = NULL;
+    size_t signature_size = 0;
+    uint8_t digest[BATCH_MAX_DIGEST];
+
+    ret = key_cache_get(scheme->pubs, args[1], &pub, &entry, NULL);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = map_data(args[2], &message, &message_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (reject_stand_in(sig, args[2], message, message_size)) {
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+    ret = map_data(args[3], &signature, &signature_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    const uint8_t *signed_data = message;
+    size_t signed_size = message_size;
+    if (sig->digest_size > 0) {
+        /* The stateful samples sign the message's SHA2-512 digest. */
+        iqr_Hash *hash = NULL;
+        ret = get_hash(state, BATCH_SHA2_512, &hash);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        ret = iqr_HashMessage(hash, message, message_size, digest, sig->digest_size);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_HashMessage(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+        signed_data = digest;
+        signed_size = sig->digest_size;
+    }
+
+    ret = sig->verify(pub, signed_data, signed_size, signature, signature_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "%s doesn't verify: %s\n", args[3], iqr_StrError(ret));
+        goto end;
+    }
+
+    fprintf(stdout, "Verified %s\n", args[3]);
+
+end:
+    unmap_data(signature, signature_size);
+    unmap_data(message, message_size);
+    key_cache_release(scheme->pubs, entry);
+    return ret;
+}
+
+typedef struct {
+    const char *name;
+    /** Number of arguments after the command's name. */
+    size_t args;
+    iqr_retval (*run)(batch_state *state, const char **args);
+} batch_command;
+
+static const batch_command commands[] = {
+    { "hash", 3, cmd_hash },
+    { "hmac", 4, cmd_hmac },
+    { "kem-keygen", 3, cmd_kem_keygen },
+    { "encapsulate", 4, cmd_encapsulate },
+    { "decapsulate", 4, cmd_decapsulate },
+    { "sig-keygen", 3, cmd_sig_keygen },
+    { "sign", 4, cmd_sign },
+    { "verify", 4, cmd_verify },
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Running a script.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_state(batch_state *state)
+{
+    state->kems = calloc(kem_scheme_count, sizeof(*state->kems));
+    state->sigs = calloc(sig_scheme_count, sizeof(*state->sigs));
+    if (state->kems == NULL || state->sigs == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    /* SHA2-256 for the DRBG; the commands register anything else they need. */
+    iqr_retval ret = bootstrap_rng(IQR_HASHALGO_SHA2_256, &state->rng);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    return bootstrap_context(NULL, 0, &state->ctx);
+}
+
+/* Add up how often the key caches saved an import. */
+static void cache_stats(const batch_scheme *schemes, size_t count, uint64_t *hits, uint64_t *imports)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint64_t h = 0;
+        uint64_t m = 0;
+        if (schemes[i].pubs != NULL) {
+            key_cache_stats(schemes[i].pubs, &h, &m);
+            *hits += h;
+            *imports += m;
+        }
+        if (schemes[i].privs != NULL) {
+            key_cache_stats(schemes[i].privs, &h, &m);
+            *hits += h;
+            *imports += m;
+        }
+    }
+}
+
+static void cleanup_state(batch_state *state)
+{
+    if (state->kems != NULL) {
+        for (size_t i = 0; i < kem_scheme_count; i++) {
+            destroy_scheme(&state->kems[i], kem_schemes[i].destroy_params);
+        }
+    }
+    if (state->sigs != NULL) {
+        for (size_t i = 0; i < sig_scheme_count; i++) {
+            destroy_scheme(&state->sigs[i], sig_schemes[i].destroy_params);
+        }
+    }
+    free(state->kems);
+    free(state->sigs);
+
+    for (size_t i = 0; i < HASH_COUNT; i++) {
+        if (state->hash[i] != NULL) {
+            iqr_HashDestroy(&state->hash[i]);
+        }
+        if (state->hmac[i] != NULL) {
+            iqr_MACDestroy(&state->hmac[i]);
+        }
+    }
+
+    bootstrap_release();
+}
+
+/* Split a line into words in place. Returns the number of words, or
+ * BATCH_MAX_WORDS + 1 if there are too many.
+ */
+static size_t split_words(char *line, const char **words)
+{
+    size_t count = 0;
+    char *p = line;
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+        }
+        if (*p == '\0') {
+            return count;
+        }
+        if (count == BATCH_MAX_WORDS) {
+            return count + 1;
+        }
+
+        words[count++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+    }
+}
+
+static iqr_retval run_line(batch_state *state, char *line, uint32_t line_number, bool *ran)
+{
+    *ran = false;
+
+    const char *words[BATCH_MAX_WORDS];
+    const size_t count = split_words(line, words);
+    if (count == 0 || words[0][0] == '#') {
+        return IQR_OK;
+    }
+
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        if (paramcmp(words[0], commands[i].name) != 0) {
+            continue;
+        }
+
+        if (count != commands[i].args + 1) {
+            fprintf(stderr, "Line %u: %s takes %zu arguments.\n", line_number, commands[i].name, commands[i].args);
+            return IQR_EBADVALUE;
+        }
+
+        *ran = true;
+        iqr_retval ret = commands[i].run(state, &words[1]);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Line %u: %s failed.\n", line_number, commands[i].name);
+        }
+        return ret;
+    }
+
+    fprintf(stderr, "Line %u: unknown command %s\n", line_number, words[0]);
+    return IQR_EBADVALUE;
+}
+
+iqr_retval batch_run(const char *script_file)
+{
+    if (script_file == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    const bool from_stdin = (strcmp(script_file, BATCH_STDIN) == 0);
+    FILE *script = from_stdin ? stdin : fopen(script_file, "r");
+    if (script == NULL) {
+        fprintf(stderr, "Failed to open %s: %s\n", script_file, strerror(errno));
+        return IQR_EBADVALUE;
+    }
+
+    batch_state state;
+    memset(&state, 0, sizeof(state));
+
+    char *line = NULL;
+    size_t line_size = 0;
+    uint32_t line_number = 0;
+    uint32_t commands_run = 0;
+    const uint64_t start = time_now_ns();
+
+    iqr_retval ret = init_state(&state);
+    while (ret == IQR_OK && getline(&line, &line_size, script) >= 0) {
+        line_number++;
+
+        bool ran = false;
+        ret = run_line(&state, line, line_number, &ran);
+        if (ran) {
+            commands_run++;
+        }
+    }
+    if (ret == IQR_OK && ferror(script) != 0) {
+        fprintf(stderr, "Failed to read %s: %s\n", script_file, strerror(errno));
+        ret = IQR_EBADVALUE;
+    }
+
+    uint64_t hits = 0;
+    uint64_t imports = 0;
+    if (state.kems != NULL && state.sigs != NULL) {
+        cache_stats(state.kems, kem_scheme_count, &hits, &imports);
+        cache_stats(state.sigs, sig_scheme_count, &hits, &imports);
+    }
+    fprintf(stdout, "Ran %u commands in %.1f ms; %llu keys imported, %llu served from the key caches.\n", commands_run,
+        (double)(time_now_ns() - start) / 1e6, (unsigned long long)imports, (unsigned long long)hits);
+    bootstrap_print_stats(stdout);
+
+    free(line);
+    cleanup_state(&state);
+    if (!from_stdin) {
+        fclose(script);
+    }
+    return ret;
+}
@@ -0,0 +1,61 @@
+/** @file batch.h
+ *
+ * @brief Run a script of sample operations in one process.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "iqr_retval.h"
+
+/* A script has one command per line. Words are separated by spaces or tabs,
+ * and file names can't contain either. Blank lines and lines starting with
+ * '#' are skipped.
+ *
+ *     hash <hash> <message> <digest>
+ *     hmac <hash> <key> <message> <tag>
+ *     kem-keygen <kem> <public key> <private key>
+ *     encapsulate <kem> <public key> <ciphertext> <shared key>
+ *     decapsulate <kem> <private key> <ciphertext> <shared key>
+ *     sig-keygen <scheme> <public key> <private key>
+ *     sign <scheme> <private key> <message> <signature>
+ *     verify <scheme> <public key> <message> <signature>
+ *
+ * <hash> is sha2-256, sha2-384, sha2-512, sha3-256 or sha3-512. <kem> is one
+ * of kem_bench's KEM names and <scheme> one of sig_bench's signature scheme
+ * names. The stateful schemes (HSS, XMSS and XMSS^MT) can only verify here,
+ * because their private key state has to be kept by their own samples.
+ */
+
+/** The script name that means standard input. */
+#define BATCH_STDIN "-"
+
+/** Run every command in a script against one context and DRBG.
+ *
+ * Hashes are registered, and parameters created, the first time a command
+ * needs them. Public and private keys are imported once and kept in a
+ * key_cache per scheme, so later commands using the same key file skip the
+ * import, unless the file has changed. The script stops at the first
+ * command that fails, including a signature that doesn't verify.
+ *
+ * @param script_file   Name of the script, or BATCH_STDIN.
+ *
+ * @return IQR_OK if every command succeeded.
+ */
+iqr_retval batch_run(const char *script_file);
+
+#endif
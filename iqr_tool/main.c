@@ -0,0 +1,149 @@
+/** @file main.c
+ *
+ * @brief Run any of the samples from one executable.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "isara_samples.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"iqr_tool <sample> [<sample's options>]\n"
+"iqr_tool --list\n"
+"iqr_tool --batch <script>|-\n"
+"  Runs one of the samples, exactly as its own executable would. Name the\n"
+"  sample either as iqr_tool's first argument (kyber_encapsulate or\n"
+"  kyber/encapsulate) or by running iqr_tool through a link with the\n"
+"  sample's name; the build puts one for every sample in iqr_tool's bin\n"
+"  directory. --list prints the samples' names.\n"
+"  --batch runs the commands in <script>, or standard input for -, in this\n"
+"  process with one shared context and DRBG. See iqr_tool's README for the\n"
+"  commands.\n";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The applets.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Each sample's main(), renamed by the build. */
+#define APPLET(name, dir) int name##_main(int argc, const char **argv);
+#include "applets.h"
+#undef APPLET
+
+typedef struct {
+    const char *name;
+    int (*main)(int argc, const char **argv);
+} applet;
+
+static const applet applets[] = {
+#define APPLET(name, dir) { #name, name##_main },
+#include "applets.h"
+#undef APPLET
+};
+
+#define APPLET_COUNT (sizeof(applets) / sizeof(applets[0]))
+
+/* Longest applet name, plus room for a few stray characters we'll reject. */
+#define MAX_NAME 64
+
+/* Find an applet by name. A '/' matches the '_' in its place, so samples can
+ * also be named by their directory.
+ */
+static const applet *find_applet(const char *name)
+{
+    char normalized[MAX_NAME];
+    const size_t len = strlen(name);
+    if (len == 0 || len >= sizeof(normalized)) {
+        return NULL;
+    }
+    for (size_t i = 0; i <= len; i++) {
+        normalized[i] = (name[i] == '/') ? '_' : name[i];
+    }
+
+    for (size_t i = 0; i < APPLET_COUNT; i++) {
+        if (strcmp(applets[i].name, normalized) == 0) {
+            return &applets[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *base_name(const char *path)
+{
+    const char *base = path;
+    for (const char *p = path; *p != '\0'; p++) {
+#if defined(_WIN32) || defined(_WIN64)
+        if (*p == '/' || *p == '\\') {
+#else
+        if (*p == '/') {
+#endif
+            base = p + 1;
+        }
+    }
+    return base;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Called through a link named after a sample. */
+    const applet *found = (argc > 0) ? find_applet(base_name(argv[0])) : NULL;
+    if (found != NULL) {
+        return found->main(argc, argv);
+    }
+
+    if (argc < 2) {
+        fprintf(stdout, "%s", usage_msg);
+        return EXIT_FAILURE;
+    }
+
+    if (paramcmp(argv[1], "--list") == 0) {
+        for (size_t i = 0; i < APPLET_COUNT; i++) {
+            fprintf(stdout, "%s\n", applets[i].name);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (paramcmp(argv[1], "--batch") == 0) {
+        if (argc != 3) {
+            fprintf(stdout, "%s", usage_msg);
+            return EXIT_FAILURE;
+        }
+        return (batch_run(argv[2]) == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    found = find_applet(argv[1]);
+    if (found == NULL) {
+        fprintf(stderr, "Unknown sample: %s\n", argv[1]);
+        fprintf(stdout, "%s", usage_msg);
+        return EXIT_FAILURE;
+    }
+
+    /* The sample sees its own name in argv[0], so its messages read the same
+     * as when it's run on its own.
+     */
+    return found->main(argc - 1, argv + 1);
+}
@@ -0,0 +1,326 @@
+/** @file startup_bench.c
+ *
+ * @brief Compare the start-up cost of a sample's own executable with running
+ * it through iqr_tool.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "iqr_retval.h"
+#include "isara_samples.h"
+#include "latency.h"
+
+#if defined(__APPLE__)
+#include <crt_externs.h>
+#define environ (*_NSGetEnviron())
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"iqr_tool_startup_bench [--sample <name>] [--runs <count>] [--tool <path>]\n"
+"  [--binary <path>]\n"
+"    Defaults are: \n"
+"        --sample version\n"
+"        --runs 1000\n"
+"        --tool iqr_tool, next to this program\n"
+"        --binary the sample's executable in the build tree\n"
+"  Starts the sample <count> times from its own executable and <count>\n"
+"  times as \"iqr_tool <name>\", alternating between the two, and reports\n"
+"  how long each run took from spawning the process to collecting its exit\n"
+"  status. The sample runs with no options and its output is discarded, so\n"
+"  pick one that does little work without options; version is a good\n"
+"  choice.\n";
+
+/* Where each sample's own executable lives in the build tree. */
+typedef struct {
+    const char *name;
+    const char *dir;
+} applet_dir;
+
+static const applet_dir applets[] = {
+#define APPLET(name, dir) { #name, dir },
+#include "applets.h"
+#undef APPLET
+};
+
+#define APPLET_COUNT (sizeof(applets) / sizeof(applets[0]))
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Timing process start-up.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Run a program to completion with its output sent to /dev/null, and time
+ * it.
+ */
+static iqr_retval time_run(const char *path, char *const *args, const posix_spawn_file_actions_t *actions, uint64_t *ns)
+{
+    const uint64_t start = time_now_ns();
+
+    pid_t pid = 0;
+    int rc = posix_spawn(&pid, path, actions, NULL, args, environ);
+    if (rc != 0) {
+        fprintf(stderr, "Failed on posix_spawn(%s): %s\n", path, strerror(rc));
+        return IQR_EBADVALUE;
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            fprintf(stderr, "Failed on waitpid(): %s\n", strerror(errno));
+            return IQR_EBADVALUE;
+        }
+    }
+
+    *ns = time_now_ns() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        fprintf(stderr, "%s failed; run it by hand to see why.\n", path);
+        return IQR_EBADVALUE;
+    }
+    return IQR_OK;
+}
+
+static void report(const char *label, const latency_histogram *h)
+{
+    fprintf(stdout, "%s: mean %.1f us\n", label, (double)h->sum_ns / (double)h->count / 1000.0);
+    latency_print(stdout, label, h);
+}
+
+static iqr_retval bench_startup(const char *sample, const char *binary, const char *tool, uint32_t runs)
+{
+    static latency_histogram separate;
+    static latency_histogram multicall;
+    latency_reset(&separate);
+    latency_reset(&multicall);
+
+    /* posix_spawn() wants mutable argument strings. */
+    char *binary_arg = strdup(binary);
+    char *tool_arg = strdup(tool);
+    char *sample_arg = strdup(sample);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    iqr_retval ret = IQR_OK;
+    if (binary_arg == NULL || tool_arg == NULL || sample_arg == NULL) {
+        fprintf(stderr, "Failed on strdup(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    if (posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0) != 0
+        || posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO) != 0) {
+        fprintf(stderr, "Failed on posix_spawn_file_actions_addopen(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    char *const separate_args[] = { binary_arg, NULL };
+    char *const multicall_args[] = { tool_arg, sample_arg, NULL };
+
+    /* One untimed run each, so both executables start out in the page
+     * cache.
+     */
+    uint64_t ns = 0;
+    ret = time_run(binary, separate_args, &actions, &ns);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = time_run(tool, multicall_args, &actions, &ns);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Alternate, so anything else happening on the machine affects both
+     * equally.
+     */
+    for (uint32_t i = 0; i < runs; i++) {
+        ret = time_run(binary, separate_args, &actions, &ns);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        latency_record(&separate, ns);
+
+        ret = time_run(tool, multicall_args, &actions, &ns);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        latency_record(&multicall, ns);
+    }
+
+    report("Own executable", &separate);
+    report("iqr_tool", &multicall);
+
+    const uint64_t separate_p50 = latency_percentile(&separate, 50.0);
+    const uint64_t multicall_p50 = latency_percentile(&multicall, 50.0);
+    if (multicall_p50 > 0) {
+        fprintf(stdout, "Median speed-up: %.2fx\n", (double)separate_p50 / (double)multicall_p50);
+    }
+
+end:
+    posix_spawn_file_actions_destroy(&actions);
+    free(binary_arg);
+    free(tool_arg);
+    free(sample_arg);
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+static void preamble(const char *cmd, const char *sample, uint32_t runs, const char *tool, const char *binary)
+{
+    fprintf(stdout, "Running %s with the following parameters...\n", cmd);
+    fprintf(stdout, "    Sample: %s\n", sample);
+    fprintf(stdout, "    Runs: %u\n", runs);
+    fprintf(stdout, "    Multi-call executable: %s\n", tool);
+    fprintf(stdout, "    Sample's executable: %s\n", binary);
+    fprintf(stdout, "\n");
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, const applet_dir **sample, uint32_t *runs,
+    const char **tool, const char **binary)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--sample") == 0) {
+            /* [--sample <name>] */
+            i++;
+            *sample = NULL;
+            for (size_t a = 0; a < APPLET_COUNT; a++) {
+                if (paramcmp(argv[i], applets[a].name) == 0) {
+                    *sample = &applets[a];
+                    break;
+                }
+            }
+            if (*sample == NULL) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--runs") == 0) {
+            /* [--runs <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *runs = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--tool") == 0) {
+            /* [--tool <path>] */
+            i++;
+            *tool = argv[i];
+        } else if (paramcmp(argv[i], "--binary") == 0) {
+            /* [--binary <path>] */
+            i++;
+            *binary = argv[i];
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    const applet_dir *sample = NULL;
+    for (size_t a = 0; a < APPLET_COUNT; a++) {
+        if (strcmp(applets[a].name, "version") == 0) {
+            sample = &applets[a];
+        }
+    }
+    uint32_t runs = 1000;
+    const char *tool = NULL;
+    const char *binary = NULL;
+
+    char default_tool[PATH_MAX];
+    char default_binary[PATH_MAX];
+
+    iqr_retval ret = parse_commandline(argc, argv, &sample, &runs, &tool, &binary);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    if (tool == NULL) {
+        /* iqr_tool is built in the same directory as this program. */
+        const char *slash = strrchr(argv[0], '/');
+        const int dir_len = (slash == NULL) ? 1 : (int)(slash - argv[0]);
+        const char *dir = (slash == NULL) ? "." : argv[0];
+        snprintf(default_tool, sizeof(default_tool), "%.*s/iqr_tool", dir_len, dir);
+        tool = default_tool;
+    }
+    if (binary == NULL) {
+        snprintf(default_binary, sizeof(default_binary), "%s/%s/%s", IQR_TOOL_BUILD_ROOT, sample->dir, sample->name);
+        binary = default_binary;
+    }
+
+    preamble(argv[0], sample->name, runs, tool, binary);
+
+    ret = bench_startup(sample->name, binary, tool, runs);
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,316 @@
+/** @file bench.c
+ *
+ * @brief Measure the throughput of the toolkit's NIST SP 800-56C Option 1
+ * Concatenation KDF scheme when deriving many keys.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_kdf.h"
+#include "iqr_retval.h"
+#include "isara_samples.h"
+#include "kdf_batch.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"kdf_concatenation_bench [--hash sha2-256|sha2-384|sha2-512|sha3-256|sha3-512]\n"
+"  [--keysize <size>] [--secretsize <size>] [--infosize <size>]\n"
+"  [--iterations <count>] [--threads <count>]\n"
+"    Defaults are: \n"
+"        --hash sha2-256\n"
+"        --keysize 32\n"
+"        --secretsize 32\n"
+"        --infosize 32\n"
+"        --iterations 100000\n"
+"        --threads 1\n";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmark scenarios.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void report(const char *mode, size_t count, uint64_t elapsed)
+{
+    const double seconds = (double)elapsed / 1e9;
+    fprintf(stdout, "%-24s %10zu %12.3f %14.0f %10.3f\n", mode, count, seconds * 1e3,
+        (double)count / (seconds > 0.0 ? seconds : 1e-9), (double)elapsed / (double)count / 1e3);
+}
+
+/* What the single-shot command line tool pays for every key, minus process
+ * start-up: a new context, hash registration and a key buffer per derivation.
+ */
+static iqr_retval bench_per_call_setup(iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb, const kdf_batch_item *items,
+    size_t count, size_t key_size)
+{
+    const uint64_t start = time_now_ns();
+    for (size_t i = 0; i < count; i++) {
+        iqr_Context *ctx = NULL;
+        iqr_retval ret = iqr_CreateContext(&ctx);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
+            return ret;
+        }
+
+        ret = iqr_HashRegisterCallbacks(ctx, hash, cb);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
+            iqr_DestroyContext(&ctx);
+            return ret;
+        }
+
+        uint8_t *key = calloc(1, key_size);
+        if (key == NULL) {
+            fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+            iqr_DestroyContext(&ctx);
+            return IQR_ENOMEM;
+        }
+
+        ret = iqr_ConcatenationKDFDeriveKey(ctx, hash, items[i].secret, items[i].secret_size, items[i].info, items[i].info_size,
+            key, key_size);
+
+        secure_memzero(key, key_size);
+        free(key);
+        iqr_DestroyContext(&ctx);
+
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_ConcatenationKDFDeriveKey(): %s\n", iqr_StrError(ret));
+            return ret;
+        }
+    }
+    report("per-call setup", count, time_now_ns() - start);
+
+    return IQR_OK;
+}
+
+/* One context and hash registration, reused for every derivation. */
+static iqr_retval bench_reused_deriver(iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb, const kdf_batch_item *items,
+    size_t count, uint8_t *keys, size_t key_size)
+{
+    kdf_deriver deriver;
+    iqr_retval ret = kdf_deriver_init(&deriver, hash, cb);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint64_t start = time_now_ns();
+    for (size_t i = 0; i < count; i++) {
+        ret = kdf_deriver_derive(&deriver, items[i].secret, items[i].secret_size, items[i].info, items[i].info_size,
+            keys + i * key_size, key_size);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_ConcatenationKDFDeriveKey(): %s\n", iqr_StrError(ret));
+            break;
+        }
+    }
+    const uint64_t elapsed = time_now_ns() - start;
+
+    kdf_deriver_cleanup(&deriver);
+
+    if (ret == IQR_OK) {
+        report("reused deriver", count, elapsed);
+    }
+    return ret;
+}
+
+/* The batch entry point: one deriver per thread. */
+static iqr_retval bench_batch(iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb, const kdf_batch_item *items,
+    size_t count, uint8_t *keys, size_t key_size, uint32_t threads)
+{
+    const uint64_t start = time_now_ns();
+    iqr_retval ret = kdf_derive_batch(hash, cb, items, count, keys, key_size, threads);
+    const uint64_t elapsed = time_now_ns() - start;
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    char mode[32];
+    snprintf(mode, sizeof(mode), "batch (%u threads)", threads);
+    report(mode, count, elapsed);
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash, const iqr_HashCallbacks **cb,
+    size_t *key_size, size_t *secret_size, size_t *info_size, size_t *iterations, uint32_t *threads)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--hash") == 0) {
+            /* [--hash sha2-256|sha2-384|sha2-512|sha3-256|sha3-512] */
+            i++;
+            if (paramcmp(argv[i], "sha2-256") == 0) {
+                *hash = IQR_HASHALGO_SHA2_256;
+                *cb = &IQR_HASH_DEFAULT_SHA2_256;
+            } else if (paramcmp(argv[i], "sha2-384") == 0) {
+                *hash = IQR_HASHALGO_SHA2_384;
+                *cb = &IQR_HASH_DEFAULT_SHA2_384;
+            } else if (paramcmp(argv[i], "sha2-512") == 0) {
+                *hash = IQR_HASHALGO_SHA2_512;
+                *cb = &IQR_HASH_DEFAULT_SHA2_512;
+            } else if (paramcmp(argv[i], "sha3-256") == 0) {
+                *hash = IQR_HASHALGO_SHA3_256;
+                *cb = &IQR_HASH_DEFAULT_SHA3_256;
+            } else if (paramcmp(argv[i], "sha3-512") == 0) {
+                *hash = IQR_HASHALGO_SHA3_512;
+                *cb = &IQR_HASH_DEFAULT_SHA3_512;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else {
+            /* The remaining options all take a positive integer. */
+            const char *option = argv[i];
+            i++;
+            int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+
+            if (paramcmp(option, "--keysize") == 0) {
+                *key_size = (size_t)value;
+            } else if (paramcmp(option, "--secretsize") == 0) {
+                *secret_size = (size_t)value;
+            } else if (paramcmp(option, "--infosize") == 0) {
+                *info_size = (size_t)value;
+            } else if (paramcmp(option, "--iterations") == 0) {
+                *iterations = (size_t)value;
+            } else if (paramcmp(option, "--threads") == 0) {
+                *threads = (uint32_t)value;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    iqr_HashAlgorithmType hash = IQR_HASHALGO_SHA2_256;
+    const iqr_HashCallbacks *cb = &IQR_HASH_DEFAULT_SHA2_256;
+    size_t key_size = 32;
+    size_t secret_size = 32;
+    size_t info_size = 32;
+    size_t iterations = 100000;
+    uint32_t threads = 1;
+
+    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &key_size, &secret_size, &info_size, &iterations, &threads);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    /* Every derivation gets its own secret and info so the numbers aren't
+     * flattered by identical inputs. The contents don't matter for timing.
+     */
+    const size_t stride = secret_size + info_size;
+    uint8_t *inputs = calloc(iterations, stride);
+    kdf_batch_item *items = calloc(iterations, sizeof(*items));
+    uint8_t *keys = calloc(iterations, key_size);
+    if (inputs == NULL || items == NULL || keys == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto cleanup;
+    }
+
+    uint32_t x = 0x9e3779b9;
+    for (size_t i = 0; i < iterations * stride; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        inputs[i] = (uint8_t)x;
+    }
+    for (size_t i = 0; i < iterations; i++) {
+        items[i].secret = inputs + i * stride;
+        items[i].secret_size = secret_size;
+        items[i].info = inputs + i * stride + secret_size;
+        items[i].info_size = info_size;
+    }
+
+    fprintf(stdout, "Concatenation KDF: %zu-byte secret, %zu-byte info, %zu-byte key\n\n", secret_size, info_size, key_size);
+    fprintf(stdout, "%-24s %10s %12s %14s %10s\n", "mode", "keys", "total ms", "keys/s", "us/key");
+
+    ret = bench_per_call_setup(hash, cb, items, iterations, key_size);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    ret = bench_reused_deriver(hash, cb, items, iterations, keys, key_size);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    ret = bench_batch(hash, cb, items, iterations, keys, key_size, threads);
+
+cleanup:
+    if (keys != NULL) {
+        secure_memzero(keys, iterations * key_size);
+    }
+    free(keys);
+    free(items);
+    free(inputs);
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
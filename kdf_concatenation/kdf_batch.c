@@ -0,0 +1,335 @@
+/** @file kdf_batch.c
+ *
+ * @brief Bulk key derivation using the toolkit's NIST SP 800-56C Option 1
+ * Concatenation KDF scheme.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kdf_batch.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iqr_kdf.h"
+#include "isara_samples.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Reusable deriver.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval kdf_deriver_init(kdf_deriver *deriver, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb)
+{
+    if (deriver == NULL || cb == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    deriver->ctx = NULL;
+    deriver->hash = hash;
+
+    iqr_retval ret = iqr_CreateContext(&deriver->ctx);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    ret = iqr_HashRegisterCallbacks(deriver->ctx, hash, cb);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
+        iqr_DestroyContext(&deriver->ctx);
+        return ret;
+    }
+
+    return IQR_OK;
+}
+
+iqr_retval kdf_deriver_derive(const kdf_deriver *deriver, const uint8_t *secret, size_t secret_size, const uint8_t *info,
+    size_t info_size, uint8_t *key, size_t key_size)
+{
+    if (deriver == NULL || deriver->ctx == NULL) {
+        return IQR_ENULLPTR;
+    }
+
+    return iqr_ConcatenationKDFDeriveKey(deriver->ctx, deriver->hash, secret, secret_size, info, info_size, key, key_size);
+}
+
+void kdf_deriver_cleanup(kdf_deriver *deriver)
+{
+    if (deriver != NULL) {
+        iqr_DestroyContext(&deriver->ctx);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Batch derivation.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    iqr_HashAlgorithmType hash;
+    const iqr_HashCallbacks *cb;
+    const kdf_batch_item *items;
+    size_t item_count;
+    uint8_t *keys;
+    size_t key_size;
+    iqr_retval ret;
+} kdf_batch_range;
+
+static void derive_range(kdf_batch_range *range)
+{
+    kdf_deriver deriver;
+    range->ret = kdf_deriver_init(&deriver, range->hash, range->cb);
+    if (range->ret != IQR_OK) {
+        return;
+    }
+
+    for (size_t i = 0; i < range->item_count; i++) {
+        const kdf_batch_item *item = &range->items[i];
+        range->ret = kdf_deriver_derive(&deriver, item->secret, item->secret_size, item->info, item->info_size,
+            range->keys + i * range->key_size, range->key_size);
+        if (range->ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_ConcatenationKDFDeriveKey(): %s\n", iqr_StrError(range->ret));
+            break;
+        }
+    }
+
+    kdf_deriver_cleanup(&deriver);
+}
+
+static void *derive_range_thread(void *arg)
+{
+    derive_range(arg);
+    return NULL;
+}
+
+iqr_retval kdf_derive_batch(iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb, const kdf_batch_item *items,
+    size_t item_count, uint8_t *keys, size_t key_size, uint32_t thread_count)
+{
+    if (cb == NULL || (item_count > 0 && (items == NULL || keys == NULL))) {
+        return IQR_ENULLPTR;
+    }
+    if (thread_count == 0) {
+        return IQR_EBADVALUE;
+    }
+    if (item_count == 0) {
+        return IQR_OK;
+    }
+    if ((size_t)thread_count > item_count) {
+        thread_count = (uint32_t)item_count;
+    }
+
+    kdf_batch_range *ranges = calloc(thread_count, sizeof(*ranges));
+    pthread_t *threads = calloc(thread_count, sizeof(*threads));
+    bool *started = calloc(thread_count, sizeof(*started));
+    if (ranges == NULL || threads == NULL || started == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(started);
+        free(threads);
+        free(ranges);
+        return IQR_ENOMEM;
+    }
+
+    /* Hand out contiguous ranges so every thread writes to its own region of
+     * the output buffer.
+     */
+    const size_t per_thread = item_count / thread_count;
+    const size_t remainder = item_count % thread_count;
+    size_t offset = 0;
+    for (uint32_t t = 0; t < thread_count; t++) {
+        const size_t count = per_thread + ((size_t)t < remainder ? 1 : 0);
+
+        ranges[t].hash = hash;
+        ranges[t].cb = cb;
+        ranges[t].items = items + offset;
+        ranges[t].item_count = count;
+        ranges[t].keys = keys + offset * key_size;
+        ranges[t].key_size = key_size;
+        ranges[t].ret = IQR_OK;
+
+        offset += count;
+    }
+
+    /* The calling thread takes the first range itself. */
+    iqr_retval ret = IQR_OK;
+    for (uint32_t t = 1; t < thread_count; t++) {
+        int rc = pthread_create(&threads[t], NULL, derive_range_thread, &ranges[t]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+        started[t] = true;
+    }
+
+    if (ret == IQR_OK) {
+        derive_range(&ranges[0]);
+    }
+
+    for (uint32_t t = 1; t < thread_count; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    for (uint32_t t = 0; t < thread_count && ret == IQR_OK; t++) {
+        ret = ranges[t].ret;
+    }
+
+    free(started);
+    free(threads);
+    free(ranges);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Batch file parsing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static int hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool is_blank(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Decode the hex token starting at data[*pos] into data[*pos] onwards. The
+ * token ends at a blank, the end of the line, or a '#' starting a comment.
+ * The decoded bytes never outrun the hex digits being read, so this is safe
+ * to do in place.
+ */
+static iqr_retval decode_hex_token(uint8_t *data, size_t data_size, size_t *pos, const uint8_t **out, size_t *out_size)
+{
+    const size_t start = *pos;
+    size_t end = start;
+    while (end < data_size && data[end] != '\n' && data[end] != '#' && !is_blank(data[end])) {
+        end++;
+    }
+
+    const size_t hex_size = end - start;
+    if (hex_size == 0 || hex_size % 2 != 0) {
+        return IQR_EINVDATA;
+    }
+
+    for (size_t i = 0; i < hex_size / 2; i++) {
+        const int hi = hex_value(data[start + 2 * i]);
+        const int lo = hex_value(data[start + 2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return IQR_EINVDATA;
+        }
+        data[start + i] = (uint8_t)((hi << 4) | lo);
+    }
+
+    *out = data + start;
+    *out_size = hex_size / 2;
+    *pos = end;
+
+    return IQR_OK;
+}
+
+iqr_retval kdf_parse_batch(uint8_t *data, size_t data_size, kdf_batch_item **items, size_t *item_count)
+{
+    if (items == NULL || item_count == NULL || (data == NULL && data_size > 0)) {
+        return IQR_ENULLPTR;
+    }
+
+    *items = NULL;
+    *item_count = 0;
+
+    /* Size the item array up front so parsing doesn't have to grow it. */
+    size_t max_items = 1;
+    for (size_t i = 0; i < data_size; i++) {
+        if (data[i] == '\n') {
+            max_items++;
+        }
+    }
+
+    kdf_batch_item *tmp = calloc(max_items, sizeof(*tmp));
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    size_t count = 0;
+    size_t line = 1;
+    size_t pos = 0;
+    while (pos < data_size) {
+        while (pos < data_size && is_blank(data[pos])) {
+            pos++;
+        }
+
+        if (pos < data_size && data[pos] != '\n' && data[pos] != '#') {
+            kdf_batch_item *item = &tmp[count];
+
+            iqr_retval ret = decode_hex_token(data, data_size, &pos, &item->secret, &item->secret_size);
+            if (ret != IQR_OK) {
+                fprintf(stderr, "Batch line %zu: the secret isn't valid hex.\n", line);
+                free(tmp);
+                return ret;
+            }
+
+            while (pos < data_size && is_blank(data[pos])) {
+                pos++;
+            }
+
+            if (pos < data_size && data[pos] != '\n' && data[pos] != '#') {
+                ret = decode_hex_token(data, data_size, &pos, &item->info, &item->info_size);
+                if (ret != IQR_OK) {
+                    fprintf(stderr, "Batch line %zu: the info isn't valid hex.\n", line);
+                    free(tmp);
+                    return ret;
+                }
+
+                while (pos < data_size && is_blank(data[pos])) {
+                    pos++;
+                }
+            }
+
+            if (pos < data_size && data[pos] != '\n' && data[pos] != '#') {
+                fprintf(stderr, "Batch line %zu: expected a secret and an optional info string.\n", line);
+                free(tmp);
+                return IQR_EINVDATA;
+            }
+
+            count++;
+        }
+
+        /* Skip the rest of the line (a comment, if anything). */
+        while (pos < data_size && data[pos] != '\n') {
+            pos++;
+        }
+        pos++;
+        line++;
+    }
+
+    *items = tmp;
+    *item_count = count;
+
+    return IQR_OK;
+}
@@ -0,0 +1,115 @@
+/** @file kdf_batch.h
+ *
+ * @brief Bulk key derivation using the toolkit's NIST SP 800-56C Option 1
+ * Concatenation KDF scheme.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KDF_BATCH_H
+#define KDF_BATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+
+/** A reusable key deriver.
+ *
+ * Creating a context and registering a hash is far more expensive than a
+ * single derivation, so a deriver holds on to both. A deriver must only be
+ * used by one thread at a time; give each worker thread its own.
+ */
+typedef struct {
+    iqr_Context *ctx;
+    iqr_HashAlgorithmType hash;
+} kdf_deriver;
+
+/** One (secret, info) tuple to derive a key from.
+ *
+ * The pointers reference memory owned by the caller; nothing is copied.
+ */
+typedef struct {
+    const uint8_t *secret;
+    size_t secret_size;
+    const uint8_t *info;
+    size_t info_size;
+} kdf_batch_item;
+
+/** Create the context and register the hash used by a deriver.
+ *
+ * @param deriver   The deriver to initialize.
+ * @param hash      The hash algorithm to derive keys with.
+ * @param cb        The hash implementation to register for @a hash.
+ */
+iqr_retval kdf_deriver_init(kdf_deriver *deriver, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb);
+
+/** Derive one key.
+ *
+ * No memory is allocated by this function.
+ *
+ * @param deriver       An initialized deriver.
+ * @param secret        The shared secret.
+ * @param secret_size   Size of @a secret in bytes.
+ * @param info          Optional other info, may be NULL.
+ * @param info_size     Size of @a info in bytes.
+ * @param key           Buffer that receives the derived key.
+ * @param key_size      Size of @a key in bytes.
+ */
+iqr_retval kdf_deriver_derive(const kdf_deriver *deriver, const uint8_t *secret, size_t secret_size, const uint8_t *info,
+    size_t info_size, uint8_t *key, size_t key_size);
+
+/** Release the resources held by a deriver.
+ *
+ * @param deriver   The deriver to clean up. Safe to call more than once.
+ */
+void kdf_deriver_cleanup(kdf_deriver *deriver);
+
+/** Derive a key for every item in a batch.
+ *
+ * The items are split into contiguous ranges, one per thread, and every
+ * thread uses its own deriver. Key @a i is written to
+ * `keys + i * key_size`.
+ *
+ * @param hash          The hash algorithm to derive keys with.
+ * @param cb            The hash implementation to register for @a hash.
+ * @param items         The (secret, info) tuples.
+ * @param item_count    Number of entries in @a items.
+ * @param keys          Buffer of `item_count * key_size` bytes.
+ * @param key_size      Size of each derived key in bytes.
+ * @param thread_count  Number of threads to use, 1 or more.
+ */
+iqr_retval kdf_derive_batch(iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb, const kdf_batch_item *items,
+    size_t item_count, uint8_t *keys, size_t key_size, uint32_t thread_count);
+
+/** Parse a batch file.
+ *
+ * Each non-empty line that doesn't start with `#` holds a hex encoded
+ * secret, optionally followed by whitespace and a hex encoded info string.
+ * The hex is decoded in place, so the returned items point into @a data;
+ * keep it around until you're done with them.
+ *
+ * You must free() the @a items array when you're done with it.
+ *
+ * @param data          The contents of the batch file.
+ * @param data_size     Size of @a data in bytes.
+ * @param items         A pointer that will receive the item array.
+ * @param item_count    A pointer that will receive the number of items.
+ */
+iqr_retval kdf_parse_batch(uint8_t *data, size_t data_size, kdf_batch_item **items, size_t *item_count);
+
+#endif
@@ -23,11 +23,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_kdf.h"
 #include "iqr_retval.h"
 #include "isara_samples.h"
+#include "kdf_batch.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -38,12 +40,17 @@ static const char *usage_msg =
 "  [--secret { string <secret> | file <filename> }]\n"
 "  [--info { string <info> | file <filename> | none }]\n"
 "  [--keysize <size>] [--keyfile <output_filename>]\n"
+"  [--batch <filename>] [--threads <count>]\n"
 "    Defaults are: \n"
 "        --hash sha2-256\n"
 "        --secret string 000102030405060708090a0b0c0d0e0f\n"
 "        --info string ISARA-kdf_concatenation\n"
 "        --keysize 32\n"
-"        --keyfile derived.key\n";
+"        --keyfile derived.key\n"
+"        --threads 1\n"
+"  In batch mode every line of the batch file holds a hex secret and an\n"
+"  optional hex info string; --secret and --info are ignored and the derived\n"
+"  keys are written back to back to the key file.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases deriving a key using the toolkit's NIST SP 800-56C
@@ -89,27 +96,95 @@ end:
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
-// This next section of code is related to the toolkit, but is not specific to
-// KDF.
+// This function showcases deriving keys for a whole batch of (secret, info)
+// tuples. Every thread keeps one context with the hash registered and reuses
+// it for all of its derivations.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb)
+static iqr_retval showcase_kdf_concatenation_batch(iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb,
+    const char *batch_file, size_t key_size, const char *key_file, uint32_t threads)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    uint8_t *batch = NULL;
+    size_t batch_size = 0;
+    kdf_batch_item *items = NULL;
+    size_t item_count = 0;
+    uint8_t *keys = NULL;
+    size_t keys_size = 0;
+
+    iqr_retval ret = load_data(batch_file, &batch, &batch_size);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
+        goto end;
     }
 
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, hash, cb);
+    ret = kdf_parse_batch(batch, batch_size, &items, &item_count);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
+        goto end;
+    }
+    if (item_count == 0) {
+        fprintf(stderr, "The batch file doesn't contain any secrets.\n");
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+    if (item_count > SIZE_MAX / key_size) {
+        fprintf(stderr, "The batch is too large.\n");
+        ret = IQR_ENOMEM;
+        goto end;
     }
 
-    return IQR_OK;
+    fprintf(stdout, "Batch contains %zu secrets.\n", item_count);
+
+    /* One allocation holds every derived key. */
+    keys_size = item_count * key_size;
+    keys = calloc(1, keys_size);
+    if (keys == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    const uint64_t start = time_now_ns();
+    ret = kdf_derive_batch(hash, cb, items, item_count, keys, key_size, threads);
+    const uint64_t elapsed = time_now_ns() - start;
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    fprintf(stdout, "Keys have been derived in %.3f ms (%.0f keys/s).\n", (double)elapsed / 1e6,
+        (double)item_count * 1e9 / (double)(elapsed > 0 ? elapsed : 1));
+
+    ret = save_data(key_file, keys, keys_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    fprintf(stdout, "Derived keys have been saved to disk.\n");
+
+end:
+    /* The batch holds the decoded secrets and the keys buffer holds every
+     * derived key; wipe both.
+     */
+    if (keys != NULL) {
+        secure_memzero(keys, keys_size);
+    }
+    if (batch != NULL) {
+        secure_memzero(batch, batch_size);
+    }
+    free(keys);
+    free(items);
+    free(batch);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// KDF.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash)
+{
+    /* Create a context with the chosen hash function registered. */
+    return bootstrap_context(&hash, 1, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -123,7 +198,7 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, co
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static void preamble(const char *cmd, iqr_HashAlgorithmType hash, const uint8_t *secret, const char *secret_file,
-    const uint8_t *info, const char *info_file, size_t key_size, const char *key_file)
+    const uint8_t *info, const char *info_file, size_t key_size, const char *key_file, const char *batch_file, uint32_t threads)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
 
@@ -138,12 +213,17 @@ static void preamble(const char *cmd, iqr_HashAlgorithmType hash, const uint8_t
     } else if (IQR_HASHALGO_SHA3_512 == hash) {
         fprintf(stdout, "    hash algorithm: IQR_HASHALGO_SHA3_512\n");
     }
-    if (secret != NULL) {
+    if (batch_file != NULL) {
+        fprintf(stdout, "    batch file: %s\n", batch_file);
+        fprintf(stdout, "    threads: %u\n", threads);
+    } else if (secret != NULL) {
         fprintf(stdout, "    shared secret: %s\n", secret);
     } else if (secret_file != NULL) {
         fprintf(stdout, "    shared secret file: %s\n", secret_file);
     }
-    if (info != NULL) {
+    if (batch_file != NULL) {
+        /* The info strings come from the batch file. */
+    } else if (info != NULL) {
         fprintf(stdout, "    info: %s\n", info);
     } else if (info_file != NULL) {
         fprintf(stdout, "    info file: %s\n", info_file);
@@ -178,7 +258,7 @@ static int32_t get_positive_int_param(const char *p) {
 
 static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash, const iqr_HashCallbacks **cb,
     const uint8_t **secret, const char **secret_file, const uint8_t **info, const char **info_file,
-    size_t *key_size, const char **key_file)
+    size_t *key_size, const char **key_file, const char **batch_file, uint32_t *threads)
 {
 
     int i = 1;
@@ -268,6 +348,19 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             /* [--keyfile <output key file>] */
             i++;
             *key_file = argv[i];
+        } else if (paramcmp(argv[i], "--batch") == 0) {
+            /* [--batch <batch file>] */
+            i++;
+            *batch_file = argv[i];
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            int32_t count = get_positive_int_param(argv[i]);
+            if (count <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)count;
         }
         i++;
     }
@@ -292,23 +385,32 @@ int main(int argc, const char **argv)
 
     const char *secret_file = NULL;
     const char *info_file = NULL;
+    const char *batch_file = NULL;
+    uint32_t threads = 1;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &secret, &secret_file, &info, &info_file, &key_size, &key_file);
+    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &secret, &secret_file, &info, &info_file, &key_size, &key_file,
+        &batch_file, &threads);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], hash, secret, secret_file, info, info_file, key_size, key_file);
+    preamble(argv[0], hash, secret, secret_file, info, info_file, key_size, key_file, batch_file, threads);
+
+    if (batch_file != NULL) {
+        /* Batch mode manages its own per-thread contexts. */
+        ret = showcase_kdf_concatenation_batch(hash, cb, batch_file, key_size, key_file, threads);
+        return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     /* IQR initialization that is not specific to KDF. */
     iqr_Context *ctx = NULL;
     uint8_t *loaded_secret = NULL;
     uint8_t *loaded_info = NULL;
-    ret = init_toolkit(&ctx, hash, cb);
+    ret = init_toolkit(&ctx, hash);
     if (ret != IQR_OK) {
         goto cleanup;
     }
@@ -358,7 +460,7 @@ cleanup:
     free(loaded_secret);
     loaded_secret = NULL;
 
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
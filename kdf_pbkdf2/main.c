@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_kdf.h"
@@ -91,23 +92,10 @@ end:
 // KDF.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb)
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, hash, cb);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    return IQR_OK;
+    /* Create a context with the chosen hash function registered. */
+    return bootstrap_context(&hash, 1, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -177,7 +165,7 @@ static int32_t get_positive_int_param(const char *p) {
     return (int32_t)l;
 }
 
-static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash, const iqr_HashCallbacks **cb,
+static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash,
     const uint8_t **password, const char **password_file, const uint8_t **salt, const char **salt_file, uint32_t *iterations,
     size_t *key_size, const char **key_file)
 {
@@ -195,19 +183,14 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             i++;
             if (paramcmp(argv[i], "sha2-256") == 0) {
                 *hash = IQR_HASHALGO_SHA2_256;
-                *cb = &IQR_HASH_DEFAULT_SHA2_256;
             } else if (paramcmp(argv[i], "sha2-384") == 0) {
                 *hash = IQR_HASHALGO_SHA2_384;
-                *cb = &IQR_HASH_DEFAULT_SHA2_384;
             } else if (paramcmp(argv[i], "sha2-512") == 0) {
                 *hash = IQR_HASHALGO_SHA2_512;
-                *cb = &IQR_HASH_DEFAULT_SHA2_512;
             } else if (paramcmp(argv[i], "sha3-256") == 0) {
                 *hash = IQR_HASHALGO_SHA3_256;
-                *cb = &IQR_HASH_DEFAULT_SHA3_256;
             } else if (paramcmp(argv[i], "sha3-512") == 0) {
                 *hash = IQR_HASHALGO_SHA3_512;
-                *cb = &IQR_HASH_DEFAULT_SHA3_512;
             } else {
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
@@ -301,7 +284,6 @@ int main(int argc, const char **argv)
      * here.
      */
     iqr_HashAlgorithmType hash = IQR_HASHALGO_SHA2_256;
-    const iqr_HashCallbacks *cb = &IQR_HASH_DEFAULT_SHA2_256;
     const uint8_t *password = (const uint8_t *)"CorrectHorseBatteryStaple";
     const uint8_t *salt = (const uint8_t *)"DEADBEEF";
     uint32_t iterations = 1000;
@@ -314,7 +296,7 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &password, &password_file, &salt, &salt_file, &iterations,
+    iqr_retval ret = parse_commandline(argc, argv, &hash, &password, &password_file, &salt, &salt_file, &iterations,
         &key_size, &key_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
@@ -327,7 +309,7 @@ int main(int argc, const char **argv)
     iqr_Context *ctx = NULL;
     uint8_t *loaded_password = NULL;
     uint8_t *loaded_salt = NULL;
-    ret = init_toolkit(&ctx, hash, cb);
+    ret = init_toolkit(&ctx, hash);
     if (ret != IQR_OK) {
         goto cleanup;
     }
@@ -369,7 +351,7 @@ cleanup:
     free(loaded_password);
     loaded_password = NULL;
 
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
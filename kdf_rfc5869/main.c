@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_kdf.h"
@@ -94,23 +95,10 @@ end:
 // KDF.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb)
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, hash, cb);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    return IQR_OK;
+    /* Create a context with the chosen hash function registered. */
+    return bootstrap_context(&hash, 1, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -184,7 +172,7 @@ static int32_t get_positive_int_param(const char *p) {
     return (int32_t)l;
 }
 
-static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash, const iqr_HashCallbacks **cb,
+static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash,
     const uint8_t **salt, const char **salt_file, const uint8_t **ikm, const char **ikm_file,
     const uint8_t **info, const char **info_file, size_t *key_size, const char **key_file)
 {
@@ -201,19 +189,14 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             i++;
             if (paramcmp(argv[i], "sha2-256") == 0) {
                 *hash = IQR_HASHALGO_SHA2_256;
-                *cb = &IQR_HASH_DEFAULT_SHA2_256;
             } else if (paramcmp(argv[i], "sha2-384") == 0) {
                 *hash = IQR_HASHALGO_SHA2_384;
-                *cb = &IQR_HASH_DEFAULT_SHA2_384;
             } else if (paramcmp(argv[i], "sha2-512") == 0) {
                 *hash = IQR_HASHALGO_SHA2_512;
-                *cb = &IQR_HASH_DEFAULT_SHA2_512;
             } else if (paramcmp(argv[i], "sha3-256") == 0) {
                 *hash = IQR_HASHALGO_SHA3_256;
-                *cb = &IQR_HASH_DEFAULT_SHA3_256;
             } else if (paramcmp(argv[i], "sha3-512") == 0) {
                 *hash = IQR_HASHALGO_SHA3_512;
-                *cb = &IQR_HASH_DEFAULT_SHA3_512;
             } else {
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
@@ -317,7 +300,6 @@ int main(int argc, const char **argv)
      * here.
      */
     iqr_HashAlgorithmType hash = IQR_HASHALGO_SHA2_256;
-    const iqr_HashCallbacks *cb = &IQR_HASH_DEFAULT_SHA2_256;
     const uint8_t *salt = (const uint8_t *)"DEADBEEF";
     const uint8_t *ikm = (const uint8_t *)"000102030405060708090a0b0c0d0e0f";
     const uint8_t *info = (const uint8_t *)"ISARA-kdf_rfc5869";
@@ -331,7 +313,7 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &salt, &salt_file, &ikm, &ikm_file, &info, &info_file,
+    iqr_retval ret = parse_commandline(argc, argv, &hash, &salt, &salt_file, &ikm, &ikm_file, &info, &info_file,
         &key_size, &key_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
@@ -346,7 +328,7 @@ int main(int argc, const char **argv)
     uint8_t *loaded_ikm = NULL;
     size_t ikm_size = 0;
     uint8_t *loaded_info = NULL;
-    ret = init_toolkit(&ctx, hash, cb);
+    ret = init_toolkit(&ctx, hash);
     if (ret != IQR_OK) {
         goto cleanup;
     }
@@ -412,7 +394,7 @@ cleanup:
     free(loaded_salt);
     loaded_salt = NULL;
 
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,718 @@
+/** @file main.c
+ *
+ * @brief Compare the speed of the toolkit's key encapsulation mechanisms.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "kem_table.h"
+#include "rng_pool.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"kem_bench [--kem all|<kem>[,<kem>...]] [--iterations <count>]\n"
+"  [--keygen-iterations <count>] [--threads <count>[,<count>...]]\n"
+"  [--format csv|json] [--output <filename>]\n"
+"    <kem> is one of kyber-128, kyber-224, frodokem-aes, frodokem-shake,\n"
+"    ntruprime, sike-p503, sike-p751, classicmceliece-6 or\n"
+"    classicmceliece-8.\n"
+"    Defaults are: \n"
+"        --kem all\n"
+"        --iterations 1000\n"
+"        --keygen-iterations 100\n"
+"        --threads 1\n"
+"        --format csv\n"
+"        --output stdout\n"
+"  Times key generation, encapsulation and decapsulation for each KEM and\n"
+"  thread count. Every thread does the given number of iterations of each\n"
+"  operation.\n";
+
+#define MAX_THREAD_COUNTS 16
+
+typedef enum {
+    OP_KEYGEN,
+    OP_ENCAPSULATE,
+    OP_DECAPSULATE,
+    OP_COUNT
+} kem_op;
+
+static const char *op_names[OP_COUNT] = { "keygen", "encapsulate", "decapsulate" };
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSON
+} output_format;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Worker threads.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Holds the workers until they're all ready, so they start timing together. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t ready;
+    bool go;
+} start_gate;
+
+typedef struct {
+    const kem_scheme *kem;
+    const void *params;
+    const kem_sizes *sizes;
+    rng_pool *rngs;
+    start_gate *gate;
+    size_t iterations[OP_COUNT];
+
+    /* Per-operation timings, one entry per iteration. */
+    uint64_t *ns[OP_COUNT];
+    uint64_t *cycles[OP_COUNT];
+    uint64_t elapsed[OP_COUNT];
+
+    iqr_retval ret;
+} bench_worker;
+
+static iqr_retval time_keygen(bench_worker *w, const iqr_RNG *rng, void **pub, void **priv)
+{
+    iqr_retval ret = IQR_OK;
+    const uint64_t phase_start = time_now_ns();
+    for (size_t i = 0; i < w->iterations[OP_KEYGEN]; i++) {
+        /* Keep the last key pair for the other operations. */
+        if (*pub != NULL) {
+            w->kem->destroy_public_key(pub);
+            w->kem->destroy_private_key(priv);
+        }
+
+        const uint64_t c0 = cycles_now();
+        const uint64_t t0 = time_now_ns();
+        ret = w->kem->create_key_pair(w->params, rng, pub, priv);
+        w->ns[OP_KEYGEN][i] = time_now_ns() - t0;
+        w->cycles[OP_KEYGEN][i] = cycles_now() - c0;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    w->elapsed[OP_KEYGEN] = time_now_ns() - phase_start;
+
+    return ret;
+}
+
+static iqr_retval time_encapsulate(bench_worker *w, const iqr_RNG *rng, const void *pub, uint8_t *ciphertext, uint8_t *key)
+{
+    const uint64_t phase_start = time_now_ns();
+    for (size_t i = 0; i < w->iterations[OP_ENCAPSULATE]; i++) {
+        const uint64_t c0 = cycles_now();
+        const uint64_t t0 = time_now_ns();
+        iqr_retval ret = w->kem->encapsulate(pub, rng, ciphertext, w->sizes->ciphertext, key, w->sizes->shared_key);
+        w->ns[OP_ENCAPSULATE][i] = time_now_ns() - t0;
+        w->cycles[OP_ENCAPSULATE][i] = cycles_now() - c0;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    w->elapsed[OP_ENCAPSULATE] = time_now_ns() - phase_start;
+
+    return IQR_OK;
+}
+
+static iqr_retval time_decapsulate(bench_worker *w, const void *priv, const uint8_t *ciphertext, uint8_t *key)
+{
+    const uint64_t phase_start = time_now_ns();
+    for (size_t i = 0; i < w->iterations[OP_DECAPSULATE]; i++) {
+        const uint64_t c0 = cycles_now();
+        const uint64_t t0 = time_now_ns();
+        iqr_retval ret = w->kem->decapsulate(priv, ciphertext, w->sizes->ciphertext, key, w->sizes->shared_key);
+        w->ns[OP_DECAPSULATE][i] = time_now_ns() - t0;
+        w->cycles[OP_DECAPSULATE][i] = cycles_now() - c0;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    w->elapsed[OP_DECAPSULATE] = time_now_ns() - phase_start;
+
+    return IQR_OK;
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_worker *w = arg;
+    void *pub = NULL;
+    void *priv = NULL;
+    iqr_RNG *rng = NULL;
+
+    uint8_t *ciphertext = calloc(1, w->sizes->ciphertext);
+    uint8_t *sent_key = calloc(1, w->sizes->shared_key);
+    uint8_t *received_key = calloc(1, w->sizes->shared_key);
+    if (ciphertext == NULL || sent_key == NULL || received_key == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        w->ret = IQR_ENOMEM;
+    } else {
+        w->ret = rng_pool_thread_rng(w->rngs, &rng);
+    }
+
+    pthread_mutex_lock(&w->gate->lock);
+    w->gate->ready++;
+    pthread_cond_broadcast(&w->gate->cond);
+    while (!w->gate->go) {
+        pthread_cond_wait(&w->gate->cond, &w->gate->lock);
+    }
+    pthread_mutex_unlock(&w->gate->lock);
+
+    if (w->ret == IQR_OK) {
+        w->ret = time_keygen(w, rng, &pub, &priv);
+    }
+    if (w->ret == IQR_OK) {
+        w->ret = time_encapsulate(w, rng, pub, ciphertext, sent_key);
+    }
+    if (w->ret == IQR_OK) {
+        w->ret = time_decapsulate(w, priv, ciphertext, received_key);
+    }
+
+    /* A benchmark of a broken KEM isn't worth much. */
+    if (w->ret == IQR_OK && memcmp(sent_key, received_key, w->sizes->shared_key) != 0) {
+        fprintf(stderr, "%s: the shared keys don't match!\n", w->kem->name);
+        w->ret = IQR_EINVDATA;
+    }
+
+    if (pub != NULL) {
+        w->kem->destroy_public_key(&pub);
+    }
+    if (priv != NULL) {
+        w->kem->destroy_private_key(&priv);
+    }
+    if (sent_key != NULL) {
+        secure_memzero(sent_key, w->sizes->shared_key);
+    }
+    if (received_key != NULL) {
+        secure_memzero(received_key, w->sizes->shared_key);
+    }
+    free(ciphertext);
+    free(sent_key);
+    free(received_key);
+
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmark driver.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    FILE *out;
+    output_format format;
+    bool first_row;
+} bench_output;
+
+typedef struct {
+    size_t count;
+    uint64_t min_ns;
+    uint64_t median_ns;
+    uint64_t p99_ns;
+    uint64_t median_cycles;
+    double ops_per_sec;
+} op_stats;
+
+static int compare_u64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorts the samples in place. */
+static void summarize(uint64_t *ns, uint64_t *cycles, size_t count, op_stats *stats)
+{
+    qsort(ns, count, sizeof(*ns), compare_u64);
+    qsort(cycles, count, sizeof(*cycles), compare_u64);
+
+    stats->count = count;
+    stats->min_ns = ns[0];
+    stats->median_ns = ns[count / 2];
+    stats->p99_ns = ns[(count * 99) / 100];
+    stats->median_cycles = cycles[count / 2];
+}
+
+static void report(bench_output *output, const kem_scheme *kem, const kem_sizes *sizes, uint32_t threads, kem_op op,
+    const op_stats *stats, uint64_t rss)
+{
+    const bool have_cycles = cycle_counter_available();
+
+    if (output->format == FORMAT_CSV) {
+        fprintf(output->out, "%s,%u,%s,%zu,%.2f,%.2f,%.2f,%.1f,", kem->name, threads, op_names[op], stats->count,
+            (double)stats->min_ns / 1e3, (double)stats->median_ns / 1e3, (double)stats->p99_ns / 1e3, stats->ops_per_sec);
+        if (have_cycles) {
+            fprintf(output->out, "%llu", (unsigned long long)stats->median_cycles);
+        }
+        fprintf(output->out, ",%llu,%zu,%zu,%zu,%zu\n", (unsigned long long)(rss / 1024), sizes->public_key,
+            sizes->private_key, sizes->ciphertext, sizes->shared_key);
+    } else {
+        fprintf(output->out, "%s  {\"kem\": \"%s\", \"threads\": %u, \"operation\": \"%s\", \"iterations\": %zu, "
+            "\"min_us\": %.2f, \"median_us\": %.2f, \"p99_us\": %.2f, \"ops_per_sec\": %.1f, \"median_cycles\": ",
+            output->first_row ? "" : ",\n", kem->name, threads, op_names[op], stats->count, (double)stats->min_ns / 1e3,
+            (double)stats->median_ns / 1e3, (double)stats->p99_ns / 1e3, stats->ops_per_sec);
+        if (have_cycles) {
+            fprintf(output->out, "%llu", (unsigned long long)stats->median_cycles);
+        } else {
+            fprintf(output->out, "null");
+        }
+        fprintf(output->out, ", \"peak_rss_kb\": %llu, \"public_key_bytes\": %zu, \"private_key_bytes\": %zu, "
+            "\"ciphertext_bytes\": %zu, \"shared_key_bytes\": %zu}", (unsigned long long)(rss / 1024), sizes->public_key,
+            sizes->private_key, sizes->ciphertext, sizes->shared_key);
+    }
+    output->first_row = false;
+}
+
+static iqr_retval gather(bench_worker *workers, uint32_t threads, kem_op op, op_stats *stats)
+{
+    size_t total = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        total += workers[t].iterations[op];
+    }
+
+    uint64_t *ns = calloc(total, sizeof(*ns));
+    uint64_t *cycles = calloc(total, sizeof(*cycles));
+    if (ns == NULL || cycles == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(cycles);
+        free(ns);
+        return IQR_ENOMEM;
+    }
+
+    /* Every thread runs flat out, so the threads' rates add up. */
+    size_t offset = 0;
+    stats->ops_per_sec = 0.0;
+    for (uint32_t t = 0; t < threads; t++) {
+        const size_t n = workers[t].iterations[op];
+        memcpy(ns + offset, workers[t].ns[op], n * sizeof(*ns));
+        memcpy(cycles + offset, workers[t].cycles[op], n * sizeof(*cycles));
+        offset += n;
+        if (workers[t].elapsed[op] > 0) {
+            stats->ops_per_sec += (double)n * 1e9 / (double)workers[t].elapsed[op];
+        }
+    }
+
+    summarize(ns, cycles, total, stats);
+
+    free(cycles);
+    free(ns);
+    return IQR_OK;
+}
+
+static void free_workers(bench_worker *workers, uint32_t threads)
+{
+    for (uint32_t t = 0; t < threads; t++) {
+        for (int op = 0; op < OP_COUNT; op++) {
+            free(workers[t].ns[op]);
+            free(workers[t].cycles[op]);
+        }
+    }
+    free(workers);
+}
+
+static iqr_retval bench_kem(const iqr_Context *ctx, const kem_scheme *kem, rng_pool *rngs, uint32_t threads, size_t iterations,
+    size_t keygen_iterations, bench_output *output)
+{
+    void *params = NULL;
+    kem_sizes sizes;
+    pthread_t *tids = NULL;
+    uint32_t started = 0;
+
+    start_gate gate;
+    memset(&gate, 0, sizeof(gate));
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+
+    bench_worker *workers = calloc(threads, sizeof(*workers));
+    if (workers == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    /* The threads share one set of parameters, like a server would. */
+    iqr_retval ret = kem->create_params(ctx, &params);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    ret = kem->get_sizes(params, &sizes);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    tids = calloc(threads, sizeof(*tids));
+    if (tids == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    for (uint32_t t = 0; t < threads; t++) {
+        bench_worker *w = &workers[t];
+        w->kem = kem;
+        w->params = params;
+        w->sizes = &sizes;
+        w->rngs = rngs;
+        w->gate = &gate;
+        w->iterations[OP_KEYGEN] = keygen_iterations;
+        w->iterations[OP_ENCAPSULATE] = iterations;
+        w->iterations[OP_DECAPSULATE] = iterations;
+        for (int op = 0; op < OP_COUNT; op++) {
+            w->ns[op] = calloc(w->iterations[op], sizeof(uint64_t));
+            w->cycles[op] = calloc(w->iterations[op], sizeof(uint64_t));
+            if (w->ns[op] == NULL || w->cycles[op] == NULL) {
+                fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+                ret = IQR_ENOMEM;
+                goto end;
+            }
+        }
+    }
+
+    for (; started < threads; started++) {
+        const int rc = pthread_create(&tids[started], NULL, bench_thread, &workers[started]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&gate.lock);
+    while (gate.ready < started) {
+        pthread_cond_wait(&gate.cond, &gate.lock);
+    }
+    gate.go = true;
+    pthread_cond_broadcast(&gate.cond);
+    pthread_mutex_unlock(&gate.lock);
+
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+        if (workers[t].ret != IQR_OK && ret == IQR_OK) {
+            ret = workers[t].ret;
+        }
+    }
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Peak RSS only ever grows, so it covers every KEM run so far. Run one
+     * KEM per process to see each one on its own.
+     */
+    const uint64_t rss = peak_rss_bytes();
+    for (int op = 0; op < OP_COUNT && ret == IQR_OK; op++) {
+        op_stats stats;
+        ret = gather(workers, threads, (kem_op)op, &stats);
+        if (ret == IQR_OK) {
+            report(output, kem, &sizes, threads, (kem_op)op, &stats, rss);
+        }
+    }
+
+end:
+    free_workers(workers, threads);
+    free(tids);
+    if (params != NULL) {
+        kem->destroy_params(&params);
+    }
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.lock);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// any one KEM.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const bool *use_kem)
+{
+    /* Create a Context. */
+    iqr_retval ret = bootstrap_context(NULL, 0, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Register the hashes every selected KEM needs, plus the DRBG's. */
+    for (size_t k = 0; k < kem_scheme_count; k++) {
+        if (use_kem[k]) {
+            ret = kem_bootstrap_context(&kem_schemes[k], ctx);
+            if (ret != IQR_OK) {
+                return ret;
+            }
+        }
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse a comma separated list of positive integers. */
+static iqr_retval get_thread_counts(const char *p, uint32_t *counts, size_t *count)
+{
+    *count = 0;
+    while (*p != '\0') {
+        char *end = NULL;
+        errno = 0;
+        const long l = strtol(p, &end, 10);
+        if (errno != 0 || end == p || l <= 0 || l > INT_MAX || *count == MAX_THREAD_COUNTS) {
+            return IQR_EBADVALUE;
+        }
+        counts[(*count)++] = (uint32_t)l;
+
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return IQR_EBADVALUE;
+        }
+        p = end;
+    }
+    return (*count > 0) ? IQR_OK : IQR_EBADVALUE;
+}
+
+/* Parse a comma separated list of KEM names, or "all". */
+static iqr_retval get_kems(const char *p, bool *use_kem)
+{
+    if (paramcmp(p, "all") == 0) {
+        for (size_t k = 0; k < kem_scheme_count; k++) {
+            use_kem[k] = true;
+        }
+        return IQR_OK;
+    }
+
+    for (size_t k = 0; k < kem_scheme_count; k++) {
+        use_kem[k] = false;
+    }
+
+    while (*p != '\0') {
+        const char *end = strchr(p, ',');
+        const size_t len = (end != NULL) ? (size_t)(end - p) : strlen(p);
+
+        bool found = false;
+        for (size_t k = 0; k < kem_scheme_count; k++) {
+            if (strlen(kem_schemes[k].name) == len && strncmp(kem_schemes[k].name, p, len) == 0) {
+                use_kem[k] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            return IQR_EBADVALUE;
+        }
+
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return IQR_OK;
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, bool *use_kem, size_t *iterations, size_t *keygen_iterations,
+    uint32_t *thread_counts, size_t *thread_count_size, output_format *format, const char **output)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--kem") == 0) {
+            /* [--kem all|<kem>[,<kem>...]] */
+            i++;
+            if (get_kems(argv[i], use_kem) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--iterations") == 0 || paramcmp(argv[i], "--keygen-iterations") == 0) {
+            /* [--iterations <count>] [--keygen-iterations <count>] */
+            const bool keygen = paramcmp(argv[i], "--keygen-iterations") == 0;
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            if (keygen) {
+                *keygen_iterations = (size_t)value;
+            } else {
+                *iterations = (size_t)value;
+            }
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>[,<count>...]] */
+            i++;
+            if (get_thread_counts(argv[i], thread_counts, thread_count_size) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--format") == 0) {
+            /* [--format csv|json] */
+            i++;
+            if (paramcmp(argv[i], "csv") == 0) {
+                *format = FORMAT_CSV;
+            } else if (paramcmp(argv[i], "json") == 0) {
+                *format = FORMAT_JSON;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output = argv[i];
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    bool *use_kem = calloc(kem_scheme_count, sizeof(*use_kem));
+    size_t iterations = 1000;
+    size_t keygen_iterations = 100;
+    uint32_t thread_counts[MAX_THREAD_COUNTS] = { 1 };
+    size_t thread_count_size = 1;
+    output_format format = FORMAT_CSV;
+    const char *output = NULL;
+
+    iqr_Context *ctx = NULL;
+    rng_pool *rngs = NULL;
+
+    if (use_kem == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    for (size_t k = 0; k < kem_scheme_count; k++) {
+        use_kem[k] = true;
+    }
+
+    iqr_retval ret = parse_commandline(argc, argv, use_kem, &iterations, &keygen_iterations, thread_counts,
+        &thread_count_size, &format, &output);
+    if (ret != IQR_OK) {
+        free(use_kem);
+        return EXIT_FAILURE;
+    }
+
+    bench_output results;
+    results.out = stdout;
+    results.format = format;
+    results.first_row = true;
+
+    if (output != NULL) {
+        results.out = fopen(output, "w");
+        if (results.out == NULL) {
+            fprintf(stderr, "Failed to open %s: %s\n", output, strerror(errno));
+            free(use_kem);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ret = init_toolkit(&ctx, use_kem);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    /* Every KEM's key generation and encapsulation is happy with a
+     * SHA2-256 HMAC-DRBG, the pool's default.
+     */
+    ret = rng_pool_create(ctx, NULL, &rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto cleanup;
+    }
+
+    if (format == FORMAT_CSV) {
+        fprintf(results.out, "kem,threads,operation,iterations,min_us,median_us,p99_us,ops_per_sec,median_cycles,peak_rss_kb,"
+            "public_key_bytes,private_key_bytes,ciphertext_bytes,shared_key_bytes\n");
+    } else {
+        fprintf(results.out, "[\n");
+    }
+
+    for (size_t k = 0; k < kem_scheme_count && ret == IQR_OK; k++) {
+        if (!use_kem[k]) {
+            continue;
+        }
+        for (size_t t = 0; t < thread_count_size && ret == IQR_OK; t++) {
+            ret = bench_kem(ctx, &kem_schemes[k], rngs, thread_counts[t], iterations, keygen_iterations, &results);
+        }
+    }
+
+    if (format == FORMAT_JSON) {
+        fprintf(results.out, "\n]\n");
+    }
+
+    /* The one-off set-up cost, kept out of the results. */
+    bootstrap_print_stats(stderr);
+
+cleanup:
+    rng_pool_destroy(&rngs);
+    bootstrap_release();
+    if (results.out != stdout) {
+        fclose(results.out);
+    }
+    free(use_kem);
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,370 @@
+/** @file client.c
+ *
+ * @brief Send ciphertexts to kem_server and measure the round trip.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "iqr_retval.h"
+#include "isara_samples.h"
+#include "latency.h"
+#include "protocol.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"kem_client [--socket <path>] [--key-index <index>] [--ciphertext <filename>]\n"
+"  [--requests <count>] [--connections <count>] [--expect <filename>]\n"
+"    Default for the sample (when no option is specified):\n"
+"        --socket " KEM_DEFAULT_SOCKET "\n"
+"        --key-index 0\n"
+"        --ciphertext ciphertext.dat\n"
+"        --requests 1000\n"
+"        --connections 1\n"
+"  Sends the ciphertext to kem_server <count> times, spread over the given\n"
+"  number of concurrent connections, and reports the round trip latency.\n"
+"  With --expect, every shared key is compared against the file's contents.\n";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Sending requests.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const char *socket_path;
+    const uint8_t *request;
+    size_t request_size;
+    const uint8_t *expected;
+    size_t expected_size;
+    uint64_t requests;
+
+    pthread_t thread;
+    latency_histogram latency;
+    iqr_retval result;
+} connection;
+
+static int connect_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "The socket path %s is too long.\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Failed on socket(): %s\n", strerror(errno));
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Failed on connect(): %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static iqr_retval send_requests(connection *c, int fd)
+{
+    uint8_t header[KEM_HEADER_SIZE];
+    uint8_t shared_key[256];
+
+    for (uint64_t i = 0; i < c->requests; i++) {
+        const uint64_t start = time_now_ns();
+
+        if (!kem_write_full(fd, c->request, c->request_size) || !kem_read_full(fd, header, sizeof(header))) {
+            fprintf(stderr, "The server closed the connection.\n");
+            return IQR_EINVDATA;
+        }
+
+        const uint32_t status = get_u32(header);
+        const uint32_t key_size = get_u32(header + 4);
+        if (key_size > sizeof(shared_key) || !kem_read_full(fd, shared_key, key_size)) {
+            fprintf(stderr, "The server sent a malformed response.\n");
+            return IQR_EINVDATA;
+        }
+
+        latency_record(&c->latency, time_now_ns() - start);
+
+        if (status != KEM_STATUS_OK) {
+            fprintf(stderr, "The server refused the request: %s\n", kem_status_str(status));
+            return IQR_EINVDATA;
+        }
+        if (c->expected != NULL
+            && (key_size != c->expected_size || memcmp(shared_key, c->expected, key_size) != 0)) {
+            fprintf(stderr, "The shared key doesn't match the expected one!\n");
+            secure_memzero(shared_key, sizeof(shared_key));
+            return IQR_EINVDATA;
+        }
+    }
+
+    secure_memzero(shared_key, sizeof(shared_key));
+    return IQR_OK;
+}
+
+static void *connection_thread(void *arg)
+{
+    connection *c = arg;
+
+    const int fd = connect_socket(c->socket_path);
+    if (fd < 0) {
+        c->result = IQR_EINVDATA;
+        return NULL;
+    }
+
+    c->result = send_requests(c, fd);
+    close(fd);
+
+    return NULL;
+}
+
+static iqr_retval showcase_kem_client(const char *socket_path, uint8_t key_index, const char *ciphertext_file,
+    uint64_t requests, uint32_t connections, const char *expect_file)
+{
+    uint8_t *ciphertext = NULL;
+    size_t ciphertext_size = 0;
+    uint8_t *expected = NULL;
+    size_t expected_size = 0;
+    uint8_t *request = NULL;
+    connection *conns = NULL;
+    latency_histogram *total = NULL;
+    uint32_t started = 0;
+
+    iqr_retval ret = load_data(ciphertext_file, &ciphertext, &ciphertext_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    if (ciphertext_size > KEM_MAX_CIPHERTEXT_SIZE) {
+        fprintf(stderr, "The ciphertext is too large for the protocol.\n");
+        ret = IQR_EINVBUFSIZE;
+        goto end;
+    }
+
+    if (expect_file != NULL) {
+        ret = load_data(expect_file, &expected, &expected_size);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+    }
+
+    /* Every request is the same, so build it once. */
+    const size_t request_size = KEM_HEADER_SIZE + ciphertext_size;
+    request = calloc(1, request_size);
+    conns = calloc(connections, sizeof(*conns));
+    total = malloc(sizeof(*total));
+    if (request == NULL || conns == NULL || total == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+    request[0] = key_index;
+    put_u32(request + 4, (uint32_t)ciphertext_size);
+    memcpy(request + KEM_HEADER_SIZE, ciphertext, ciphertext_size);
+
+    const uint64_t start = time_now_ns();
+    for (; started < connections; started++) {
+        connection *c = &conns[started];
+        c->socket_path = socket_path;
+        c->request = request;
+        c->request_size = request_size;
+        c->expected = expected;
+        c->expected_size = expected_size;
+        c->requests = requests / connections + (started < requests % connections ? 1 : 0);
+        latency_reset(&c->latency);
+
+        const int rc = pthread_create(&c->thread, NULL, connection_thread, c);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+    }
+
+    latency_reset(total);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(conns[i].thread, NULL);
+        latency_merge(total, &conns[i].latency);
+        if (conns[i].result != IQR_OK && ret == IQR_OK) {
+            ret = conns[i].result;
+        }
+    }
+    const double seconds = (double)(time_now_ns() - start) / 1e9;
+
+    fprintf(stdout, "Completed %llu requests in %.2f s (%.1f requests/sec).\n", (unsigned long long)total->count, seconds,
+        seconds > 0.0 ? (double)total->count / seconds : 0.0);
+    latency_print(stdout, "Round trip", total);
+    if (ret == IQR_OK && expected != NULL) {
+        fprintf(stdout, "Every shared key matched %s.\n", expect_file);
+    }
+
+end:
+    if (expected != NULL) {
+        secure_memzero(expected, expected_size);
+    }
+    free(expected);
+    free(ciphertext);
+    free(request);
+    free(conns);
+    free(total);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user use the sample or are
+// generic utility functions. This section has little value to the developer
+// trying to learn how to use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Report the chosen runtime parameters.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void preamble(const char *cmd, const char *socket_path, uint8_t key_index, const char *ciphertext_file,
+    uint64_t requests, uint32_t connections, const char *expect_file)
+{
+    fprintf(stdout, "Running %s with the following parameters:\n", cmd);
+    fprintf(stdout, "    socket: %s\n", socket_path);
+    fprintf(stdout, "    key index: %u\n", (unsigned int)key_index);
+    fprintf(stdout, "    ciphertext file: %s\n", ciphertext_file);
+    fprintf(stdout, "    requests: %llu\n", (unsigned long long)requests);
+    fprintf(stdout, "    connections: %u\n", connections);
+    if (expect_file != NULL) {
+        fprintf(stdout, "    expected shared key file: %s\n", expect_file);
+    }
+    fprintf(stdout, "\n");
+}
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse the command line options. */
+static iqr_retval parse_commandline(int argc, const char **argv, const char **socket_path, uint8_t *key_index,
+    const char **ciphertext_file, uint64_t *requests, uint32_t *connections, const char **expect_file)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--socket") == 0) {
+            /* [--socket <path>] */
+            i++;
+            *socket_path = argv[i];
+        } else if (paramcmp(argv[i], "--ciphertext") == 0) {
+            /* [--ciphertext <filename>] */
+            i++;
+            *ciphertext_file = argv[i];
+        } else if (paramcmp(argv[i], "--expect") == 0) {
+            /* [--expect <filename>] */
+            i++;
+            *expect_file = argv[i];
+        } else {
+            /* The remaining options all take a non-negative integer. */
+            const char *option = argv[i];
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+
+            if (paramcmp(option, "--key-index") == 0 && value <= UINT8_MAX) {
+                *key_index = (uint8_t)value;
+            } else if (paramcmp(option, "--requests") == 0 && value > 0) {
+                *requests = (uint64_t)value;
+            } else if (paramcmp(option, "--connections") == 0 && value > 0 && value <= 1024) {
+                *connections = (uint32_t)value;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        }
+        i++;
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    const char *socket_path = KEM_DEFAULT_SOCKET;
+    uint8_t key_index = 0;
+    const char *ciphertext_file = "ciphertext.dat";
+    uint64_t requests = 1000;
+    uint32_t connections = 1;
+    const char *expect_file = NULL;
+
+    /* If the command line arguments were not sane, this function will return
+     * an error.
+     */
+    iqr_retval ret = parse_commandline(argc, argv, &socket_path, &key_index, &ciphertext_file, &requests, &connections,
+        &expect_file);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    /* Show the parameters for the program. */
+    preamble(argv[0], socket_path, key_index, ciphertext_file, requests, connections, expect_file);
+
+    /* The client doesn't need the toolkit; the server does the work. */
+    ret = showcase_kem_client(socket_path, key_index, ciphertext_file, requests, connections, expect_file);
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
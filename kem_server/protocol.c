@@ -0,0 +1,76 @@
+/** @file protocol.c
+ *
+ * @brief The wire format shared by kem_server and kem_client.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "protocol.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+bool kem_read_full(int fd, void *buf, size_t size)
+{
+    uint8_t *p = buf;
+    while (size > 0) {
+        const ssize_t got = read(fd, p, size);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (got == 0) {
+            return false;
+        }
+        p += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+bool kem_write_full(int fd, const void *buf, size_t size)
+{
+    const uint8_t *p = buf;
+    while (size > 0) {
+        const ssize_t put = write(fd, p, size);
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += put;
+        size -= (size_t)put;
+    }
+    return true;
+}
+
+const char *kem_status_str(uint32_t status)
+{
+    switch (status) {
+    case KEM_STATUS_OK:
+        return "OK";
+    case KEM_STATUS_BAD_KEY:
+        return "no such key";
+    case KEM_STATUS_BAD_CIPHERTEXT:
+        return "wrong ciphertext size";
+    case KEM_STATUS_FAILED:
+        return "decapsulation failed";
+    default:
+        return "unknown status";
+    }
+}
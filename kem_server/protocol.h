@@ -0,0 +1,70 @@
+/** @file protocol.h
+ *
+ * @brief The wire format shared by kem_server and kem_client.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* A connection carries any number of requests, answered in order.
+ *
+ * Request:  u8 key index, 3 zero bytes, u32 ciphertext size, ciphertext.
+ * Response: u32 status, u32 shared key size, shared key.
+ *
+ * Integers are big-endian. The shared key is only sent when the status is
+ * KEM_STATUS_OK; otherwise its size is 0.
+ */
+
+/** Size of a request or response header in bytes. */
+#define KEM_HEADER_SIZE 8
+
+/** Largest ciphertext the server accepts. FrodoKEM's is the biggest. */
+#define KEM_MAX_CIPHERTEXT_SIZE (64 * 1024)
+
+/** Default socket path. */
+#define KEM_DEFAULT_SOCKET "kem_server.sock"
+
+typedef enum {
+    KEM_STATUS_OK = 0,
+    /** There's no key with the requested index. */
+    KEM_STATUS_BAD_KEY = 1,
+    /** The ciphertext has the wrong size for the key. */
+    KEM_STATUS_BAD_CIPHERTEXT = 2,
+    /** Decapsulation failed. */
+    KEM_STATUS_FAILED = 3
+} kem_status;
+
+/** Read exactly @a size bytes, retrying short reads.
+ *
+ * @return true on success; false on error or end of file.
+ */
+bool kem_read_full(int fd, void *buf, size_t size);
+
+/** Write exactly @a size bytes, retrying short writes.
+ *
+ * @return true on success, false on error.
+ */
+bool kem_write_full(int fd, const void *buf, size_t size);
+
+/** Describe a status code. */
+const char *kem_status_str(uint32_t status);
+
+#endif
@@ -0,0 +1,783 @@
+/** @file server.c
+ *
+ * @brief A KEM decapsulation service that keeps its private keys imported.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_retval.h"
+#include "isara_samples.h"
+#include "kem_table.h"
+#include "latency.h"
+#include "protocol.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"kem_server --key <kem>=<filename> [--key <kem>=<filename> ...]\n"
+"  [--socket <path>] [--threads <count>]\n"
+"    <kem> is one of kyber-128, kyber-224, frodokem-aes, frodokem-shake,\n"
+"    ntruprime, sike-p503, sike-p751, classicmceliece-6 or\n"
+"    classicmceliece-8.\n"
+"    Default for the sample (when no option is specified):\n"
+"        --socket " KEM_DEFAULT_SOCKET "\n"
+"        --threads 4\n"
+"  Imports each private key once, then decapsulates ciphertexts sent to the\n"
+"  Unix domain socket until interrupted. Keys are numbered from 0 in the\n"
+"  order they're given. Press Ctrl-C to stop and print a summary.\n";
+
+/* Most keys that can be served at once; the request's key index is a byte. */
+#define MAX_KEYS 16
+
+/* How often blocked threads check whether they should stop, in ms. */
+#define POLL_INTERVAL_MS 250
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Server state.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const kem_scheme *kem;
+    const char *file;
+    void *params;
+    void *priv;
+    kem_sizes sizes;
+} server_key;
+
+/* Accepted connections waiting for a worker. */
+typedef struct {
+    int *fds;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    bool closing;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} connection_queue;
+
+typedef struct {
+    const server_key *keys;
+    size_t key_count;
+    connection_queue *queue;
+
+    pthread_t thread;
+
+    /* Scratch buffers, allocated once so requests don't touch the heap. */
+    uint8_t *ciphertext;
+    uint8_t *response;
+    size_t response_size;
+
+    latency_histogram latency;
+    uint64_t rejected;
+    uint64_t first_ns;
+    uint64_t last_ns;
+} worker;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+static bool should_stop(void)
+{
+    return stop_requested != 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Connection queue.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static bool queue_push(connection_queue *q, int fd)
+{
+    pthread_mutex_lock(&q->lock);
+    const bool full = (q->count == q->capacity);
+    if (!full) {
+        q->fds[(q->head + q->count) % q->capacity] = fd;
+        q->count++;
+        pthread_cond_signal(&q->ready);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return !full;
+}
+
+/* Returns -1 once the queue is closing. */
+static int queue_pop(connection_queue *q)
+{
+    int fd = -1;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closing) {
+        pthread_cond_wait(&q->ready, &q->lock);
+    }
+    if (q->count > 0) {
+        fd = q->fds[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return fd;
+}
+
+static void queue_close(connection_queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closing = true;
+    pthread_cond_broadcast(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Serving requests.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Wait for data without blocking a shutdown for more than POLL_INTERVAL_MS. */
+static bool wait_readable(int fd)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (!should_stop()) {
+        pfd.revents = 0;
+        const int rc = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (rc > 0) {
+            return true;
+        }
+        if (rc < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static uint32_t decapsulate_request(worker *w, uint8_t key_index, size_t ciphertext_size, size_t *shared_key_size)
+{
+    *shared_key_size = 0;
+
+    if (key_index >= w->key_count) {
+        return KEM_STATUS_BAD_KEY;
+    }
+
+    const server_key *key = &w->keys[key_index];
+    if (ciphertext_size != key->sizes.ciphertext) {
+        return KEM_STATUS_BAD_CIPHERTEXT;
+    }
+
+    iqr_retval ret = key->kem->decapsulate(key->priv, w->ciphertext, ciphertext_size, w->response + KEM_HEADER_SIZE,
+        key->sizes.shared_key);
+    if (ret != IQR_OK) {
+        return KEM_STATUS_FAILED;
+    }
+
+    *shared_key_size = key->sizes.shared_key;
+    return KEM_STATUS_OK;
+}
+
+static void serve_connection(worker *w, int fd)
+{
+    uint8_t header[KEM_HEADER_SIZE];
+
+    while (wait_readable(fd)) {
+        if (!kem_read_full(fd, header, sizeof(header))) {
+            break;  // The client hung up.
+        }
+
+        const uint8_t key_index = header[0];
+        const uint32_t ciphertext_size = get_u32(header + 4);
+        if (ciphertext_size > KEM_MAX_CIPHERTEXT_SIZE) {
+            /* We can't skip a ciphertext we won't read, so drop the
+             * connection.
+             */
+            w->rejected++;
+            break;
+        }
+        if (!kem_read_full(fd, w->ciphertext, ciphertext_size)) {
+            break;
+        }
+
+        const uint64_t start = time_now_ns();
+
+        size_t shared_key_size = 0;
+        const uint32_t status = decapsulate_request(w, key_index, ciphertext_size, &shared_key_size);
+        put_u32(w->response, status);
+        put_u32(w->response + 4, (uint32_t)shared_key_size);
+
+        const bool sent = kem_write_full(fd, w->response, KEM_HEADER_SIZE + shared_key_size);
+        secure_memzero(w->response + KEM_HEADER_SIZE, shared_key_size);
+        if (!sent) {
+            break;
+        }
+
+        if (status == KEM_STATUS_OK) {
+            const uint64_t end = time_now_ns();
+            latency_record(&w->latency, end - start);
+            if (w->first_ns == 0) {
+                w->first_ns = start;
+            }
+            w->last_ns = end;
+        } else {
+            w->rejected++;
+        }
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    worker *w = arg;
+
+    for (;;) {
+        const int fd = queue_pop(w->queue);
+        if (fd < 0) {
+            break;
+        }
+        serve_connection(w, fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Running the server.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Remove the socket at @a path, but never anything else that's there, such as
+ * a regular file named with --socket by mistake.
+ */
+static bool remove_socket(const char *path)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        fprintf(stderr, "Failed on lstat(): %s\n", strerror(errno));
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        fprintf(stderr, "%s exists and isn't a socket; not replacing it.\n", path);
+        return false;
+    }
+    if (unlink(path) != 0) {
+        fprintf(stderr, "Failed to remove %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static int open_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "The socket path %s is too long.\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Failed on socket(): %s\n", strerror(errno));
+        return -1;
+    }
+
+    /* Clear out a socket left behind by an earlier run. */
+    if (!remove_socket(path)) {
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Failed on bind(): %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Failed on listen(): %s\n", strerror(errno));
+        close(fd);
+        remove_socket(path);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void install_signal_handlers(void)
+{
+    /* No SA_RESTART, so a blocking call returns EINTR and we notice the stop
+     * request straight away.
+     */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* A client that hangs up early shouldn't kill the server. */
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+}
+
+static void accept_connections(int listen_fd, connection_queue *queue, uint64_t *dropped)
+{
+    struct pollfd pfd;
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+
+    while (!should_stop()) {
+        pfd.revents = 0;
+        const int rc = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (rc <= 0) {
+            continue;
+        }
+
+        const int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                fprintf(stderr, "Failed on accept(): %s\n", strerror(errno));
+            }
+            continue;
+        }
+        if (!queue_push(queue, fd)) {
+            close(fd);
+            (*dropped)++;
+        }
+    }
+}
+
+static void report(const worker *workers, uint32_t threads, uint64_t dropped)
+{
+    latency_histogram *total = malloc(sizeof(*total));
+    if (total == NULL) {
+        fprintf(stderr, "Failed on malloc(): %s\n", strerror(errno));
+        return;
+    }
+    latency_reset(total);
+
+    /* Throughput is measured from the first request to the last, so time
+     * spent waiting for clients doesn't count.
+     */
+    uint64_t rejected = 0;
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        latency_merge(total, &workers[i].latency);
+        rejected += workers[i].rejected;
+        if (workers[i].latency.count > 0) {
+            first = (workers[i].first_ns < first) ? workers[i].first_ns : first;
+            last = (workers[i].last_ns > last) ? workers[i].last_ns : last;
+        }
+    }
+
+    const double seconds = (last > first) ? (double)(last - first) / 1e9 : 0.0;
+    fprintf(stdout, "\nServed %llu decapsulations in %.2f s (%.1f ops/sec).\n", (unsigned long long)total->count, seconds,
+        seconds > 0.0 ? (double)total->count / seconds : 0.0);
+    latency_print(stdout, "Latency", total);
+    fprintf(stdout, "Rejected requests: %llu, dropped connections: %llu\n", (unsigned long long)rejected,
+        (unsigned long long)dropped);
+
+    free(total);
+}
+
+static iqr_retval showcase_kem_server(const server_key *keys, size_t key_count, const char *socket_path, uint32_t threads)
+{
+    iqr_retval ret = IQR_OK;
+    uint32_t started = 0;
+    uint64_t dropped = 0;
+
+    connection_queue queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.capacity = (size_t)threads * 4 + 64;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+
+    size_t max_shared_key = 0;
+    for (size_t i = 0; i < key_count; i++) {
+        if (keys[i].sizes.shared_key > max_shared_key) {
+            max_shared_key = keys[i].sizes.shared_key;
+        }
+    }
+
+    worker *workers = calloc(threads, sizeof(*workers));
+    queue.fds = calloc(queue.capacity, sizeof(*queue.fds));
+    if (workers == NULL || queue.fds == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        workers[i].keys = keys;
+        workers[i].key_count = key_count;
+        workers[i].queue = &queue;
+        workers[i].response_size = KEM_HEADER_SIZE + max_shared_key;
+        workers[i].ciphertext = calloc(1, KEM_MAX_CIPHERTEXT_SIZE);
+        workers[i].response = calloc(1, workers[i].response_size);
+        if (workers[i].ciphertext == NULL || workers[i].response == NULL) {
+            fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+            ret = IQR_ENOMEM;
+            goto end;
+        }
+        latency_reset(&workers[i].latency);
+    }
+
+    const int listen_fd = open_socket(socket_path);
+    if (listen_fd < 0) {
+        ret = IQR_EINVDATA;
+        goto end;
+    }
+
+    install_signal_handlers();
+
+    /* Workers inherit this mask, so the signals are always delivered to the
+     * accepting thread.
+     */
+    sigset_t stop_signals;
+    sigset_t old_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+    for (; started < threads; started++) {
+        const int rc = pthread_create(&workers[started].thread, NULL, worker_thread, &workers[started]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    if (ret == IQR_OK) {
+        fprintf(stdout, "Listening on %s with %u worker threads. Press Ctrl-C to stop.\n", socket_path, threads);
+        fflush(stdout);
+        accept_connections(listen_fd, &queue, &dropped);
+    }
+
+    /* Workers notice the stop request between requests; queued connections
+     * that no worker picked up are closed unanswered.
+     */
+    stop_requested = 1;
+    queue_close(&queue);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    while (queue.count > 0) {
+        close(queue.fds[queue.head]);
+        queue.head = (queue.head + 1) % queue.capacity;
+        queue.count--;
+    }
+    close(listen_fd);
+    remove_socket(socket_path);
+
+    if (ret == IQR_OK) {
+        report(workers, threads, dropped);
+    }
+
+end:
+    if (workers != NULL) {
+        for (uint32_t i = 0; i < threads; i++) {
+            free(workers[i].ciphertext);
+            free(workers[i].response);
+        }
+    }
+    free(workers);
+    free(queue.fds);
+    pthread_cond_destroy(&queue.ready);
+    pthread_mutex_destroy(&queue.lock);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Importing the keys.
+//
+// This is the expensive part of a one-shot decapsulation, especially for
+// Classic McEliece, so the server only does it once per key.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval import_key(const iqr_Context *ctx, server_key *key)
+{
+    uint8_t *data = NULL;
+    size_t data_size = 0;
+
+    iqr_retval ret = key->kem->create_params(ctx, &key->params);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    ret = key->kem->get_sizes(key->params, &key->sizes);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+    if (key->sizes.ciphertext > KEM_MAX_CIPHERTEXT_SIZE) {
+        fprintf(stderr, "%s ciphertexts are too large for the protocol.\n", key->kem->name);
+        return IQR_EINVBUFSIZE;
+    }
+
+    ret = load_data(key->file, &data, &data_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    const uint64_t start = time_now_ns();
+    ret = key->kem->import_private_key(key->params, data, data_size, &key->priv);
+    if (ret == IQR_OK) {
+        fprintf(stdout, "Imported the %s private key in %.1f ms.\n", key->kem->name, (double)(time_now_ns() - start) / 1e6);
+    }
+
+    secure_memzero(data, data_size);
+    free(data);
+
+    return ret;
+}
+
+static void destroy_keys(server_key *keys, size_t key_count)
+{
+    for (size_t i = 0; i < key_count; i++) {
+        if (keys[i].priv != NULL) {
+            keys[i].kem->destroy_private_key(&keys[i].priv);
+        }
+        if (keys[i].params != NULL) {
+            keys[i].kem->destroy_params(&keys[i].params);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// any one KEM.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Initialize the toolkit by creating a context and registering the hash
+// algorithms every served KEM needs.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const server_key *keys, size_t key_count)
+{
+    /* Create a context. */
+    iqr_retval ret = bootstrap_context(NULL, 0, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* This sets the hash functions that will be used globally. */
+    for (size_t i = 0; i < key_count; i++) {
+        ret = kem_bootstrap_context(keys[i].kem, ctx);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user use the sample or are
+// generic utility functions. This section has little value to the developer
+// trying to learn how to use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Report the chosen runtime parameters.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void preamble(const char *cmd, const server_key *keys, size_t key_count, const char *socket_path, uint32_t threads)
+{
+    fprintf(stdout, "Running %s with the following parameters:\n", cmd);
+    for (size_t i = 0; i < key_count; i++) {
+        fprintf(stdout, "    key %zu: %s from %s\n", i, keys[i].kem->name, keys[i].file);
+    }
+    fprintf(stdout, "    socket: %s\n", socket_path);
+    fprintf(stdout, "    threads: %u\n", threads);
+    fprintf(stdout, "\n");
+}
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse a <kem>=<filename> key specification. */
+static iqr_retval parse_key(const char *spec, server_key *key)
+{
+    const char *eq = strchr(spec, '=');
+    if (eq == NULL || eq[1] == '\0') {
+        return IQR_EBADVALUE;
+    }
+
+    char name[32];
+    const size_t name_len = (size_t)(eq - spec);
+    if (name_len == 0 || name_len >= sizeof(name)) {
+        return IQR_EBADVALUE;
+    }
+    memcpy(name, spec, name_len);
+    name[name_len] = '\0';
+
+    key->kem = kem_find(name);
+    if (key->kem == NULL) {
+        fprintf(stdout, "Unknown KEM: %s\n", name);
+        return IQR_EBADVALUE;
+    }
+    key->file = eq + 1;
+
+    return IQR_OK;
+}
+
+/* Parse the command line options. */
+static iqr_retval parse_commandline(int argc, const char **argv, server_key *keys, size_t *key_count, const char **socket_path,
+    uint32_t *threads)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--key") == 0) {
+            /* --key <kem>=<filename> */
+            i++;
+            if (*key_count == MAX_KEYS) {
+                fprintf(stdout, "At most %d keys can be served.\n", MAX_KEYS);
+                return IQR_EBADVALUE;
+            }
+            if (parse_key(argv[i], &keys[*key_count]) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            (*key_count)++;
+        } else if (paramcmp(argv[i], "--socket") == 0) {
+            /* [--socket <path>] */
+            i++;
+            *socket_path = argv[i];
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)value;
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+
+    if (*key_count == 0) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    server_key keys[MAX_KEYS];
+    size_t key_count = 0;
+    const char *socket_path = KEM_DEFAULT_SOCKET;
+    uint32_t threads = 4;
+
+    iqr_Context *ctx = NULL;
+
+    memset(keys, 0, sizeof(keys));
+
+    /* If the command line arguments were not sane, this function will return
+     * an error.
+     */
+    iqr_retval ret = parse_commandline(argc, argv, keys, &key_count, &socket_path, &threads);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    /* Show the parameters for the program. */
+    preamble(argv[0], keys, key_count, socket_path, threads);
+
+    /* IQR initialization that is not specific to any one KEM. */
+    ret = init_toolkit(&ctx, keys, key_count);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    /* Import every private key once, up front. */
+    for (size_t i = 0; i < key_count; i++) {
+        ret = import_key(ctx, &keys[i]);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
+    /* Showcase serving decapsulations with resident keys. */
+    ret = showcase_kem_server(keys, key_count, socket_path, threads);
+
+cleanup:
+    destroy_keys(keys, key_count);
+    bootstrap_release();
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
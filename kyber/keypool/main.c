@@ -0,0 +1,483 @@
+/** @file main.c
+ *
+ * @brief Compare Kyber handshake latency with and without a key pool.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_kyber.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "keypool.h"
+#include "rng_pool.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"kyber_keypool [--security 128|224] [--handshakes <count>]\n"
+"  [--interval <microseconds>] [--capacity <count>] [--low <count>]\n"
+"  [--high <count>]\n"
+"    Default for the sample (when no option is specified):\n"
+"        --security 128\n"
+"        --handshakes 1000\n"
+"        --interval 0\n"
+"        --capacity 64\n"
+"        --low 16\n"
+"        --high 48\n"
+"  Runs the server side of an ephemeral Kyber handshake (key generation,\n"
+"  the peer's encapsulation, decapsulation) <count> times, first generating\n"
+"  each key pair on demand and then taking it from a key pool. --interval\n"
+"  sets the idle time between handshakes, which gives the pool's refill\n"
+"  thread time to keep up.\n";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Key pairs for the pool.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* What the key pool holds for Kyber: a whole key pair. */
+typedef struct {
+    iqr_KyberPublicKey *pub;
+    iqr_KyberPrivateKey *priv;
+} kyber_key_pair;
+
+static void destroy_key_pair(void *item)
+{
+    kyber_key_pair *pair = item;
+    iqr_KyberDestroyPublicKey(&pair->pub);
+    iqr_KyberDestroyPrivateKey(&pair->priv);
+    free(pair);
+}
+
+static iqr_retval create_key_pair(const void *params, const iqr_RNG *rng, void **item)
+{
+    kyber_key_pair *pair = calloc(1, sizeof(*pair));
+    if (pair == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = iqr_KyberCreateKeyPair(params, rng, &pair->pub, &pair->priv);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberCreateKeyPair(): %s\n", iqr_StrError(ret));
+        destroy_key_pair(pair);
+        return ret;
+    }
+
+    *item = pair;
+    return IQR_OK;
+}
+
+/* Take a key pair from the pool; the caller owns the keys. */
+static iqr_retval take_key_pair(keypool *pool, iqr_KyberPublicKey **pub, iqr_KyberPrivateKey **priv)
+{
+    void *item = NULL;
+    iqr_retval ret = keypool_take(pool, &item);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on keypool_take(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    kyber_key_pair *pair = item;
+    *pub = pair->pub;
+    *priv = pair->priv;
+    free(pair);
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Handshake simulation.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const iqr_KyberParams *params;
+    rng_pool *rngs;
+    keypool *pool;
+    uint8_t *ciphertext;
+    size_t ciphertext_size;
+} handshake_state;
+
+/* One ephemeral handshake, seen from the server: get a key pair, let the
+ * peer encapsulate against the public key, decapsulate the ciphertext.
+ */
+static iqr_retval handshake(handshake_state *state)
+{
+    iqr_KyberPublicKey *pub = NULL;
+    iqr_KyberPrivateKey *priv = NULL;
+    uint8_t peer_key[IQR_KYBER_SHARED_KEY_SIZE] = { 0 };
+    uint8_t our_key[IQR_KYBER_SHARED_KEY_SIZE] = { 0 };
+
+    iqr_RNG *rng = NULL;
+    iqr_retval ret = rng_pool_thread_rng(state->rngs, &rng);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (state->pool != NULL) {
+        ret = take_key_pair(state->pool, &pub, &priv);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+    } else {
+        ret = iqr_KyberCreateKeyPair(state->params, rng, &pub, &priv);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_KyberCreateKeyPair(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+    }
+
+    ret = iqr_KyberEncapsulate(pub, rng, state->ciphertext, state->ciphertext_size, peer_key, sizeof(peer_key));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberEncapsulate(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = iqr_KyberDecapsulate(priv, state->ciphertext, state->ciphertext_size, our_key, sizeof(our_key));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberDecapsulate(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    if (memcmp(peer_key, our_key, sizeof(our_key)) != 0) {
+        fprintf(stderr, "The shared keys don't match!\n");
+        ret = IQR_EINVDATA;
+    }
+
+end:
+    secure_memzero(peer_key, sizeof(peer_key));
+    secure_memzero(our_key, sizeof(our_key));
+    iqr_KyberDestroyPublicKey(&pub);
+    iqr_KyberDestroyPrivateKey(&priv);
+
+    return ret;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void idle(uint32_t interval_us)
+{
+    if (interval_us == 0) {
+        return;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)(interval_us / 1000000);
+    ts.tv_nsec = (long)(interval_us % 1000000) * 1000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        // Keep sleeping for the remainder.
+    }
+}
+
+static iqr_retval run_handshakes(const char *label, handshake_state *state, size_t handshakes, uint32_t interval_us,
+    uint64_t *latencies)
+{
+    for (size_t i = 0; i < handshakes; i++) {
+        const uint64_t start = time_now_ns();
+        iqr_retval ret = handshake(state);
+        latencies[i] = time_now_ns() - start;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+        idle(interval_us);
+    }
+
+    qsort(latencies, handshakes, sizeof(*latencies), compare_u64);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < handshakes; i++) {
+        total += latencies[i];
+    }
+
+    fprintf(stdout, "%-12s %10.1f %10.1f %10.1f %10.1f\n", label, (double)total / (double)handshakes / 1e3,
+        (double)latencies[handshakes / 2] / 1e3, (double)latencies[(handshakes * 99) / 100] / 1e3,
+        (double)latencies[handshakes - 1] / 1e3);
+
+    return IQR_OK;
+}
+
+static iqr_retval showcase_kyber_keypool(const iqr_Context *ctx, const iqr_KyberParams *params, size_t handshakes,
+    uint32_t interval_us, size_t capacity, size_t low, size_t high)
+{
+    handshake_state state;
+    memset(&state, 0, sizeof(state));
+    state.params = params;
+
+    uint64_t *latencies = calloc(handshakes, sizeof(*latencies));
+    if (latencies == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = iqr_KyberGetCiphertextSize(params, &state.ciphertext_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberGetCiphertextSize(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    state.ciphertext = calloc(1, state.ciphertext_size);
+    if (state.ciphertext == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = rng_pool_create(ctx, NULL, &state.rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    fprintf(stdout, "Handshake latency in microseconds:\n");
+    fprintf(stdout, "%-12s %10s %10s %10s %10s\n", "", "mean", "p50", "p99", "max");
+
+    ret = run_handshakes("on demand", &state, handshakes, interval_us, latencies);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Kyber's key generation and encapsulation want the DRBG to use
+     * SHA2-256.
+     */
+    const keypool_ops ops = { create_key_pair, destroy_key_pair };
+    ret = keypool_create(ctx, IQR_HASHALGO_SHA2_256, &ops, params, capacity, low, high, &state.pool);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on keypool_create(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    /* Let the refill thread fill the pool before we start timing. */
+    ret = keypool_warm(state.pool);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on keypool_warm(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = run_handshakes("key pool", &state, handshakes, interval_us, latencies);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    keypool_stats(state.pool, &hits, &misses);
+    fprintf(stdout, "\nKey pool: %llu key pairs from the pool, %llu generated on demand.\n", (unsigned long long)hits,
+        (unsigned long long)misses);
+
+end:
+    keypool_destroy(&state.pool);
+    rng_pool_destroy(&state.rngs);
+    free(state.ciphertext);
+    free(latencies);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// kyber.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Initialize the toolkit by creating a context and registering hash
+// algorithms. The pools create their own RNGs.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx)
+{
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256, IQR_HASHALGO_SHA3_256, IQR_HASHALGO_SHA3_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user use the sample or are
+// generic utility functions. This section has little value to the developer
+// trying to learn how to use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Report the chosen runtime parameters.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void preamble(const char *cmd, const iqr_KyberVariant *variant, size_t handshakes, uint32_t interval_us,
+    size_t capacity, size_t low, size_t high)
+{
+    fprintf(stdout, "Running %s with the following parameters:\n", cmd);
+    if (variant == &IQR_KYBER_768) {
+        fprintf(stdout, "    security level: 128 bits\n");
+    } else {
+        fprintf(stdout, "    security level: 224 bits\n");
+    }
+    fprintf(stdout, "    handshakes: %zu\n", handshakes);
+    fprintf(stdout, "    interval: %u us\n", interval_us);
+    fprintf(stdout, "    pool capacity: %zu\n", capacity);
+    fprintf(stdout, "    low watermark: %zu\n", low);
+    fprintf(stdout, "    high watermark: %zu\n", high);
+    fprintf(stdout, "\n");
+}
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse the command line options. */
+static iqr_retval parse_commandline(int argc, const char **argv, const iqr_KyberVariant **variant, size_t *handshakes,
+    uint32_t *interval_us, size_t *capacity, size_t *low, size_t *high)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--security") == 0) {
+            /* [--security 128|224] */
+            i++;
+            if (paramcmp(argv[i], "128") == 0) {
+                *variant = &IQR_KYBER_768;
+            } else if  (paramcmp(argv[i], "224") == 0) {
+                *variant = &IQR_KYBER_1024;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else {
+            /* The remaining options all take a non-negative integer. */
+            const char *option = argv[i];
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+
+            if (paramcmp(option, "--handshakes") == 0 && value > 0) {
+                *handshakes = (size_t)value;
+            } else if (paramcmp(option, "--interval") == 0) {
+                *interval_us = (uint32_t)value;
+            } else if (paramcmp(option, "--capacity") == 0 && value > 0) {
+                *capacity = (size_t)value;
+            } else if (paramcmp(option, "--low") == 0) {
+                *low = (size_t)value;
+            } else if (paramcmp(option, "--high") == 0 && value > 0) {
+                *high = (size_t)value;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        }
+        i++;
+    }
+
+    if (*low >= *high || *high > *capacity) {
+        fprintf(stdout, "The watermarks must satisfy low < high <= capacity.\n");
+        return IQR_EBADVALUE;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    const iqr_KyberVariant *variant = &IQR_KYBER_768;
+    size_t handshakes = 1000;
+    uint32_t interval_us = 0;
+    size_t capacity = 64;
+    size_t low = 16;
+    size_t high = 48;
+
+    iqr_Context * ctx = NULL;
+    iqr_KyberParams *parameters = NULL;
+
+    /* If the command line arguments were not sane, this function will return
+     * an error.
+     */
+    iqr_retval ret = parse_commandline(argc, argv, &variant, &handshakes, &interval_us, &capacity, &low, &high);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    /* Show the parameters for the program. */
+    preamble(argv[0], variant, handshakes, interval_us, capacity, low, high);
+
+    /* IQR toolkit initialization. */
+    ret = init_toolkit(&ctx);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    ret = iqr_KyberCreateParams(ctx, variant, &parameters);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_KyberCreateParams(): %s\n", iqr_StrError(ret));
+        goto cleanup;
+    }
+
+    ret = showcase_kyber_keypool(ctx, parameters, handshakes, interval_us, capacity, low, high);
+
+cleanup:
+    iqr_KyberDestroyParams(&parameters);
+    bootstrap_release();
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
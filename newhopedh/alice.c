@@ -3,9 +3,9 @@
  * @brief Functions to demonstrate how Alice (the initiator) should use
  * NewHopeDH.
  *
- * Alice is treated as a pseudo-separate process. She has her own params and
- * appears to keep her own state. It is done like this to show how the "Alice"
- * side of the transaction can be performed independent of Bob.
+ * Alice is treated as a pseudo-separate process. She keeps her params and
+ * private key in a alice_session, so the "Alice" side of the transaction can be
+ * performed independent of Bob, and of any other handshake.
  *
  * @copyright Copyright (C) 2016-2019, ISARA Corporation
  *
@@ -24,7 +24,6 @@
 
 #include "internal.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -32,48 +31,54 @@
 #include "iqr_rng.h"
 #include "isara_samples.h"
 
-/* It is not suggested to make these global variables. It's not thread safe.
- * It would be better to pass this around as required. It is done this way to
- * facilitate the pseudo-separate process paradigm.
- */
-static iqr_NewHopeDHParams *params;
-static iqr_NewHopeDHInitiatorPrivateKey *initiator_private_key;
-
-iqr_retval init_alice(const iqr_Context *ctx)
+iqr_retval init_alice(alice_session *alice, const iqr_Context *ctx)
 {
+    if (alice == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (ctx == NULL) {
         fprintf(stderr, "Context was null.\n");
         return IQR_ENULLPTR;
     }
 
-    iqr_retval ret = iqr_NewHopeDHCreateParams(ctx, &params);
+    iqr_retval ret = iqr_NewHopeDHCreateParams(ctx, &alice->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_NewHopeDHCreateParams(): %s\n", iqr_StrError(ret));
     }
     return ret;
 }
 
-iqr_retval alice_start(const iqr_RNG *rng, bool dump)
+iqr_retval alice_start(alice_session *alice, comms_channel *comms, const iqr_RNG *rng, bool dump)
 {
+    if (alice == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (rng == NULL) {
         fprintf(stderr, "The RNG was null and we really need that RNG\n");
         return IQR_ENULLPTR;
     }
 
+    /* The public key is written straight into a slab from the channel, and
+     * sending it hands the slab over.
+     */
     size_t initiator_size = IQR_NEWHOPEDH_INITIATOR_PUBLIC_KEY_SIZE;
-    uint8_t *initiator_public_key = calloc(1, initiator_size);
-    if (initiator_public_key == NULL) {
-        fprintf(stderr, "We seem to have run out of memory. ret=%d\n", errno);
-        return IQR_ENOMEM;
+    uint8_t *initiator_public_key = NULL;
+    iqr_retval ret = comms_acquire(comms, &initiator_public_key);
+    if (ret != IQR_OK) {
+        return ret;
     }
 
-    iqr_retval ret = iqr_NewHopeDHCreateInitiatorPrivateKey(params, rng, &initiator_private_key);
+    ret = iqr_NewHopeDHCreateInitiatorPrivateKey(alice->params, rng, &alice->initiator_private_key);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_NewHopeDHCreateInitiatorPrivateKey(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
-    ret = iqr_NewHopeDHGetInitiatorPublicKey(initiator_private_key, rng, initiator_public_key, initiator_size);
+    ret = iqr_NewHopeDHGetInitiatorPublicKey(alice->initiator_private_key, rng, initiator_public_key, initiator_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_NewHopeDHGetInitiatorPublicKey(): %s\n", iqr_StrError(ret));
         goto end;
@@ -86,18 +91,24 @@ iqr_retval alice_start(const iqr_RNG *rng, bool dump)
         }
     }
 
-    ret = send_to_bob(initiator_public_key, initiator_size);
+    ret = send_to_bob(comms, initiator_public_key, initiator_size);
+    initiator_public_key = NULL;
 
 end:
     if (ret != IQR_OK) {
-        iqr_NewHopeDHDestroyInitiatorPrivateKey(&initiator_private_key);
+        iqr_NewHopeDHDestroyInitiatorPrivateKey(&alice->initiator_private_key);
     }
-    free(initiator_public_key);
+    comms_release(comms, initiator_public_key);
     return ret;
 }
 
-iqr_retval alice_get_secret(uint8_t *secret, size_t secret_size)
+iqr_retval alice_get_secret(alice_session *alice, comms_channel *comms, uint8_t *secret, size_t secret_size)
 {
+    if (alice == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     iqr_retval ret = IQR_OK;
     uint8_t *responder_public_key = NULL;
 
@@ -107,36 +118,39 @@ iqr_retval alice_get_secret(uint8_t *secret, size_t secret_size)
         goto end;
     }
 
-    size_t responder_size = IQR_NEWHOPEDH_RESPONDER_PUBLIC_KEY_SIZE;
-    responder_public_key = calloc(1, responder_size);
-    if (responder_public_key == NULL) {
-        fprintf(stderr, "We seem to have run out of memory. ret=%d\n", errno);
-        ret = IQR_ENOMEM;
-        goto end;
-    }
-
-    ret = receive_from_bob(responder_public_key, &responder_size);
+    /* Bob's key arrives in a slab, which goes back to the channel at the end. */
+    size_t responder_size = 0;
+    ret = receive_from_bob(comms, &responder_public_key, &responder_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "We couldn't get the responder key from Bob.\n");
         goto end;
     }
 
-    ret = iqr_NewHopeDHGetInitiatorSecret(initiator_private_key, responder_public_key, responder_size, secret, secret_size);
+    ret = iqr_NewHopeDHGetInitiatorSecret(alice->initiator_private_key, responder_public_key, responder_size,
+        secret, secret_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_NewHopeDHGetInitiatorSecret(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
 end:
-    free(responder_public_key);
-    iqr_NewHopeDHDestroyInitiatorPrivateKey(&initiator_private_key);
+    comms_release(comms, responder_public_key);
+    iqr_NewHopeDHDestroyInitiatorPrivateKey(&alice->initiator_private_key);
 
     return ret;
 }
 
-iqr_retval cleanup_alice(void)
+iqr_retval cleanup_alice(alice_session *alice)
 {
-    iqr_retval ret = iqr_NewHopeDHDestroyParams(&params);
+    if (alice == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
+    /* A handshake that stopped part way can leave a private key behind. */
+    iqr_NewHopeDHDestroyInitiatorPrivateKey(&alice->initiator_private_key);
+
+    iqr_retval ret = iqr_NewHopeDHDestroyParams(&alice->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_NewHopeDHDestroyParams(): %s\n", iqr_StrError(ret));
     }
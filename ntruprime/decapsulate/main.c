@@ -24,6 +24,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_ntruprime.h"
@@ -129,22 +130,15 @@ static iqr_retval showcase_ntruprime_params_creation(const iqr_Context *ctx, iqr
 
 static iqr_retval init_toolkit(iqr_Context **ctx)
 {
-    /* Create a context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
     fprintf(stdout, "The context has been created.\n");
 
-    /* Globally register the hashing functions. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_512, &IQR_HASH_DEFAULT_SHA2_512);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
     fprintf(stdout, "Hash functions have been registered in the context.\n");
 
     return IQR_OK;
@@ -240,6 +234,6 @@ int main(int argc, const char **argv)
 
 cleanup:
     iqr_NTRUPrimeDestroyParams(&parameters);
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_mac.h"
 #include "iqr_retval.h"
@@ -141,14 +142,8 @@ end:
 
 static iqr_retval init_toolkit(iqr_Context **ctx)
 {
-    /* Create an IQR Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    return IQR_OK;
+    /* Create an IQR Context. These algorithms don't need any hashes. */
+    return bootstrap_context(NULL, 0, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -324,6 +319,6 @@ cleanup:
         files = next;
     }
     files = NULL;
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -18,15 +18,20 @@
  */
 
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_rainbow.h"
 #include "iqr_retval.h"
 #include "isara_samples.h"
+#include "sig_batch.h"
+#include "verify_cache.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -35,11 +40,21 @@
 static const char *usage_msg =
 "rainbow_verify [--security IIIc|Vc] [--sig <filename>]\n"
 "  [--pub <filename>] [--message <filename>]\n"
+"  [--cache <filename> --cache-key <filename>]\n"
+"rainbow_verify [--security IIIc|Vc] --batch <filename>\n"
+"  [--output <filename>] [--threads <count>]\n"
 "    Defaults are: \n"
 "        --security IIIb\n"
 "        --sig sig.dat\n"
 "        --pub pub.key\n"
-"        --message message.dat\n";
+"        --message message.dat\n"
+"        --output verify_results.txt\n"
+"        --threads 0 (one per CPU)\n"
+"  --batch names a manifest listing a public key, message and signature file\n"
+"  per line; the result for every line is written to the --output file.\n"
+"  --cache names a verify cache file; a signature found in it was verified\n"
+"  before and isn't checked again. --cache-key names the file holding the\n"
+"  cache's secret HMAC key (at least 32 bytes).\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases the verification of a Rainbow signature against a
@@ -47,13 +62,13 @@ static const char *usage_msg =
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static iqr_retval showcase_rainbow_verify(const iqr_Context *ctx, const iqr_RainbowVariant *variant, const char *pub_file,
-    const char *message_file, const char *sig_file)
+    const char *message_file, const char *sig_file, verify_cache *cache)
 {
     iqr_RainbowParams *params = NULL;
     iqr_RainbowPublicKey *pub = NULL;
 
     size_t pub_raw_size = 0;
-    uint8_t *pub_raw = NULL;
+    const uint8_t *pub_raw = NULL;
 
     size_t message_size = 0;
     uint8_t *message = NULL;
@@ -61,41 +76,64 @@ static iqr_retval showcase_rainbow_verify(const iqr_Context *ctx, const iqr_Rain
     size_t sig_size = 0;
     uint8_t *sig = NULL;
 
+    verify_cache_id cache_id;
+    memset(&cache_id, 0, sizeof(cache_id));
+
     iqr_retval ret = iqr_RainbowCreateParams(ctx, variant, &params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_RainbowCreateParams(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
-    /* Load the public key and signature from disk. */
-    ret = load_data(pub_file, &pub_raw, &pub_raw_size);
+    /* Map the public key instead of copying it; Rainbow public keys are large
+     * and the import reads straight from the page cache.
+     */
+    ret = map_data(pub_file, &pub_raw, &pub_raw_size);
     if (ret != IQR_OK) {
         goto end;
     }
 
+    /* Load the signature and message from disk. */
     ret = load_data(sig_file, &sig, &sig_size);
     if (ret != IQR_OK) {
         goto end;
     }
 
-    /* Import the public key data and create a public key object. */
-    ret = iqr_RainbowImportPublicKey(params, pub_raw, pub_raw_size, &pub);
+    ret = load_data(message_file, &message, &message_size);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RainbowImportPublicKey(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
-    fprintf(stdout, "Public key has been loaded successfully!\n");
+    /* A signature that verified on an earlier run is in the cache, so the
+     * toolkit doesn't need to check it again.
+     */
+    if (cache != NULL) {
+        const char *scheme = variant == &IQR_RAINBOW_GF256_92_48_48 ? "rainbow-vc" : "rainbow-iiic";
+        ret = verify_cache_make_id(cache, scheme, pub_raw, pub_raw_size, message, message_size, sig, sig_size, &cache_id);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        if (verify_cache_lookup(cache, &cache_id)) {
+            fprintf(stdout, "Found the Rainbow signature in the verify cache; it was verified before.\n");
+            goto end;
+        }
+    }
 
-    /* Load the message. */
-    ret = load_data(message_file, &message, &message_size);
+    /* Import the public key data and create a public key object. */
+    ret = iqr_RainbowImportPublicKey(params, pub_raw, pub_raw_size, &pub);
     if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RainbowImportPublicKey(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
+    fprintf(stdout, "Public key has been loaded successfully!\n");
+
     ret = iqr_RainbowVerify(pub, message, message_size, sig, sig_size);
     if (ret == IQR_OK) {
         fprintf(stdout, "Rainbow verified the signature successfully!\n");
+        if (cache != NULL) {
+            ret = verify_cache_add(cache, &cache_id);
+        }
     } else {
         fprintf(stderr, "Failed on iqr_RainbowVerify(): %s\n", iqr_StrError(ret));
     }
@@ -105,7 +143,7 @@ end:
     iqr_RainbowDestroyParams(&params);
 
     free(message);
-    free(pub_raw);
+    unmap_data(pub_raw, pub_raw_size);
     free(sig);
 
     return ret;
@@ -118,27 +156,15 @@ end:
 
 static iqr_retval init_toolkit(iqr_Context **ctx)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered.
+     * SHA2-256 is for the verify cache.
+     */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_384, IQR_HASHALGO_SHA2_512, IQR_HASHALGO_SHA2_256 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    /* This sets the hashing functions that will be used by the scheme. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_384, &IQR_HASH_DEFAULT_SHA2_384);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_512, &IQR_HASH_DEFAULT_SHA2_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-
     return IQR_OK;
 }
 
@@ -152,7 +178,8 @@ static iqr_retval init_toolkit(iqr_Context **ctx)
 // Report the chosen runtime parameters.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static void preamble(const char *cmd, const iqr_RainbowVariant *variant, const char *sig, const char *pub, const char *message)
+static void preamble(const char *cmd, const iqr_RainbowVariant *variant, const char *sig, const char *pub, const char *message,
+    const char *batch, const char *output, uint32_t threads, const char *cache_file)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     if (variant == &IQR_RAINBOW_GF256_68_36_36) {
@@ -160,14 +187,45 @@ static void preamble(const char *cmd, const iqr_RainbowVariant *variant, const c
     } else if (variant == &IQR_RAINBOW_GF256_92_48_48) {
         fprintf(stdout, "    security level: Vc. parameter set: (GF(256), 92, 48, 48)\n");
     }
-    fprintf(stdout, "    signature file: %s\n", sig);
-    fprintf(stdout, "    public key file: %s\n", pub);
-    fprintf(stdout, "    message data file: %s\n", message);
+    if (batch != NULL) {
+        fprintf(stdout, "    manifest file: %s\n", batch);
+        fprintf(stdout, "    results file: %s\n", output);
+        fprintf(stdout, "    threads: %u\n", threads);
+    } else {
+        fprintf(stdout, "    signature file: %s\n", sig);
+        fprintf(stdout, "    public key file: %s\n", pub);
+        fprintf(stdout, "    message data file: %s\n", message);
+    }
+    if (cache_file != NULL) {
+        fprintf(stdout, "    verify cache: %s\n", cache_file);
+    }
     fprintf(stdout, "\n");
 }
 
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
 static iqr_retval parse_commandline(int argc, const char **argv, const iqr_RainbowVariant **variant, const char **sig,
-    const char **pub, const char **message)
+    const char **pub, const char **message, const char **batch_file, const char **output_file, uint32_t *threads,
+    const char **cache_file, const char **cache_key_file)
 {
     int i = 1;
     while (i != argc) {
@@ -199,9 +257,41 @@ static iqr_retval parse_commandline(int argc, const char **argv, const iqr_Rainb
            /* [--message <filename>] */
            i++;
            *message = argv[i];
+        } else if (paramcmp(argv[i], "--cache") == 0) {
+            /* [--cache <filename>] */
+            i++;
+            *cache_file = argv[i];
+        } else if (paramcmp(argv[i], "--cache-key") == 0) {
+            /* [--cache-key <filename>] */
+            i++;
+            *cache_key_file = argv[i];
+        } else if (paramcmp(argv[i], "--batch") == 0) {
+            /* [--batch <filename>] */
+            i++;
+            *batch_file = argv[i];
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output_file = argv[i];
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)value;
         }
         i++;
     }
+
+    /* The cache and its key go together, and batch mode doesn't use them. */
+    if ((*cache_file == NULL) != (*cache_key_file == NULL) || (*batch_file != NULL && *cache_file != NULL)) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
     return IQR_OK;
 }
 
@@ -217,19 +307,26 @@ int main(int argc, const char **argv)
     const char *sig = "sig.dat";
     const char *pub = "pub.key";
     const char *message = "message.dat";
+    const char *cache_file = NULL;
+    const char *cache_key_file = NULL;
+    const char *batch_file = NULL;
+    const char *output_file = "verify_results.txt";
+    uint32_t threads = 0;
 
     iqr_Context *ctx = NULL;
+    verify_cache *cache = NULL;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &variant, &sig, &pub, &message);
+    iqr_retval ret = parse_commandline(argc, argv, &variant, &sig, &pub, &message, &batch_file, &output_file, &threads,
+        &cache_file, &cache_key_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], variant, sig, pub, message);
+    preamble(argv[0], variant, sig, pub, message, batch_file, output_file, threads, cache_file);
 
     /* IQR initialization that is not specific to Rainbow. */
     ret = init_toolkit(&ctx);
@@ -237,11 +334,26 @@ int main(int argc, const char **argv)
         goto cleanup;
     }
 
-    /* This function showcases the usage of Rainbow signature verification.
-     */
-    ret = showcase_rainbow_verify(ctx, variant, pub, message, sig);
+    /* Signatures that verified on an earlier run skip the toolkit. */
+    if (cache_file != NULL) {
+        ret = verify_cache_open(ctx, cache_file, cache_key_file, VERIFY_CACHE_DEFAULT_SLOTS, &cache);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
+    if (batch_file != NULL) {
+        /* Verify every signature in the manifest. */
+        const sig_scheme *scheme = sig_find(variant == &IQR_RAINBOW_GF256_92_48_48 ? "rainbow-vc" : "rainbow-iiic");
+        ret = sig_verify_batch(ctx, scheme, batch_file, output_file, threads);
+    } else {
+        /* This function showcases the usage of Rainbow signature verification.
+         */
+        ret = showcase_rainbow_verify(ctx, variant, pub, message, sig, cache);
+    }
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    verify_cache_close(&cache);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,513 @@
+/** @file bench.c
+ *
+ * @brief Measure HMAC-DRBG throughput and reseed cost for each hash.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"rng_bench [--hash all|sha2-256|sha2-384|sha2-512|sha3-256|sha3-512]\n"
+"  [--threads <count>[,<count>...]] [--duration <milliseconds>]\n"
+"  [--format csv|json] [--output <filename>]\n"
+"    Defaults are: \n"
+"        --hash all\n"
+"        --threads 1\n"
+"        --duration 200\n"
+"        --format csv\n"
+"        --output stdout\n"
+"  Measures iqr_RNGGetBytes() at request sizes from 1 byte to 1 MiB, and\n"
+"  iqr_RNGReseed(), for each hash and thread count. Every thread has its own\n"
+"  HMAC-DRBG.\n";
+
+/* HMAC-DRBG limits a single request to 2^19 bits; bigger requests are made
+ * of several calls, the way an application would have to.
+ */
+#define MAX_DRBG_REQUEST 65536
+
+/* Entropy fed to each reseed: a typical 256-bit seed plus a nonce. */
+#define RESEED_SIZE 48
+
+#define MAX_THREAD_COUNTS 16
+
+static const size_t request_sizes[] = {
+    1, 16, 32, 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576
+};
+
+typedef struct {
+    iqr_HashAlgorithmType hash;
+    const char *name;
+} bench_hash;
+
+static const bench_hash hashes[] = {
+    { IQR_HASHALGO_SHA2_256, "sha2-256" },
+    { IQR_HASHALGO_SHA2_384, "sha2-384" },
+    { IQR_HASHALGO_SHA2_512, "sha2-512" },
+    { IQR_HASHALGO_SHA3_256, "sha3-256" },
+    { IQR_HASHALGO_SHA3_512, "sha3-512" }
+};
+
+#define HASH_COUNT (sizeof(hashes) / sizeof(hashes[0]))
+
+typedef enum {
+    BENCH_GET_BYTES,
+    BENCH_RESEED
+} bench_op;
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSON
+} output_format;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Worker threads.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Holds the workers until they've all set up their DRBGs, so they start
+ * timing together.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t ready;
+    bool go;
+} start_gate;
+
+typedef struct {
+    const iqr_Context *ctx;
+    iqr_HashAlgorithmType hash;
+    bench_op op;
+    size_t size;
+    uint64_t duration_ns;
+    start_gate *gate;
+
+    uint64_t ops;
+    uint64_t elapsed;
+    iqr_retval ret;
+} bench_worker;
+
+static iqr_retval run_op(iqr_RNG *rng, bench_op op, uint8_t *buf, size_t size, const uint8_t *entropy)
+{
+    if (op == BENCH_RESEED) {
+        return iqr_RNGReseed(rng, entropy, RESEED_SIZE);
+    }
+
+    for (size_t offset = 0; offset < size; offset += MAX_DRBG_REQUEST) {
+        const size_t chunk = (size - offset < MAX_DRBG_REQUEST) ? size - offset : MAX_DRBG_REQUEST;
+        iqr_retval ret = iqr_RNGGetBytes(rng, buf + offset, chunk);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    return IQR_OK;
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_worker *worker = arg;
+    iqr_RNG *rng = NULL;
+    uint8_t entropy[RESEED_SIZE] = { 0 };
+    const size_t buf_size = (worker->op == BENCH_GET_BYTES) ? worker->size : 1;
+
+    uint8_t *buf = calloc(1, buf_size);
+    if (buf == NULL) {
+        worker->ret = IQR_ENOMEM;
+        goto ready;
+    }
+
+    worker->ret = iqr_RNGCreateHMACDRBG(worker->ctx, worker->hash, &rng);
+    if (worker->ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(worker->ret));
+        goto ready;
+    }
+
+    worker->ret = get_system_entropy(entropy, sizeof(entropy));
+    if (worker->ret != IQR_OK) {
+        goto ready;
+    }
+
+    worker->ret = iqr_RNGInitialize(rng, entropy, sizeof(entropy));
+    if (worker->ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(worker->ret));
+    }
+
+ready:
+    pthread_mutex_lock(&worker->gate->lock);
+    worker->gate->ready++;
+    pthread_cond_broadcast(&worker->gate->cond);
+    while (!worker->gate->go) {
+        pthread_cond_wait(&worker->gate->cond, &worker->gate->lock);
+    }
+    pthread_mutex_unlock(&worker->gate->lock);
+
+    if (worker->ret == IQR_OK) {
+        /* A DRBG call costs far more than reading the clock, so checking it
+         * every iteration doesn't skew the results.
+         */
+        const uint64_t start = time_now_ns();
+        uint64_t now = start;
+        do {
+            worker->ret = run_op(rng, worker->op, buf, worker->size, entropy);
+            if (worker->ret != IQR_OK) {
+                fprintf(stderr, "Failed on %s(): %s\n", (worker->op == BENCH_RESEED) ? "iqr_RNGReseed" : "iqr_RNGGetBytes",
+                    iqr_StrError(worker->ret));
+                break;
+            }
+            worker->ops++;
+            now = time_now_ns();
+        } while (now - start < worker->duration_ns);
+        worker->elapsed = now - start;
+    }
+
+    secure_memzero(entropy, sizeof(entropy));
+    if (buf != NULL) {
+        secure_memzero(buf, buf_size);
+    }
+    free(buf);
+    iqr_RNGDestroy(&rng);
+
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmark driver.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    FILE *out;
+    output_format format;
+    bool first_row;
+} bench_output;
+
+static void report(bench_output *output, const char *hash, uint32_t threads, bench_op op, size_t size, uint64_t ops,
+    double ns_per_op, double ops_per_sec)
+{
+    const char *op_name = (op == BENCH_RESEED) ? "reseed" : "get_bytes";
+    const double mb_per_sec = (op == BENCH_RESEED) ? 0.0 : ops_per_sec * (double)size / 1e6;
+
+    if (output->format == FORMAT_CSV) {
+        fprintf(output->out, "%s,%u,%s,%zu,%llu,%.1f,%.1f,%.3f\n", hash, threads, op_name, size, (unsigned long long)ops,
+            ns_per_op, ops_per_sec, mb_per_sec);
+    } else {
+        fprintf(output->out, "%s  {\"hash\": \"%s\", \"threads\": %u, \"operation\": \"%s\", \"request_bytes\": %zu, "
+            "\"operations\": %llu, \"ns_per_op\": %.1f, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.3f}",
+            output->first_row ? "" : ",\n", hash, threads, op_name, size, (unsigned long long)ops, ns_per_op, ops_per_sec,
+            mb_per_sec);
+    }
+    output->first_row = false;
+}
+
+static iqr_retval bench_one(const iqr_Context *ctx, const bench_hash *hash, uint32_t threads, bench_op op, size_t size,
+    uint64_t duration_ns, bench_output *output)
+{
+    bench_worker *workers = calloc(threads, sizeof(*workers));
+    pthread_t *tids = calloc(threads, sizeof(*tids));
+    if (workers == NULL || tids == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(tids);
+        free(workers);
+        return IQR_ENOMEM;
+    }
+
+    start_gate gate;
+    memset(&gate, 0, sizeof(gate));
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+
+    iqr_retval ret = IQR_OK;
+    uint32_t started = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        workers[t].ctx = ctx;
+        workers[t].hash = hash->hash;
+        workers[t].op = op;
+        workers[t].size = size;
+        workers[t].duration_ns = duration_ns;
+        workers[t].gate = &gate;
+        workers[t].ret = IQR_OK;
+
+        int rc = pthread_create(&tids[t], NULL, bench_thread, &workers[t]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            break;
+        }
+        started++;
+    }
+
+    pthread_mutex_lock(&gate.lock);
+    while (gate.ready < started) {
+        pthread_cond_wait(&gate.cond, &gate.lock);
+    }
+    gate.go = true;
+    pthread_cond_broadcast(&gate.cond);
+    pthread_mutex_unlock(&gate.lock);
+
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    uint64_t ops = 0;
+    uint64_t busy = 0;
+    double ops_per_sec = 0.0;
+    for (uint32_t t = 0; t < started && ret == IQR_OK; t++) {
+        ret = workers[t].ret;
+        ops += workers[t].ops;
+        busy += workers[t].elapsed;
+        if (workers[t].elapsed > 0) {
+            ops_per_sec += (double)workers[t].ops * 1e9 / (double)workers[t].elapsed;
+        }
+    }
+
+    if (ret == IQR_OK && ops > 0) {
+        report(output, hash->name, threads, op, size, ops, (double)busy / (double)ops, ops_per_sec);
+    }
+
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.lock);
+    free(tids);
+    free(workers);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// RNG.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const bool *use_hash)
+{
+    /* Create a Context. */
+    iqr_retval ret = bootstrap_context(NULL, 0, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Register the hashes of the DRBGs being measured. */
+    for (size_t i = 0; i < HASH_COUNT; i++) {
+        if (use_hash[i]) {
+            ret = bootstrap_context(&hashes[i].hash, 1, ctx);
+            if (ret != IQR_OK) {
+                return ret;
+            }
+        }
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse a comma separated list of positive integers. */
+static iqr_retval get_thread_counts(const char *p, uint32_t *counts, size_t *count)
+{
+    *count = 0;
+    while (*p != '\0') {
+        char *end = NULL;
+        errno = 0;
+        const long l = strtol(p, &end, 10);
+        if (errno != 0 || end == p || l <= 0 || l > INT_MAX || *count == MAX_THREAD_COUNTS) {
+            return IQR_EBADVALUE;
+        }
+        counts[(*count)++] = (uint32_t)l;
+
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return IQR_EBADVALUE;
+        }
+        p = end;
+    }
+    return (*count > 0) ? IQR_OK : IQR_EBADVALUE;
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, bool *use_hash, uint32_t *thread_counts,
+    size_t *thread_count_size, uint64_t *duration_ns, output_format *format, const char **output)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--hash") == 0) {
+            /* [--hash all|sha2-256|sha2-384|sha2-512|sha3-256|sha3-512] */
+            i++;
+            bool found = false;
+            for (size_t h = 0; h < HASH_COUNT; h++) {
+                use_hash[h] = paramcmp(argv[i], "all") == 0 || paramcmp(argv[i], hashes[h].name) == 0;
+                found = found || use_hash[h];
+            }
+            if (!found) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>[,<count>...]] */
+            i++;
+            if (get_thread_counts(argv[i], thread_counts, thread_count_size) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--duration") == 0) {
+            /* [--duration <milliseconds>] */
+            i++;
+            int32_t ms = get_positive_int_param(argv[i]);
+            if (ms <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *duration_ns = (uint64_t)ms * UINT64_C(1000000);
+        } else if (paramcmp(argv[i], "--format") == 0) {
+            /* [--format csv|json] */
+            i++;
+            if (paramcmp(argv[i], "csv") == 0) {
+                *format = FORMAT_CSV;
+            } else if (paramcmp(argv[i], "json") == 0) {
+                *format = FORMAT_JSON;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output = argv[i];
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    bool use_hash[HASH_COUNT] = { true, true, true, true, true };
+    uint32_t thread_counts[MAX_THREAD_COUNTS] = { 1 };
+    size_t thread_count_size = 1;
+    uint64_t duration_ns = UINT64_C(200) * UINT64_C(1000000);
+    output_format format = FORMAT_CSV;
+    const char *output = NULL;
+
+    iqr_retval ret = parse_commandline(argc, argv, use_hash, thread_counts, &thread_count_size, &duration_ns, &format,
+        &output);
+    if (ret != IQR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    bench_output results;
+    results.out = stdout;
+    results.format = format;
+    results.first_row = true;
+
+    if (output != NULL) {
+        results.out = fopen(output, "w");
+        if (results.out == NULL) {
+            fprintf(stderr, "Failed to open %s: %s\n", output, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    iqr_Context *ctx = NULL;
+    ret = init_toolkit(&ctx, use_hash);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    if (format == FORMAT_CSV) {
+        fprintf(results.out, "hash,threads,operation,request_bytes,operations,ns_per_op,ops_per_sec,mb_per_sec\n");
+    } else {
+        fprintf(results.out, "[\n");
+    }
+
+    for (size_t h = 0; h < HASH_COUNT && ret == IQR_OK; h++) {
+        if (!use_hash[h]) {
+            continue;
+        }
+        for (size_t t = 0; t < thread_count_size && ret == IQR_OK; t++) {
+            for (size_t s = 0; s < sizeof(request_sizes) / sizeof(request_sizes[0]) && ret == IQR_OK; s++) {
+                ret = bench_one(ctx, &hashes[h], thread_counts[t], BENCH_GET_BYTES, request_sizes[s], duration_ns, &results);
+            }
+            if (ret == IQR_OK) {
+                ret = bench_one(ctx, &hashes[h], thread_counts[t], BENCH_RESEED, RESEED_SIZE, duration_ns, &results);
+            }
+        }
+    }
+
+    if (format == FORMAT_JSON) {
+        fprintf(results.out, "\n]\n");
+    }
+
+cleanup:
+    bootstrap_release();
+    if (results.out != stdout) {
+        fclose(results.out);
+    }
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -18,15 +18,19 @@
  */
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
 #include "iqr_rng.h"
+#include "internal.h"
 #include "isara_samples.h"
+#include "rng_pool.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -35,12 +39,21 @@
 static const char *usage_msg =
 "rng [--hash sha2-256|sha2-384|sha2-512|sha3-256|sha3-512]\n"
 "  [--seed <filename>] [--reseed <filename>] [--output <filename>]\n"
-"  [--count <bytes>]\n"
+"  [--count <bytes>] [--pool <request size>]\n"
+"  [--stream <generators>] [--block <bytes>]\n"
 "    Defaults are: \n"
 "        --hash sha2-256\n"
 "        --output random.dat\n"
 "        --count 256\n"
-"  Uses HMAC-DRBG with the specified hash.\n";
+"        --block 65536\n"
+"  Uses HMAC-DRBG with the specified hash.\n"
+"  --pool serves the output from a buffered, system-seeded RNG pool in\n"
+"  <request size> byte requests and compares the per-request latency with\n"
+"  calling the DRBG directly. --seed and --reseed are ignored.\n"
+"  --stream writes --count bytes through a fixed double buffer instead of\n"
+"  holding the output in memory, using <generators> system-seeded DRBGs\n"
+"  whose output is interleaved in --block sized blocks. Use --output - to\n"
+"  write to stdout. --seed and --reseed are ignored.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases random number generation.
@@ -121,27 +134,120 @@ end:
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
-// This next section of code is related to the toolkit, but is not specific to
-// RNG.
+// This function showcases the RNG pool from the common library.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, const iqr_HashCallbacks *cb)
+static iqr_retval showcase_rng_pool(const iqr_Context *ctx, iqr_HashAlgorithmType hash, const char *output, size_t count,
+    size_t request_size)
 {
-    /* Create a Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    const size_t requests = (count + request_size - 1) / request_size;
+
+    rng_pool *pool = NULL;
+    iqr_RNG *rng = NULL;
+    uint8_t seed[64] = { 0 };
+
+    uint8_t *data = calloc(1, count);
+    uint8_t *direct = calloc(1, count);
+    if (data == NULL || direct == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(direct);
+        free(data);
+        return IQR_ENOMEM;
+    }
+
+    rng_pool_config config;
+    rng_pool_default_config(&config);
+    config.hash = hash;
+
+    iqr_retval ret = rng_pool_create(ctx, &config, &pool);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto end;
     }
 
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, hash, cb);
+    /* Getting the thread's RNG creates and seeds it, so that cost isn't
+     * counted against the first request.
+     */
+    iqr_RNG *unused = NULL;
+    ret = rng_pool_thread_rng(pool, &unused);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
+        goto end;
     }
 
-    return IQR_OK;
+    fprintf(stdout, "RNG pool has been created.\n");
+
+    uint64_t start = time_now_ns();
+    for (size_t offset = 0; offset < count; offset += request_size) {
+        const size_t size = (count - offset < request_size) ? count - offset : request_size;
+        ret = rng_pool_get_bytes(pool, data + offset, size);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+    }
+    const uint64_t pool_elapsed = time_now_ns() - start;
+
+    fprintf(stdout, "RNG data has been read from the pool.\n");
+
+    /* The same requests, each one a DRBG call. */
+    ret = iqr_RNGCreateHMACDRBG(ctx, hash, &rng);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = get_system_entropy(seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = iqr_RNGInitialize(rng, seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    start = time_now_ns();
+    for (size_t offset = 0; offset < count; offset += request_size) {
+        const size_t size = (count - offset < request_size) ? count - offset : request_size;
+        ret = iqr_RNGGetBytes(rng, direct + offset, size);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_RNGGetBytes(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+    }
+    const uint64_t direct_elapsed = time_now_ns() - start;
+
+    fprintf(stdout, "%zu requests of up to %zu bytes:\n", requests, request_size);
+    fprintf(stdout, "    RNG pool: %.1f ns/request\n", (double)pool_elapsed / (double)requests);
+    fprintf(stdout, "    direct DRBG: %.1f ns/request\n", (double)direct_elapsed / (double)requests);
+
+    ret = save_data(output, data, count);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    fprintf(stdout, "Random data has been saved to disk.\n");
+
+end:
+    secure_memzero(seed, sizeof(seed));
+    secure_memzero(direct, count);
+    free(direct);
+    free(data);
+    iqr_RNGDestroy(&rng);
+    rng_pool_destroy(&pool);
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// RNG.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash)
+{
+    /* Create a context with the chosen hash function registered. */
+    return bootstrap_context(&hash, 1, ctx);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -154,36 +260,44 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_HashAlgorithmType hash, co
 // Report the chosen runtime parameters.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static void preamble(const char *cmd, iqr_HashAlgorithmType hash, const char *seed, const char *reseed, const char *output,
-    size_t count)
+static void preamble(FILE *out, const char *cmd, iqr_HashAlgorithmType hash, const char *seed, const char *reseed,
+    const char *output, uint64_t count, size_t pool_request, uint32_t generators, size_t block_size)
 {
-    fprintf(stdout, "Running %s with the following parameters...\n", cmd);
+    fprintf(out, "Running %s with the following parameters...\n", cmd);
 
     if (IQR_HASHALGO_SHA2_256 == hash) {
-        fprintf(stdout, "    hash algorithm: IQR_HASHALGO_SHA2_256\n");
+        fprintf(out, "    hash algorithm: IQR_HASHALGO_SHA2_256\n");
     } else if (IQR_HASHALGO_SHA2_384 == hash) {
-        fprintf(stdout, "    hash algorithm: IQR_HASHALGO_SHA2_384\n");
+        fprintf(out, "    hash algorithm: IQR_HASHALGO_SHA2_384\n");
     } else if (IQR_HASHALGO_SHA2_512 == hash) {
-        fprintf(stdout, "    hash algorithm: IQR_HASHALGO_SHA2_512\n");
+        fprintf(out, "    hash algorithm: IQR_HASHALGO_SHA2_512\n");
     } else if (IQR_HASHALGO_SHA3_256 == hash) {
-        fprintf(stdout, "    hash algorithm: IQR_HASHALGO_SHA3_256\n");
+        fprintf(out, "    hash algorithm: IQR_HASHALGO_SHA3_256\n");
     } else if (IQR_HASHALGO_SHA3_512 == hash) {
-        fprintf(stdout, "    hash algorithm: IQR_HASHALGO_SHA3_512\n");
+        fprintf(out, "    hash algorithm: IQR_HASHALGO_SHA3_512\n");
     }
 
-    if (seed != NULL) {
-        fprintf(stdout, "    seed source: %s\n", seed);
+    if (pool_request > 0) {
+        fprintf(out, "    seed: system entropy (RNG pool)\n");
+        fprintf(out, "    pool request size: %zu\n", pool_request);
+    } else if (generators > 0) {
+        fprintf(out, "    seed: system entropy (%u generators)\n", generators);
+        fprintf(out, "    block size: %zu\n", block_size);
+    } else if (seed != NULL) {
+        fprintf(out, "    seed source: %s\n", seed);
     } else {
-        fprintf(stdout, "    seed: NIST HMAC-DRBG test vectors\n");
+        fprintf(out, "    seed: NIST HMAC-DRBG test vectors\n");
     }
-    if (reseed != NULL) {
-        fprintf(stdout, "    reseed source: %s\n", reseed);
+    if (pool_request > 0 || generators > 0) {
+        fprintf(out, "    reseed: automatic\n");
+    } else if (reseed != NULL) {
+        fprintf(out, "    reseed source: %s\n", reseed);
     } else {
-        fprintf(stdout, "    reseed: NIST HMAC-DRBG test vectors\n");
+        fprintf(out, "    reseed: NIST HMAC-DRBG test vectors\n");
     }
-    fprintf(stdout, "    randomness output file: %s\n", output);
-    fprintf(stdout, "    randomness output byte count: %zu\n", count);
-    fprintf(stdout, "\n");
+    fprintf(out, "    randomness output file: %s\n", output);
+    fprintf(out, "    randomness output byte count: %" PRIu64 "\n", count);
+    fprintf(out, "\n");
 }
 
 /* Parse a parameter string which is supposed to be a positive integer
@@ -207,8 +321,27 @@ static int32_t get_positive_int_param(const char *p) {
     return (int32_t)l;
 }
 
-static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash, const iqr_HashCallbacks **cb,
-    const char **seed, const char **reseed, const char **output, size_t *count)
+/* Parse a parameter string which is supposed to be a positive 64-bit integer
+ * and return the value or 0 if the string is not properly formatted.
+ */
+static uint64_t get_positive_u64_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    if (p[0] == '-') {
+        return 0;
+    }
+    const unsigned long long ull = strtoull(p, &end, 10);
+    if (errno != 0) {
+        return 0;
+    }
+    if (end == NULL || end == p || *end != '\0' ) {
+        return 0;
+    }
+    return (uint64_t)ull;
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorithmType *hash,
+    const char **seed, const char **reseed, const char **output, uint64_t *count, size_t *pool_request, uint32_t *generators, size_t *block_size)
 {
     int i = 1;
     while (i != argc) {
@@ -222,19 +355,14 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             i++;
             if (paramcmp(argv[i], "sha2-256") == 0) {
                 *hash = IQR_HASHALGO_SHA2_256;
-                *cb = &IQR_HASH_DEFAULT_SHA2_256;
             } else if (paramcmp(argv[i], "sha2-384") == 0) {
                 *hash = IQR_HASHALGO_SHA2_384;
-                *cb = &IQR_HASH_DEFAULT_SHA2_384;
             } else if (paramcmp(argv[i], "sha2-512") == 0) {
                 *hash = IQR_HASHALGO_SHA2_512;
-                *cb = &IQR_HASH_DEFAULT_SHA2_512;
             } else if (paramcmp(argv[i], "sha3-256") == 0) {
                 *hash = IQR_HASHALGO_SHA3_256;
-                *cb = &IQR_HASH_DEFAULT_SHA3_256;
             } else if (paramcmp(argv[i], "sha3-512") == 0) {
                 *hash = IQR_HASHALGO_SHA3_512;
-                *cb = &IQR_HASH_DEFAULT_SHA3_512;
             } else {
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
@@ -252,19 +380,60 @@ static iqr_retval parse_commandline(int argc, const char **argv, iqr_HashAlgorit
             i++;
             *output = argv[i];
         } else if (paramcmp(argv[i], "--count") == 0) {
+            /* [--count <bytes>] */
+            i++;
+            *count = get_positive_u64_param(argv[i]);
+            if (*count == 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--pool") == 0) {
+            /* [--pool <request size>] */
             i++;
             int32_t sz  = get_positive_int_param(argv[i]);
             if (sz <= 0) {
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
             }
-            *count = (size_t)sz;
+            *pool_request = (size_t)sz;
+        } else if (paramcmp(argv[i], "--stream") == 0) {
+            /* [--stream <generators>] */
+            i++;
+            int32_t n  = get_positive_int_param(argv[i]);
+            if (n <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *generators = (uint32_t)n;
+        } else if (paramcmp(argv[i], "--block") == 0) {
+            /* [--block <bytes>] */
+            i++;
+            int32_t sz  = get_positive_int_param(argv[i]);
+            if (sz <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *block_size = (size_t)sz;
         } else {
                 fprintf(stdout, "%s", usage_msg);
             return IQR_EBADVALUE;
         }
         i++;
     }
+
+    if (*pool_request > 0 && *generators > 0) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+    /* Only streaming mode can produce more than fits comfortably in memory. */
+    if (*generators == 0 && *count > INT_MAX) {
+        fprintf(stdout, "--count is limited to %d bytes without --stream.\n", INT_MAX);
+        return IQR_EBADVALUE;
+    }
+    if (*generators == 0 && paramcmp(*output, "-") == 0) {
+        fprintf(stdout, "--output - requires --stream.\n");
+        return IQR_EBADVALUE;
+    }
     return IQR_OK;
 }
 
@@ -303,7 +472,6 @@ int main(int argc, const char **argv)
      * here.
      */
     iqr_HashAlgorithmType hash = IQR_HASHALGO_SHA2_256;
-    const iqr_HashCallbacks *cb = &IQR_HASH_DEFAULT_SHA2_256;
 
     const char *seed = NULL;
     uint8_t *loaded_seed_data = NULL;
@@ -317,27 +485,50 @@ int main(int argc, const char **argv)
 
     const char *output = "random.dat";
     const size_t default_count = 256;
-    size_t count = default_count;
+    uint64_t requested_count = default_count;
     uint8_t *validate = NULL;
+    size_t pool_request = 0;
+    uint32_t generators = 0;
+    size_t block_size = 65536;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &hash, &cb, &seed, &reseed, &output, &count);
+    iqr_retval ret = parse_commandline(argc, argv, &hash, &seed, &reseed, &output, &requested_count, &pool_request,
+        &generators, &block_size);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
+    size_t count = (size_t)requested_count;
+
+    /* When streaming to stdout, stdout is reserved for the random data. */
+    FILE *msg = (generators > 0 && paramcmp(output, "-") == 0) ? stderr : stdout;
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], hash, seed, reseed, output, count);
+    preamble(msg, argv[0], hash, seed, reseed, output, requested_count, pool_request, generators, block_size);
 
     /* IQR initialization that is not specific to RNG. */
     iqr_Context *ctx = NULL;
-    ret = init_toolkit(&ctx, hash, cb);
+    ret = init_toolkit(&ctx, hash);
     if (ret != IQR_OK) {
         goto cleanup;
     }
 
+    if (generators > 0) {
+        /** Like the pool, the streaming DRBGs seed themselves.
+         */
+        ret = stream_rng(ctx, hash, output, requested_count, generators, block_size, msg);
+        goto cleanup;
+    }
+
+    if (pool_request > 0) {
+        /** The pool seeds itself, so there's nothing to load and nothing to
+         * compare against the NIST test vectors.
+         */
+        ret = showcase_rng_pool(ctx, hash, output, count, pool_request);
+        goto cleanup;
+    }
+
     if (seed != NULL) {
         ret = load_data(seed, &loaded_seed_data, &seed_size);
         if (ret != IQR_OK) {
@@ -396,7 +587,7 @@ cleanup:
     free(loaded_seed_data);
     loaded_seed_data = NULL;
 
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
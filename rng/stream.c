@@ -0,0 +1,348 @@
+/** @file stream.c
+ *
+ * @brief Stream large amounts of random data to a file or stdout.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "isara_samples.h"
+#include "rng_pool.h"
+
+/* HMAC-DRBG limits a single request to 2^19 bits. */
+#define MAX_DRBG_REQUEST 65536
+
+/* The output is produced in rounds. Each round fills one half of a double
+ * buffer: generator g fills block g of the half with its own DRBG, so the
+ * DRBG outputs are interleaved block by block. While the generators fill
+ * one half, the writer writes out the other.
+ */
+typedef enum {
+    HALF_IDLE,
+    HALF_FILLING,
+    HALF_FULL
+} half_state;
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    uint64_t round;
+    half_state state;
+    uint32_t pending;
+} stream_half;
+
+typedef struct {
+    rng_pool *pool;
+    uint32_t generators;
+    size_t block_size;
+
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t assigned;
+    stream_half halves[2];
+    bool done;
+    iqr_retval failed;
+} stream_state;
+
+typedef struct {
+    stream_state *stream;
+    uint32_t index;
+} generator_arg;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Generator threads.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval fill_block(rng_pool *pool, uint8_t *buf, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += MAX_DRBG_REQUEST) {
+        const size_t chunk = (size - offset < MAX_DRBG_REQUEST) ? size - offset : MAX_DRBG_REQUEST;
+        iqr_retval ret = rng_pool_get_bytes(pool, buf + offset, chunk);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    return IQR_OK;
+}
+
+static void *generator_thread(void *arg)
+{
+    const generator_arg *gen = arg;
+    stream_state *stream = gen->stream;
+
+    for (uint64_t round = 0; ; round++) {
+        stream_half *half = &stream->halves[round % 2];
+
+        pthread_mutex_lock(&stream->lock);
+        while (!(half->round == round && half->state == HALF_FILLING) && !stream->done && stream->failed == IQR_OK) {
+            pthread_cond_wait(&stream->assigned, &stream->lock);
+        }
+        if (stream->done || stream->failed != IQR_OK) {
+            pthread_mutex_unlock(&stream->lock);
+            break;
+        }
+        const size_t offset = (size_t)gen->index * stream->block_size;
+        const size_t size = (half->size > offset) ? half->size - offset : 0;
+        pthread_mutex_unlock(&stream->lock);
+
+        /* The last round may be short, leaving some generators with a
+         * partial block or nothing to do.
+         */
+        iqr_retval ret = fill_block(stream->pool, half->data + offset, (size < stream->block_size) ? size : stream->block_size);
+
+        pthread_mutex_lock(&stream->lock);
+        if (ret != IQR_OK && stream->failed == IQR_OK) {
+            stream->failed = ret;
+            pthread_cond_broadcast(&stream->assigned);
+        }
+        half->pending--;
+        if (half->pending == 0) {
+            half->state = HALF_FULL;
+        }
+        pthread_cond_signal(&stream->filled);
+        pthread_mutex_unlock(&stream->lock);
+    }
+
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Writer.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval write_all(int fd, const uint8_t *buf, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = write(fd, buf, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed on write(): %s\n", strerror(errno));
+            return IQR_EBADVALUE;
+        }
+        buf += written;
+        size -= (size_t)written;
+    }
+    return IQR_OK;
+}
+
+/* Call with the lock held. */
+static void assign_round(stream_state *stream, uint64_t round, uint64_t *assigned, uint64_t count)
+{
+    stream_half *half = &stream->halves[round % 2];
+    const size_t half_size = (size_t)stream->generators * stream->block_size;
+    const uint64_t left = count - *assigned;
+
+    half->size = (left < half_size) ? (size_t)left : half_size;
+    half->round = round;
+    half->state = HALF_FILLING;
+    half->pending = stream->generators;
+    *assigned += half->size;
+
+    pthread_cond_broadcast(&stream->assigned);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Streaming driver.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+iqr_retval stream_rng(const iqr_Context *ctx, iqr_HashAlgorithmType hash, const char *output, uint64_t count,
+    uint32_t generators, size_t block_size, FILE *msg)
+{
+    if (ctx == NULL || output == NULL || msg == NULL) {
+        return IQR_ENULLPTR;
+    }
+    if (generators == 0 || block_size == 0) {
+        return IQR_EBADVALUE;
+    }
+
+    const bool to_stdout = strcmp(output, "-") == 0;
+    const size_t half_size = (size_t)generators * block_size;
+
+    stream_state stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.generators = generators;
+    stream.block_size = block_size;
+    stream.failed = IQR_OK;
+
+    generator_arg *args = calloc(generators, sizeof(*args));
+    pthread_t *threads = calloc(generators, sizeof(*threads));
+    uint8_t *buffer = calloc(2, half_size);
+    if (args == NULL || threads == NULL || buffer == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(buffer);
+        free(threads);
+        free(args);
+        return IQR_ENOMEM;
+    }
+    stream.halves[0].data = buffer;
+    stream.halves[1].data = buffer + half_size;
+
+    int fd = -1;
+    uint32_t started = 0;
+    bool sync_created = false;
+
+    /* Every generator thread gets its own DRBG from the pool, seeded from
+     * the system and reseeded as it goes. Full blocks are bigger than anything
+     * the pool buffers, so they're generated in place.
+     */
+    rng_pool_config config;
+    rng_pool_default_config(&config);
+    config.hash = hash;
+
+    iqr_retval ret = rng_pool_create(ctx, &config, &stream.pool);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    if (to_stdout) {
+        fd = STDOUT_FILENO;
+    } else {
+        fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd < 0) {
+            fprintf(stderr, "Failed to open %s: %s\n", output, strerror(errno));
+            ret = IQR_EBADVALUE;
+            goto end;
+        }
+    }
+
+    if (pthread_mutex_init(&stream.lock, NULL) != 0) {
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+    if (pthread_cond_init(&stream.filled, NULL) != 0) {
+        pthread_mutex_destroy(&stream.lock);
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+    if (pthread_cond_init(&stream.assigned, NULL) != 0) {
+        pthread_cond_destroy(&stream.filled);
+        pthread_mutex_destroy(&stream.lock);
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+    sync_created = true;
+
+    /* Mark both halves as not belonging to any round yet. */
+    stream.halves[0].round = UINT64_MAX;
+    stream.halves[1].round = UINT64_MAX;
+
+    for (uint32_t g = 0; g < generators; g++) {
+        args[g].stream = &stream;
+        args[g].index = g;
+        int rc = pthread_create(&threads[g], NULL, generator_thread, &args[g]);
+        if (rc != 0) {
+            fprintf(stderr, "Failed on pthread_create(): %s\n", strerror(rc));
+            ret = IQR_ENOMEM;
+            goto end;
+        }
+        started++;
+    }
+
+    fprintf(msg, "Streaming with %u generator thread(s), %zu byte blocks.\n", generators, block_size);
+
+    const uint64_t start = time_now_ns();
+    uint64_t assigned = 0;
+
+    pthread_mutex_lock(&stream.lock);
+    for (uint64_t round = 0; round < 2 && assigned < count; round++) {
+        assign_round(&stream, round, &assigned, count);
+    }
+    pthread_mutex_unlock(&stream.lock);
+
+    uint64_t written = 0;
+    for (uint64_t round = 0; written < count; round++) {
+        stream_half *half = &stream.halves[round % 2];
+
+        pthread_mutex_lock(&stream.lock);
+        while (half->state != HALF_FULL && stream.failed == IQR_OK) {
+            pthread_cond_wait(&stream.filled, &stream.lock);
+        }
+        ret = stream.failed;
+        const size_t size = half->size;
+        pthread_mutex_unlock(&stream.lock);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+
+        ret = write_all(fd, half->data, size);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        written += size;
+
+        /* Wipe it before handing the half back; nothing should linger in
+         * memory once it's been written.
+         */
+        secure_memzero(half->data, size);
+
+        pthread_mutex_lock(&stream.lock);
+        half->state = HALF_IDLE;
+        if (assigned < count) {
+            assign_round(&stream, round + 2, &assigned, count);
+        }
+        pthread_mutex_unlock(&stream.lock);
+    }
+
+    const uint64_t elapsed = time_now_ns() - start;
+    const double seconds = (double)elapsed / 1e9;
+    fprintf(msg, "Streamed %llu bytes in %.3f s (%.1f MB/s).\n", (unsigned long long)written, seconds,
+        (double)written / 1e6 / (seconds > 0.0 ? seconds : 1e-9));
+
+end:
+    if (sync_created) {
+        pthread_mutex_lock(&stream.lock);
+        stream.done = true;
+        if (ret != IQR_OK && stream.failed == IQR_OK) {
+            stream.failed = ret;
+        }
+        pthread_cond_broadcast(&stream.assigned);
+        pthread_mutex_unlock(&stream.lock);
+
+        for (uint32_t g = 0; g < started; g++) {
+            pthread_join(threads[g], NULL);
+        }
+
+        pthread_cond_destroy(&stream.assigned);
+        pthread_cond_destroy(&stream.filled);
+        pthread_mutex_destroy(&stream.lock);
+    }
+
+    if (fd >= 0 && !to_stdout) {
+        if (close(fd) != 0 && ret == IQR_OK) {
+            fprintf(stderr, "Failed to close %s: %s\n", output, strerror(errno));
+            ret = IQR_EBADVALUE;
+        }
+    }
+
+    rng_pool_destroy(&stream.pool);
+    secure_memzero(buffer, 2 * half_size);
+    free(buffer);
+    free(threads);
+    free(args);
+
+    return ret;
+}
@@ -18,18 +18,22 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "bootstrap.h"
+#include "dh_load.h"
 #include "iqr_context.h"
 #include "iqr_samwise.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
 #include "iqr_rng.h"
 #include "isara_samples.h"
+#include "latency.h"
 
 #include "internal.h"
 
@@ -38,7 +42,9 @@
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static const char *usage_msg =
-"samwise [--dump] [--variant AES|ChaCha20]\n"
+"samwise [--dump] [--variant AES|ChaCha20] [--handshakes <count>]\n"
+"    [--threads <count>] [--transport memory|socketpair|tcp]\n"
+"    [--precompute <count>] [--latency <count>]\n"
 "        --dump Dumps the generated keys and secrets to file.\n"
 "               Filenames:\n"
 "                 Alice's key:    alice_key.dat\n"
@@ -48,7 +54,133 @@ static const char *usage_msg =
 "        --variant The variant of Samwise to use.\n"
 "               Valid values are:\n"
 "                 * AES\n"
-"                 * ChaCha20\n";
+"                 * ChaCha20\n"
+"        --handshakes Run this many handshakes on several threads and report\n"
+"               the throughput, instead of running one handshake.\n"
+"        --threads The number of threads for --handshakes; 0 (the default)\n"
+"               means one per CPU.\n"
+"        --transport How Alice's and Bob's messages travel.\n"
+"               Valid values are:\n"
+"                 * memory (the default)\n"
+"                 * socketpair, with Bob in a separate process\n"
+"                 * tcp, over loopback with Bob in a separate process\n"
+"               The handshake's round trip is timed. With --handshakes both\n"
+"               ends of every link stay in one process.\n"
+"        --precompute Keep this many of Bob's keys precomputed by a\n"
+"               background thread, so less of his work waits on Alice.\n"
+"               0 (the default) makes each key during its handshake.\n"
+"        --latency Time Bob's side of this many handshakes, one at a time,\n"
+"               first making his keys during each handshake and then taking\n"
+"               them from a warm pool of --precompute keys (16 if it isn't\n"
+"               given).\n";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// With a socket transport Bob runs in a child process of his own, and this is
+// his half of the handshake there.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval bob_process(const iqr_Context *ctx, bob_session *bob, comms_channel *comms, bool dump, uint8_t *secret,
+    size_t secret_size)
+{
+    /* The child starts with a copy of the parent's DRBG, so Bob would draw the
+     * same random numbers as Alice. He gets a DRBG of his own instead.
+     */
+    uint8_t seed[32] = { 0 };
+    iqr_RNG *rng = NULL;
+    iqr_retval ret = iqr_RNGCreateHMACDRBG(ctx, IQR_HASHALGO_SHA2_256, &rng);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+    ret = get_system_entropy(seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on get_system_entropy(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+    ret = iqr_RNGInitialize(rng, seed, sizeof(seed));
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = transport_echo(comms->link, TRANSPORT_PINGS);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = bob_start(bob, comms, rng, dump);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = bob_get_secret(bob, secret, secret_size);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Bob hands his secret back only so the sample can check that it matches
+     * Alice's. A real responder would never send it anywhere.
+     */
+    ret = transport_send(comms->link, TRANSPORT_BOB, secret, secret_size);
+
+end:
+    secure_memzero(seed, sizeof(seed));
+    iqr_RNGDestroy(&rng);
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Bob can make the part of his keys that doesn't depend on Alice ahead of
+// time. A background thread keeps a pool of them topped up, and Bob takes one
+// when a handshake starts. The pool has parameters of its own so it can serve
+// any number of Bobs.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void close_key_pool(iqr_SamwiseParams **params, keypool **pool)
+{
+    /* The pool's keys refer to its parameters, so the pool goes first. */
+    keypool_destroy(pool);
+    iqr_SamwiseDestroyParams(params);
+}
+
+static iqr_retval open_key_pool(const iqr_Context *ctx, const iqr_SamwiseVariant *variant, uint32_t size,
+    iqr_SamwiseParams **params, keypool **pool)
+{
+    iqr_retval ret = iqr_SamwiseCreateParams(ctx, variant, params);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SamwiseCreateParams(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    /* Refill when a quarter of the keys are left. */
+    const keypool_ops ops = { bob_precompute, bob_discard_precomputed };
+    ret = keypool_create(ctx, IQR_HASHALGO_SHA2_256, &ops, *params, size, size / 4, size, pool);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on keypool_create(): %s\n", iqr_StrError(ret));
+        close_key_pool(params, pool);
+        return ret;
+    }
+
+    ret = keypool_warm(*pool);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on keypool_warm(): %s\n", iqr_StrError(ret));
+        close_key_pool(params, pool);
+    }
+    return ret;
+}
+
+static void report_key_pool(const keypool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    keypool_stats(pool, &hits, &misses);
+    fprintf(stdout, "    Bob took %llu precomputed keys and made %llu during handshakes.\n", (unsigned long long)hits,
+        (unsigned long long)misses);
+}
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases the use of the Samwise algorithm to generate a
@@ -59,52 +191,107 @@ static const char *usage_msg =
 // failure.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval showcase_samwise(const iqr_Context *ctx, const iqr_RNG *rng, bool dump, const iqr_SamwiseVariant *variant)
+static iqr_retval showcase_samwise(const iqr_Context *ctx, const iqr_RNG *rng, bool dump,
+    const iqr_SamwiseVariant *variant, transport_kind transport, uint32_t precompute)
 {
-    iqr_retval ret = init_comms();
+    alice_session alice;
+    bob_session bob;
+    comms_channel comms;
+    memset(&alice, 0, sizeof(alice));
+    memset(&bob, 0, sizeof(bob));
+    memset(&comms, 0, sizeof(comms));
+    transport_role role = TRANSPORT_ROLE_BOTH;
+    iqr_SamwiseParams *pool_params = NULL;
+    keypool *pool = NULL;
+
+    iqr_retval ret = init_comms(&comms, transport);
     if (ret != IQR_OK) {
         return ret;
     }
 
-    ret = init_alice(ctx, variant);
+    ret = init_alice(&alice, ctx, variant);
     if (ret != IQR_OK) {
-        cleanup_comms();
+        cleanup_comms(&comms);
         return ret;
     }
-    ret = init_bob(ctx, variant);
+    ret = init_bob(&bob, ctx, variant);
     if (ret != IQR_OK) {
-        cleanup_alice();
-        cleanup_comms();
+        cleanup_alice(&alice);
+        cleanup_comms(&comms);
         return ret;
     }
 
     uint8_t alice_secret[IQR_SAMWISE_SECRET_SIZE] = { 0 };
     uint8_t bob_secret[IQR_SAMWISE_SECRET_SIZE] = { 0 };
 
+    /* With a socket transport Bob gets a process of his own and Alice stays
+     * in this one. Otherwise they take turns in this process.
+     */
+    ret = transport_fork(comms.link, &role);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    /* Bob's pool is made in whichever process he's in, since its thread
+     * wouldn't survive the fork.
+     */
+    if (precompute > 0 && role != TRANSPORT_ROLE_ALICE) {
+        ret = open_key_pool(ctx, variant, precompute, &pool_params, &pool);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        bob.pool = pool;
+    }
+
+    if (role == TRANSPORT_ROLE_BOB) {
+        ret = bob_process(ctx, &bob, &comms, dump, bob_secret, sizeof(bob_secret));
+        goto end;
+    }
+
+    transport_timing timing;
+    ret = transport_timing_begin(comms.link, &timing);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
     /* Alice must start the transfer. Bob cannot go first since, as the
      * responder, he needs information from Alice. For more information on how
      * the Samwise data protocol works see the README.md.
      */
-    ret = alice_start(rng, dump);
+    ret = alice_start(&alice, &comms, rng, dump);
     if (ret != IQR_OK) {
         goto end;
     }
 
-    ret = bob_start(rng, dump);
-    if (ret != IQR_OK) {
-        goto end;
+    if (role == TRANSPORT_ROLE_BOTH) {
+        ret = bob_start(&bob, &comms, rng, dump);
+        if (ret != IQR_OK) {
+            goto end;
+        }
     }
 
-    ret = alice_get_secret(alice_secret, sizeof(alice_secret));
+    ret = alice_get_secret(&alice, &comms, alice_secret, sizeof(alice_secret));
     if (ret != IQR_OK) {
         goto end;
     }
+    transport_timing_end(comms.link, &timing);
 
-    ret = bob_get_secret(bob_secret, sizeof(bob_secret));
+    if (role == TRANSPORT_ROLE_BOTH) {
+        ret = bob_get_secret(&bob, bob_secret, sizeof(bob_secret));
+    } else {
+        /* Bob's process sends his secret back; see bob_process(). */
+        size_t size = sizeof(bob_secret);
+        ret = transport_receive(comms.link, TRANSPORT_ALICE, bob_secret, &size);
+        if (ret == IQR_OK) {
+            ret = transport_join(comms.link);
+        }
+    }
     if (ret != IQR_OK) {
         goto end;
     }
 
+    transport_timing_report(comms.link, &timing);
+
     /* Test to make sure the secrets are the same */
     if (memcmp(alice_secret, bob_secret, sizeof(alice_secret)) == 0) {
         fprintf(stdout, "\nAlice and Bob's secrets match.\n\n");
@@ -127,49 +314,255 @@ end:
     secure_memzero(alice_secret, sizeof(alice_secret));
     secure_memzero(bob_secret, sizeof(bob_secret));
 
-    cleanup_alice();
-    cleanup_bob();
-    cleanup_comms();
+    cleanup_alice(&alice);
+    cleanup_bob(&bob);
+    cleanup_comms(&comms);
+    close_key_pool(&pool_params, &pool);
+
+    if (role == TRANSPORT_ROLE_BOB) {
+        /* This is Bob's process, and its work is done. */
+        exit((ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
 
     return ret;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
-// This next section of code is related to the toolkit, but is not specific to
-// Samwise.
+// The load generator runs many handshakes at once. Each thread has its own
+// Alice, Bob and channel, and reuses them for every handshake it runs.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
+typedef struct {
+    const iqr_Context *ctx;
+    const iqr_SamwiseVariant *variant;
+    transport_kind transport;
+    keypool *pool;
+} load_config;
+
+typedef struct {
+    alice_session alice;
+    bob_session bob;
+    comms_channel comms;
+    /* Time Bob spent on the last handshake. */
+    uint64_t bob_ns;
+} handshake_pair;
+
+static void destroy_pair(void *handshake)
+{
+    handshake_pair *pair = handshake;
+    cleanup_alice(&pair->alice);
+    cleanup_bob(&pair->bob);
+    cleanup_comms(&pair->comms);
+    free(pair);
+}
+
+static iqr_retval create_pair(const void *arg, void **handshake)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    const load_config *config = arg;
+
+    handshake_pair *pair = calloc(1, sizeof(*pair));
+    if (pair == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return IQR_ENOMEM;
+    }
+
+    iqr_retval ret = init_comms(&pair->comms, config->transport);
+    if (ret == IQR_OK) {
+        ret = init_alice(&pair->alice, config->ctx, config->variant);
+    }
+    if (ret == IQR_OK) {
+        ret = init_bob(&pair->bob, config->ctx, config->variant);
+    }
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_ContextCreate(): %s\n", iqr_StrError(ret));
+        destroy_pair(pair);
         return ret;
     }
 
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
+    pair->bob.pool = config->pool;
+
+    *handshake = pair;
+    return IQR_OK;
+}
+
+static iqr_retval run_pair(void *handshake, const iqr_RNG *rng, bool *match)
+{
+    handshake_pair *pair = handshake;
+    uint8_t alice_secret[IQR_SAMWISE_SECRET_SIZE] = { 0 };
+    uint8_t bob_secret[IQR_SAMWISE_SECRET_SIZE] = { 0 };
+
+    iqr_retval ret = alice_start(&pair->alice, &pair->comms, rng, false);
+    if (ret == IQR_OK) {
+        const uint64_t start = time_now_ns();
+        ret = bob_start(&pair->bob, &pair->comms, rng, false);
+        pair->bob_ns = time_now_ns() - start;
+    }
+    if (ret == IQR_OK) {
+        ret = alice_get_secret(&pair->alice, &pair->comms, alice_secret, sizeof(alice_secret));
+    }
+    if (ret == IQR_OK) {
+        const uint64_t start = time_now_ns();
+        ret = bob_get_secret(&pair->bob, bob_secret, sizeof(bob_secret));
+        pair->bob_ns += time_now_ns() - start;
+    }
+    *match = (ret == IQR_OK && memcmp(alice_secret, bob_secret, sizeof(alice_secret)) == 0);
+
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
+        /* A handshake that failed part way can leave private keys behind. */
+        iqr_SamwiseDestroyInitiatorPrivateKey(&pair->alice.initiator_private_key);
+        iqr_SamwiseDestroyResponderPrivateKey(&pair->bob.responder_private_key);
     }
 
-    /* This lets us give satisfactory randomness to the algorithm. */
-    ret = iqr_RNGCreateHMACDRBG(*ctx, IQR_HASHALGO_SHA2_256, rng);
+    secure_memzero(alice_secret, sizeof(alice_secret));
+    secure_memzero(bob_secret, sizeof(bob_secret));
+    return ret;
+}
+
+static iqr_retval run_load(const iqr_Context *ctx, const iqr_SamwiseVariant *variant, transport_kind transport,
+    uint32_t handshakes, uint32_t threads, uint32_t precompute)
+{
+    const dh_load_ops ops = { create_pair, run_pair, destroy_pair };
+
+    load_config config;
+    config.ctx = ctx;
+    config.transport = transport;
+    config.variant = variant;
+    config.pool = NULL;
+
+    /* Every thread's Bob takes his keys from the same pool. */
+    iqr_SamwiseParams *pool_params = NULL;
+    iqr_retval ret = IQR_OK;
+    if (precompute > 0) {
+        ret = open_key_pool(ctx, variant, precompute, &pool_params, &config.pool);
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+
+    dh_load_result result;
+    ret = dh_load_run(ctx, IQR_HASHALGO_SHA2_256, &ops, &config, handshakes, threads, &result);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    dh_load_report("Samwise", &result);
+    report_key_pool(config.pool);
+
+    /* Every handshake has to agree on a secret. */
+    if (result.failures > 0) {
+        ret = IQR_EINVDATA;
+    }
+
+end:
+    close_key_pool(&pool_params, &config.pool);
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The latency benchmark runs one handshake at a time and times Bob's side of
+// each, first with Bob making his keys during the handshake and then with him
+// taking them from a pool. Between handshakes the pool is given time to fill
+// up again, the way a server would refill it while it's idle.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+#define LATENCY_POOL_SIZE 16
+
+static iqr_retval time_bob(const load_config *config, const iqr_RNG *rng, uint32_t handshakes, latency_histogram *h)
+{
+    void *handshake = NULL;
+    iqr_retval ret = create_pair(config, &handshake);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
         return ret;
     }
+    handshake_pair *pair = handshake;
+
+    latency_reset(h);
+    for (uint32_t i = 0; i < handshakes; i++) {
+        if (config->pool != NULL) {
+            ret = keypool_warm(config->pool);
+            if (ret != IQR_OK) {
+                fprintf(stderr, "Failed on keypool_warm(): %s\n", iqr_StrError(ret));
+                break;
+            }
+        }
 
-    /* The seed should be initialized from a guaranteed entropy source. This is
-     * only an example; DO NOT INITIALIZE THE SEED LIKE THIS.
-     */
-    time_t seed = time(NULL);
+        bool match = false;
+        ret = run_pair(pair, rng, &match);
+        if (ret == IQR_OK && !match) {
+            fprintf(stderr, "Alice and Bob's secrets do NOT match.\n");
+            ret = IQR_EINVDATA;
+        }
+        if (ret != IQR_OK) {
+            break;
+        }
+        latency_record(h, pair->bob_ns);
+    }
+
+    destroy_pair(pair);
+    return ret;
+}
 
-    ret = iqr_RNGInitialize(*rng, (uint8_t *)&seed, sizeof(seed));
+static iqr_retval run_latency(const iqr_Context *ctx, const iqr_RNG *rng, const iqr_SamwiseVariant *variant,
+    transport_kind transport, uint32_t handshakes, uint32_t precompute)
+{
+    load_config config;
+    config.ctx = ctx;
+    config.transport = transport;
+    config.variant = variant;
+    config.pool = NULL;
+
+    iqr_SamwiseParams *pool_params = NULL;
+    latency_histogram *cold = calloc(1, sizeof(*cold));
+    latency_histogram *warm = calloc(1, sizeof(*warm));
+    iqr_retval ret = IQR_OK;
+    if (cold == NULL || warm == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = time_bob(&config, rng, handshakes, cold);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = open_key_pool(ctx, variant, (precompute > 0) ? precompute : LATENCY_POOL_SIZE, &pool_params, &config.pool);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    ret = time_bob(&config, rng, handshakes, warm);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    latency_print(stdout, "Cold responder", cold);
+    latency_print(stdout, "Pre-warmed responder", warm);
+    report_key_pool(config.pool);
+
+end:
+    close_key_pool(&pool_params, &config.pool);
+    free(cold);
+    free(warm);
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// Samwise.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
+{
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Create an HMAC DRBG object, seeded from the system's entropy source. */
+    ret = bootstrap_rng(IQR_HASHALGO_SHA2_256, rng);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -186,7 +579,8 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 // Report the chosen runtime parameters.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static void preamble(const char *cmd, bool dump, const iqr_SamwiseVariant *variant)
+static void preamble(const char *cmd, bool dump, const iqr_SamwiseVariant *variant, transport_kind transport, uint32_t handshakes,
+    uint32_t threads, uint32_t precompute, uint32_t latency)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     fprintf(stdout, "    Dump data to files: ");
@@ -205,10 +599,52 @@ static void preamble(const char *cmd, bool dump, const iqr_SamwiseVariant *varia
         fprintf(stdout, "Invalid\n");
     }
 
+    fprintf(stdout, "    Transport: %s\n", transport_name(transport));
+
+    if (handshakes > 0) {
+        fprintf(stdout, "    Handshakes: %u\n", handshakes);
+        if (threads == 0) {
+            fprintf(stdout, "    Threads: one per CPU\n");
+        } else {
+            fprintf(stdout, "    Threads: %u\n", threads);
+        }
+    }
+
+    if (precompute > 0) {
+        fprintf(stdout, "    Precomputed keys: %u\n", precompute);
+    }
+    if (latency > 0) {
+        fprintf(stdout, "    Latency handshakes: %u\n", latency);
+    }
+
     fprintf(stdout, "\n");
 }
 
-static iqr_retval parse_commandline(int argc, const char **argv, bool *dump, const iqr_SamwiseVariant **variant)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Parse a parameter string which is supposed to be a positive integer
+// and return the value or -1 if the string is not a positive integer.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, bool *dump, const iqr_SamwiseVariant **variant,
+    transport_kind *transport, uint32_t *handshakes, uint32_t *threads, uint32_t *precompute, uint32_t *latency)
 {
     int i = 1;
 
@@ -225,6 +661,49 @@ static iqr_retval parse_commandline(int argc, const char **argv, bool *dump, con
                 fprintf(stdout, "%s", usage_msg);
                 return IQR_EBADVALUE;
             }
+        } else if (paramcmp(argv[i], "--handshakes") == 0) {
+            /* [--handshakes <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 1) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *handshakes = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--threads") == 0) {
+            /* [--threads <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 0 || value > 1024) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *threads = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--transport") == 0) {
+            /* [--transport memory|socketpair|tcp] */
+            i++;
+            if (i == argc || transport_parse(argv[i], transport) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--precompute") == 0) {
+            /* [--precompute <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 0 || value > 4096) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *precompute = (uint32_t)value;
+        } else if (paramcmp(argv[i], "--latency") == 0) {
+            /* [--latency <count>] */
+            i++;
+            const int32_t value = (i == argc) ? -1 : get_positive_int_param(argv[i]);
+            if (value < 1) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *latency = (uint32_t)value;
         } else {
             fprintf(stdout, "%s", usage_msg);
             return IQR_EBADVALUE;
@@ -232,6 +711,18 @@ static iqr_retval parse_commandline(int argc, const char **argv, bool *dump, con
         i++;
     }
 
+    /* The load generator doesn't write files. */
+    if (*dump && *handshakes > 0) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
+    /* The latency benchmark runs its own handshakes. */
+    if (*latency > 0 && (*dump || *handshakes > 0)) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
     return IQR_OK;
 }
 
@@ -246,6 +737,11 @@ int main(int argc, const char **argv)
      */
     const iqr_SamwiseVariant *variant = &IQR_SAMWISE_976_AES;
     bool dump = false;
+    uint32_t handshakes = 0;
+    uint32_t threads = 0;
+    transport_kind transport = TRANSPORT_MEMORY;
+    uint32_t precompute = 0;
+    uint32_t latency = 0;
 
     iqr_Context *ctx = NULL;
     iqr_RNG *rng = NULL;
@@ -253,13 +749,14 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &dump, &variant);
+    iqr_retval ret = parse_commandline(argc, argv, &dump, &variant, &transport, &handshakes, &threads, &precompute,
+        &latency);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], dump, variant);
+    preamble(argv[0], dump, variant, transport, handshakes, threads, precompute, latency);
 
     /* IQR initialization that is not specific to Samwise. */
     ret = init_toolkit(&ctx, &rng);
@@ -268,11 +765,16 @@ int main(int argc, const char **argv)
     }
 
     /* This function showcases the usage of Samwise. */
-    ret = showcase_samwise(ctx, rng, dump, variant);
+    if (latency > 0) {
+        ret = run_latency(ctx, rng, variant, transport, latency, precompute);
+    } else if (handshakes > 0) {
+        ret = run_load(ctx, variant, transport, handshakes, threads, precompute);
+    } else {
+        ret = showcase_samwise(ctx, rng, dump, variant, transport, precompute);
+    }
 
 cleanup:
     /* Clean up. */
-    iqr_RNGDestroy(&rng);
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
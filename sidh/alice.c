@@ -2,9 +2,9 @@
  *
  * @brief Functions to demonstrate how Alice should use SIDH.
  *
- * Alice is treated as a pseudo-separate process. She has her own params and
- * appears to keep her own state. It is done like this to show how the "Alice"
- * side of the transaction can be performed independent of Bob.
+ * Alice is treated as a pseudo-separate process. She keeps her params and
+ * private key in a alice_session, so the "Alice" side of the transaction can be
+ * performed independent of Bob, and of any other handshake.
  *
  * @copyright Copyright (C) 2017-2019, ISARA Corporation
  *
@@ -23,7 +23,6 @@
 
 #include "internal.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -32,59 +31,65 @@
 #include "iqr_sidh.h"
 #include "isara_samples.h"
 
-/* It is not suggested to make these global variables. It's not thread safe.
- * It would be better to pass this around as required. It is done this way to
- * facilitate the pseudo-separate process paradigm.
- */
-static iqr_SIDHParams *params;
-static iqr_SIDHAlicePrivateKey *alice_private_key;
-
-iqr_retval init_alice(const iqr_Context *ctx, const iqr_SIDHVariant *variant, size_t *secret_size)
+iqr_retval init_alice(alice_session *alice, const iqr_Context *ctx, const iqr_SIDHVariant *variant, size_t *secret_size)
 {
+    if (alice == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (ctx == NULL || variant == NULL || secret_size == NULL) {
         fprintf(stderr, "Context was null.\n");
         return IQR_ENULLPTR;
     }
 
-    iqr_retval ret = iqr_SIDHCreateParams(ctx, variant, &params);
+    iqr_retval ret = iqr_SIDHCreateParams(ctx, variant, &alice->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHCreateParams(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    ret = iqr_SIDHGetSecretSize(params, secret_size);
+    ret = iqr_SIDHGetSecretSize(alice->params, secret_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetSecretSize(): %s\n", iqr_StrError(ret));
     }
     return ret;
 }
 
-iqr_retval alice_start(const iqr_RNG *rng, bool dump)
+iqr_retval alice_start(alice_session *alice, comms_channel *comms, const iqr_RNG *rng, bool dump)
 {
+    if (alice == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (rng == NULL) {
         fprintf(stderr, "The RNG was NULL and we really need that RNG.\n");
         return IQR_ENULLPTR;
     }
 
     size_t alice_size = 0;
-    iqr_retval ret = iqr_SIDHGetPublicKeySize(params, &alice_size);
+    iqr_retval ret = iqr_SIDHGetPublicKeySize(alice->params, &alice_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetPublicKeySize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    uint8_t *alice_public_key = calloc(1, alice_size);
-    if (alice_public_key == NULL) {
-        fprintf(stderr, "We seem to have run out of memory. ret=%d\n", errno);
-        return IQR_ENOMEM;
+    /* The public key is written straight into a slab from the channel, and
+     * sending it hands the slab over.
+     */
+    uint8_t *alice_public_key = NULL;
+    ret = comms_acquire(comms, &alice_public_key);
+    if (ret != IQR_OK) {
+        return ret;
     }
 
-    ret = iqr_SIDHCreateAlicePrivateKey(params, rng, &alice_private_key);
+    ret = iqr_SIDHCreateAlicePrivateKey(alice->params, rng, &alice->alice_private_key);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHCreateAlicePrivateKey(): %s\n", iqr_StrError(ret));
         goto end;
     }
-    ret = iqr_SIDHGetAlicePublicKey(alice_private_key, alice_public_key, alice_size);
+    ret = iqr_SIDHGetAlicePublicKey(alice->alice_private_key, alice_public_key, alice_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetAlicePublicKey(): %s\n", iqr_StrError(ret));
         goto end;
@@ -97,18 +102,24 @@ iqr_retval alice_start(const iqr_RNG *rng, bool dump)
         }
     }
 
-    ret = send_to_bob(alice_public_key, alice_size);
+    ret = send_to_bob(comms, alice_public_key, alice_size);
+    alice_public_key = NULL;
 
 end:
     if (ret != IQR_OK) {
-        iqr_SIDHDestroyAlicePrivateKey(&alice_private_key);
+        iqr_SIDHDestroyAlicePrivateKey(&alice->alice_private_key);
     }
-    free(alice_public_key);
+    comms_release(comms, alice_public_key);
     return ret;
 }
 
-iqr_retval alice_get_secret(uint8_t *secret, size_t secret_size)
+iqr_retval alice_get_secret(alice_session *alice, comms_channel *comms, uint8_t *secret, size_t secret_size)
 {
+    if (alice == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     iqr_retval ret = IQR_OK;
     uint8_t *bob_public_key = NULL;
 
@@ -117,41 +128,38 @@ iqr_retval alice_get_secret(uint8_t *secret, size_t secret_size)
         return IQR_ENULLPTR;
     }
 
+    /* Bob's key arrives in a slab, which goes back to the channel at the end. */
     size_t bob_size = 0;
-    ret = iqr_SIDHGetPublicKeySize(params, &bob_size);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_SIDHGetPublicKeySize(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    bob_public_key = calloc(1, bob_size);
-    if (bob_public_key == NULL) {
-        fprintf(stderr, "We seem to have run out of memory. ret=%d\n", errno);
-        return  IQR_ENOMEM;
-    }
-
-    ret = receive_from_bob(bob_public_key, &bob_size);
+    ret = receive_from_bob(comms, &bob_public_key, &bob_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "We couldn't get Bob's public key.\n");
         goto end;
     }
 
-    ret = iqr_SIDHGetAliceSecret(alice_private_key, bob_public_key, bob_size, secret, secret_size);
+    ret = iqr_SIDHGetAliceSecret(alice->alice_private_key, bob_public_key, bob_size, secret, secret_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetAliceSecret(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
 end:
-    free(bob_public_key);
-    iqr_SIDHDestroyAlicePrivateKey(&alice_private_key);
+    comms_release(comms, bob_public_key);
+    iqr_SIDHDestroyAlicePrivateKey(&alice->alice_private_key);
 
     return ret;
 }
 
-iqr_retval cleanup_alice(void)
+iqr_retval cleanup_alice(alice_session *alice)
 {
-    iqr_retval ret = iqr_SIDHDestroyParams(&params);
+    if (alice == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
+    /* A handshake that stopped part way can leave a private key behind. */
+    iqr_SIDHDestroyAlicePrivateKey(&alice->alice_private_key);
+
+    iqr_retval ret = iqr_SIDHDestroyParams(&alice->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHDestroyParams(): %s\n", iqr_StrError(ret));
     }
@@ -2,9 +2,9 @@
  *
  * @brief Functions to demonstrate how Bob should use SIDH.
  *
- * Bob is treated as a pseudo-separate process. He has his own params and
- * appears to keep his own state. It is done like this to show how the "Bob"
- * side of the transaction can be performed independent of Alice.
+ * Bob is treated as a pseudo-separate process. He keeps his params and
+ * private key in a bob_session, so the "Bob" side of the transaction can be
+ * performed independent of Alice, and of any other handshake.
  *
  * @copyright Copyright (C) 2017-2019, ISARA Corporation
  *
@@ -26,63 +26,149 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "iqr_retval.h"
 #include "iqr_rng.h"
 #include "iqr_sidh.h"
 #include "isara_samples.h"
 
-/* It is not suggested to make these global variables. It's not thread safe.
- * It would be better to pass this around as required. It is done this way to
- * facilitate the pseudo-separate process paradigm.
- */
-static iqr_SIDHParams *params;
-static iqr_SIDHBobPrivateKey *bob_private_key;
-
-iqr_retval init_bob(const iqr_Context *ctx, const iqr_SIDHVariant *variant)
+iqr_retval init_bob(bob_session *bob, const iqr_Context *ctx, const iqr_SIDHVariant *variant)
 {
+    if (bob == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     if (ctx == NULL || variant == NULL) {
         fprintf(stderr, "Context was null, somehow.\n");
         return IQR_ENULLPTR;
     }
 
-    iqr_retval ret = iqr_SIDHCreateParams(ctx, variant, &params);
+    iqr_retval ret = iqr_SIDHCreateParams(ctx, variant, &bob->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHCreateParams(): %s\n", iqr_StrError(ret));
     }
     return ret;
 }
 
-iqr_retval bob_start(const iqr_RNG *rng, bool dump)
-{
-    if (rng == NULL) {
-        fprintf(stderr, "The RNG was NULL and we really need that RNG.\n");
-        return IQR_ENULLPTR;
-    }
+/* Bob's precomputed key pair; the public key is kept in its encoded form so
+ * it only has to be copied into a slab.
+ */
+typedef struct {
+    iqr_SIDHBobPrivateKey *private_key;
+    size_t public_key_size;
+    uint8_t public_key[];
+} bob_key_pair;
 
-    size_t bob_size = 0;
-    iqr_retval ret = iqr_SIDHGetPublicKeySize(params, &bob_size);
+iqr_retval bob_precompute(const void *params, const iqr_RNG *rng, void **precomputed)
+{
+    size_t size = 0;
+    iqr_retval ret = iqr_SIDHGetPublicKeySize(params, &size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetPublicKeySize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    uint8_t *bob_public_key = calloc(1, bob_size);
-    if (bob_public_key == NULL) {
-        fprintf(stderr, "Couldn't find more memory. ret=%d\n", errno);
+    bob_key_pair *pair = calloc(1, sizeof(*pair) + size);
+    if (pair == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
         return IQR_ENOMEM;
     }
+    pair->public_key_size = size;
 
-    ret = iqr_SIDHCreateBobPrivateKey(params, rng, &bob_private_key);
+    ret = iqr_SIDHCreateBobPrivateKey(params, rng, &pair->private_key);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHCreateBobPrivateKey(): %s\n", iqr_StrError(ret));
-        goto end;
+        free(pair);
+        return ret;
     }
 
-    ret = iqr_SIDHGetBobPublicKey(bob_private_key, bob_public_key, bob_size);
+    ret = iqr_SIDHGetBobPublicKey(pair->private_key, pair->public_key, size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetBobPublicKey(): %s\n", iqr_StrError(ret));
-        goto end;
+        bob_discard_precomputed(pair);
+        return ret;
+    }
+
+    *precomputed = pair;
+    return IQR_OK;
+}
+
+void bob_discard_precomputed(void *precomputed)
+{
+    bob_key_pair *pair = precomputed;
+    if (pair == NULL) {
+        return;
+    }
+    iqr_SIDHDestroyBobPrivateKey(&pair->private_key);
+    free(pair);
+}
+
+iqr_retval bob_start(bob_session *bob, comms_channel *comms, const iqr_RNG *rng, bool dump)
+{
+    if (bob == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
+    if (rng == NULL) {
+        fprintf(stderr, "The RNG was NULL and we really need that RNG.\n");
+        return IQR_ENULLPTR;
+    }
+
+    size_t bob_size = 0;
+    iqr_retval ret = iqr_SIDHGetPublicKeySize(bob->params, &bob_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_SIDHGetPublicKeySize(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+
+    /* The public key is written straight into a slab from the channel, and
+     * sending it hands the slab over.
+     */
+    uint8_t *bob_public_key = NULL;
+    ret = comms_acquire(comms, &bob_public_key);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    if (bob->pool != NULL) {
+        /* Bob's key pair doesn't depend on anything from Alice, so it was
+         * made ahead of time and all that's left is to send it.
+         */
+        void *precomputed = NULL;
+        ret = keypool_take(bob->pool, &precomputed);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on keypool_take(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+
+        bob_key_pair *pair = precomputed;
+        bob->bob_private_key = pair->private_key;
+        pair->private_key = NULL;
+        if (pair->public_key_size == bob_size) {
+            memcpy(bob_public_key, pair->public_key, bob_size);
+        } else {
+            fprintf(stderr, "The precomputed key is for a different variant.\n");
+            ret = IQR_EINVBUFSIZE;
+        }
+        bob_discard_precomputed(pair);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+    } else {
+        ret = iqr_SIDHCreateBobPrivateKey(bob->params, rng, &bob->bob_private_key);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_SIDHCreateBobPrivateKey(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+
+        ret = iqr_SIDHGetBobPublicKey(bob->bob_private_key, bob_public_key, bob_size);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_SIDHGetBobPublicKey(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
     }
 
     if (dump) {
@@ -92,18 +178,24 @@ iqr_retval bob_start(const iqr_RNG *rng, bool dump)
         }
     }
 
-    ret = send_to_alice(bob_public_key, bob_size);
+    ret = send_to_alice(comms, bob_public_key, bob_size);
+    bob_public_key = NULL;
 
 end:
     if (ret != IQR_OK) {
-        iqr_SIDHDestroyBobPrivateKey(&bob_private_key);
+        iqr_SIDHDestroyBobPrivateKey(&bob->bob_private_key);
     }
-    free(bob_public_key);
+    comms_release(comms, bob_public_key);
     return ret;
 }
 
-iqr_retval bob_get_secret(uint8_t *secret, size_t secret_size)
+iqr_retval bob_get_secret(bob_session *bob, comms_channel *comms, uint8_t *secret, size_t secret_size)
 {
+    if (bob == NULL || comms == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
     iqr_retval ret = IQR_OK;
     uint8_t *alice_public_key = NULL;
 
@@ -113,40 +205,37 @@ iqr_retval bob_get_secret(uint8_t *secret, size_t secret_size)
         goto end;
     }
 
+    /* Alice's key arrives in a slab, which goes back to the channel at the end. */
     size_t alice_size = 0;
-    ret = iqr_SIDHGetPublicKeySize(params, &alice_size);
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_SIDHGetPublicKeySize(): %s\n", iqr_StrError(ret));
-        goto end;
-    }
-
-    alice_public_key = calloc(1, alice_size);
-    if (alice_public_key == NULL) {
-        fprintf(stderr, "We seem to have run out of memory. ret=%d\n", errno);
-        ret = IQR_ENOMEM;
-    }
-
-    ret = receive_from_alice(alice_public_key, &alice_size);
+    ret = receive_from_alice(comms, &alice_public_key, &alice_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "We couldn't get Alice's public key.\n");
         goto end;
     }
 
-    ret = iqr_SIDHGetBobSecret(bob_private_key, alice_public_key, alice_size, secret, secret_size);
+    ret = iqr_SIDHGetBobSecret(bob->bob_private_key, alice_public_key, alice_size, secret, secret_size);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHGetBobSecret(): %s\n", iqr_StrError(ret));
         goto end;
     }
 
 end:
-    free(alice_public_key);
-    iqr_SIDHDestroyBobPrivateKey(&bob_private_key);
+    comms_release(comms, alice_public_key);
+    iqr_SIDHDestroyBobPrivateKey(&bob->bob_private_key);
     return ret;
 }
 
-iqr_retval cleanup_bob(void)
+iqr_retval cleanup_bob(bob_session *bob)
 {
-    iqr_retval ret = iqr_SIDHDestroyParams(&params);
+    if (bob == NULL) {
+        fprintf(stderr, "The session was null.\n");
+        return IQR_ENULLPTR;
+    }
+
+    /* A handshake that stopped part way can leave a private key behind. */
+    iqr_SIDHDestroyBobPrivateKey(&bob->bob_private_key);
+
+    iqr_retval ret = iqr_SIDHDestroyParams(&bob->params);
     if (ret != IQR_OK) {
         fprintf(stderr, "Failed on iqr_SIDHDestroyParams(): %s\n", iqr_StrError(ret));
     }
@@ -1,8 +1,9 @@
 /** @file comms.c
  *
- * @brief A fake communication channel used for communication between the
- * fabricated Alice and Bob. Meant to act as a network or other communication
- * channel to help demonstrate the process of key establishment.
+ * @brief A communication channel used for communication between the
+ * fabricated Alice and Bob. It carries their messages in memory, over a
+ * socketpair or over loopback TCP, to help demonstrate the process of key
+ * establishment and to measure what the exchange costs on the wire.
  *
  * Quick suggestion, don't look too deeply into this file. It is not an example
  * of how to write good clean code. It is merely a stub required to help users
@@ -26,94 +27,71 @@
 
 #include "internal.h"
 
-#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "iqr_sidh.h"
 
-#define NUM_TRANSACTIONS    2
 #define MAX_PAYLOAD_BYTES   564
 
-/* Alice sends her public key stored in index 0.
- * Bob sends his public key stored in index 1.
+/* Messages travel over the channel's transport; Alice sends and receives at
+ * her end of the link and Bob at his. With a socket transport the two ends
+ * can be in different processes.
+ *
+ * A message is built in a slab from comms_acquire(), and send_to_*() takes
+ * the slab back whether or not it succeeds. receive_from_*() hands over the
+ * slab the message arrived in; give it back with comms_release(). On the
+ * memory transport the sender's slab is the one the receiver gets, so the
+ * keys are never copied or allocated per handshake.
  */
-#define ALICE_KEY_INDEX    0
-#define BOB_KEY_INDEX      1
 
-struct com_buf {
-    uint8_t *data;
-    size_t size;
-};
+iqr_retval init_comms(comms_channel *comms, transport_kind kind)
+{
+    return transport_open(kind, MAX_PAYLOAD_BYTES, &comms->link);
+}
 
-static struct com_buf gross_global_bufs[NUM_TRANSACTIONS];
+void cleanup_comms(comms_channel *comms)
+{
+    transport_close(&comms->link);
+}
 
-iqr_retval init_comms(void)
+iqr_retval comms_acquire(comms_channel *comms, uint8_t **buf)
 {
-    for (int i = 0; i < NUM_TRANSACTIONS; i++) {
-        gross_global_bufs[i].data = calloc(1, MAX_PAYLOAD_BYTES);
-        if (gross_global_bufs[i].data == NULL) {
-            fprintf(stderr, "MEMORY ERROR!!!. ret=%d\n", errno);
-            return IQR_ENOMEM;
-        }
-        gross_global_bufs[i].size = 0;
-    }
-    return IQR_OK;
+    return transport_acquire(comms->link, buf);
 }
 
-void cleanup_comms(void)
+void comms_release(comms_channel *comms, uint8_t *buf)
 {
-    for (int i = 0; i < NUM_TRANSACTIONS; i++) {
-        free(gross_global_bufs[i].data);
-    }
+    transport_release(comms->link, buf);
 }
 
-iqr_retval send_to_alice(uint8_t *buf, size_t size)
+iqr_retval send_to_alice(comms_channel *comms, uint8_t *buf, size_t size)
 {
     if (size > MAX_PAYLOAD_BYTES) {
         fprintf(stderr, "Need less bytes.\n");
+        transport_release(comms->link, buf);
         return IQR_EBADVALUE;
     }
-
-    memcpy(gross_global_bufs[BOB_KEY_INDEX].data, buf, size);
-    gross_global_bufs[BOB_KEY_INDEX].size = size;
-    return IQR_OK;
+    return transport_send_slab(comms->link, TRANSPORT_BOB, buf, size);
 }
 
-iqr_retval send_to_bob(uint8_t *buf, size_t size)
+iqr_retval send_to_bob(comms_channel *comms, uint8_t *buf, size_t size)
 {
     if (size > MAX_PAYLOAD_BYTES) {
         fprintf(stderr, "Bob cannot store that much data.\n");
+        transport_release(comms->link, buf);
         return IQR_EBADVALUE;
     }
-
-    memcpy(gross_global_bufs[ALICE_KEY_INDEX].data, buf, size);
-    gross_global_bufs[ALICE_KEY_INDEX].size = size;
-    return IQR_OK;
+    return transport_send_slab(comms->link, TRANSPORT_ALICE, buf, size);
 }
 
-iqr_retval receive_from_alice(uint8_t *buf, size_t *size)
+iqr_retval receive_from_alice(comms_channel *comms, uint8_t **buf, size_t *size)
 {
-    if (*size > MAX_PAYLOAD_BYTES) {
-        fprintf(stderr, "That buffer is a tad on the large side.\n");
-        return IQR_EBADVALUE;
-    }
-
-    memcpy(buf, gross_global_bufs[ALICE_KEY_INDEX].data, gross_global_bufs[ALICE_KEY_INDEX].size);
-    *size = gross_global_bufs[ALICE_KEY_INDEX].size;
-    return IQR_OK;
+    return transport_receive_slab(comms->link, TRANSPORT_BOB, buf, size);
 }
 
-iqr_retval receive_from_bob(uint8_t *buf, size_t *size)
+iqr_retval receive_from_bob(comms_channel *comms, uint8_t **buf, size_t *size)
 {
-    if (*size > MAX_PAYLOAD_BYTES) {
-        fprintf(stderr, "You want too many bytes, don't be greedy.\n");
-        return IQR_EBADVALUE;
-    }
-
-    memcpy(buf, gross_global_bufs[BOB_KEY_INDEX].data, gross_global_bufs[BOB_KEY_INDEX].size);
-    *size = gross_global_bufs[BOB_KEY_INDEX].size;
-    return IQR_OK;
+    return transport_receive_slab(comms->link, TRANSPORT_ALICE, buf, size);
 }
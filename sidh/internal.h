@@ -28,29 +28,62 @@
 #include "iqr_rng.h"
 #include "iqr_sidh.h"
 
+#include "keypool.h"
+#include "transport.h"
+
 #define ALICE_KEY_FNAME     "alice_key.dat"
 #define BOB_KEY_FNAME       "bob_key.dat"
 #define ALICE_SECRET_FNAME  "alice_secret.dat"
 #define BOB_SECRET_FNAME    "bob_secret.dat"
 
+/* Each side of a handshake keeps its state in a session, and the two sides
+ * talk over a comms_channel. Nothing is shared between handshakes, so any
+ * number of them can run at once, on any threads, as long as each has its own
+ * sessions and channel. The one exception is Bob's key pool, which is thread
+ * safe. Zero these structures before their init_*() call.
+ */
+
+/* The channel between one Alice and one Bob. */
+typedef struct {
+    transport_link *link;
+} comms_channel;
+
+typedef struct {
+    iqr_SIDHParams *params;
+    iqr_SIDHAlicePrivateKey *alice_private_key;
+} alice_session;
+
+typedef struct {
+    iqr_SIDHParams *params;
+    iqr_SIDHBobPrivateKey *bob_private_key;
+    /* Precomputed keys to take instead of making them during the
+     * handshake, or NULL. Bob doesn't own the pool.
+     */
+    keypool *pool;
+} bob_session;
+
 /* Alice related. */
-iqr_retval init_alice(const iqr_Context *ctx, const iqr_SIDHVariant *variant, size_t *secret_size);
-iqr_retval alice_start(const iqr_RNG *rng, bool dump);
-iqr_retval alice_get_secret(uint8_t *secret, size_t secret_size);
-iqr_retval cleanup_alice(void);
+iqr_retval init_alice(alice_session *alice, const iqr_Context *ctx, const iqr_SIDHVariant *variant, size_t *secret_size);
+iqr_retval alice_start(alice_session *alice, comms_channel *comms, const iqr_RNG *rng, bool dump);
+iqr_retval alice_get_secret(alice_session *alice, comms_channel *comms, uint8_t *secret, size_t secret_size);
+iqr_retval cleanup_alice(alice_session *alice);
 
 /* Bob related */
-iqr_retval init_bob(const iqr_Context *ctx, const iqr_SIDHVariant *variant);
-iqr_retval bob_start(const iqr_RNG *rng, bool dump);
-iqr_retval bob_get_secret(uint8_t *secret, size_t secret_size);
-iqr_retval cleanup_bob(void);
+iqr_retval init_bob(bob_session *bob, const iqr_Context *ctx, const iqr_SIDHVariant *variant);
+iqr_retval bob_precompute(const void *params, const iqr_RNG *rng, void **precomputed);
+void bob_discard_precomputed(void *precomputed);
+iqr_retval bob_start(bob_session *bob, comms_channel *comms, const iqr_RNG *rng, bool dump);
+iqr_retval bob_get_secret(bob_session *bob, comms_channel *comms, uint8_t *secret, size_t secret_size);
+iqr_retval cleanup_bob(bob_session *bob);
 
 /* Comms related. */
-iqr_retval init_comms(void);
-iqr_retval send_to_alice(uint8_t *buf, size_t size);
-iqr_retval send_to_bob(uint8_t *buf, size_t size);
-iqr_retval receive_from_alice(uint8_t *buf, size_t *size);
-iqr_retval receive_from_bob(uint8_t *buf, size_t *size);
-void cleanup_comms(void);
+iqr_retval init_comms(comms_channel *comms, transport_kind kind);
+iqr_retval comms_acquire(comms_channel *comms, uint8_t **buf);
+void comms_release(comms_channel *comms, uint8_t *buf);
+iqr_retval send_to_alice(comms_channel *comms, uint8_t *buf, size_t size);
+iqr_retval send_to_bob(comms_channel *comms, uint8_t *buf, size_t size);
+iqr_retval receive_from_alice(comms_channel *comms, uint8_t **buf, size_t *size);
+iqr_retval receive_from_bob(comms_channel *comms, uint8_t **buf, size_t *size);
+void cleanup_comms(comms_channel *comms);
 
 #endif
@@ -0,0 +1,939 @@
+/** @file main.c
+ *
+ * @brief Compare the speed of the toolkit's signature schemes.
+ *
+ * @copyright Copyright (C) 2019, ISARA Corporation
+ *
+ * @license Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * <a href="http://www.apache.org/licenses/LICENSE-2.0">http://www.apache.org/licenses/LICENSE-2.0</a>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootstrap.h"
+#include "iqr_context.h"
+#include "iqr_hash.h"
+#include "iqr_retval.h"
+#include "iqr_rng.h"
+#include "isara_samples.h"
+#include "rng_pool.h"
+#include "sig_table.h"
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Document the command-line arguments.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const char *usage_msg =
+"sig_bench [--sig all|<sig>[,<sig>...]] [--strategy <strategy>[,<strategy>...]]\n"
+"  [--message-sizes <bytes>[,<bytes>...]] [--iterations <count>]\n"
+"  [--keygen-iterations <count>] [--format csv|json] [--output <filename>]\n"
+"  [--compare <baseline> [--tolerance <percent>]]\n"
+"    <sig> is a variant name such as dilithium-128, rainbow-iiic,\n"
+"    sphincs-shake256f, hss-2e20f, xmss-16 or xmssmt-2e40_4d; see the\n"
+"    README for the full list.\n"
+"    <strategy> is cpu, memory or full; it only applies to HSS, XMSS and\n"
+"    XMSS^MT.\n"
+"    Defaults are: \n"
+"        --sig all\n"
+"        --strategy cpu,memory,full\n"
+"        --message-sizes 32,1024,65536\n"
+"        --iterations 100\n"
+"        --keygen-iterations 5\n"
+"        --format csv\n"
+"        --output stdout\n"
+"        --tolerance 10\n"
+"  Times key generation, signing and verification for each variant, tree\n"
+"  strategy and message size. With --compare, the results are checked\n"
+"  against a baseline written earlier with --format json; the results\n"
+"  themselves are only written if you give --output.\n";
+
+#define MAX_MESSAGE_SIZES 16
+#define MAX_LINE_FIELD 64
+
+typedef enum {
+    OP_KEYGEN,
+    OP_SIGN,
+    OP_VERIFY,
+    OP_COUNT
+} sig_op;
+
+static const char *op_names[OP_COUNT] = { "keygen", "sign", "verify" };
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSON
+} output_format;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Results.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const sig_scheme *sig;
+    /* Empty for the stateless schemes. */
+    const char *strategy;
+    sig_op op;
+    /* 0 for key generation. */
+    size_t message_bytes;
+    size_t iterations;
+    uint64_t min_ns;
+    uint64_t median_ns;
+    uint64_t p99_ns;
+    double ops_per_sec;
+    uint64_t peak_rss;
+    sig_sizes sizes;
+} bench_row;
+
+typedef struct {
+    FILE *out;
+    output_format format;
+    bool first_row;
+
+    /* Every row so far, kept for --compare. */
+    bench_row *rows;
+    size_t count;
+    size_t capacity;
+} bench_output;
+
+static void report(bench_output *output, const bench_row *row)
+{
+    if (output->out == NULL) {
+        return;
+    }
+
+    if (output->format == FORMAT_CSV) {
+        fprintf(output->out, "%s,%s,%s,%zu,%zu,%.2f,%.2f,%.2f,%.1f,%llu,%zu,%zu,%zu,%zu\n", row->sig->name, row->strategy,
+            op_names[row->op], row->message_bytes, row->iterations, (double)row->min_ns / 1e3, (double)row->median_ns / 1e3,
+            (double)row->p99_ns / 1e3, row->ops_per_sec, (unsigned long long)(row->peak_rss / 1024), row->sizes.public_key,
+            row->sizes.private_key, row->sizes.state, row->sizes.signature);
+    } else {
+        /* One row per line; --compare relies on that. */
+        fprintf(output->out, "%s  {\"sig\": \"%s\", \"strategy\": \"%s\", \"operation\": \"%s\", \"message_bytes\": %zu, "
+            "\"iterations\": %zu, \"min_us\": %.2f, \"median_us\": %.2f, \"p99_us\": %.2f, \"ops_per_sec\": %.1f, "
+            "\"peak_rss_kb\": %llu, \"public_key_bytes\": %zu, \"private_key_bytes\": %zu, \"state_bytes\": %zu, "
+            "\"signature_bytes\": %zu}", output->first_row ? "" : ",\n", row->sig->name, row->strategy, op_names[row->op],
+            row->message_bytes, row->iterations, (double)row->min_ns / 1e3, (double)row->median_ns / 1e3,
+            (double)row->p99_ns / 1e3, row->ops_per_sec, (unsigned long long)(row->peak_rss / 1024), row->sizes.public_key,
+            row->sizes.private_key, row->sizes.state, row->sizes.signature);
+    }
+    fflush(output->out);
+    output->first_row = false;
+}
+
+static iqr_retval add_row(bench_output *output, const bench_row *row)
+{
+    if (output->count == output->capacity) {
+        const size_t capacity = (output->capacity == 0) ? 64 : output->capacity * 2;
+        bench_row *rows = realloc(output->rows, capacity * sizeof(*rows));
+        if (rows == NULL) {
+            fprintf(stderr, "Failed on realloc(): %s\n", strerror(errno));
+            return IQR_ENOMEM;
+        }
+        output->rows = rows;
+        output->capacity = capacity;
+    }
+    output->rows[output->count++] = *row;
+
+    report(output, row);
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmark driver.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    const sig_scheme *sig;
+    const void *params;
+    sig_sizes sizes;
+    const iqr_RNG *rng;
+
+    /* SHA2-512, for the schemes that sign a digest. */
+    iqr_Hash *hash;
+
+    void *pub;
+    void *priv;
+    void *state;
+    uint64_t signatures_made;
+
+    /* One entry per iteration. */
+    uint64_t *samples;
+} bench_run;
+
+static int compare_u64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorts the samples in place. */
+static void summarize(uint64_t *samples, size_t count, uint64_t elapsed, bench_row *row)
+{
+    qsort(samples, count, sizeof(*samples), compare_u64);
+
+    row->iterations = count;
+    row->min_ns = samples[0];
+    row->median_ns = samples[count / 2];
+    row->p99_ns = samples[(count * 99) / 100];
+    row->ops_per_sec = (elapsed > 0) ? (double)count * 1e9 / (double)elapsed : 0.0;
+}
+
+static void destroy_keys(bench_run *run)
+{
+    if (run->pub != NULL) {
+        run->sig->destroy_public_key(&run->pub);
+    }
+    if (run->priv != NULL) {
+        run->sig->destroy_private_key(&run->priv);
+    }
+    if (run->state != NULL) {
+        run->sig->destroy_state(&run->state);
+    }
+}
+
+static iqr_retval time_keygen(bench_run *run, size_t iterations, bench_row *row)
+{
+    const uint64_t phase_start = time_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        /* Keep the last key pair for signing. */
+        destroy_keys(run);
+
+        const uint64_t t0 = time_now_ns();
+        iqr_retval ret = run->sig->create_key_pair(run->params, run->rng, &run->pub, &run->priv, &run->state);
+        run->samples[i] = time_now_ns() - t0;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    summarize(run->samples, iterations, time_now_ns() - phase_start, row);
+    run->signatures_made = 0;
+
+    return IQR_OK;
+}
+
+/* The stateful schemes sign a digest, so hashing the message is part of
+ * their cost.
+ */
+static iqr_retval prepare_message(bench_run *run, const uint8_t *message, size_t message_size, uint8_t *digest,
+    const uint8_t **to_sign, size_t *to_sign_size)
+{
+    if (run->sig->digest_size == 0) {
+        *to_sign = message;
+        *to_sign_size = message_size;
+        return IQR_OK;
+    }
+
+    iqr_retval ret = iqr_HashMessage(run->hash, message, message_size, digest, run->sig->digest_size);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_HashMessage(): %s\n", iqr_StrError(ret));
+        return ret;
+    }
+    *to_sign = digest;
+    *to_sign_size = run->sig->digest_size;
+    return IQR_OK;
+}
+
+static iqr_retval time_sign(bench_run *run, const uint8_t *message, size_t message_size, size_t iterations, uint8_t *sig,
+    bench_row *row)
+{
+    uint8_t digest[IQR_SHA2_512_DIGEST_SIZE] = { 0 };
+
+    const uint64_t phase_start = time_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        const uint8_t *to_sign = NULL;
+        size_t to_sign_size = 0;
+
+        const uint64_t t0 = time_now_ns();
+        iqr_retval ret = prepare_message(run, message, message_size, digest, &to_sign, &to_sign_size);
+        if (ret == IQR_OK) {
+            ret = run->sig->sign(run->priv, run->rng, run->state, to_sign, to_sign_size, sig, run->sizes.signature);
+        }
+        run->samples[i] = time_now_ns() - t0;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+        run->signatures_made++;
+    }
+    summarize(run->samples, iterations, time_now_ns() - phase_start, row);
+
+    return IQR_OK;
+}
+
+static iqr_retval time_verify(bench_run *run, const uint8_t *message, size_t message_size, size_t iterations, const uint8_t *sig,
+    bench_row *row)
+{
+    uint8_t digest[IQR_SHA2_512_DIGEST_SIZE] = { 0 };
+
+    const uint64_t phase_start = time_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        const uint8_t *to_verify = NULL;
+        size_t to_verify_size = 0;
+
+        const uint64_t t0 = time_now_ns();
+        iqr_retval ret = prepare_message(run, message, message_size, digest, &to_verify, &to_verify_size);
+        if (ret == IQR_OK) {
+            ret = run->sig->verify(run->pub, to_verify, to_verify_size, sig, run->sizes.signature);
+            if (ret != IQR_OK) {
+                fprintf(stderr, "%s: the signature didn't verify: %s\n", run->sig->name, iqr_StrError(ret));
+            }
+        }
+        run->samples[i] = time_now_ns() - t0;
+        if (ret != IQR_OK) {
+            return ret;
+        }
+    }
+    summarize(run->samples, iterations, time_now_ns() - phase_start, row);
+
+    return IQR_OK;
+}
+
+static iqr_retval bench_sig(const iqr_Context *ctx, const sig_scheme *sig, sig_strategy strategy, const iqr_RNG *rng,
+    const size_t *message_sizes, size_t message_size_count, size_t iterations, size_t keygen_iterations, bench_output *output)
+{
+    void *params = NULL;
+    uint8_t *message = NULL;
+    uint8_t *signature = NULL;
+
+    bench_run run;
+    memset(&run, 0, sizeof(run));
+    run.sig = sig;
+    run.rng = rng;
+
+    bench_row rows[1 + 2 * MAX_MESSAGE_SIZES];
+    size_t row_count = 0;
+    memset(rows, 0, sizeof(rows));
+
+    iqr_retval ret = sig->create_params(ctx, strategy, &params);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    run.params = params;
+
+    ret = sig->get_sizes(params, &run.sizes);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+
+    if (sig->digest_size != 0) {
+        ret = iqr_HashCreate(ctx, IQR_HASHALGO_SHA2_512, &run.hash);
+        if (ret != IQR_OK) {
+            fprintf(stderr, "Failed on iqr_HashCreate(): %s\n", iqr_StrError(ret));
+            goto end;
+        }
+    }
+
+    size_t largest_message = 0;
+    for (size_t m = 0; m < message_size_count; m++) {
+        if (message_sizes[m] > largest_message) {
+            largest_message = message_sizes[m];
+        }
+    }
+
+    run.samples = calloc((iterations > keygen_iterations) ? iterations : keygen_iterations, sizeof(uint64_t));
+    message = calloc(1, largest_message);
+    signature = calloc(1, run.sizes.signature);
+    if (run.samples == NULL || message == NULL || signature == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        ret = IQR_ENOMEM;
+        goto end;
+    }
+
+    ret = iqr_RNGGetBytes(rng, message, largest_message);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on iqr_RNGGetBytes(): %s\n", iqr_StrError(ret));
+        goto end;
+    }
+
+    ret = time_keygen(&run, keygen_iterations, &rows[row_count]);
+    if (ret != IQR_OK) {
+        goto end;
+    }
+    rows[row_count++].op = OP_KEYGEN;
+
+    for (size_t m = 0; m < message_size_count; m++) {
+        /* A stateful key only has so many signatures; share what's left
+         * between the remaining message sizes.
+         */
+        size_t count = iterations;
+        if (sig->stateful) {
+            const uint64_t budget = (run.sizes.max_signatures - run.signatures_made) / (message_size_count - m);
+            if (budget < count) {
+                count = (size_t)budget;
+            }
+        }
+        if (count == 0) {
+            fprintf(stderr, "%s: the key has no signatures left for %zu byte messages.\n", sig->name, message_sizes[m]);
+            continue;
+        }
+
+        ret = time_sign(&run, message, message_sizes[m], count, signature, &rows[row_count]);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        rows[row_count].op = OP_SIGN;
+        rows[row_count++].message_bytes = message_sizes[m];
+
+        ret = time_verify(&run, message, message_sizes[m], count, signature, &rows[row_count]);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        rows[row_count].op = OP_VERIFY;
+        rows[row_count++].message_bytes = message_sizes[m];
+    }
+
+    /* Peak RSS only ever grows, so it covers every variant run so far. Run
+     * one variant per process to see each one on its own.
+     */
+    const uint64_t rss = peak_rss_bytes();
+    for (size_t r = 0; r < row_count && ret == IQR_OK; r++) {
+        rows[r].sig = sig;
+        rows[r].strategy = sig->stateful ? sig_strategy_name(strategy) : "";
+        rows[r].peak_rss = rss;
+        rows[r].sizes = run.sizes;
+        ret = add_row(output, &rows[r]);
+    }
+
+end:
+    destroy_keys(&run);
+    iqr_HashDestroy(&run.hash);
+    free(run.samples);
+    free(message);
+    free(signature);
+    if (params != NULL) {
+        sig->destroy_params(&params);
+    }
+
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Regression checks against a baseline.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+    char sig[MAX_LINE_FIELD];
+    char strategy[MAX_LINE_FIELD];
+    char operation[MAX_LINE_FIELD];
+    size_t message_bytes;
+    double median_us;
+} baseline_row;
+
+/* Find "key": in a line and return what follows it, or NULL. */
+static const char *find_field(const char *line, const char *key)
+{
+    char pattern[MAX_LINE_FIELD + 4];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+    const char *p = strstr(line, pattern);
+    if (p == NULL) {
+        return NULL;
+    }
+    p += strlen(pattern);
+    while (*p == ' ') {
+        p++;
+    }
+    return p;
+}
+
+static bool get_string_field(const char *line, const char *key, char *value, size_t value_size)
+{
+    const char *p = find_field(line, key);
+    if (p == NULL || *p != '"') {
+        return false;
+    }
+    p++;
+
+    const char *end = strchr(p, '"');
+    if (end == NULL || (size_t)(end - p) >= value_size) {
+        return false;
+    }
+    memcpy(value, p, (size_t)(end - p));
+    value[end - p] = '\0';
+    return true;
+}
+
+static bool get_number_field(const char *line, const char *key, double *value)
+{
+    const char *p = find_field(line, key);
+    if (p == NULL) {
+        return false;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    *value = strtod(p, &end);
+    return errno == 0 && end != p;
+}
+
+/* This only reads what sig_bench --format json writes: one row per line. */
+static iqr_retval load_baseline(const char *fname, baseline_row **rows, size_t *count)
+{
+    const uint8_t *data = NULL;
+    size_t data_size = 0;
+    *rows = NULL;
+    *count = 0;
+
+    iqr_retval ret = map_data(fname, &data, &data_size);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    char *text = calloc(1, data_size + 1);
+    if (text == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        unmap_data(data, data_size);
+        return IQR_ENOMEM;
+    }
+    if (data_size > 0) {
+        memcpy(text, data, data_size);
+    }
+    unmap_data(data, data_size);
+
+    /* There's at most one row per line. */
+    size_t lines = 1;
+    for (size_t i = 0; i < data_size; i++) {
+        if (text[i] == '\n') {
+            lines++;
+        }
+    }
+    *rows = calloc(lines, sizeof(**rows));
+    if (*rows == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        free(text);
+        return IQR_ENOMEM;
+    }
+
+    char *line = text;
+    while (line != NULL && *line != '\0') {
+        char *next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+
+        baseline_row *row = &(*rows)[*count];
+        double message_bytes = 0.0;
+        if (get_string_field(line, "sig", row->sig, sizeof(row->sig))
+            && get_string_field(line, "strategy", row->strategy, sizeof(row->strategy))
+            && get_string_field(line, "operation", row->operation, sizeof(row->operation))
+            && get_number_field(line, "message_bytes", &message_bytes)
+            && get_number_field(line, "median_us", &row->median_us)) {
+            row->message_bytes = (size_t)message_bytes;
+            (*count)++;
+        }
+
+        line = next;
+    }
+    free(text);
+
+    if (*count == 0) {
+        fprintf(stderr, "%s doesn't contain any sig_bench results.\n", fname);
+        free(*rows);
+        *rows = NULL;
+        return IQR_EINVDATA;
+    }
+
+    return IQR_OK;
+}
+
+/* Compare median times. Returns IQR_OK if nothing got slower by more than
+ * the tolerance.
+ */
+static iqr_retval compare_results(const bench_output *output, const char *baseline_file, double tolerance)
+{
+    baseline_row *baseline = NULL;
+    size_t baseline_count = 0;
+
+    iqr_retval ret = load_baseline(baseline_file, &baseline, &baseline_count);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    size_t compared = 0;
+    size_t regressed = 0;
+    fprintf(stdout, "Comparing median times with %s (tolerance %.1f%%):\n", baseline_file, tolerance);
+    for (size_t r = 0; r < output->count; r++) {
+        const bench_row *row = &output->rows[r];
+        const double median_us = (double)row->median_ns / 1e3;
+
+        const baseline_row *match = NULL;
+        for (size_t b = 0; b < baseline_count && match == NULL; b++) {
+            if (strcmp(baseline[b].sig, row->sig->name) == 0 && strcmp(baseline[b].strategy, row->strategy) == 0
+                && strcmp(baseline[b].operation, op_names[row->op]) == 0 && baseline[b].message_bytes == row->message_bytes) {
+                match = &baseline[b];
+            }
+        }
+
+        fprintf(stdout, "    %s%s%s %s", row->sig->name, row->strategy[0] != '\0' ? "/" : "", row->strategy,
+            op_names[row->op]);
+        if (row->op != OP_KEYGEN) {
+            fprintf(stdout, " %zu bytes", row->message_bytes);
+        }
+        fprintf(stdout, ": ");
+        if (match == NULL || match->median_us <= 0.0) {
+            fprintf(stdout, "%.2f us, not in the baseline\n", median_us);
+            continue;
+        }
+
+        const double change = (median_us - match->median_us) * 100.0 / match->median_us;
+        const bool slower = change > tolerance;
+        fprintf(stdout, "%.2f us -> %.2f us (%+.1f%%)%s\n", match->median_us, median_us, change, slower ? " REGRESSION" : "");
+        compared++;
+        if (slower) {
+            regressed++;
+        }
+    }
+    fprintf(stdout, "%zu of %zu results regressed.\n", regressed, compared);
+
+    free(baseline);
+    return (regressed == 0) ? IQR_OK : IQR_EOUTOFRANGE;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// This next section of code is related to the toolkit, but is not specific to
+// any one signature scheme.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static iqr_retval init_toolkit(iqr_Context **ctx, const bool *use_sig)
+{
+    /* Create a Context. */
+    iqr_retval ret = bootstrap_context(NULL, 0, ctx);
+    if (ret != IQR_OK) {
+        return ret;
+    }
+
+    /* Register the hashes every selected scheme needs, plus the DRBG's. */
+    for (size_t s = 0; s < sig_scheme_count; s++) {
+        if (use_sig[s]) {
+            ret = sig_bootstrap_context(&sig_schemes[s], ctx);
+            if (ret != IQR_OK) {
+                return ret;
+            }
+        }
+    }
+
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// These functions are designed to help the end user understand how to use
+// this sample and hold little value to the developer trying to learn how to
+// use the toolkit.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+/* Parse a parameter string which is supposed to be a positive integer
+ * and return the value or -1 if the string is not properly formatted.
+ */
+static int32_t get_positive_int_param(const char *p) {
+    char *end = NULL;
+    errno = 0;
+    const long l = strtol(p, &end, 10);
+    // Check for conversion errors.
+    if (errno != 0) {
+        return -1;
+    }
+    // Check that the string contained only a number and nothing else.
+    if (end == NULL || end == p || *end != '\0' ) {
+        return -1;
+    }
+    if (l < 0 || l > INT_MAX) {
+        return -1;
+    }
+    return (int32_t)l;
+}
+
+/* Parse a comma separated list of positive integers. */
+static iqr_retval get_message_sizes(const char *p, size_t *sizes, size_t *count)
+{
+    *count = 0;
+    while (*p != '\0') {
+        char *end = NULL;
+        errno = 0;
+        const long l = strtol(p, &end, 10);
+        if (errno != 0 || end == p || l <= 0 || l > INT_MAX || *count == MAX_MESSAGE_SIZES) {
+            return IQR_EBADVALUE;
+        }
+        sizes[(*count)++] = (size_t)l;
+
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return IQR_EBADVALUE;
+        }
+        p = end;
+    }
+    return (*count > 0) ? IQR_OK : IQR_EBADVALUE;
+}
+
+/* Parse a comma separated list of names from a table, or "all". */
+static iqr_retval get_names(const char *p, const char *(*name_at)(size_t), size_t name_count, bool *use)
+{
+    if (paramcmp(p, "all") == 0) {
+        for (size_t n = 0; n < name_count; n++) {
+            use[n] = true;
+        }
+        return IQR_OK;
+    }
+
+    for (size_t n = 0; n < name_count; n++) {
+        use[n] = false;
+    }
+
+    while (*p != '\0') {
+        const char *end = strchr(p, ',');
+        const size_t len = (end != NULL) ? (size_t)(end - p) : strlen(p);
+
+        bool found = false;
+        for (size_t n = 0; n < name_count; n++) {
+            const char *name = name_at(n);
+            if (strlen(name) == len && strncmp(name, p, len) == 0) {
+                use[n] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            return IQR_EBADVALUE;
+        }
+
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return IQR_OK;
+}
+
+static const char *sig_name_at(size_t n)
+{
+    return sig_schemes[n].name;
+}
+
+static const sig_strategy strategies[] = { SIG_STRATEGY_CPU, SIG_STRATEGY_MEMORY, SIG_STRATEGY_FULL };
+#define STRATEGY_COUNT (sizeof(strategies) / sizeof(strategies[0]))
+
+static const char *strategy_name_at(size_t n)
+{
+    return sig_strategy_name(strategies[n]);
+}
+
+static iqr_retval parse_commandline(int argc, const char **argv, bool *use_sig, bool *use_strategy, size_t *message_sizes,
+    size_t *message_size_count, size_t *iterations, size_t *keygen_iterations, output_format *format, const char **output,
+    const char **baseline, double *tolerance)
+{
+    int i = 1;
+    while (i != argc) {
+        if (i + 2 > argc) {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+
+        if (paramcmp(argv[i], "--sig") == 0) {
+            /* [--sig all|<sig>[,<sig>...]] */
+            i++;
+            if (get_names(argv[i], sig_name_at, sig_scheme_count, use_sig) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--strategy") == 0) {
+            /* [--strategy <strategy>[,<strategy>...]] */
+            i++;
+            if (get_names(argv[i], strategy_name_at, STRATEGY_COUNT, use_strategy) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--message-sizes") == 0) {
+            /* [--message-sizes <bytes>[,<bytes>...]] */
+            i++;
+            if (get_message_sizes(argv[i], message_sizes, message_size_count) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--iterations") == 0 || paramcmp(argv[i], "--keygen-iterations") == 0) {
+            /* [--iterations <count>] [--keygen-iterations <count>] */
+            const bool keygen = paramcmp(argv[i], "--keygen-iterations") == 0;
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value <= 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            if (keygen) {
+                *keygen_iterations = (size_t)value;
+            } else {
+                *iterations = (size_t)value;
+            }
+        } else if (paramcmp(argv[i], "--format") == 0) {
+            /* [--format csv|json] */
+            i++;
+            if (paramcmp(argv[i], "csv") == 0) {
+                *format = FORMAT_CSV;
+            } else if (paramcmp(argv[i], "json") == 0) {
+                *format = FORMAT_JSON;
+            } else {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+        } else if (paramcmp(argv[i], "--output") == 0) {
+            /* [--output <filename>] */
+            i++;
+            *output = argv[i];
+        } else if (paramcmp(argv[i], "--compare") == 0) {
+            /* [--compare <baseline>] */
+            i++;
+            *baseline = argv[i];
+        } else if (paramcmp(argv[i], "--tolerance") == 0) {
+            /* [--tolerance <percent>] */
+            i++;
+            const int32_t value = get_positive_int_param(argv[i]);
+            if (value < 0) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
+            *tolerance = (double)value;
+        } else {
+            fprintf(stdout, "%s", usage_msg);
+            return IQR_EBADVALUE;
+        }
+        i++;
+    }
+    return IQR_OK;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Executable entry point.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char **argv)
+{
+    /* Default values.  Please adjust the usage message if you make changes
+     * here.
+     */
+    bool *use_sig = calloc(sig_scheme_count, sizeof(*use_sig));
+    bool use_strategy[STRATEGY_COUNT] = { true, true, true };
+    size_t message_sizes[MAX_MESSAGE_SIZES] = { 32, 1024, 65536 };
+    size_t message_size_count = 3;
+    size_t iterations = 100;
+    size_t keygen_iterations = 5;
+    output_format format = FORMAT_CSV;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    double tolerance = 10.0;
+
+    iqr_Context *ctx = NULL;
+    rng_pool *rngs = NULL;
+    iqr_RNG *rng = NULL;
+
+    if (use_sig == NULL) {
+        fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    for (size_t s = 0; s < sig_scheme_count; s++) {
+        use_sig[s] = true;
+    }
+
+    iqr_retval ret = parse_commandline(argc, argv, use_sig, use_strategy, message_sizes, &message_size_count, &iterations,
+        &keygen_iterations, &format, &output, &baseline, &tolerance);
+    if (ret != IQR_OK) {
+        free(use_sig);
+        return EXIT_FAILURE;
+    }
+
+    bench_output results;
+    memset(&results, 0, sizeof(results));
+    results.format = format;
+    results.first_row = true;
+
+    /* When comparing, the comparison goes to stdout and the results are
+     * only kept if they have somewhere else to go.
+     */
+    if (output != NULL) {
+        results.out = fopen(output, "w");
+        if (results.out == NULL) {
+            fprintf(stderr, "Failed to open %s: %s\n", output, strerror(errno));
+            free(use_sig);
+            return EXIT_FAILURE;
+        }
+    } else if (baseline == NULL) {
+        results.out = stdout;
+    }
+
+    ret = init_toolkit(&ctx, use_sig);
+    if (ret != IQR_OK) {
+        goto cleanup;
+    }
+
+    /* The benchmark is single threaded; the pool just takes care of seeding. */
+    ret = rng_pool_create(ctx, NULL, &rngs);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_create(): %s\n", iqr_StrError(ret));
+        goto cleanup;
+    }
+    ret = rng_pool_thread_rng(rngs, &rng);
+    if (ret != IQR_OK) {
+        fprintf(stderr, "Failed on rng_pool_thread_rng(): %s\n", iqr_StrError(ret));
+        goto cleanup;
+    }
+
+    if (results.out != NULL) {
+        if (format == FORMAT_CSV) {
+            fprintf(results.out, "sig,strategy,operation,message_bytes,iterations,min_us,median_us,p99_us,ops_per_sec,"
+                "peak_rss_kb,public_key_bytes,private_key_bytes,state_bytes,signature_bytes\n");
+        } else {
+            fprintf(results.out, "[\n");
+        }
+    }
+
+    for (size_t s = 0; s < sig_scheme_count && ret == IQR_OK; s++) {
+        if (!use_sig[s]) {
+            continue;
+        }
+        if (!sig_schemes[s].stateful) {
+            ret = bench_sig(ctx, &sig_schemes[s], SIG_STRATEGY_FULL, rng, message_sizes, message_size_count, iterations,
+                keygen_iterations, &results);
+            continue;
+        }
+        for (size_t t = 0; t < STRATEGY_COUNT && ret == IQR_OK; t++) {
+            if (use_strategy[t]) {
+                ret = bench_sig(ctx, &sig_schemes[s], strategies[t], rng, message_sizes, message_size_count, iterations,
+                    keygen_iterations, &results);
+            }
+        }
+    }
+
+    if (results.out != NULL && format == FORMAT_JSON) {
+        fprintf(results.out, "\n]\n");
+    }
+
+    /* The one-off set-up cost, kept out of the results. */
+    bootstrap_print_stats(stderr);
+
+    if (ret == IQR_OK && baseline != NULL) {
+        ret = compare_results(&results, baseline, tolerance);
+    }
+
+cleanup:
+    rng_pool_destroy(&rngs);
+    bootstrap_release();
+    if (results.out != NULL && results.out != stdout) {
+        fclose(results.out);
+    }
+    free(results.rows);
+    free(use_sig);
+
+    return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
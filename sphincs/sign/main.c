@@ -21,14 +21,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_sphincs.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
 #include "iqr_rng.h"
 #include "isara_samples.h"
+#include "prehash.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -39,11 +40,15 @@ static const char *usage_msg =
 "  [--variant shake192f|shake192s|shake256f|shake256s|sha192f|sha192s|sha256f\n"
 "    |sha256s]\n"
 "  [--sig filename] [--priv <filename>] [--message <filename>]\n"
+"  [--prehash none|sha2-512|sha3-512]\n"
 "    Defaults are: \n"
 "        --variant 192f\n"
 "        --sig sig.dat\n"
 "        --priv priv.key\n"
-"        --message message.dat\n";
+"        --message message.dat\n"
+"        --prehash none\n"
+"  --prehash signs a digest of the message instead of the message itself, so\n"
+"  the message can be any size; with it, --message - reads standard input.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases signing of a digest using the SPHINCS+ signature
@@ -51,7 +56,7 @@ static const char *usage_msg =
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static iqr_retval showcase_sphincs_sign(const iqr_Context *ctx, const iqr_RNG *rng, const iqr_SPHINCSVariant *variant,
-    const char *priv_file, const char *message_file, const char *sig_file)
+    const char *priv_file, const char *message_file, const char *sig_file, prehash_mode prehash)
 {
     iqr_SPHINCSParams *params = NULL;
     iqr_SPHINCSPrivateKey *priv = NULL;
@@ -86,7 +91,16 @@ static iqr_retval showcase_sphincs_sign(const iqr_Context *ctx, const iqr_RNG *r
     fprintf(stdout, "Private key has been imported.\n");
 
     /* Load the message. */
-    ret = load_data(message_file, &message, &message_size);
+    if (prehash != PREHASH_NONE) {
+        /* Stream the message through the hash instead of loading it. */
+        ret = prehash_message(ctx, prehash, message_file, &message, &message_size);
+    } else {
+        ret = load_data(message_file, &message, &message_size);
+        if (ret == IQR_OK && prehash_is_stand_in(message, message_size)) {
+            fprintf(stderr, "%s starts like a pre-hash stand-in message; it can only be signed with --prehash.\n", message_file);
+            ret = IQR_EINVDATA;
+        }
+    }
     if (ret != IQR_OK) {
         goto end;
     }
@@ -146,41 +160,16 @@ end:
 
 static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 {
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA3_512, IQR_HASHALGO_SHA2_512, IQR_HASHALGO_SHA2_256 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA3_512, &IQR_HASH_DEFAULT_SHA3_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This lets us give satisfactory randomness to the algorithm. */
-    ret =  iqr_RNGCreateHMACDRBG(*ctx, IQR_HASHALGO_SHA3_512, rng);
+    /* Create an HMAC DRBG object, seeded from the system's entropy source. */
+    ret = bootstrap_rng(IQR_HASHALGO_SHA3_512, rng);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* The seed should be initialized from a guaranteed entropy source. This is
-     * only an example; DO NOT INITIALIZE THE SEED LIKE THIS.
-     */
-    time_t seed = time(NULL);
-
-    ret = iqr_RNGInitialize(*rng, (uint8_t *)&seed, sizeof(seed));
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -197,7 +186,8 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng)
 // Report the chosen runtime parameters.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-static void preamble(const char *cmd, const iqr_SPHINCSVariant *variant, const char *sig, const char *priv, const char *message)
+static void preamble(const char *cmd, const iqr_SPHINCSVariant *variant, const char *sig, const char *priv, const char *message,
+    prehash_mode prehash)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     if (variant == &IQR_SPHINCS_SHAKE_256_192F) {
@@ -221,11 +211,14 @@ static void preamble(const char *cmd, const iqr_SPHINCSVariant *variant, const c
     fprintf(stdout, "    signature file: %s\n", sig);
     fprintf(stdout, "    private key file: %s\n", priv);
     fprintf(stdout, "    message data file: %s\n", message);
+    if (prehash != PREHASH_NONE) {
+        fprintf(stdout, "    pre-hash: %s\n", prehash_name(prehash));
+    }
     fprintf(stdout, "\n");
 }
 
 static iqr_retval parse_commandline(int argc, const char **argv, const iqr_SPHINCSVariant **variant, const char **sig,
-    const char **priv, const char **message)
+    const char **priv, const char **message, prehash_mode *prehash)
 {
     int i = 1;
     while (i != argc) {
@@ -264,6 +257,13 @@ static iqr_retval parse_commandline(int argc, const char **argv, const iqr_SPHIN
            /* [--message <filename>] */
            i++;
            *message = argv[i];
+        } else if (paramcmp(argv[i], "--prehash") == 0) {
+            /* [--prehash none|sha2-512|sha3-512] */
+            i++;
+            if (prehash_parse(argv[i], prehash) != IQR_OK) {
+                fprintf(stdout, "%s", usage_msg);
+                return IQR_EBADVALUE;
+            }
         } else {
             fprintf(stdout, "%s", usage_msg);
             return IQR_EBADVALUE;
@@ -288,6 +288,7 @@ int main(int argc, const char **argv)
     const char *sig = "sig.dat";
     const char *priv = "priv.key";
     const char *message = "message.dat";
+    prehash_mode prehash = PREHASH_NONE;
 
     iqr_Context *ctx = NULL;
     iqr_RNG *rng = NULL;
@@ -295,13 +296,13 @@ int main(int argc, const char **argv)
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &variant, &sig, &priv, &message);
+    iqr_retval ret = parse_commandline(argc, argv, &variant, &sig, &priv, &message, &prehash);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], variant, sig, priv, message);
+    preamble(argv[0], variant, sig, priv, message, prehash);
 
     /* IQR initialization that is not specific to SPHINCS+. */
     ret = init_toolkit(&ctx, &rng);
@@ -310,9 +311,9 @@ int main(int argc, const char **argv)
     }
 
     /* Showcase the generation of a SPHINCS+ signature. */
-    ret = showcase_sphincs_sign(ctx, rng, variant, priv, message, sig);
+    ret = showcase_sphincs_sign(ctx, rng, variant, priv, message, sig, prehash);
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    bootstrap_release();
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
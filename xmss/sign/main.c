@@ -22,14 +22,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
 #include "iqr_rng.h"
 #include "iqr_xmss.h"
 #include "isara_samples.h"
+#include "merkle_batch.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -38,13 +39,17 @@
 static const char *usage_msg =
 "xmss_sign [--sig filename] [--priv <filename>] [--state <filename>]\n"
 "  [--variant 10|16|20] [--strategy cpu|memory|full] [--message <filename>]\n"
+"  [--batch <filename>]\n"
 "    Defaults are: \n"
 "        --sig sig.dat\n"
 "        --priv priv.key\n"
 "        --state priv.state\n"
 "        --variant 10\n"
 "        --strategy full\n"
-"        --message message.dat\n";
+"        --message message.dat\n"
+"  --batch names a file listing one message file per line. The messages are\n"
+"  signed together with one signature over a Merkle tree of their digests,\n"
+"  and each message's inclusion proof is saved as <message>.proof.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases signing of a digest using the XMSS signature scheme.
@@ -244,45 +249,22 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng, const char *mes
     uint8_t *message_raw = NULL;
     size_t message_raw_size = 0;
 
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256, IQR_HASHALGO_SHA2_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* SHA2-512 produces a 64-byte digest, which is required by iqr_XMSSSign.
-     * Any 64-byte digest is suitable for signing.
-     */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_512, &IQR_HASH_DEFAULT_SHA2_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This will let us give satisfactory randomness to the algorithm. */
-    ret =  iqr_RNGCreateHMACDRBG(*ctx, IQR_HASHALGO_SHA2_256, rng);
+    /* Create an HMAC DRBG object, seeded from the system's entropy source. */
+    ret = bootstrap_rng(IQR_HASHALGO_SHA2_256, rng);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGCreateHMACDRBG(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
-    /* The seed should be initialized from a guaranteed entropy source. This is
-     * only an example; DO NOT INITIALIZE THE SEED LIKE THIS.
-     */
-    time_t seed = time(NULL);
-
-    ret = iqr_RNGInitialize(*rng, (uint8_t *)&seed, sizeof(seed));
-    if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_RNGInitialize(): %s\n", iqr_StrError(ret));
-        return ret;
+    /* In batch mode the messages are hashed into a Merkle tree instead. */
+    if (message == NULL) {
+        return IQR_OK;
     }
 
     /* Before we do any more work, lets make sure we can load the message
@@ -296,6 +278,11 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng, const char *mes
         fprintf(stderr, "Input message must be one or more bytes long.\n");
         return IQR_EINVBUFSIZE;
     }
+    if (merkle_is_stand_in(message_raw, message_raw_size)) {
+        fprintf(stderr, "%s starts like a Merkle batch's signed message; it can't be signed on its own.\n", message);
+        free(message_raw);
+        return IQR_EINVDATA;
+    }
 
     *digest = calloc(1, IQR_SHA2_512_DIGEST_SIZE);
     if (NULL == *digest) {
@@ -328,7 +315,7 @@ static iqr_retval init_toolkit(iqr_Context **ctx, iqr_RNG **rng, const char *mes
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static void preamble(const char *cmd, const char *sig, const char *priv, const char *state, const iqr_XMSSVariant *variant,
-    const iqr_XMSSTreeStrategy *strategy, const char *message)
+    const iqr_XMSSTreeStrategy *strategy, const char *message, const char *batch_file)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     fprintf(stdout, "    signature file: %s\n", sig);
@@ -355,12 +342,16 @@ static void preamble(const char *cmd, const char *sig, const char *priv, const c
         fprintf(stdout, "    strategy: INVALID\n");
     }
 
-    fprintf(stdout, "    message data file: %s\n", message);
+    if (batch_file != NULL) {
+        fprintf(stdout, "    message list file: %s\n", batch_file);
+    } else {
+        fprintf(stdout, "    message data file: %s\n", message);
+    }
     fprintf(stdout, "\n");
 }
 
 static iqr_retval parse_commandline(int argc, const char **argv, const char **sig, const char **priv, const char **state,
-    const iqr_XMSSVariant **variant, const iqr_XMSSTreeStrategy **strategy, const char **message)
+    const iqr_XMSSVariant **variant, const iqr_XMSSTreeStrategy **strategy, const char **message, const char **batch_file)
 {
     int i = 1;
     while (i != argc) {
@@ -398,6 +389,10 @@ static iqr_retval parse_commandline(int argc, const char **argv, const char **si
            /* [--message <filename>] */
            i++;
            *message = argv[i];
+        } else if (paramcmp(argv[i], "--batch") == 0) {
+            /* [--batch <filename>] */
+            i++;
+            *batch_file = argv[i];
         } else if (paramcmp(argv[i], "--strategy") == 0) {
             /* [--strategy cpu|memory|full] */
             i++;
@@ -431,37 +426,63 @@ int main(int argc, const char **argv)
     const char *priv = "priv.key";
     const char *state = "priv.state";
     const char *message = "message.dat";
+    const char *batch_file = NULL;
     const iqr_XMSSTreeStrategy *strategy = &IQR_XMSS_FULL_TREE_STRATEGY;
     const iqr_XMSSVariant *variant =  &IQR_XMSS_2E10;
 
     iqr_Context *ctx = NULL;
     iqr_RNG *rng = NULL;
     uint8_t *digest = NULL;
+    merkle_batch *batch = NULL;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &sig, &priv, &state, &variant, &strategy, &message);
+    iqr_retval ret = parse_commandline(argc, argv, &sig, &priv, &state, &variant, &strategy, &message, &batch_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], sig, priv, state, variant, strategy, message);
+    preamble(argv[0], sig, priv, state, variant, strategy, message, batch_file);
 
     /* IQR initialization that is not specific to XMSS. */
-    ret = init_toolkit(&ctx, &rng, message, &digest);
+    ret = init_toolkit(&ctx, &rng, (batch_file == NULL) ? message : NULL, &digest);
     if (ret != IQR_OK) {
         goto cleanup;
     }
 
+    /* In batch mode one signature covers every message: it signs a digest
+     * of a Merkle tree over the messages' digests, and each message gets
+     * an inclusion proof.
+     */
+    if (batch_file != NULL) {
+        ret = merkle_batch_create(ctx, batch_file, &batch);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+
+        digest = calloc(1, MERKLE_DIGEST_SIZE);
+        if (digest == NULL) {
+            fprintf(stderr, "Failed on calloc(): %s\n", strerror(errno));
+            ret = IQR_ENOMEM;
+            goto cleanup;
+        }
+        merkle_batch_signed_digest(batch, digest);
+
+        ret = merkle_batch_save_proofs(batch);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
     /* This function showcases the usage of XMSS signing.
      */
     ret = showcase_xmss_sign(ctx, rng, variant, strategy, digest, priv, state, sig);
 
 cleanup:
-    iqr_RNGDestroy(&rng);
-    iqr_DestroyContext(&ctx);
+    merkle_batch_destroy(&batch);
+    bootstrap_release();
     free(digest);
 
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -22,11 +22,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bootstrap.h"
 #include "iqr_context.h"
 #include "iqr_hash.h"
 #include "iqr_retval.h"
 #include "iqr_xmssmt.h"
 #include "isara_samples.h"
+#include "merkle_batch.h"
+#include "verify_cache.h"
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Document the command-line arguments.
@@ -35,12 +38,18 @@
 static const char *usage_msg =
 "xmssmt_verify [--sig <filename>] [--pub <filename>]\n"
 "  [--variant 2e20_2d|2e20_4d|2e40_2d|2e40_4d|2e40_8d|2e60_3d|2e60_6d|2e60_12d]\n"
-"  [--message <filename>]\n"
+"  [--message <filename>] [--proof <filename>]\n"
+"  [--cache <filename> --cache-key <filename>]\n"
 "    Defaults are: \n"
 "        --sig sig.dat\n"
 "        --pub pub.key\n"
 "        --variant 2e20_4d\n"
-"        --message message.dat\n";
+"        --message message.dat\n"
+"  --cache names a verify cache file; a signature found in it was verified\n"
+"  before and isn't checked again. --cache-key names the file holding the\n"
+"  cache's secret HMAC key (at least 32 bytes).\n"
+"  --proof names the message's inclusion proof from a batch signed with\n"
+"  xmssmt_sign --batch; the signature is the batch's signature.\n";
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // This function showcases the verification of an XMSS^MT signature against a
@@ -48,7 +57,7 @@ static const char *usage_msg =
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static iqr_retval showcase_xmssmt_verify(const iqr_Context *ctx, const iqr_XMSSMTVariant *variant,
-    const uint8_t *digest, const char *pub_file, const char *sig_file)
+    const uint8_t *digest, const char *pub_file, const char *sig_file, verify_cache *cache)
 {
     iqr_XMSSMTParams *params = NULL;
     iqr_XMSSMTPublicKey *pub = NULL;
@@ -59,6 +68,9 @@ static iqr_retval showcase_xmssmt_verify(const iqr_Context *ctx, const iqr_XMSSM
     size_t sig_size = 0;
     uint8_t *sig = NULL;
 
+    verify_cache_id cache_id;
+    memset(&cache_id, 0, sizeof(cache_id));
+
     /* The tree strategy chosen will have no effect on verification. */
     iqr_retval ret = iqr_XMSSMTCreateParams(ctx, &IQR_XMSSMT_VERIFY_ONLY_STRATEGY, variant, &params);
     if (ret != IQR_OK) {
@@ -77,6 +89,21 @@ static iqr_retval showcase_xmssmt_verify(const iqr_Context *ctx, const iqr_XMSSM
         goto end;
     }
 
+    /* A signature that verified on an earlier run is in the cache, so the
+     * toolkit doesn't need to check it again.
+     */
+    if (cache != NULL) {
+        ret = verify_cache_make_id(cache, "xmssmt", pub_raw, pub_raw_size, digest, IQR_SHA2_512_DIGEST_SIZE, sig, sig_size,
+            &cache_id);
+        if (ret != IQR_OK) {
+            goto end;
+        }
+        if (verify_cache_lookup(cache, &cache_id)) {
+            fprintf(stdout, "Found the XMSS^MT signature in the verify cache; it was verified before.\n");
+            goto end;
+        }
+    }
+
     /* Import the public key data and create a public key object. */
     ret = iqr_XMSSMTImportPublicKey(params, pub_raw, pub_raw_size, &pub);
     if (ret != IQR_OK) {
@@ -92,6 +119,9 @@ static iqr_retval showcase_xmssmt_verify(const iqr_Context *ctx, const iqr_XMSSM
     ret = iqr_XMSSMTVerify(pub, digest, IQR_SHA2_512_DIGEST_SIZE, sig, sig_size);
     if (ret == IQR_OK) {
         fprintf(stdout, "XMSS^MT verified the signature successfully!\n");
+        if (cache != NULL) {
+            ret = verify_cache_add(cache, &cache_id);
+        }
     } else {
         fprintf(stderr, "Failed on iqr_XMSSMTVerify(): %s\n", iqr_StrError(ret));
     }
@@ -145,26 +175,10 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
     uint8_t *message_raw = NULL;
     size_t message_raw_size = 0;
 
-    /* Create a Global Context. */
-    iqr_retval ret = iqr_CreateContext(ctx);
+    /* Create a context with the hash functions this sample uses registered. */
+    static const iqr_HashAlgorithmType hashes[] = { IQR_HASHALGO_SHA2_256, IQR_HASHALGO_SHA2_512 };
+    iqr_retval ret = bootstrap_context(hashes, sizeof(hashes) / sizeof(hashes[0]), ctx);
     if (ret != IQR_OK) {
-        fprintf(stderr, "Failed on iqr_CreateContext(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* This sets the hashing functions that will be used globally. */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_256, &IQR_HASH_DEFAULT_SHA2_256);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
-        return ret;
-    }
-
-    /* SHA2-512 produces a 64-byte digest, which is required by
-     * iqr_XMSSMTVerify.
-     */
-    ret = iqr_HashRegisterCallbacks(*ctx, IQR_HASHALGO_SHA2_512, &IQR_HASH_DEFAULT_SHA2_512);
-    if (IQR_OK != ret) {
-        fprintf(stderr, "Failed on iqr_HashRegisterCallbacks(): %s\n", iqr_StrError(ret));
         return ret;
     }
 
@@ -173,6 +187,11 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
     if (ret != IQR_OK) {
         return ret;
     }
+    if (merkle_is_stand_in(message_raw, message_raw_size)) {
+        fprintf(stderr, "%s starts like a Merkle batch's signed message; it can't be verified on its own.\n", message);
+        free(message_raw);
+        return IQR_EINVDATA;
+    }
 
     *digest = calloc(1, IQR_SHA2_512_DIGEST_SIZE);
     if (*digest == NULL) {
@@ -205,7 +224,7 @@ static iqr_retval init_toolkit(iqr_Context **ctx, const char *message, uint8_t *
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 static void preamble(const char *cmd, const char *sig, const char *pub, const iqr_XMSSMTVariant *variant,
-    const char *message)
+    const char *message, const char *proof_file, const char *cache_file)
 {
     fprintf(stdout, "Running %s with the following parameters...\n", cmd);
     fprintf(stdout, "    signature file: %s\n", sig);
@@ -232,11 +251,18 @@ static void preamble(const char *cmd, const char *sig, const char *pub, const iq
     }
 
     fprintf(stdout, "    message data file: %s\n", message);
+    if (proof_file != NULL) {
+        fprintf(stdout, "    inclusion proof file: %s\n", proof_file);
+    }
+    if (cache_file != NULL) {
+        fprintf(stdout, "    verify cache: %s\n", cache_file);
+    }
     fprintf(stdout, "\n");
 }
 
 static iqr_retval parse_commandline(int argc, const char **argv, const char **sig, const char **pub,
-    const iqr_XMSSMTVariant **variant, const char **message)
+    const iqr_XMSSMTVariant **variant, const char **message, const char **proof_file, const char **cache_file,
+    const char **cache_key_file)
 {
     int i = 1;
     while (i != argc) {
@@ -281,6 +307,18 @@ static iqr_retval parse_commandline(int argc, const char **argv, const char **si
            /* [--message <filename>] */
            i++;
            *message = argv[i];
+        } else if (paramcmp(argv[i], "--proof") == 0) {
+            /* [--proof <filename>] */
+            i++;
+            *proof_file = argv[i];
+        } else if (paramcmp(argv[i], "--cache") == 0) {
+            /* [--cache <filename>] */
+            i++;
+            *cache_file = argv[i];
+        } else if (paramcmp(argv[i], "--cache-key") == 0) {
+            /* [--cache-key <filename>] */
+            i++;
+            *cache_key_file = argv[i];
         } else {
             fprintf(stderr, "Unknown argument: %s", argv[i]);
             fprintf(stdout, "%s", usage_msg);
@@ -289,6 +327,12 @@ static iqr_retval parse_commandline(int argc, const char **argv, const char **si
         i++;
     }
 
+    /* The cache and its key go together. */
+    if ((*cache_file == NULL) != (*cache_key_file == NULL)) {
+        fprintf(stdout, "%s", usage_msg);
+        return IQR_EBADVALUE;
+    }
+
     return IQR_OK;
 }
 
@@ -303,21 +347,25 @@ int main(int argc, const char **argv)
     const char *sig = "sig.dat";
     const char *pub = "pub.key";
     const char *message = "message.dat";
+    const char *proof_file = NULL;
+    const char *cache_file = NULL;
+    const char *cache_key_file = NULL;
     const iqr_XMSSMTVariant *variant = &IQR_XMSSMT_2E20_4D;
 
     iqr_Context *ctx = NULL;
+    verify_cache *cache = NULL;
     uint8_t *digest = NULL;
 
     /* If the command line arguments were not sane, this function will return
      * an error.
      */
-    iqr_retval ret = parse_commandline(argc, argv, &sig, &pub, &variant, &message);
+    iqr_retval ret = parse_commandline(argc, argv, &sig, &pub, &variant, &message, &proof_file, &cache_file, &cache_key_file);
     if (ret != IQR_OK) {
         return EXIT_FAILURE;
     }
 
     /* Make sure the user understands what we are about to do. */
-    preamble(argv[0], sig, pub, variant, message);
+    preamble(argv[0], sig, pub, variant, message, proof_file, cache_file);
 
     /* IQR initialization that is not specific to XMSS^MT. */
     ret = init_toolkit(&ctx, message, &digest);
@@ -325,12 +373,32 @@ int main(int argc, const char **argv)
         goto cleanup;
     }
 
+    /* A message from a batch is covered by a signature over a digest of
+     * the batch's Merkle tree; its inclusion proof leads from the
+     * message's digest to that digest.
+     */
+    if (proof_file != NULL) {
+        ret = merkle_proof_signed_digest(ctx, digest, proof_file, digest);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
+    /* Signatures that verified on an earlier run skip the toolkit. */
+    if (cache_file != NULL) {
+        ret = verify_cache_open(ctx, cache_file, cache_key_file, VERIFY_CACHE_DEFAULT_SLOTS, &cache);
+        if (ret != IQR_OK) {
+            goto cleanup;
+        }
+    }
+
     /* This function showcases the usage of XMSS^MT signature verification.
      */
-    ret = showcase_xmssmt_verify(ctx, variant, digest, pub, sig);
+    ret = showcase_xmssmt_verify(ctx, variant, digest, pub, sig, cache);
 
 cleanup:
-    iqr_DestroyContext(&ctx);
+    verify_cache_close(&cache);
+    bootstrap_release();
     free(digest);
     return (ret == IQR_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }